@@ -3,10 +3,6 @@
 
 typedef BuiltInTriangleIntersectionAttributes Attributes;
 
-uint3 Load3x32BitIndices(uint offsetBytes, uint instID) {
-	return gIndices[instID].Load3(offsetBytes);
-}
-
 // Retrieve hit world position.
 float3 HitWorldPosition() {
 	return WorldRayOrigin() + RayTCurrent() * WorldRayDirection();
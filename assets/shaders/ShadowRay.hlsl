@@ -15,8 +15,9 @@ struct ShadowHitInfo {
 
 ConstantBuffer<PassConstants> cbPass		: register(b0);
 
-StructuredBuffer<Vertex> gVertices[64]		: register(t0, space1);
-ByteAddressBuffer gIndices[64]				: register(t0, space2);
+// Geometry pool arenas shared by every instance.
+StructuredBuffer<Vertex> gVertices			: register(t0, space1);
+ByteAddressBuffer gIndices					: register(t0, space2);
 
 RaytracingAccelerationStructure	gBVH		: register(t0);
 StructuredBuffer<ObjectData> gObjects		: register(t1);
@@ -24,8 +25,6 @@ StructuredBuffer<MaterialData> gMaterials	: register(t2);
 Texture2D<float> gDepthMap					: register(t3);
 RWTexture2D<float> gShadowMap				: register(u0);
 
-// Requirements:
-//  - ByteAddressBuffer gIndices[64]
 #include "DxrShadingHelpers.hlsli"
 
 [shader("raygeneration")]
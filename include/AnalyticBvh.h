@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Bvh.h"
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Shape intersected in closed form, the CPU side of a procedural-primitive AABB and the
+//  intersection shader that would go with it.
+struct AnalyticPrimitive {
+	enum Type {
+		ESphere = 0,
+		// Segment from P0 to P1 swept by Radius.
+		ECapsule,
+		// Axis-aligned from P0 to P1.
+		EBox
+	};
+
+	Type Shape = ESphere;
+	// Center of a sphere, first end of a capsule's segment or minimum corner of a box.
+	DirectX::XMFLOAT3 P0 = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 P1 = { 0.0f, 0.0f, 0.0f };
+	float Radius = 0.0f;
+};
+
+// Bottom level over analytic primitives; leaves hold boxes instead of triangles.
+struct AnalyticBvh {
+	std::vector<AnalyticPrimitive> Primitives;
+	// Over the primitives' bounds; leaves reference ranges of PrimitiveIndices.
+	std::vector<BvhNode> Nodes;
+	std::vector<UINT> PrimitiveIndices;
+};
+
+class AnalyticBvhBuilder {
+public:
+	// Binned SAH over the bounds of AnalyticBvh::Primitives.
+	static bool Build(AnalyticBvh& bvh, const BvhBuildDesc& desc, BvhBuildStats* pStats = nullptr);
+
+	static BvhBounds CalcBounds(const AnalyticPrimitive& primitive);
+
+	// Primitives, nodes and primitive indices.
+	static size_t CalcMemoryBytes(const AnalyticBvh& bvh);
+
+	// Scatters spheres over the ground like the stress scene and traces the same rays through a
+	//  two-level hierarchy over the tessellated sphere and one over its analytic stand-in: steep
+	//  rays down onto the field, and short occlusion rays from random points among the spheres.
+	static bool RunBenchmark(const Bvh& triangles, const AnalyticBvh& analytic, UINT instanceCount, UINT seed,
+		float density, UINT rayCount, float aoRadius, const BvhBuildDesc& desc);
+};
@@ -77,8 +77,21 @@
 
 #include "Renderer.h"
 
+#include <string>
+#include <vector>
+
 class Camera;
 
+// Stress-scene scaling run selected with -benchmark on the command line.
+struct SceneBenchmarkDesc {
+	bool Enabled = false;
+	std::vector<UINT> InstanceCounts = { 1000, 10000, 100000, 1000000 };
+	UINT Seed = 1;
+	// Frames averaged per instance count.
+	UINT FrameCount = 32;
+	std::wstring OutputFilename = L"./scene_benchmark.csv";
+};
+
 class Application {
 public:
 	enum EGameStates {
@@ -97,6 +110,10 @@ private:
 	Application& operator=(Application&& rval) = delete;
 
 public:
+	// Recognizes -benchmark, -benchmark-counts=<n,n,...>, -benchmark-seed=<n>,
+	//  -benchmark-frames=<n> and -benchmark-out=<file>.
+	bool ParseCommandLine(LPCSTR cmdLine);
+
 	bool Initialize();
 	HRESULT RunLoop();
 	void CleanUp();
@@ -115,6 +132,10 @@ private:
 
 	bool UpdateGame(const GameTimer& gt);
 
+	// Renders each stress scene of mBenchmarkDesc for a fixed number of frames and writes the
+	//  averaged per-stage CPU timings as CSV rows, one per instance count.
+	bool RunBenchmark();
+
 	void OnMouseDown(WPARAM state, int x, int y);
 	void OnMouseUp(WPARAM state, int x, int y);
 	void OnMouseMove(WPARAM state, int x, int y);
@@ -148,4 +169,6 @@ private:
 	UINT mPrimaryMonitorHeight;
 
 	EGameStates mGameState;
+
+	SceneBenchmarkDesc mBenchmarkDesc;
 };
\ No newline at end of file
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C++20 coroutine building blocks for the asynchronous asset pipeline.
+//
+// Tasks are lazy: the body starts when the task is awaited and resumes its awaiter directly on
+//  whichever thread finishes it. Threads are only ever changed explicitly by awaiting
+//  WorkerPool::Schedule. The code base does not use exceptions, so one escaping a coroutine
+//  terminates; failures travel as bool results like everywhere else.
+namespace Async {
+	template <typename T>
+	class Task {
+	public:
+		struct promise_type {
+			T Value = {};
+			std::coroutine_handle<> Continuation;
+
+			struct FinalAwaiter {
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+					const auto continuation = handle.promise().Continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+
+			Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+			void return_value(T value) { Value = std::move(value); }
+			void unhandled_exception() { std::terminate(); }
+		};
+
+	public:
+		Task() = default;
+		explicit Task(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+		Task(Task&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+		~Task() { if (mHandle) mHandle.destroy(); }
+
+	private:
+		Task(const Task& ref) = delete;
+		Task& operator=(const Task& rhs) = delete;
+
+	public:
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+			mHandle.promise().Continuation = awaiting;
+			return mHandle;
+		}
+		T await_resume() { return std::move(mHandle.promise().Value); }
+
+	private:
+		std::coroutine_handle<promise_type> mHandle;
+	};
+
+	// Eagerly started coroutine that frees itself when it finishes; the bridge from synchronous
+	//  code into a chain of tasks.
+	struct Detached {
+		struct promise_type {
+			Detached get_return_object() noexcept { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	// Fixed set of threads resuming posted coroutines in FIFO order.
+	class WorkerPool {
+	public:
+		struct ScheduleAwaiter {
+			WorkerPool* Pool;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { Pool->Post(handle); }
+			void await_resume() const noexcept {}
+		};
+
+	public:
+		WorkerPool() = default;
+		virtual ~WorkerPool();
+
+	private:
+		WorkerPool(const WorkerPool& ref) = delete;
+		WorkerPool& operator=(const WorkerPool& rhs) = delete;
+
+	public:
+		void Initialize(size_t threadCount);
+		// Runs what is already queued, then joins the threads.
+		void CleanUp();
+
+		void Post(std::coroutine_handle<> handle);
+
+		// co_await pool.Schedule() continues the awaiting coroutine on one of the pool's threads.
+		__forceinline ScheduleAwaiter Schedule();
+		__forceinline size_t ThreadCount() const;
+
+	private:
+		void WorkerMain();
+
+	private:
+		std::vector<std::thread> mThreads;
+
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		std::deque<std::coroutine_handle<>> mQueue;
+		bool bStopping = false;
+	};
+
+	// Counting semaphore over bytes for coroutines. Acquire suspends until the reservation fits
+	//  under the limit and waiters are served in arrival order, so a large request is not starved
+	//  by small ones. A reservation larger than the whole limit proceeds once nothing else is
+	//  held; an oversized asset slows the pipeline down but cannot deadlock it.
+	class MemoryBudget {
+	public:
+		struct AcquireAwaiter {
+			MemoryBudget* Budget;
+			UINT64 Bytes;
+
+			bool await_ready() const noexcept { return false; }
+			bool await_suspend(std::coroutine_handle<> handle) { return Budget->Enqueue(handle, Bytes); }
+			void await_resume() const noexcept {}
+		};
+
+	public:
+		MemoryBudget() = default;
+		virtual ~MemoryBudget() = default;
+
+	private:
+		MemoryBudget(const MemoryBudget& ref) = delete;
+		MemoryBudget& operator=(const MemoryBudget& rhs) = delete;
+
+	public:
+		// Waiters that become admissible in Release are resumed on pResumePool, never on the
+		//  releasing thread.
+		void Initialize(UINT64 limit, WorkerPool* pResumePool);
+
+		__forceinline AcquireAwaiter Acquire(UINT64 bytes);
+		void Release(UINT64 bytes);
+
+		UINT64 Limit() const;
+		UINT64 Reserved() const;
+		UINT64 PeakReserved() const;
+
+	private:
+		// Reserves immediately and returns false when the request fits and nobody is queued
+		//  ahead of it; otherwise queues the coroutine and returns true.
+		bool Enqueue(std::coroutine_handle<> handle, UINT64 bytes);
+		__forceinline bool Fits(UINT64 bytes) const;
+
+	private:
+		struct Waiter {
+			std::coroutine_handle<> Handle;
+			UINT64 Bytes;
+		};
+
+		WorkerPool* mpResumePool = nullptr;
+
+		mutable std::mutex mMutex;
+		std::deque<Waiter> mWaiters;
+
+		UINT64 mLimit = 0;
+		UINT64 mReserved = 0;
+		UINT64 mPeakReserved = 0;
+	};
+}
+
+Async::WorkerPool::ScheduleAwaiter Async::WorkerPool::Schedule() {
+	return ScheduleAwaiter{ this };
+}
+
+size_t Async::WorkerPool::ThreadCount() const {
+	return mThreads.size();
+}
+
+Async::MemoryBudget::AcquireAwaiter Async::MemoryBudget::Acquire(UINT64 bytes) {
+	return AcquireAwaiter{ this, bytes };
+}
+
+bool Async::MemoryBudget::Fits(UINT64 bytes) const {
+	return mReserved == 0 || mReserved + bytes <= mLimit;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Async.h"
+#include "ObjLoader.h"
+#include "Stopwatch.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct MeshGeometry;
+
+// Turns a parsed OBJ into a MeshGeometry whose CPU blobs and draw arguments are ready for
+//  upload; runs on a worker thread.
+using AsyncMeshProcessFunc = std::function<bool(const std::string& name, ObjMesh& mesh, MeshGeometry* outGeo)>;
+
+struct AsyncMeshRequest {
+	std::string				Name;
+	std::wstring			Filename;
+	ObjLoadDesc				LoadDesc;
+	AsyncMeshProcessFunc	Process;
+};
+
+struct AsyncMeshLoaderStats {
+	UINT	RequestedCount		= 0;
+	UINT	CompletedCount		= 0;
+	UINT	FailedCount			= 0;
+	UINT64	BudgetBytes			= 0;
+	UINT64	PeakReservedBytes	= 0;
+};
+
+// Thread-safe timeline of load stages, written in the Chrome trace event format so it opens
+//  in chrome://tracing or Perfetto.
+class LoadTrace {
+public:
+	struct Event {
+		std::string	Name;
+		const char*	Stage;
+		UINT		ThreadIndex;
+		UINT64		BeginMicroseconds;
+		UINT64		EndMicroseconds;
+	};
+
+public:
+	LoadTrace() = default;
+	virtual ~LoadTrace() = default;
+
+public:
+	// Microseconds since the trace was created.
+	UINT64 Now() const;
+
+	// Records the span on the calling thread's lane.
+	void Add(const std::string& name, const char* stage, UINT64 beginMicroseconds, UINT64 endMicroseconds);
+
+	std::vector<Event> Events() const;
+	bool Write(const std::wstring& inFilename) const;
+
+private:
+	Stopwatch mClock;
+
+	mutable std::mutex mMutex;
+	std::vector<Event> mEvents;
+	std::unordered_map<std::thread::id, UINT> mThreadIndices;
+};
+
+// Coroutine-driven OBJ pipeline that keeps mesh loading off the render thread.
+//
+// Every request is one coroutine: it reserves an estimate of its working set from the memory
+//  budget, reads the file on the I/O thread, parses and welds on a worker, runs the caller's
+//  processing stage on the same worker and parks the finished geometry in the ready queue.
+// The render thread polls TryPopReady once per frame and uploads what it finds; the
+//  reservation is held until then, so parsed meshes waiting for upload count against the
+//  budget as well and peak memory stays bounded however many requests are queued.
+class AsyncMeshLoader {
+public:
+	AsyncMeshLoader() = default;
+	virtual ~AsyncMeshLoader();
+
+private:
+	AsyncMeshLoader(const AsyncMeshLoader& ref) = delete;
+	AsyncMeshLoader& operator=(const AsyncMeshLoader& rhs) = delete;
+
+public:
+	// A workerCount of zero uses one worker per hardware thread, minus the render thread.
+	// workingSetFactor scales a file's size into the bytes reserved for its load.
+	bool Initialize(UINT workerCount, UINT64 memoryBudget, float workingSetFactor);
+	// Waits for in-flight requests, then stops the threads; unclaimed geometries are dropped.
+	void CleanUp();
+
+	// Returns immediately; the result arrives through TryPopReady.
+	bool Request(const AsyncMeshRequest& request);
+
+	// Hands over one finished geometry, if any, and releases its reservation.
+	bool TryPopReady(std::unique_ptr<MeshGeometry>& outGeo);
+
+	// True once every request has reached the ready queue or failed.
+	bool IsIdle() const;
+
+	AsyncMeshLoaderStats Stats() const;
+
+	// Loads meshCount copies of one OBJ concurrently under a tight budget, draining the ready queue
+	//  the way the render thread does, and compares every result with a synchronous load.
+	static bool RunBenchmark(
+		const std::wstring& inFilename, UINT meshCount, UINT64 memoryBudget, UINT workerCount, float workingSetFactor,
+		const ObjLoadDesc& loadDesc, const AsyncMeshProcessFunc& process);
+
+	__forceinline LoadTrace& Trace();
+	__forceinline const LoadTrace& Trace() const;
+
+private:
+	struct ReadyMesh {
+		std::unique_ptr<MeshGeometry> Geometry;
+		UINT64 ReservedBytes;
+		UINT64 ReadyMicroseconds;
+	};
+
+	Async::Detached Run(AsyncMeshRequest request, UINT64 reservedBytes);
+	Async::Task<bool> Load(const AsyncMeshRequest& request, std::unique_ptr<MeshGeometry>& outGeo);
+	Async::Task<bool> ReadFileAsync(const AsyncMeshRequest& request, std::vector<char>& outData);
+
+private:
+	Async::WorkerPool mIoPool;
+	Async::WorkerPool mWorkerPool;
+	Async::MemoryBudget mBudget;
+
+	float mWorkingSetFactor = 1.0f;
+
+	mutable std::mutex mReadyMutex;
+	std::deque<ReadyMesh> mReady;
+
+	std::atomic<UINT> mPendingCount = 0;
+	std::atomic<UINT> mRequestedCount = 0;
+	std::atomic<UINT> mCompletedCount = 0;
+	std::atomic<UINT> mFailedCount = 0;
+
+	LoadTrace mTrace;
+
+	bool bInitialized = false;
+};
+
+LoadTrace& AsyncMeshLoader::Trace() {
+	return mTrace;
+}
+
+const LoadTrace& AsyncMeshLoader::Trace() const {
+	return mTrace;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+// Deepest leaf a build produces; traversal stacks are sized for it.
+const UINT BvhMaxDepth = 96;
+
+// 32 bytes, two to a cache line.
+// Siblings are stored next to each other, so an interior node only records its left child, and
+//  children always come after their parent: a reverse sweep reaches every child before its parent.
+struct BvhNode {
+	DirectX::XMFLOAT3 BoundsMin;
+	// Interior: index of the left child; the right child follows it.
+	// Leaf: first entry of the leaf's range in Bvh::TriangleIndices.
+	UINT LeftFirst;
+	DirectX::XMFLOAT3 BoundsMax;
+	// Zero for interior nodes; primitive count for hierarchies built over bounds.
+	UINT TriangleCount;
+
+	__forceinline bool IsLeaf() const;
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+// Triangle list a hierarchy is built over; it points into existing vertex and index buffers
+//  (a MeshGeometry's CPU blobs, for instance), which have to outlive the Bvh.
+// Indices are relative to Vertices, i.e. the submesh's base vertex is already applied.
+struct BvhMesh {
+	const Vertex* Vertices = nullptr;
+	UINT VertexCount = 0;
+	const void* Indices = nullptr;
+	UINT IndexCount = 0;
+	// 2 or 4 bytes.
+	UINT IndexStride = 4;
+
+	__forceinline UINT TriangleCount() const;
+	__forceinline void Triangle(UINT triangle, UINT& i0, UINT& i1, UINT& i2) const;
+	__forceinline const DirectX::XMFLOAT3& Position(UINT index) const;
+};
+
+struct Bvh {
+	BvhMesh Mesh;
+	// Nodes[0] is the root.
+	std::vector<BvhNode> Nodes;
+	// Triangle numbers of BvhMesh in leaf order; leaves reference ranges of it.
+	std::vector<UINT> TriangleIndices;
+};
+
+// Axis-aligned box a hierarchy can be built over in place of a triangle.
+struct BvhBounds {
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+};
+
+struct BvhBuildDesc {
+	// Centroid bins per axis when evaluating split candidates.
+	UINT BinCount = 16;
+	// Leaves larger than this are split even when SAH would rather keep them.
+	UINT MaxLeafSize = 8;
+	// Relative costs of visiting a node and testing a triangle.
+	float TraversalCost = 1.0f;
+	float IntersectionCost = 1.0f;
+};
+
+struct BvhBuildStats {
+	UINT TriangleCount = 0;
+	UINT NodeCount = 0;
+	UINT LeafCount = 0;
+	UINT MaxDepth = 0;
+	float AverageLeafSize = 0.0f;
+	// Expected cost of a random ray hitting the root bounds, in BvhBuildDesc's cost units.
+	float SahCost = 0.0f;
+	double BuildMilliseconds = 0.0;
+
+	// Triangles per microsecond, i.e. millions per second.
+	__forceinline double Throughput() const;
+};
+
+class BvhBuilder {
+public:
+	// Top-down binned SAH over triangle centroids (Wald 2007).
+	// Ranges still unresolved 32 levels above BvhMaxDepth are halved by centroid order instead.
+	// Large ranges bin in parallel and are partitioned one level at a time until there are enough
+	//  subtrees to keep every core busy; those are then built independently and stitched together
+	//  in a fixed order, so the result does not depend on the thread count.
+	static bool Build(const BvhMesh& mesh, const BvhBuildDesc& desc, Bvh& outBvh, BvhBuildStats* pStats = nullptr);
+
+	// Same build over arbitrary boxes; leaves reference ranges of outPrimitiveIndices, which holds
+	//  indices into pBounds.
+	static bool BuildOverBounds(const BvhBounds* pBounds, UINT count, const BvhBuildDesc& desc,
+		std::vector<BvhNode>& outNodes, std::vector<UINT>& outPrimitiveIndices);
+
+	// Fills everything but BuildMilliseconds.
+	static void CalcStats(const Bvh& bvh, const BvhBuildDesc& desc, BvhBuildStats& outStats);
+	// Same over a hierarchy of primitiveCount boxes; TriangleCount counts the primitives.
+	static void CalcStats(const std::vector<BvhNode>& nodes, UINT primitiveCount, const BvhBuildDesc& desc, BvhBuildStats& outStats);
+
+	// Builds a BVH over a dense generated sphere to check that the builder keeps up with meshes of
+	//  tens of millions of triangles.
+	static bool RunBenchmark(UINT sphereSize, const BvhBuildDesc& desc);
+};
+
+bool BvhNode::IsLeaf() const {
+	return TriangleCount != 0;
+}
+
+double BvhBuildStats::Throughput() const {
+	return BuildMilliseconds > 0.0 ? TriangleCount / (BuildMilliseconds * 1000.0) : 0.0;
+}
+
+UINT BvhMesh::TriangleCount() const {
+	return IndexCount / 3;
+}
+
+void BvhMesh::Triangle(UINT triangle, UINT& i0, UINT& i1, UINT& i2) const {
+	const size_t first = static_cast<size_t>(triangle) * 3;
+	if (IndexStride == 2) {
+		const std::uint16_t* indices = reinterpret_cast<const std::uint16_t*>(Indices) + first;
+		i0 = indices[0];
+		i1 = indices[1];
+		i2 = indices[2];
+	}
+	else {
+		const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(Indices) + first;
+		i0 = indices[0];
+		i1 = indices[1];
+		i2 = indices[2];
+	}
+}
+
+const DirectX::XMFLOAT3& BvhMesh::Position(UINT index) const {
+	return Vertices[index].Pos;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Bvh.h"
+#include "MappedFile.h"
+
+#include <memory>
+#include <string>
+
+struct LbvhBuildDesc;
+
+namespace BvhCache {
+	// 'B' 'V' 'H' 'C'
+	const UINT Magic = 0x43485642;
+	// Bump whenever the on-disk layout, BvhNode or the output of either builder changes.
+	const UINT Version = 1;
+
+	const UINT SectionAlignment = 16;
+
+	// On-disk layout (little-endian, every section 16-byte aligned):
+	//  FileHeader | BvhNode[NodeCount] | uint32[TriangleIndexCount]
+	// Sections are found by offset and nodes refer to each other by index, so the file can be
+	//  mapped anywhere. The mesh itself is not stored; the key ties the file to it.
+	struct FileHeader {
+		UINT	Magic;
+		UINT	Version;
+		UINT	HeaderSize;
+		UINT	NodeStride;
+
+		UINT	NodeCount;
+		UINT	TriangleIndexCount;
+		// Of the mesh the hierarchy was built over.
+		UINT	TriangleCount;
+		UINT	FileHeaderPad1;
+
+		UINT64	NodeOffset;
+		UINT64	TriangleIndexOffset;
+		UINT64	FileSize;
+		// CalcKey of the mesh and build settings; a mismatch means the file is stale.
+		UINT64	Key;
+
+		// Hash of the node and triangle index sections.
+		UINT64	ContentHash;
+		UINT64	FileHeaderPad2;
+	};
+
+	class BvhCacheFile {
+	public:
+		BvhCacheFile() = default;
+		virtual ~BvhCacheFile() = default;
+
+	public:
+		// Maps the file and checks magic, version, key, node stride and section bounds.
+		// bValidate additionally recomputes the content hash and checks that every child and
+		//  triangle a node references is in range, so a damaged file cannot send traversal astray.
+		bool Open(const std::wstring& inFilename, UINT64 key, bool bValidate);
+
+		const FileHeader& Header() const;
+
+		const BvhNode* Nodes() const;
+		const UINT* TriangleIndices() const;
+
+		// Points outBvh at mesh and copies both sections into it in one block each; nothing is
+		//  rebuilt or visited per node.
+		bool Load(const BvhMesh& mesh, Bvh& outBvh) const;
+
+	private:
+		std::unique_ptr<MappedFile> mFile;
+		const FileHeader* mHeader = nullptr;
+	};
+
+	// Hash of the mesh's vertices and indices and of the settings it is built with; binned SAH
+	//  and LBVH settings never share a key.
+	UINT64 CalcKey(const BvhMesh& mesh, const BvhBuildDesc& desc);
+	UINT64 CalcKey(const BvhMesh& mesh, const LbvhBuildDesc& desc);
+
+	// The key in hexadecimal under directory, which has to end in a separator.
+	std::wstring Filename(const std::wstring& directory, UINT64 key);
+
+	bool Write(const std::wstring& inFilename, UINT64 key, const Bvh& bvh);
+
+	// Marks a cache file as just used by moving its last-write time to now, which is what Trim
+	//  ages files by.
+	void Touch(const std::wstring& inFilename);
+
+	// Deletes the least recently used cache files under directory, which has to end in a
+	//  separator, until the rest fit in maxBytes.
+	void Trim(const std::wstring& directory, UINT64 maxBytes);
+
+	// Startup cost of a large static mesh with and without a cached hierarchy: cold is hashing,
+	//  building and saving, warm is hashing, mapping and loading. The file is removed afterwards.
+	bool RunBenchmark(UINT sphereSize, const BvhBuildDesc& desc, const std::wstring& directory);
+}
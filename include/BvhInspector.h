@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Bvh.h"
+#include "BvhTraversal.h"
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+struct TwoLevelBvh;
+
+// Shape of a hierarchy beyond BvhBuildStats, to spot meshes that will trace slowly.
+struct BvhStructureStats {
+	// Leaves per triangle count; the last bucket also takes every larger leaf.
+	static const UINT LeafSizeBucketCount = 17;
+
+	UINT NodeCount = 0;
+	UINT LeafCount = 0;
+	UINT TriangleCount = 0;
+	// In BvhBuildDesc's cost units, as in BvhBuildStats.
+	float SahCost = 0.0f;
+
+	std::vector<UINT> LeafSizeHistogram;
+	// Leaves per depth, the root being depth 0.
+	std::vector<UINT> LeafDepthHistogram;
+	float AverageLeafDepth = 0.0f;
+	UINT MaxDepth = 0;
+
+	// Surface area of the box two siblings share over the area of their parent, summed over
+	//  interior nodes and weighted by parent area; 0 for disjoint children, 1 when they coincide
+	//  with the parent. Rays through shared volume have to visit both subtrees.
+	float SiblingOverlap = 0.0f;
+	// Worst ratio of a single interior node.
+	float MaxSiblingOverlap = 0.0f;
+};
+
+// Primary rays through the centers of a Width x Height grid over the camera's view.
+struct BvhHeatmapDesc {
+	UINT Width = 0;
+	UINT Height = 0;
+	// Inverse of view * projection, row-vector convention as XMMatrixMultiply builds it; rays run
+	//  from the near plane to the far plane.
+	DirectX::XMFLOAT4X4 InvViewProj;
+	BvhTraversal::Mode Mode = BvhTraversal::EClosestHit;
+	BvhTraversal::Cull Cull = BvhTraversal::ECullNone;
+};
+
+// Per-pixel counters of the traces, row-major from the top-left pixel.
+struct BvhHeatmap {
+	UINT Width = 0;
+	UINT Height = 0;
+
+	std::vector<float> NodeCounts;
+	std::vector<float> TriangleCounts;
+	std::vector<float> InstanceCounts;
+
+	// Over all pixels.
+	BvhTraceCounters Max;
+	double MeanNodeCount = 0.0;
+	double MeanTriangleCount = 0.0;
+	double MeanInstanceCount = 0.0;
+	double Milliseconds = 0.0;
+};
+
+class BvhInspector {
+public:
+	// Pixels per side of the square tiles handed out to worker threads.
+	static const UINT TileSize = 16;
+
+public:
+	static void CalcStructureStats(const Bvh& bvh, const BvhBuildDesc& desc, BvhStructureStats& outStats);
+	// Same over a hierarchy of primitiveCount boxes, such as a TwoLevelBvh's top level.
+	static void CalcStructureStats(const std::vector<BvhNode>& nodes, UINT primitiveCount, const BvhBuildDesc& desc, BvhStructureStats& outStats);
+
+	// Traces one counted ray per pixel, tile-parallel.
+	static bool RenderHeatmap(const Bvh& bvh, const BvhHeatmapDesc& desc, BvhHeatmap& outHeatmap);
+	static bool RenderHeatmap(const TwoLevelBvh& tlas, const BvhHeatmapDesc& desc, BvhHeatmap& outHeatmap);
+
+	// One-channel portable float map, readable by most HDR viewers and image libraries.
+	static bool WritePfm(const std::wstring& inFilename, UINT width, UINT height, const std::vector<float>& image);
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Bvh.h"
+
+#include <DirectXMath.h>
+#include <cfloat>
+#include <string>
+
+struct TwoLevelBvh;
+struct WideBvh;
+struct AnalyticBvh;
+
+struct BvhRay {
+	DirectX::XMFLOAT3 Origin;
+	float TMin = 0.0f;
+	// Need not be normalized; T is measured in multiples of it.
+	DirectX::XMFLOAT3 Direction;
+	float TMax = FLT_MAX;
+};
+
+struct BvhHit {
+	static const UINT Miss = 0xFFFFFFFF;
+
+	float T = FLT_MAX;
+	// Weights of the second and third vertex, like BuiltInTriangleIntersectionAttributes.
+	float U = 0.0f;
+	float V = 0.0f;
+	// Triangle number in the BvhMesh, or primitive number in an AnalyticBvh.
+	UINT Triangle = Miss;
+	// Index into TwoLevelBvh::Instances; Miss for single-level traces.
+	UINT Instance = Miss;
+
+	__forceinline bool IsHit() const;
+};
+
+// Work done by counted traces; they add to it, so one instance can total a pixel or a frame.
+struct BvhTraceCounters {
+	// Nodes visited, leaves included, in every level.
+	UINT NodeCount = 0;
+	// Triangles, or analytic primitives, tested against the ray.
+	UINT TriangleCount = 0;
+	// Instances whose bottom level the ray entered.
+	UINT InstanceCount = 0;
+};
+
+// CPU ray queries against a Bvh.
+// Triangles use the watertight test of Woop, Benthin and Wald (2013): rays through shared edges
+//  and vertices hit exactly one of the adjacent triangles, and box tests widen the far distance
+//  by a few ulps (Ize 2013) so they never cull a hit the triangle test would find.
+// Both sides of a triangle are hit unless one of them is culled.
+class BvhTraversal {
+public:
+	enum Mode {
+		// Nearest intersection in [TMin, TMax].
+		EClosestHit = 0,
+		// Any intersection in [TMin, TMax], ending the search as soon as one is found
+		//  (RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH); enough for occlusion rays.
+		EAnyHit
+	};
+
+	// Front faces are those whose cross(p1 - p0, p2 - p0) points toward the ray origin, i.e. whose
+	//  vertices appear clockwise from it, the default of D3D12 ray tracing.
+	enum Cull {
+		ECullNone = 0,
+		// RAY_FLAG_CULL_FRONT_FACING_TRIANGLES
+		ECullFrontFacing,
+		// RAY_FLAG_CULL_BACK_FACING_TRIANGLES
+		ECullBackFacing
+	};
+
+	static const UINT PacketSize = 4;
+
+public:
+	// Single ray; both children of a node are tested together in SSE lanes and the nearer one is
+	//  visited first.
+	static bool Trace(const Bvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit, Cull cull = ECullNone);
+
+	// Four rays at once in SSE lanes: a node is entered when any active ray hits its bounds and
+	//  every triangle is tested against all four rays together.
+	// Pays off for coherent rays (neighbouring primary or shadow rays); rays with TMax < TMin are
+	//  inactive and come back as misses.
+	static void TracePacket(const Bvh& bvh, const BvhRay* pRays, Mode mode, BvhHit* pOutHits, Cull cull = ECullNone);
+
+	// Traces count rays on the calling thread, grouping consecutive rays into packets when
+	//  bPackets is set.
+	static void TraceStream(const Bvh& bvh, const BvhRay* pRays, size_t count, Mode mode, bool bPackets, BvhHit* pOutHits, Cull cull = ECullNone);
+
+	// Single ray against analytic primitives; the nearest surface crossing in [TMin, TMax] counts,
+	//  from outside or inside, and U and V stay zero. Cull modes only concern triangles, as in DXR.
+	static bool Trace(const AnalyticBvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit);
+
+	// Single ray through the top level; instances whose mask shares no bit with instanceMask are
+	//  skipped, like TraceRay's InstanceInclusionMask, and their flags can turn off or flip cull.
+	static bool Trace(const TwoLevelBvh& tlas, const BvhRay& ray, Mode mode, BvhHit& outHit, Cull cull = ECullNone, UINT instanceMask = 0xFF);
+
+	// Single ray through the eight-wide layout: all child boxes of a node are tested together in
+	//  AVX2 lanes, or two SSE halves on CPUs without it, and hit children are visited nearest first.
+	static bool Trace(const WideBvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit, Cull cull = ECullNone);
+
+	static void TraceStream(const WideBvh& bvh, const BvhRay* pRays, size_t count, Mode mode, BvhHit* pOutHits, Cull cull = ECullNone);
+
+	// Same single-ray queries, also counting the work they do into counters; for heatmaps and cost
+	//  reports rather than throughput.
+	static bool Trace(const Bvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit, BvhTraceCounters& counters, Cull cull = ECullNone);
+	static bool Trace(const TwoLevelBvh& tlas, const BvhRay& ray, Mode mode, BvhHit& outHit, BvhTraceCounters& counters,
+		Cull cull = ECullNone, UINT instanceMask = 0xFF);
+
+	// Whether wide traversal runs on AVX2 on this CPU.
+	static bool HasAvx2();
+
+	// Coherent primary rays from a pinhole camera looking at the BVH's bounds, then aoSampleCount
+	//  cosine-distributed rays over the hemisphere of every primary hit, as RtaoRayGen casts them.
+	// Primary rays are laid out in 2x2 pixel quads so packets hold neighbouring pixels; each pixel's
+	//  AO rays are consecutive, so packets share an origin but scatter in direction.
+	// Single rays are also traced through the BVH collapsed to eight-wide quantized nodes.
+	static bool RunBenchmark(const std::string& name, const Bvh& bvh, UINT width, UINT height, UINT aoSampleCount, float aoRadius);
+};
+
+bool BvhHit::IsHit() const {
+	return Triangle != Miss;
+}
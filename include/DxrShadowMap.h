@@ -55,7 +55,7 @@ namespace DxrShadow {
 	public:
 		bool Initialize(ID3D12Device5*const device, ID3D12GraphicsCommandList*const cmdList, ShaderManager*const manager, UINT width, UINT height);
 		bool CompileShaders(const std::wstring& filePath);
-		bool BuildRootSignatures(const StaticSamplers& samplers, UINT geometryBufferCount);
+		bool BuildRootSignatures(const StaticSamplers& samplers);
 		bool BuildDXRPSO();
 		bool BuildShaderTables();
 		void Run(
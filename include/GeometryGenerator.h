@@ -24,6 +24,10 @@ public:
 
     using uint16 = std::uint16_t;
     using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+	// Deeper subdivision requests are clamped; every level quadruples the triangle count.
+	static const uint32 MaxSubdivisions = 8;
 
 	struct Vertex
 	{
@@ -74,23 +78,54 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+	// Where each attribute lives in a caller's vertex struct; a negative offset skips it.
+	struct VertexLayout
+	{
+		uint32 Stride;
+		int PositionOffset;
+		int NormalOffset;
+		int TangentUOffset;
+		int TexCOffset;
+		// Float written as +1; every generated shape has a right-handed tangent frame.
+		int TangentSignOffset;
+	};
+
+	// Destination of the streaming generators, e.g. a CPU blob or mapped upload memory.
+	// Allocate is called once with the final counts before anything is written and returns
+	// buffers for vertexCount vertices in Layout() and indexCount indices, 16-bit ones when
+	// bOutIndices16 is set. Returning false aborts the generator.
+	class MeshSink
+	{
+	public:
+		virtual ~MeshSink() = default;
+
+		virtual const VertexLayout& Layout() const = 0;
+		virtual bool Allocate(uint32 vertexCount, uint32 indexCount, void*& outVertices, void*& outIndices, bool& bOutIndices16) = 0;
+	};
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
-    /// face has m rows and n columns of vertices.
+    /// face has m rows and n columns of vertices.  The box is subdivided in a
+	/// MeshData, which the sink overload then writes out in the caller's layout.
 	///</summary>
     MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    bool CreateBox(float width, float height, float depth, uint32 numSubdivisions, MeshSink& sink);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
-	/// slices and stacks parameters control the degree of tessellation.
+	/// slices and stacks parameters control the degree of tessellation.  The
+	/// sink overload writes straight into the caller's layout and buffers.
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    bool CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshSink& sink);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation.  Like the box, the sink overload
+	/// writes out a finished MeshData.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    bool CreateGeosphere(float radius, uint32 numSubdivisions, MeshSink& sink);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -101,15 +136,30 @@ public:
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
-	/// at the origin with the specified width and depth.
+	/// at the origin with the specified width and depth.  The sink overload
+	/// writes straight into the caller's layout and buffers.
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    bool CreateGrid(float width, float depth, uint32 m, uint32 n, MeshSink& sink);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Generates the subdivided shapes at every depth up to maxDepth and logs their size next to
+	/// the former per-triangle midpoints, which emitted six vertices for every input triangle.
+	///</summary>
+	static void RunSubdivisionBenchmark(uint32 maxDepth);
+
+	///<summary>
+	/// Generates large grids and spheres in the given layout through the former MeshData path
+	/// (generate, repack into the layout, copy into the final buffers) and straight through a
+	/// sink, logging time and peak live geometry bytes of both.
+	///</summary>
+	static bool RunSinkBenchmark(uint32 gridSize, uint32 sphereSize, const VertexLayout& layout);
+
 private:
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
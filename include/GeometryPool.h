@@ -0,0 +1,107 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <vector>
+
+#include "TlsfAllocator.h"
+
+// Ranges one geometry occupies in the pool's arenas.
+struct GeometryPoolAllocation {
+	// In vertices.
+	TlsfAllocation Vertices;
+	// In 32-bit words, so both 16- and 32-bit index views stay aligned.
+	TlsfAllocation Indices;
+
+	bool IsValid() const { return Vertices.IsValid() && Indices.IsValid(); }
+};
+
+// One vertex arena and one index arena shared by every geometry, sub-allocated with TLSF.
+// Draws bind the arenas once and address each geometry through BaseVertexLocation and
+//  StartIndexLocation; shaders reach all of them through a single pair of SRVs.
+class GeometryPool {
+public:
+	GeometryPool() = default;
+	virtual ~GeometryPool() = default;
+
+public:
+	bool Initialize(ID3D12Device* pDevice, UINT vertexByteStride, UINT vertexCapacity, UINT indexByteCapacity);
+
+	// Sub-allocates both ranges and records the copies on cmdList; fails without side effects
+	//  when either arena is full.
+	// The staging buffers live until DisposeUploaders.
+	bool Upload(
+		ID3D12GraphicsCommandList* pCmdList,
+		const void* pVertices, UINT vertexCount,
+		const void* pIndices, UINT indexByteSize,
+		GeometryPoolAllocation& outAllocation);
+	void Free(const GeometryPoolAllocation& allocation);
+
+	// Call once the command lists recorded by Upload have finished executing.
+	void DisposeUploaders();
+
+	__forceinline ID3D12Resource* VertexBuffer() const;
+	__forceinline ID3D12Resource* IndexBuffer() const;
+
+	__forceinline UINT VertexByteStride() const;
+	__forceinline UINT VertexCapacity() const;
+	__forceinline UINT IndexByteCapacity() const;
+
+	__forceinline TlsfStats VertexStats() const;
+	__forceinline TlsfStats IndexStats() const;
+
+	static __forceinline UINT VertexOffset(const GeometryPoolAllocation& allocation);
+	static __forceinline UINT IndexByteOffset(const GeometryPoolAllocation& allocation);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mVertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mIndexBuffer;
+	D3D12_RESOURCE_STATES mState = D3D12_RESOURCE_STATE_COMMON;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mUploaders;
+
+	TlsfAllocator mVertexAllocator;
+	TlsfAllocator mIndexAllocator;
+
+	UINT mVertexByteStride = 0;
+	UINT mVertexCapacity = 0;
+	UINT mIndexByteCapacity = 0;
+};
+
+ID3D12Resource* GeometryPool::VertexBuffer() const {
+	return mVertexBuffer.Get();
+}
+
+ID3D12Resource* GeometryPool::IndexBuffer() const {
+	return mIndexBuffer.Get();
+}
+
+UINT GeometryPool::VertexByteStride() const {
+	return mVertexByteStride;
+}
+
+UINT GeometryPool::VertexCapacity() const {
+	return mVertexCapacity;
+}
+
+UINT GeometryPool::IndexByteCapacity() const {
+	return mIndexByteCapacity;
+}
+
+TlsfStats GeometryPool::VertexStats() const {
+	return mVertexAllocator.Stats();
+}
+
+TlsfStats GeometryPool::IndexStats() const {
+	return mIndexAllocator.Stats();
+}
+
+UINT GeometryPool::VertexOffset(const GeometryPoolAllocation& allocation) {
+	return static_cast<UINT>(allocation.Vertices.Offset);
+}
+
+UINT GeometryPool::IndexByteOffset(const GeometryPoolAllocation& allocation) {
+	return static_cast<UINT>(allocation.Indices.Offset * sizeof(UINT));
+}
@@ -4,7 +4,7 @@
 #ifdef HLSL
 #include "HlslCompaction.hlsli"
 #else
-#include <unordered_map>
+#include <vector>
 #include <MathHelper.h>
 #endif
 
@@ -28,33 +28,16 @@ struct Vertex {
 	DirectX::XMFLOAT3 Pos;
 	DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT2 TexC;
-	DirectX::XMFLOAT3 Tangent;
-
-#ifndef HLSL
-	bool operator==(const Vertex& other) const {
-		return MathHelper::IsEqual(Pos, other.Pos) &&
-			MathHelper::IsEqual(Normal, other.Normal) &&
-			MathHelper::IsEqual(TexC, other.TexC);
-	}
-#endif
+	// xyz points along +u; w is +1 or -1 and gives the bitangent as w * cross(Normal, Tangent.xyz),
+	//  which flips in mirrored texture regions.
+	DirectX::XMFLOAT4 Tangent;
 };
 
 #ifndef HLSL
-namespace std {
-	template<> struct hash<Vertex> {
-		size_t operator()(Vertex const& vertex) const {
-			size_t pos = static_cast<size_t>(vertex.Pos.x + vertex.Pos.y + vertex.Pos.z);
-			size_t normal = static_cast<size_t>(vertex.Normal.x + vertex.Normal.y + vertex.Normal.z);
-			size_t texc = static_cast<size_t>(vertex.TexC.x + vertex.TexC.y);
-			return (pos ^ normal ^ texc);
-		}
-	};
-}
-
+// Unique vertices and triangle-list indices produced by VertexWelder.
 struct Mesh {
-	std::unordered_map<Vertex, std::uint32_t>	UniqueVertices;
-	std::vector<Vertex>							Vertices;
-	std::vector<std::uint32_t>					Indices;
+	std::vector<Vertex>			Vertices;
+	std::vector<std::uint32_t>	Indices;
 };
 #endif
 
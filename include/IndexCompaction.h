@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Mesh.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct IndexCompactionStats {
+	size_t SourceByteSize = 0;
+	size_t PackedByteSize = 0;
+	// Submeshes whose BaseVertexLocation moved to bring their indices into 16-bit range.
+	UINT RebasedSubmeshCount = 0;
+};
+
+class IndexCompaction {
+public:
+	static const size_t Max16BitVertexSpan = 65536;
+
+	// Rebases every submesh onto the lowest vertex it references, so a buffer with more than
+	//  65536 vertices still packs as long as each submesh spans no more than that.
+	// Returns false and leaves drawArgs untouched when some submesh spans more, or when two
+	//  overlapping submeshes would need different bases.
+	// The output is padded to a multiple of four bytes, as raw buffer views require.
+	static bool PackTo16Bit(
+		const std::uint32_t* pIndices, size_t indexCount,
+		std::unordered_map<std::string, SubmeshGeometry>& drawArgs,
+		std::vector<std::uint16_t>& outIndices,
+		IndexCompactionStats* pStats = nullptr);
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Bvh.h"
+
+struct LbvhBuildDesc {
+	// 21 bits per axis instead of 10; separates dense clusters a 30-bit code lumps together, at
+	//  twice the sorting passes.
+	bool Use63BitCodes = false;
+	// Tree rotations (Kensler 2008) applied while bounds are fitted: a node swaps one child with
+	//  a grandchild on the other side when that shrinks the surface area of the changed child.
+	bool Rotate = false;
+	// Subtrees of at most this many triangles collapse into one leaf when SAH favours it.
+	UINT MaxLeafSize = 8;
+	float TraversalCost = 1.0f;
+	float IntersectionCost = 1.0f;
+};
+
+// Linear BVH built in a handful of parallel passes, for geometry rebuilt every frame:
+//  - Morton codes of triangle centroids within the centroid bounds,
+//  - an LSD radix sort of the codes,
+//  - the binary radix tree over the sorted codes (Karras 2012), every internal node found
+//    independently,
+//  - bounds fitted bottom-up, each node finished by whichever of its children arrives last,
+//  - and the tree laid out top-down, level by level, as a Bvh with siblings side by side.
+// Trees trace slower than BvhBuilder's binned SAH; BvhBuildStats::SahCost tells how much.
+class LbvhBuilder {
+public:
+	static bool Build(const BvhMesh& mesh, const LbvhBuildDesc& desc, Bvh& outBvh, BvhBuildStats* pStats = nullptr);
+
+	// Sets every LBVH variant against the binned SAH tree over a dense generated sphere: how much
+	//  faster it builds and how much more a ray is expected to cost.
+	static bool RunBenchmark(UINT sphereSize, const LbvhBuildDesc& desc, const BvhBuildDesc& referenceDesc);
+};
@@ -152,6 +152,26 @@
 	}
 #endif
 
+// Coroutine counterparts of ReturnFalse and CheckIsValid for Async::Task<bool> bodies.
+#ifndef CoReturnFalse
+#define CoReturnFalse(__msg)	\
+	{						\
+		WErrln(__msg);		\
+		co_return false;	\
+	}
+#endif
+
+#ifndef CoCheckIsValid
+#define CoCheckIsValid(__statement)			\
+	{										\
+		bool __result = __statement;		\
+		if (!__result) {					\
+			WErrln(L"");					\
+			co_return false;				\
+		}									\
+	}
+#endif
+
 #ifndef CheckHResult
 #define CheckHResult(__statement)							\
 	{														\
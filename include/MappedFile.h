@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Windows.h>
+#include <string>
+
+// Read-only view of a whole file mapped into the address space.
+// The view stays valid until Close() is called or the object is destroyed.
+class MappedFile {
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+private:
+	MappedFile(const MappedFile& ref) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+
+public:
+	bool Open(const std::wstring& inFilename);
+	void Close();
+
+	__forceinline const void* Data() const;
+	__forceinline UINT64 Size() const;
+	__forceinline bool IsOpen() const;
+
+	// Last-write time of the mapped file, in FILETIME units.
+	__forceinline UINT64 WriteTime() const;
+
+private:
+	HANDLE mhFile;
+	HANDLE mhMapping;
+
+	const void* mData;
+	UINT64 mSize;
+	UINT64 mWriteTime;
+};
+
+const void* MappedFile::Data() const {
+	return mData;
+}
+
+UINT64 MappedFile::Size() const {
+	return mSize;
+}
+
+bool MappedFile::IsOpen() const {
+	return mData != nullptr;
+}
+
+UINT64 MappedFile::WriteTime() const {
+	return mWriteTime;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "MathHelper.h"
+#include "Meshlet.h"
+#include "GeometryPool.h"
 
 #include <d3d12.h>
 #include <DirectXMath.h>
@@ -11,10 +13,15 @@
 
 extern const int gNumFrameResources;
 
+// Offsets are relative to the geometry's own CPU buffers until Renderer::UploadGeometry places it
+//  in the geometry pool, and relative to the pool's arenas afterwards.
 struct SubmeshGeometry {
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	INT BaseVertexLocation = 0;
+
+	// Object-space deviation from the full-detail submesh; zero unless this is a simplified level.
+	float LodError = 0.0f;
 };
 
 struct MeshGeometry {
@@ -26,13 +33,13 @@ struct MeshGeometry {
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU = nullptr;
 
+	// The geometry pool's arenas; this geometry occupies PoolAllocation within them.
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
+	GeometryPoolAllocation PoolAllocation;
 
-	// Data about the buffers.
+	// Data about the buffers; the byte sizes cover this geometry only.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -40,16 +47,23 @@ struct MeshGeometry {
 
 	UINT GeometryIndex = 0;
 
+	// Box drawn until the asynchronous loader delivers the real mesh; never cached.
+	bool Placeholder = false;
+
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
 	// the Submeshes individually.
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
 
+	// Clusters of each DrawArgs entry, keyed by the same name.
+	std::unordered_map<std::string, MeshletGeometry> Meshlets;
+
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const {
 		D3D12_VERTEX_BUFFER_VIEW vbv;
+		// Views start at the arena so the pool-relative draw arguments apply unchanged.
 		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
 		vbv.StrideInBytes = VertexByteStride;
-		vbv.SizeInBytes = VertexBufferByteSize;
+		vbv.SizeInBytes = GeometryPool::VertexOffset(PoolAllocation) * VertexByteStride + VertexBufferByteSize;
 
 		return vbv;
 	}
@@ -58,16 +72,10 @@ struct MeshGeometry {
 		D3D12_INDEX_BUFFER_VIEW ibv;
 		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
 		ibv.Format = IndexFormat;
-		ibv.SizeInBytes = IndexBufferByteSize;
+		ibv.SizeInBytes = GeometryPool::IndexByteOffset(PoolAllocation) + IndexBufferByteSize;
 
 		return ibv;
 	}
-
-	// We can free this memory after we finish upload to the GPU.
-	void DisposeUploaders() {
-		VertexBufferUploader = nullptr;
-		IndexBufferUploader = nullptr;
-	}
 };
 
 struct Material {
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "HlslCompaction.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MeshCache {
+	// 'M' 'B' 'I' 'N'
+	const UINT Magic = 0x4E49424D;
+	// Bump whenever the on-disk layout or the Vertex layout in HlslCompaction.h changes.
+	const UINT Version = 4;
+
+	const UINT SectionAlignment = 16;
+	const UINT MaxSubmeshNameLength = 64;
+
+	// On-disk layout (little-endian, every section 16-byte aligned):
+	//  FileHeader | Vertex[VertexCount] | uint16/uint32[IndexCount] | SubmeshRecord[SubmeshCount]
+	struct FileHeader {
+		UINT				Magic;
+		UINT				Version;
+		UINT				HeaderSize;
+		UINT				VertexStride;
+
+		UINT				VertexCount;
+		UINT				IndexCount;
+		UINT				IndexStride;
+		UINT				SubmeshCount;
+
+		DirectX::XMFLOAT3	BoundsMin;
+		// MeshOptimizer::Flags applied before baking.
+		UINT				BakeFlags;
+		DirectX::XMFLOAT3	BoundsMax;
+		UINT				FileHeaderPad1;
+
+		UINT64				VertexOffset;
+		UINT64				IndexOffset;
+		UINT64				SubmeshOffset;
+		UINT64				FileSize;
+
+		// Identifies the file the cache was baked from; a mismatch invalidates the cache.
+		UINT64				SourceSize;
+		UINT64				SourceWriteTime;
+
+		// Hash of the vertex, index and submesh sections.
+		UINT64				ContentHash;
+		// SourceInfo::SettingsHash the cache was baked with.
+		UINT64				SettingsHash;
+	};
+
+	struct SubmeshRecord {
+		char	Name[MaxSubmeshNameLength];
+		UINT	IndexCount;
+		UINT	StartIndexLocation;
+		INT		BaseVertexLocation;
+		float	LodError;
+	};
+
+	struct SourceInfo {
+		UINT64 Size		 = 0;
+		UINT64 WriteTime = 0;
+		// Processing the cache is expected to have been baked with.
+		UINT   BakeFlags = 0;
+		// Hash of every other setting the baked vertices and indices depend on.
+		UINT64 SettingsHash = 0;
+	};
+
+	struct NamedSubmesh {
+		std::string		Name;
+		SubmeshGeometry	Submesh;
+	};
+
+	// Read-only ID3DBlob over a range of a mapped file.
+	// Holds a reference to the mapping, so MeshGeometry::VertexBufferCPU/IndexBufferCPU can
+	//  point straight into the mapped pages; the memory must not be written through.
+	class MappedBlob : public ID3DBlob {
+	public:
+		MappedBlob(const std::shared_ptr<MappedFile>& file, const void* pData, SIZE_T size);
+		virtual ~MappedBlob() = default;
+
+	public:
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override;
+		ULONG STDMETHODCALLTYPE AddRef() override;
+		ULONG STDMETHODCALLTYPE Release() override;
+
+		LPVOID STDMETHODCALLTYPE GetBufferPointer() override;
+		SIZE_T STDMETHODCALLTYPE GetBufferSize() override;
+
+	private:
+		std::atomic<ULONG> mRefCount;
+
+		std::shared_ptr<MappedFile> mFile;
+		const void* mData;
+		SIZE_T mSize;
+	};
+
+	class MeshCacheFile {
+	public:
+		MeshCacheFile() = default;
+		virtual ~MeshCacheFile() = default;
+
+	public:
+		// Maps the file and checks magic, version, strides, section bounds and that every submesh's
+		//  index range and base vertex lie within the file.
+		// When pSource is given, the cache is also rejected if it was baked from a
+		//  different version of the source file.
+		// bValidate additionally recomputes the content hash and range-checks every index, on its
+		//  own and offset by the base vertex of each submesh that draws it.
+		bool Open(const std::wstring& inFilename, const SourceInfo* pSource, bool bValidate);
+
+		const FileHeader& Header() const;
+
+		const Vertex* Vertices() const;
+		const void* Indices() const;
+		DXGI_FORMAT IndexFormat() const;
+		UINT64 VertexBufferByteSize() const;
+		UINT64 IndexBufferByteSize() const;
+
+		void GetSubmeshes(std::vector<NamedSubmesh>& outSubmeshes) const;
+
+		// Zero-copy blobs over the vertex and index sections.
+		Microsoft::WRL::ComPtr<ID3DBlob> CreateVertexBlob() const;
+		Microsoft::WRL::ComPtr<ID3DBlob> CreateIndexBlob() const;
+
+	private:
+		std::shared_ptr<MappedFile> mFile;
+		const FileHeader* mHeader = nullptr;
+	};
+
+	bool QuerySourceInfo(const std::wstring& inFilename, SourceInfo& outInfo);
+
+	// indexStride is 2 or 4.
+	bool Write(
+		const std::wstring& inFilename,
+		const Vertex* pVertices, UINT vertexCount,
+		const void* pIndices, UINT indexCount, UINT indexStride,
+		const std::vector<NamedSubmesh>& inSubmeshes,
+		const SourceInfo& inSource);
+
+	// 64-bit FNV-1a over 8-byte words (tail bytes folded individually).
+	UINT64 HashBytes(const void* pData, size_t size, UINT64 seed = 0xCBF29CE484222325ull);
+}
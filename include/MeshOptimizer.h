@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats {
+	// Average cache miss ratio: transformed vertices per triangle (0.5 is ideal for large grids, 3 is worst).
+	float ACMR = 0.0f;
+	// Average transform to vertex ratio: transformed vertices per referenced vertex (1 is ideal).
+	float ATVR = 0.0f;
+
+	size_t TransformedVertexCount = 0;
+};
+
+// Triangle/vertex reordering for the raster passes.
+//
+// The passes are meant to run in order: OptimizeVertexCache, then OptimizeOverdraw on the
+//  cache-optimized stream, then OptimizeVertexFetch, which also renumbers the vertex buffer.
+// Indices are assumed to be a triangle list addressing the vertex array directly
+//  (BaseVertexLocation of zero).
+class MeshOptimizer {
+public:
+	enum Flags {
+		ENone			= 0,
+		EVertexCache	= 1 << 0,
+		EOverdraw		= 1 << 1,
+		EVertexFetch	= 1 << 2,
+		EAll			= EVertexCache | EOverdraw | EVertexFetch
+	};
+
+	static const UINT DefaultCacheSize = 16;
+	static const float DefaultOverdrawThreshold;
+
+public:
+	// FIFO post-transform cache simulation.
+	static VertexCacheStats AnalyzeVertexCache(const std::uint32_t* pIndices, size_t indexCount, size_t vertexCount, UINT cacheSize = DefaultCacheSize);
+
+	// Tipsify (Sander, Nehab, Barczak 2007): fans around the vertex that keeps the most
+	//  neighbours resident in a FIFO cache of the given size, jumping on dead ends.
+	static void OptimizeVertexCache(std::uint32_t* pIndices, size_t indexCount, size_t vertexCount, UINT cacheSize = DefaultCacheSize);
+
+	// Splits the stream into clusters at cache restarts and where a cluster's ACMR stays
+	//  within threshold of its parent's, then sorts clusters by a view-independent occlusion
+	//  potential (outward-facing clusters far from the mesh centroid first).
+	static void OptimizeOverdraw(
+		std::uint32_t* pIndices, size_t indexCount,
+		const Vertex* pVertices, size_t vertexCount,
+		UINT cacheSize = DefaultCacheSize,
+		float threshold = DefaultOverdrawThreshold);
+
+	// Renumbers vertices in first-use order, dropping unreferenced ones.
+	// Returns the new vertex count.
+	static size_t OptimizeVertexFetch(std::uint32_t* pIndices, size_t indexCount, std::vector<Vertex>& ioVertices);
+
+	// Runs the passes selected by flags over the whole mesh.
+	static void Optimize(
+		std::vector<Vertex>& ioVertices,
+		std::vector<std::uint32_t>& ioIndices,
+		UINT flags = EAll,
+		UINT cacheSize = DefaultCacheSize);
+};
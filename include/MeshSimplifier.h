@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <cstdint>
+#include <vector>
+
+struct SimplifyDesc {
+	// Simplification stops once the index count drops to this many.
+	size_t TargetIndexCount = 0;
+	// Upper bound on the geometric error, relative to the mesh extent.
+	float MaxError = 0.01f;
+	// Weights of normal and texture coordinate mismatch when ranking collapses; they do not
+	//  count against MaxError.
+	float NormalWeight = 0.5f;
+	float TexCoordWeight = 1.0f;
+	// Open borders stay in place instead of only collapsing along themselves.
+	bool LockBorders = false;
+};
+
+struct LodLevel {
+	std::vector<std::uint32_t> Indices;
+	// Object-space deviation from the full-detail mesh.
+	float Error = 0.0f;
+};
+
+class MeshSimplifier {
+public:
+	// Quadric error metric edge collapse (Garland, Heckbert 1997) onto existing vertices, so the
+	//  result indexes the same vertex buffer.
+	// Vertices sharing a position collapse together; each corner is then remapped to the vertex of
+	//  the target position whose normal and texture coordinates match best, which keeps attribute
+	//  seams and faceted meshes intact.
+	// Returns the achieved error relative to the mesh extent (the largest side of its bounds).
+	static float Simplify(
+		const Vertex* pVertices, size_t vertexCount,
+		const std::uint32_t* pIndices, size_t indexCount,
+		const SimplifyDesc& desc,
+		std::vector<std::uint32_t>& outIndices);
+
+	// Each level targets ratio times the previous level's index count and simplifies that level.
+	// The chain stops early once a level removes less than a tenth of its input.
+	// desc.TargetIndexCount is ignored; desc.MaxError bounds each step.
+	static void BuildLodChain(
+		const Vertex* pVertices, size_t vertexCount,
+		const std::uint32_t* pIndices, size_t indexCount,
+		UINT maxLevelCount, float ratio,
+		const SimplifyDesc& desc,
+		std::vector<LodLevel>& outLevels);
+
+	static float CalcExtent(const Vertex* pVertices, size_t vertexCount);
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+// Same limits as the D3D12 mesh shader samples; 124 triangles keeps the packed primitive
+//  block under 512 bytes.
+const UINT DefaultMeshletMaxVertices = 64;
+const UINT DefaultMeshletMaxTriangles = 124;
+
+struct Meshlet {
+	UINT VertexCount;
+	UINT VertexOffset;
+	UINT TriangleCount;
+	UINT TriangleOffset;
+};
+
+// Bounding sphere plus a backface cone; the cluster faces away from every eye position p
+//  where dot(Center - p, ConeAxis) >= ConeCutoff * length(Center - p) + Radius.
+// ConeCutoff is 1 when the normals spread too far for the test to ever pass.
+struct MeshletBounds {
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// MeshletBounds of four clusters transposed into SIMD lanes.
+// Unused lanes of the last block carry a negative infinite radius and never pass.
+struct MeshletBoundsX4 {
+	DirectX::XMVECTOR CenterX;
+	DirectX::XMVECTOR CenterY;
+	DirectX::XMVECTOR CenterZ;
+	DirectX::XMVECTOR Radius;
+	DirectX::XMVECTOR ConeAxisX;
+	DirectX::XMVECTOR ConeAxisY;
+	DirectX::XMVECTOR ConeAxisZ;
+	DirectX::XMVECTOR ConeCutoff;
+};
+
+struct MeshletGeometry {
+	std::vector<Meshlet> Meshlets;
+	// Meshlet-local vertex -> vertex index relative to the submesh's BaseVertexLocation.
+	std::vector<UINT> UniqueVertexIndices;
+	// Meshlet-local triangles packed 10:10:10.
+	std::vector<UINT> PrimitiveIndices;
+	std::vector<MeshletBounds> Bounds;
+	std::vector<MeshletBoundsX4> CullBounds;
+};
+
+struct MeshletCullStats {
+	UINT MeshletCount = 0;
+	UINT VisibleMeshletCount = 0;
+	UINT TriangleCount = 0;
+	UINT VisibleTriangleCount = 0;
+};
+
+class MeshletBuilder {
+public:
+	// Splits a triangle list into clusters in index order, closing a cluster as soon as the next
+	//  triangle would exceed either limit; run the vertex cache pass first for fuller clusters.
+	static bool Build(
+		const Vertex* pVertices, size_t vertexCount,
+		const std::uint32_t* pIndices, size_t indexCount,
+		MeshletGeometry& outGeometry,
+		UINT maxVertices = DefaultMeshletMaxVertices,
+		UINT maxTriangles = DefaultMeshletMaxTriangles);
+
+	static __forceinline UINT PackTriangle(UINT i0, UINT i1, UINT i2);
+	static __forceinline void UnpackTriangle(UINT packed, UINT& i0, UINT& i1, UINT& i2);
+};
+
+class MeshletCuller {
+public:
+	// Frustum and backface cone test over four clusters per iteration.
+	// worldViewProj and eyePosL take the clusters' object space to clip space and the eye into
+	//  object space; scaled transforms are handled as long as the scale is uniform.
+	// Appends the indices of surviving clusters to outVisible and returns their count;
+	//  pStats, when given, is accumulated into rather than reset.
+	static UINT Cull(
+		const MeshletGeometry& inGeometry,
+		DirectX::FXMMATRIX worldViewProj,
+		DirectX::FXMVECTOR eyePosL,
+		std::vector<UINT>& outVisible,
+		MeshletCullStats* pStats = nullptr);
+
+	// Orbits dense generated meshes and reports what the cluster culler rejects per frame.
+	static bool RunBenchmark(UINT frameCount, UINT maxVertices = DefaultMeshletMaxVertices, UINT maxTriangles = DefaultMeshletMaxTriangles);
+};
+
+UINT MeshletBuilder::PackTriangle(UINT i0, UINT i1, UINT i2) {
+	return (i0 & 0x3FF) | ((i1 & 0x3FF) << 10) | ((i2 & 0x3FF) << 20);
+}
+
+void MeshletBuilder::UnpackTriangle(UINT packed, UINT& i0, UINT& i1, UINT& i2) {
+	i0 = packed & 0x3FF;
+	i1 = (packed >> 10) & 0x3FF;
+	i2 = (packed >> 20) & 0x3FF;
+}
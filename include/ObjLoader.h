@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+#include "VertexWelder.h"
+
+#include <string>
+#include <vector>
+
+struct ObjMaterial {
+	std::string			Name;
+
+	DirectX::XMFLOAT3	Ambient		= { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3	Diffuse		= { 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3	Specular	= { 0.0f, 0.0f, 0.0f };
+	float				Shininess	= 1.0f;
+	float				Dissolve	= 1.0f;
+
+	std::string			DiffuseMap;
+	std::string			NormalMap;
+};
+
+// A run of triangles sharing one object/group name and material.
+struct ObjSubmesh {
+	std::string	Name;
+	std::string	MaterialName;
+	int			MaterialIndex		= -1;
+	UINT		StartIndexLocation	= 0;
+	UINT		IndexCount			= 0;
+};
+
+struct ObjMesh : public Mesh {
+	std::vector<ObjSubmesh>		Submeshes;
+	std::vector<ObjMaterial>	Materials;
+};
+
+struct ObjLoadDesc {
+	VertexWelder::WeldTolerance WeldTolerance;
+
+	// Splits the mesh at object, group and material changes; otherwise a single submesh covers it.
+	bool	SplitSubmeshes	= true;
+	// Reads each referenced material library once, after every chunk is parsed.
+	bool	LoadMaterials	= true;
+
+	// Lower bound of bytes handed to one parse task.
+	UINT64	MinChunkSize	= 256 * 1024;
+};
+
+struct ObjLoadStats {
+	UINT64	FileSize			= 0;
+	size_t	ChunkCount			= 0;
+	size_t	TriangleCount		= 0;
+
+	double	MapMilliseconds		= 0.0;
+	double	ParseMilliseconds	= 0.0;
+	double	MergeMilliseconds	= 0.0;
+	double	WeldMilliseconds	= 0.0;
+	double	TotalMilliseconds	= 0.0;
+
+	VertexWelder::WeldStats Weld;
+};
+
+// Wavefront OBJ/MTL reader.
+//
+// The OBJ file is memory-mapped and split into line-aligned chunks that are parsed in
+//  parallel. Per-chunk attribute arrays are merged at prefix-summed offsets, relative
+//  (negative) indices are resolved against them, and polygons are fan-triangulated
+//  straight into the Vertex layout before being welded into an indexed mesh.
+class ObjLoader {
+public:
+	static bool Load(
+		const std::wstring& inFilename,
+		ObjMesh& outMesh,
+		const ObjLoadDesc& inDesc = ObjLoadDesc(),
+		ObjLoadStats* pOutStats = nullptr);
+
+	// Parses OBJ text already in memory; inFilename only names the file in errors and locates
+	//  its material libraries.
+	static bool Parse(
+		const void* pData, UINT64 size,
+		const std::wstring& inFilename,
+		ObjMesh& outMesh,
+		const ObjLoadDesc& inDesc = ObjLoadDesc(),
+		ObjLoadStats* pOutStats = nullptr);
+
+	static bool LoadMaterials(const std::wstring& inFilename, std::vector<ObjMaterial>& outMaterials);
+
+	// Times the former tinyobjloader path (parse, then serially expand and weld every corner)
+	//  on inFilename against the native loader's numbers.
+	static bool RunBenchmark(const std::wstring& inFilename, const ObjLoadStats& nativeStats);
+};
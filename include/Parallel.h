@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Minimal fork-join helpers for CPU-side asset and acceleration structure work.
+// Every call spawns its worker threads and joins them before returning; the calling
+//  thread participates, so a single-core machine degrades to a plain loop.
+namespace Parallel {
+	namespace Detail {
+		inline thread_local bool bSerialThread = false;
+	}
+
+	// Makes every later ForEach and ForRange on the calling thread a plain loop. For threads that
+	//  already run side by side with others, such as an Async::WorkerPool's, where spawning
+	//  WorkerCount() more threads per call would oversubscribe the cores.
+	inline void MakeThreadSerial() {
+		Detail::bSerialThread = true;
+	}
+
+	inline bool IsThreadSerial() {
+		return Detail::bSerialThread;
+	}
+
+	inline size_t WorkerCount() {
+		const unsigned count = std::thread::hardware_concurrency();
+		return count == 0 ? 1 : static_cast<size_t>(count);
+	}
+
+	// Calls func(taskIndex) once for every index in [0, taskCount), handing out tasks
+	//  dynamically so uneven tasks still balance.
+	template <typename Func>
+	void ForEach(size_t taskCount, const Func& func) {
+		const size_t workerCount = std::min(WorkerCount(), taskCount);
+		if (workerCount <= 1 || IsThreadSerial()) {
+			for (size_t i = 0; i < taskCount; ++i)
+				func(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < taskCount; i = next++)
+				func(i);
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(workerCount - 1);
+		for (size_t i = 1; i < workerCount; ++i)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	// Splits [0, count) into ranges of at least minGrain elements and calls func(begin, end)
+	//  for each of them.
+	template <typename Func>
+	void ForRange(size_t count, size_t minGrain, const Func& func) {
+		if (count == 0) return;
+
+		const size_t grain = std::max(minGrain, (count + WorkerCount() * 4 - 1) / (WorkerCount() * 4));
+		const size_t rangeCount = (count + grain - 1) / grain;
+
+		ForEach(rangeCount, [&](size_t range) {
+			const size_t begin = range * grain;
+			const size_t end = std::min(begin + grain, count);
+			func(begin, end);
+		});
+	}
+}
@@ -1,14 +1,26 @@
 #pragma once
 
 #include <d3d12.h>
+#include <DirectXCollision.h>
+#include <vector>
 
 #include "MathHelper.h"
 
 struct MeshGeometry;
 struct Material;
+struct MeshletGeometry;
 
 extern const int gNumFrameResources;
 
+struct RenderItemLod {
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+	// Object-space deviation from the full-detail level.
+	float Error = 0.0f;
+	const MeshletGeometry* Meshlets = nullptr;
+};
+
 struct RenderItem {
 public:
 	enum RenderType {
@@ -46,4 +58,18 @@ public:
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Clusters of the submesh above, for CPU culling.
+	const MeshletGeometry* Meshlets = nullptr;
+
+	// Full-detail level followed by coarser ones; Renderer::SelectLods copies the chosen level
+	//  into the draw parameters above every frame.
+	std::vector<RenderItemLod> Lods;
+	UINT LodIndex = 0;
+	// Object-space bounds of the full-detail level.
+	DirectX::BoundingSphere Bounds;
+
+	// CPU ray tracing intersects the geometry's analytic stand-in instead of its triangles;
+	//  raster keeps drawing the triangles. See Renderer::BuildCpuAnalyticBvhs.
+	bool AnalyticRayTracing = false;
 };
\ No newline at end of file
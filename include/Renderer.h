@@ -5,6 +5,7 @@ const int gNumFrameResources = 3;
 #include "LowRenderer.h"
 #include "GameTimer.h"
 #include "RenderItem.h"
+#include "Meshlet.h"
 
 #include <array>
 #include <unordered_map>
@@ -22,6 +23,14 @@ struct FrameResource;
 struct DXRObjectCB;
 struct PassConstants;
 struct AccelerationStructureBuffer;
+struct Bvh;
+struct AnalyticBvh;
+struct TwoLevelBvh;
+struct RtaoFrame;
+struct ShadowFrame;
+class GeometryPool;
+class AsyncMeshLoader;
+class Stopwatch;
 
 namespace GaussianFilter { class GaussianFilterClass; }
 namespace GaussianFilterCS { class GaussianFilterCSClass; }
@@ -33,8 +42,8 @@ namespace DxrShadow { class DxrShadowClass; }
 namespace Rtao { class RtaoClass; }
 namespace Debug { class DebugClass; }
 namespace BackBuffer { class BackBufferClass; }
+namespace MeshCache { class MeshCacheFile; }
 
-const int gNumGeometryBuffers = 64;
 const int gNumObjects = 32;
 const int gNumMaterials = 32;
 
@@ -105,8 +114,8 @@ namespace GroundTruthDenoising {
 namespace EDescriptors {
 	enum {
 		ES_Vertices = 0,
-		ES_Indices = ES_Vertices + gNumGeometryBuffers,
-		ES_Font = ES_Indices + gNumGeometryBuffers,
+		ES_Indices,
+		ES_Font,
 		Count
 	};
 }
@@ -149,6 +158,21 @@ public:
 		}
 	};
 
+	// CPU milliseconds per stage. The scene stages cover the last BuildStressScene, the others
+	//  the last frame.
+	struct StageTimings {
+		double SceneGeneration = 0.0;
+		double RenderItems = 0.0;
+		double TlasInstances = 0.0;
+		// Includes waiting for the GPU build.
+		double TlasBuild = 0.0;
+		double ObjectUpload = 0.0;
+		double LodSelection = 0.0;
+		double MeshletCulling = 0.0;
+		double ShadowRecording = 0.0;
+		double GBufferRecording = 0.0;
+	};
+
 public:
 	Renderer();
 	virtual ~Renderer();
@@ -177,6 +201,16 @@ public:
 
 	void DisplayImGui(bool state);
 
+	// Replaces the generated stress-scene instances with instanceCount new ones, growing the
+	//  per-frame object buffers when needed, and rebuilds the TLAS.
+	bool BuildStressScene(UINT instanceCount, UINT seed);
+	// True until every mesh requested from the asynchronous loader has replaced its placeholder.
+	bool GeometryLoadsPending() const;
+	// Makes every object's constants upload again, as if the whole scene moved.
+	void InvalidateObjectConstants();
+
+	__forceinline const StageTimings& GetStageTimings() const;
+
 protected:
 	virtual bool CreateRtvAndDsvDescriptorHeaps() override;
 
@@ -188,6 +222,17 @@ protected:
 	bool CompileShaders();
 	bool BuildFrameResources();
 	bool BuildGeometries();
+	bool LoadGeometry(const std::string& name, const std::wstring& inFilename, UINT optimizeFlags, UINT lodLevelCount);
+	// Uploads an opened mesh cache; cacheTimer started before the cache was opened.
+	bool LoadCachedGeometry(const std::string& name, const std::wstring& inFilename, const MeshCache::MeshCacheFile& cache, bool bHasSource, const Stopwatch& cacheTimer);
+	// Draws a placeholder under name until the asynchronous loader delivers the mesh.
+	bool RequestGeometry(const std::string& name, const std::wstring& inFilename, UINT optimizeFlags, UINT lodLevelCount);
+	bool BuildPlaceholderGeometry(const std::string& name);
+	// Uploads whatever the asynchronous loader finished and swaps it in for its placeholder.
+	bool IntegrateLoadedGeometries();
+	// Records the uploads and acceleration structure builds of geo and every other ready geometry.
+	bool RecordLoadedGeometries(std::unique_ptr<MeshGeometry> geo);
+	bool UploadGeometry(std::unique_ptr<MeshGeometry> geo);
 	bool BuildMaterials();
 	bool BuildResources();
 	bool BuildRootSignatures();
@@ -197,10 +242,25 @@ protected:
 	// Raterization
 	bool BuildPSOs();
 	bool BuildRenderItems();
+	// Appends SceneGenerator instances of the stress-scene shapes after the fixed items.
+	bool AddStressSceneItems(UINT instanceCount, UINT seed);
 
 	// Raytracing
 	bool BuildBLAS();
+	bool BuildBLAS(MeshGeometry* geo);
 	bool BuildTLAS();
+	// CPU counterparts of the BLASs, over the same full-detail ranges of the CPU buffers.
+	bool BuildCpuBvhs();
+	bool BuildCpuBvh(const MeshGeometry* geo);
+	// Analytic stand-ins of the geometries that have one, for render items traced analytically.
+	bool BuildCpuAnalyticBvhs();
+	// Logs CPU traversal throughput on the monkey and a stress scene and two-level build/refit
+	//  timings; needs the imported meshes loaded.
+	bool RunCpuRayTracingBenchmarks();
+	// CPU counterpart of the TLAS over the CPU BVHs; rebuilt whenever render items or BVHs change.
+	bool BuildCpuTlas();
+	// World-space triangle soup of the opaque render items, as the TLAS sees them.
+	bool BuildCpuSceneBvh(std::vector<Vertex>& outVertices, std::vector<std::uint32_t>& outIndices, Bvh& outBvh);
 	bool BuildDXRPSOs();
 	bool BuildShaderTables();
 
@@ -213,6 +273,8 @@ protected:
 	bool UpdateBlurPassCB(const GameTimer& gt);
 	bool UpdateSsaoPassCB(const GameTimer& gt);
 	bool UpdateRtaoPassCB(const GameTimer& gt);
+	bool SelectLods();
+	bool CullMeshlets();
 
 	// Drawing
 	bool Rasterize();
@@ -231,6 +293,19 @@ protected:
 	bool dxrDrawRtao();
 	bool dxrDrawBackBuffer();
 
+	// Copies subresource 0 of each texture, left in the given state, into a new readback buffer;
+	//  flushes the queue.
+	bool ReadbackTextures(UINT count, ID3D12Resource* const* pSources, const D3D12_RESOURCE_STATES* pStates,
+		Microsoft::WRL::ComPtr<ID3D12Resource>* pOutReadbacks, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* pOutFootprints);
+	// Reads back the last frame's RTAO inputs and outputs; flushes the queue.
+	bool CaptureRtaoFrame(RtaoFrame& outFrame);
+	bool CompareRtaoWithCpu();
+	// Reads back the last frame's depth and shadow mask, which is only unblurred on the compare frame.
+	bool CaptureShadowFrame(ShadowFrame& outFrame);
+	bool CompareShadowsWithCpu();
+	// Traces the CPU TLAS from the current camera and writes per-pixel traversal counts.
+	bool RenderCpuHeatmaps();
+
 private:
 	bool bIsCleanedUp;
 	bool bInitialized;
@@ -239,6 +314,9 @@ private:
 	bool bDisplayMaps;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+
+	std::unique_ptr<AsyncMeshLoader> mAsyncMeshLoader;
+	bool bLoadsFinished;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 
 	std::vector<std::unique_ptr<FrameResource>> mFrameResources;
@@ -279,10 +357,20 @@ private:
 
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 	std::unordered_map<RenderItem::RenderType, std::vector<RenderItem*>> mRitems;
+	// Hand-placed items come first; generated stress-scene items follow.
+	UINT mStaticRitemCount;
+	UINT mObjectCapacity;
 	
 	std::unique_ptr<PassConstants> mMainPassCB;
 	std::unique_ptr<PassConstants> mShadowPassCB;
 
+	UINT mSubmittedTriangleCount;
+	UINT mFullDetailTriangleCount;
+
+	MeshletCullStats mMeshletCullStats;
+	StageTimings mStageTimings;
+	std::vector<UINT> mVisibleMeshlets;
+
 	D3D12_VIEWPORT mDebugViewport;
 	D3D12_RECT mDebugScissorRect;
 
@@ -297,15 +385,21 @@ private:
 	std::unordered_map<std::string, std::unique_ptr<AccelerationStructureBuffer>> mBLASs;
 	std::unique_ptr<AccelerationStructureBuffer> mTLAS;
 
+	std::unordered_map<std::string, std::unique_ptr<Bvh>> mCpuBvhs;
+	std::unordered_map<std::string, std::unique_ptr<AnalyticBvh>> mCpuAnalyticBvhs;
+	std::unique_ptr<TwoLevelBvh> mCpuTlas;
+
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D12StateObject>> mDXRPSOs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D12StateObjectProperties>> mDXRPSOProps;
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D12Resource>> mShaderTables;
 
-	int mGeometryBufferCount;
+	std::unique_ptr<GeometryPool> mGeometryPool;
 
 	std::unique_ptr<DxrShadow::DxrShadowClass> mDxrShadow;
 	std::unique_ptr<Rtao::RtaoClass> mRtao;
+	// Constants of the last RTAO dispatch.
+	std::unique_ptr<RtaoConstants> mRtaoCB;
 
 	bool bCheckerboardSamplingEnabled;
 	bool bCheckerboardGenerateRaysForEvenPixels;
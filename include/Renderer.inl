@@ -9,4 +9,8 @@ __forceinline constexpr bool Renderer::Initialized() const {
 	return bInitialized;
 }
 
+__forceinline const Renderer::StageTimings& Renderer::GetStageTimings() const {
+	return mStageTimings;
+}
+
 #endif // __RENDERER_INL__
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+struct Bvh;
+
+// One dispatch of RtaoRayGen: the constants and G-buffer texels it reads and the two images it writes.
+struct RtaoFrame {
+	UINT Width = 0;
+	UINT Height = 0;
+	RtaoConstants Constants = {};
+
+	// gi_Normal and gi_DepthMap texels of the dispatched area, row-major.
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<float> Depths;
+
+	// go_AOCoefficient and go_RayHitDistance.
+	std::vector<float> AOCoefficients;
+	std::vector<float> RayHitDistances;
+};
+
+// How RtaoReference::Run schedules each tile's rays; every combination gives the same images.
+struct RtaoTraceDesc {
+	// Groups consecutive rays into SSE packets.
+	bool Packets = false;
+	// Bins the tile's rays by direction octant, orders each bin by quantized direction, traces them
+	//  in that order and scatters the hits back to their pixels.
+	bool SortRays = false;
+	// Zero follows the shader; otherwise every pixel traces this many directions drawn one after
+	//  the other from its seed, averages their occlusion and keeps the nearest hit.
+	UINT SamplesPerPixel = 0;
+};
+
+struct RtaoReferenceStats {
+	UINT64 RayCount = 0;
+	double Milliseconds = 0.0;
+};
+
+struct RtaoComparison {
+	UINT PixelCount = 0;
+	// Pixels one image shades and the other marks invalid.
+	UINT CoverageMismatchCount = 0;
+	// Pixels off by more than the tolerance.
+	UINT AOMismatchCount = 0;
+	UINT HitDistanceMismatchCount = 0;
+	float AOMaxError = 0.0f;
+	float HitDistanceMaxError = 0.0f;
+	double AOMeanError = 0.0;
+	double HitDistanceMeanError = 0.0;
+};
+
+// CPU implementation of RtaoRayGen in Rtao.hlsl for golden images and headless AO.
+// World positions, TEA seeds, cosine samples and the occlusion falloff are computed in the same
+//  order as the shader, so results only differ where GPU transcendentals or the 16-bit outputs
+//  round differently. Rays follow the shader too: one direction per pixel, closest hit, and the
+//  front faces of RAY_FLAG_CULL_FRONT_FACING_TRIANGLES under the TLAS's counter-clockwise instances.
+class RtaoReference {
+public:
+	// Pixels per side of the square tiles handed out to worker threads.
+	static const UINT TileSize = 16;
+
+	// 'R' 'T' 'A' 'O'
+	static const UINT FileMagic = 0x4F415452;
+	static const UINT FileVersion = 1;
+
+public:
+	// Traces against bvh, which has to hold the scene in world space like the TLAS, and fills the
+	//  frame's AOCoefficients and RayHitDistances from its Normals and Depths.
+	static bool Run(const Bvh& bvh, RtaoFrame& frame, const RtaoTraceDesc& desc = RtaoTraceDesc(), RtaoReferenceStats* pStats = nullptr);
+
+	// Errors are relative to max(1, |gpu|).
+	static bool Compare(const RtaoFrame& reference, const RtaoFrame& gpu, float tolerance, RtaoComparison& outComparison);
+
+	// Raw little-endian dump: header, constants, then normals, depths, AO coefficients and hit
+	//  distances; the output images may be empty.
+	static bool Write(const std::wstring& inFilename, const RtaoFrame& frame);
+	static bool Read(const std::wstring& inFilename, RtaoFrame& outFrame);
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <DirectXMath.h>
+#include <vector>
+
+struct SceneGeneratorDesc {
+	UINT Seed = 1;
+	UINT InstanceCount = 0;
+	// Instances pick a shape in [0, ShapeCount) and a material in [0, MaterialCount).
+	UINT ShapeCount = 1;
+	UINT MaterialCount = 1;
+	// Instances per square unit of ground; the scattered square grows with the instance count
+	//  so density, and with it the per-view load, stays comparable across scene sizes.
+	float Density = 0.25f;
+	float MinHeight = 0.0f;
+	float MaxHeight = 8.0f;
+	float MinScale = 0.25f;
+	float MaxScale = 1.0f;
+};
+
+struct SceneInstance {
+	DirectX::XMFLOAT4X4 World;
+	UINT ShapeIndex;
+	UINT MaterialIndex;
+};
+
+// Deterministic procedural scenes for scaling benchmarks.
+// Every instance draws from its own random stream keyed by (seed, instance index), so the same
+//  description yields the same scene on every machine and thread count.
+class SceneGenerator {
+public:
+	static const UINT MaxInstanceCount = 1u << 20;
+
+public:
+	static bool Generate(const SceneGeneratorDesc& desc, std::vector<SceneInstance>& outInstances);
+
+	// Half the side of the square the instances are scattered over.
+	static float HalfExtent(const SceneGeneratorDesc& desc);
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <string>
+#include <vector>
+
+struct Bvh;
+
+// One dispatch of ShadowRayGen: the pass constants and depth texels it reads and the mask it writes.
+struct ShadowFrame {
+	UINT Width = 0;
+	UINT Height = 0;
+	// Directional lights traced, Constants.Lights[0, LightCount); the GPU pass only traces the first.
+	UINT LightCount = 1;
+	PassConstants Constants = {};
+
+	// gDepthMap texels of the dispatched area, row-major.
+	std::vector<float> Depths;
+
+	// gShadowMap: the fraction of lights that reach each pixel, so 0 or 1 for a single light.
+	std::vector<float> ShadowFactors;
+};
+
+struct ShadowTraceDesc {
+	// Groups neighbouring pixels into SSE packets.
+	bool Packets = true;
+};
+
+struct ShadowReferenceStats {
+	UINT64 RayCount = 0;
+	// Rays that found an occluder.
+	UINT64 OccludedCount = 0;
+	double Milliseconds = 0.0;
+};
+
+struct ShadowComparison {
+	UINT PixelCount = 0;
+	// Pixels off by more than the tolerance.
+	UINT MismatchCount = 0;
+	float MaxError = 0.0f;
+	double MeanError = 0.0;
+};
+
+// CPU implementation of ShadowRayGen in ShadowRay.hlsl, the regression oracle for the unblurred
+//  DxrShadow mask.
+// World positions are reconstructed in the same order as the shader, and rays follow it: origin on
+//  the surface, TMin 0.001, TMax 1000, any hit, and the front faces of
+//  RAY_FLAG_CULL_FRONT_FACING_TRIANGLES under the TLAS's counter-clockwise instances.
+class ShadowReference {
+public:
+	// Pixels per side of the square tiles handed out to worker threads.
+	static const UINT TileSize = 16;
+
+	// 'S' 'H' 'D' 'W'
+	static const UINT FileMagic = 0x57444853;
+	static const UINT FileVersion = 1;
+
+public:
+	// Traces against bvh, which has to hold the scene in world space like the TLAS, and fills the
+	//  frame's ShadowFactors from its Depths.
+	// Each tile traces its rays light by light.
+	static bool Run(const Bvh& bvh, ShadowFrame& frame, const ShadowTraceDesc& desc = ShadowTraceDesc(), ShadowReferenceStats* pStats = nullptr);
+
+	static bool Compare(const ShadowFrame& reference, const ShadowFrame& gpu, float tolerance, ShadowComparison& outComparison);
+
+	// Raw little-endian dump: header, constants, then depths and shadow factors; the factors may
+	//  be empty.
+	static bool Write(const std::wstring& inFilename, const ShadowFrame& frame);
+	static bool Read(const std::wstring& inFilename, ShadowFrame& outFrame);
+};
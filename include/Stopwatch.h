@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Windows.h>
+
+// Lightweight QueryPerformanceCounter-based timer for load-time and benchmark reports.
+class Stopwatch {
+public:
+	Stopwatch() {
+		__int64 countsPerSec;
+		QueryPerformanceFrequency(reinterpret_cast<LARGE_INTEGER*>(&countsPerSec));
+		mSecondsPerCount = 1.0 / static_cast<double>(countsPerSec);
+
+		Restart();
+	}
+
+public:
+	void Restart() {
+		QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(&mStartTime));
+	}
+
+	double ElapsedSeconds() const {
+		__int64 currTime;
+		QueryPerformanceCounter(reinterpret_cast<LARGE_INTEGER*>(&currTime));
+		return static_cast<double>(currTime - mStartTime) * mSecondsPerCount;
+	}
+
+	double ElapsedMilliseconds() const {
+		return ElapsedSeconds() * 1000.0;
+	}
+
+private:
+	double mSecondsPerCount;
+	__int64 mStartTime;
+};
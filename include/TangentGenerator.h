@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <cstdint>
+#include <vector>
+
+struct TangentGenerationStats {
+	// Vertices duplicated because their triangles disagree on handedness.
+	size_t SplitVertexCount = 0;
+	// Triangles with no texture-space area; they contribute nothing.
+	size_t DegenerateTriangleCount = 0;
+};
+
+// Per-vertex tangents following the MikkTSpace conventions (Mikkelsen 2008): each corner
+//  contributes its triangle's texture-space tangent projected onto the vertex normal's plane
+//  and weighted by the corner angle, and the sum is normalized.
+// Triangles of opposite handedness (mirrored texture coordinates) never share a tangent; a
+//  vertex used by both is split so neither half cancels the other, and each half stores its
+//  handedness in Tangent.w.
+class TangentGenerator {
+public:
+	// Per-triangle tangents are computed in parallel over fixed-size triangle chunks; each vertex
+	//  then sums its corners in index order, so the output is identical to GenerateReference
+	//  regardless of the thread count.
+	static void Generate(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, TangentGenerationStats* pStats = nullptr);
+
+	// Single-threaded equivalent, kept as the benchmark baseline.
+	static void GenerateReference(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, TangentGenerationStats* pStats = nullptr);
+
+	// Times the parallel generator against the single-threaded reference on a dense sphere and
+	//  checks that both produce the same mesh.
+	static bool RunBenchmark(UINT iterationCount);
+};
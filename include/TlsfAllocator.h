@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <cstdint>
+#include <vector>
+
+struct TlsfAllocation {
+	UINT64 Offset = 0;
+	UINT64 Size = 0;
+	UINT Node = 0xFFFFFFFF;
+
+	bool IsValid() const { return Node != 0xFFFFFFFF; }
+};
+
+struct TlsfStats {
+	UINT64 Capacity = 0;
+	UINT64 UsedSize = 0;
+	UINT64 LargestFreeBlock = 0;
+	UINT AllocationCount = 0;
+	UINT FreeBlockCount = 0;
+
+	// 1 - largest free block / total free space; 0 while the free space is one block.
+	float Fragmentation() const;
+};
+
+// Two-level segregated fit sub-allocator (Masmano et al. 2004) over an abstract range of units;
+//  it never touches the memory it manages, so callers pick the unit (bytes, vertices, ...) and
+//  map offsets onto their own resources.
+//
+// Free blocks are binned by the position of their highest set bit and the next SecondLevelBits
+//  bits below it, with a bitmap per level, so allocation and release are O(1) and adjacent free
+//  blocks are coalesced immediately.
+// Requests are rounded up to the next bin boundary before the search, so any block in the found
+//  bin fits without walking its list.
+class TlsfAllocator {
+public:
+	static const UINT SecondLevelBits = 4;
+	static const UINT SecondLevelCount = 1 << SecondLevelBits;
+	static const UINT FirstLevelCount = 64 - SecondLevelBits + 1;
+
+public:
+	TlsfAllocator() = default;
+	virtual ~TlsfAllocator() = default;
+
+public:
+	void Initialize(UINT64 capacity);
+
+	// Returns an invalid allocation when no free block is large enough.
+	TlsfAllocation Allocate(UINT64 size);
+	void Free(const TlsfAllocation& allocation);
+
+	TlsfStats Stats() const;
+
+	__forceinline UINT64 Capacity() const;
+	__forceinline UINT64 UsedSize() const;
+
+	// Random allocate/free traffic with mesh-like sizes against a TLSF arena held near the
+	//  target occupancy; reports throughput and how fragmented the free space gets.
+	static void RunBenchmark(UINT64 capacity, UINT operationCount, float targetOccupancy);
+
+private:
+	struct Node {
+		UINT64 Offset;
+		UINT64 Size;
+		UINT PrevPhysical;
+		UINT NextPhysical;
+		UINT PrevFree;
+		UINT NextFree;
+		bool bFree;
+	};
+
+	static __forceinline void Mapping(UINT64 size, UINT& outFirst, UINT& outSecond);
+
+	UINT NewNode();
+	void ReleaseNode(UINT node);
+
+	void InsertFree(UINT node);
+	void RemoveFree(UINT node);
+	UINT FindFree(UINT64 size) const;
+
+private:
+	std::vector<Node> mNodes;
+	std::vector<UINT> mUnusedNodes;
+
+	UINT64 mFirstLevelBitmap = 0;
+	UINT mSecondLevelBitmaps[FirstLevelCount] = {};
+	UINT mFreeHeads[FirstLevelCount][SecondLevelCount];
+
+	UINT64 mCapacity = 0;
+	UINT64 mUsedSize = 0;
+	UINT mAllocationCount = 0;
+	UINT mFreeBlockCount = 0;
+};
+
+UINT64 TlsfAllocator::Capacity() const {
+	return mCapacity;
+}
+
+UINT64 TlsfAllocator::UsedSize() const {
+	return mUsedSize;
+}
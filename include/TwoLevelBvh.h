@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "AnalyticBvh.h"
+#include "Bvh.h"
+
+#include <d3d12.h>
+#include <DirectXMath.h>
+#include <vector>
+
+// One placement of a bottom-level Bvh, the CPU side of a D3D12_RAYTRACING_INSTANCE_DESC.
+struct BvhInstance {
+	// Object to world in the layout of D3D12_RAYTRACING_INSTANCE_DESC::Transform, i.e. the first
+	//  three columns of a row-vector world matrix; it has to be invertible.
+	DirectX::XMFLOAT3X4 Transform;
+	UINT InstanceID = 0;
+	// ANDed with the ray's instance mask; the instance is skipped when nothing is left.
+	UINT Mask = 0xFF;
+	// D3D12_RAYTRACING_INSTANCE_FLAGS; TRIANGLE_CULL_DISABLE and TRIANGLE_FRONT_COUNTERCLOCKWISE
+	//  are honoured.
+	UINT Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+	// Index into TwoLevelBvh::Blases, or into AnalyticBlases when Analytic is set.
+	UINT Blas = 0;
+	bool Analytic = false;
+};
+
+struct TwoLevelBvh {
+	static const UINT NoParent = 0xFFFFFFFF;
+
+	// Bottom levels in object space; they have to outlive the structure.
+	std::vector<const Bvh*> Blases;
+	std::vector<const AnalyticBvh*> AnalyticBlases;
+	std::vector<BvhInstance> Instances;
+
+	//
+	// Derived from Blases and Instances by TwoLevelBvhBuilder.
+	//
+	// World-space bounds of every instance and the inverse of its Transform, which rays are
+	//  taken into object space with.
+	std::vector<BvhBounds> InstanceBounds;
+	std::vector<DirectX::XMFLOAT3X4> WorldToObject;
+	// Top level over InstanceBounds; leaves reference ranges of InstanceIndices.
+	std::vector<BvhNode> Nodes;
+	std::vector<UINT> InstanceIndices;
+	// Parent of every node and leaf of every instance, for refitting a few instances at a time.
+	std::vector<UINT> Parents;
+	std::vector<UINT> InstanceLeaves;
+};
+
+struct TwoLevelBvhStats {
+	UINT InstanceCount = 0;
+	UINT NodeCount = 0;
+	// Top-level nodes whose bounds were recomputed.
+	UINT UpdatedNodeCount = 0;
+	double Milliseconds = 0.0;
+};
+
+// CPU counterpart of a TLAS over BLASs: a top-level Bvh over instance bounds whose leaves hand
+//  rays, taken into object space, to the bottom-level hierarchies.
+// Moving instances only needs a refit; adding or removing them needs a rebuild. A refit keeps the
+//  topology, so traversal slows down as instances drift from where the last build put them.
+class TwoLevelBvhBuilder {
+public:
+	// Rebuilds the top level over every instance.
+	static bool Build(TwoLevelBvh& tlas, const BvhBuildDesc& desc, TwoLevelBvhStats* pStats = nullptr);
+
+	// Takes new transforms of the listed instances, or of all of them when pInstances is null, and
+	//  grows or shrinks the top-level bounds to match. Listed instances are walked up to the root,
+	//  stopping where bounds stop changing; otherwise every node is swept bottom-up.
+	static bool Refit(TwoLevelBvh& tlas, const UINT* pInstances, UINT count, TwoLevelBvhStats* pStats = nullptr);
+
+	static void SetTransform(BvhInstance& instance, const DirectX::XMFLOAT4X4& world);
+
+	// Scatters instanceCount instances of the bottom levels and times a full rebuild against an
+	//  incremental refit after movingFraction of them move and a full refit after all of them do,
+	//  each by up to drift along every axis. SAH costs show what the refit gives up.
+	static bool RunBenchmark(const std::vector<const Bvh*>& blases, UINT instanceCount, UINT seed, float density,
+		float drift, float movingFraction, const BvhBuildDesc& desc);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "GeometryGenerator.h"
+#include "HlslCompaction.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where GeometryGenerator writes each attribute of the renderer's Vertex.
+inline const GeometryGenerator::VertexLayout GeneratorVertexLayout = {
+	static_cast<std::uint32_t>(sizeof(Vertex)),
+	static_cast<int>(offsetof(Vertex, Pos)),
+	static_cast<int>(offsetof(Vertex, Normal)),
+	static_cast<int>(offsetof(Vertex, Tangent)),
+	static_cast<int>(offsetof(Vertex, TexC)),
+	static_cast<int>(offsetof(Vertex, Tangent) + offsetof(DirectX::XMFLOAT4, w))
+};
+
+// Generates into vectors of Vertex, e.g. the ones the optimizer and the LOD builder rework in place.
+class VectorMeshSink : public GeometryGenerator::MeshSink {
+public:
+	VectorMeshSink(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices) : mVertices(vertices), mIndices(indices) {}
+
+	const GeometryGenerator::VertexLayout& Layout() const override { return GeneratorVertexLayout; }
+
+	bool Allocate(std::uint32_t vertexCount, std::uint32_t indexCount, void*& outVertices, void*& outIndices, bool& bOutIndices16) override {
+		mVertices.resize(vertexCount);
+		mIndices.resize(indexCount);
+
+		outVertices = mVertices.data();
+		outIndices = mIndices.data();
+		bOutIndices16 = false;
+
+		return true;
+	}
+
+private:
+	std::vector<Vertex>& mVertices;
+	std::vector<std::uint32_t>& mIndices;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <cstdint>
+
+// 20-byte alternative to the 48-byte Vertex.
+// Positions are SNORM relative to the mesh bounds so the buffer can feed both the input
+//  assembler (R16G16B16A16_SNORM) and a DXR 1.0 BLAS, which accepts SNORM but not UNORM vertices.
+//  Pos[3] carries the tangent's handedness as +1 or -1.
+// Normal and tangent are octahedral-encoded; texture coordinates are half precision.
+struct PackedVertex {
+	std::int16_t Pos[4];
+	std::int16_t Normal[2];
+	std::int16_t Tangent[2];
+	DirectX::PackedVector::HALF TexC[2];
+};
+
+// Maps SNORM positions back to object space: pos = Center + Extents * snorm.
+struct VertexQuantization {
+	DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 Extents = { 1.0f, 1.0f, 1.0f };
+
+	// Scale-then-translate matrix to prepend to the world transform (or to hand to a BLAS as its
+	//  Transform3x4) when drawing packed vertices.
+	DirectX::XMMATRIX Dequantization() const;
+};
+
+struct VertexCompressionReport {
+	size_t VertexCount = 0;
+	size_t SourceByteSize = 0;
+	size_t PackedByteSize = 0;
+
+	// Object-space units.
+	float MaxPositionError = 0.0f;
+	float MeanPositionError = 0.0f;
+	// Degrees.
+	float MaxNormalError = 0.0f;
+	float MaxTangentError = 0.0f;
+	// Should stay zero; the handedness is stored exactly.
+	size_t TangentSignMismatchCount = 0;
+	float MaxTexCoordError = 0.0f;
+};
+
+class VertexCompression {
+public:
+	static VertexQuantization CalcQuantization(const Vertex* pVertices, size_t vertexCount);
+
+	// Both directions work on four vertices at a time in SoA form; the last partial group repeats its final vertex
+	//  in the unused lanes and only the valid ones are written back.
+	static void Encode(const Vertex* pVertices, size_t vertexCount, const VertexQuantization& quantization, PackedVertex* pOutVertices);
+	static void Decode(const PackedVertex* pVertices, size_t vertexCount, const VertexQuantization& quantization, Vertex* pOutVertices);
+
+	// Round-trips the vertices and measures what the packing loses.
+	static VertexCompressionReport Analyze(const Vertex* pVertices, size_t vertexCount);
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "HlslCompaction.h"
+
+#include <cstdint>
+#include <vector>
+
+// Collapses duplicated vertices of an unindexed (per-corner) vertex stream into a unique
+// vertex array plus an index buffer.
+//
+// Vertices are keyed on the quantized bits of Pos, Normal and TexC (Tangent is carried
+//  along from the first occurrence) and looked up in a flat open-addressing table with
+//  linear probing.
+// A tolerance of zero welds bit-exactly (only +0/-0 are treated as equal); a positive
+//  tolerance snaps each component to a grid of that cell size before keying.
+class VertexWelder {
+public:
+	struct WeldTolerance {
+		float Position	= 0.0f;
+		float Normal	= 0.0f;
+		float TexCoord	= 0.0f;
+
+		WeldTolerance() {}
+		WeldTolerance(float position, float normal, float texCoord) :
+			Position(position), Normal(normal), TexCoord(texCoord) {}
+	};
+
+	struct WeldStats {
+		std::uint64_t	InputVertexCount	= 0;
+		std::uint64_t	UniqueVertexCount	= 0;
+		std::uint64_t	ProbeCount			= 0;
+		std::uint64_t	TableCapacity		= 0;
+	};
+
+public:
+	VertexWelder();
+	VertexWelder(const WeldTolerance& tolerance, size_t expectedUniqueCount = 0);
+	virtual ~VertexWelder() = default;
+
+public:
+	void Reserve(size_t expectedUniqueCount);
+	void Clear();
+
+	// Returns the index of the welded vertex, appending it if it is not in the table yet.
+	std::uint32_t Insert(const Vertex& vertex);
+
+	// Welds a whole per-corner stream, appending one index per input vertex.
+	void Insert(const Vertex* pVertices, size_t count, std::vector<std::uint32_t>& outIndices);
+
+	// Hands the unique vertices to the caller and frees the lookup table.
+	void Release(std::vector<Vertex>& outVertices);
+
+	__forceinline const std::vector<Vertex>& Vertices() const;
+	__forceinline const WeldStats& Stats() const;
+	__forceinline const WeldTolerance& Tolerance() const;
+
+private:
+	struct VertexKey {
+		std::int32_t Bits[8];
+	};
+
+	void MakeKey(const Vertex& vertex, VertexKey& outKey) const;
+	void Rehash(size_t newCapacity);
+
+private:
+	WeldTolerance mTolerance;
+	float mInvPosTolerance;
+	float mInvNormalTolerance;
+	float mInvTexCoordTolerance;
+
+	// Slot -> unique vertex index. Capacity is always a power of two.
+	std::vector<std::uint32_t> mSlots;
+	size_t mSlotMask;
+
+	// Per unique vertex; kept so rehashing never has to re-quantize.
+	std::vector<VertexKey> mKeys;
+	std::vector<std::uint32_t> mHashes;
+
+	std::vector<Vertex> mVertices;
+
+	WeldStats mStats;
+};
+
+const std::vector<Vertex>& VertexWelder::Vertices() const {
+	return mVertices;
+}
+
+const VertexWelder::WeldStats& VertexWelder::Stats() const {
+	return mStats;
+}
+
+const VertexWelder::WeldTolerance& VertexWelder::Tolerance() const {
+	return mTolerance;
+}
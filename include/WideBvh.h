@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Bvh.h"
+
+#include <cstdint>
+#include <vector>
+
+const UINT WideBvhWidth = 8;
+
+// 80 bytes; a node holds its children's boxes rather than its own.
+// Child boxes are stored in 8 bits per plane on a grid anchored at Origin with a power-of-two cell
+//  size per axis (Ylitie, Karras and Laine 2017), rounded outward so they always contain the boxes
+//  of the binary hierarchy they were collapsed from.
+struct WideBvhNode {
+	DirectX::XMFLOAT3 Origin;
+	// The grid cell along each axis is 2^Exponent wide.
+	std::int8_t Exponent[3];
+	// Bit i is set when child i is an interior node.
+	std::uint8_t InteriorMask;
+	// Interior children are stored consecutively from here, in slot order.
+	UINT ChildBase;
+	// Leaf children reference consecutive ranges of WideBvh::TriangleIndices from here, in slot order.
+	UINT TriangleBase;
+	// Per slot; zero for interior children and empty slots.
+	std::uint8_t TriangleCounts[WideBvhWidth];
+	// Per slot, so the same plane of all eight children loads at once.
+	std::uint8_t QuantizedMin[3][WideBvhWidth];
+	std::uint8_t QuantizedMax[3][WideBvhWidth];
+
+	__forceinline bool IsEmpty(UINT slot) const;
+};
+static_assert(sizeof(WideBvhNode) == 80, "WideBvhNode must stay 80 bytes");
+
+struct WideBvh {
+	BvhMesh Mesh;
+	// Nodes[0] is the root.
+	std::vector<WideBvhNode> Nodes;
+	std::vector<UINT> TriangleIndices;
+};
+
+struct WideBvhStats {
+	UINT NodeCount = 0;
+	UINT LeafCount = 0;
+	// Occupied slots per node.
+	float AverageChildCount = 0.0f;
+	// Nodes and triangle indices.
+	size_t MemoryBytes = 0;
+	double CollapseMilliseconds = 0.0;
+};
+
+class WideBvhBuilder {
+public:
+	// Collapses a binary hierarchy into one with up to eight children per node: starting from a
+	//  node's two children, the interior child with the largest surface area is replaced by its
+	//  own two children until the slots are full. Leaves keep their triangles.
+	static bool Collapse(const Bvh& bvh, WideBvh& outBvh, WideBvhStats* pStats = nullptr);
+
+	// Bytes of a binary hierarchy's nodes and triangle indices, to compare against MemoryBytes.
+	static size_t CalcMemoryBytes(const Bvh& bvh);
+};
+
+bool WideBvhNode::IsEmpty(UINT slot) const {
+	return (InteriorMask & (1u << slot)) == 0 && TriangleCounts[slot] == 0;
+}
@@ -0,0 +1,182 @@
+#include "AnalyticBvh.h"
+#include "Logger.h"
+#include "BvhTraversal.h"
+#include "Parallel.h"
+#include "SceneGenerator.h"
+#include "Stopwatch.h"
+#include "TwoLevelBvh.h"
+#include "WideBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+bool AnalyticBvhBuilder::Build(AnalyticBvh& bvh, const BvhBuildDesc& desc, BvhBuildStats* pStats) {
+	if (bvh.Primitives.empty()) ReturnFalse(L"Analytic BVH has no primitives");
+	for (const auto& primitive : bvh.Primitives) {
+		if (primitive.Shape != AnalyticPrimitive::EBox && !(primitive.Radius > 0.0f)) ReturnFalse(L"Analytic spheres and capsules need a positive radius");
+	}
+
+	Stopwatch timer;
+
+	const UINT count = static_cast<UINT>(bvh.Primitives.size());
+
+	std::vector<BvhBounds> bounds(count);
+	for (UINT i = 0; i < count; ++i)
+		bounds[i] = CalcBounds(bvh.Primitives[i]);
+
+	CheckIsValid(BvhBuilder::BuildOverBounds(bounds.data(), count, desc, bvh.Nodes, bvh.PrimitiveIndices));
+
+	if (pStats != nullptr) {
+		BvhBuilder::CalcStats(bvh.Nodes, count, desc, *pStats);
+		pStats->BuildMilliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+BvhBounds AnalyticBvhBuilder::CalcBounds(const AnalyticPrimitive& primitive) {
+	const XMFLOAT3& p0 = primitive.P0;
+	const XMFLOAT3& p1 = primitive.P1;
+	const float r = primitive.Radius;
+
+	BvhBounds bounds;
+	switch (primitive.Shape) {
+	case AnalyticPrimitive::ESphere:
+		bounds.Min = XMFLOAT3(p0.x - r, p0.y - r, p0.z - r);
+		bounds.Max = XMFLOAT3(p0.x + r, p0.y + r, p0.z + r);
+		break;
+	case AnalyticPrimitive::ECapsule:
+		bounds.Min = XMFLOAT3(std::min(p0.x, p1.x) - r, std::min(p0.y, p1.y) - r, std::min(p0.z, p1.z) - r);
+		bounds.Max = XMFLOAT3(std::max(p0.x, p1.x) + r, std::max(p0.y, p1.y) + r, std::max(p0.z, p1.z) + r);
+		break;
+	default:
+		bounds.Min = XMFLOAT3(std::min(p0.x, p1.x), std::min(p0.y, p1.y), std::min(p0.z, p1.z));
+		bounds.Max = XMFLOAT3(std::max(p0.x, p1.x), std::max(p0.y, p1.y), std::max(p0.z, p1.z));
+		break;
+	}
+
+	return bounds;
+}
+
+size_t AnalyticBvhBuilder::CalcMemoryBytes(const AnalyticBvh& bvh) {
+	return bvh.Primitives.size() * sizeof(AnalyticPrimitive) + bvh.Nodes.size() * sizeof(BvhNode) + bvh.PrimitiveIndices.size() * sizeof(UINT);
+}
+
+namespace {
+	// Ray counts per second in millions of a parallel trace through the top level, in chunks of
+	//  consecutive rays.
+	double TimeTrace(const TwoLevelBvh& tlas, const std::vector<BvhRay>& rays, BvhTraversal::Mode mode, std::vector<BvhHit>& outHits) {
+		outHits.resize(rays.size());
+
+		const size_t chunkSize = 256;
+		const size_t chunkCount = (rays.size() + chunkSize - 1) / chunkSize;
+
+		Stopwatch timer;
+		Parallel::ForRange(chunkCount, 4, [&](size_t begin, size_t end) {
+			for (size_t i = begin * chunkSize, last = std::min(end * chunkSize, rays.size()); i < last; ++i)
+				BvhTraversal::Trace(tlas, rays[i], mode, outHits[i]);
+		});
+		const double elapsedMs = timer.ElapsedMilliseconds();
+
+		return elapsedMs > 0.0 ? rays.size() / (elapsedMs * 1000.0) : 0.0;
+	}
+
+	UINT CountHits(const std::vector<BvhHit>& hits) {
+		UINT count = 0;
+		for (const auto& hit : hits)
+			if (hit.IsHit()) ++count;
+		return count;
+	}
+}
+
+bool AnalyticBvhBuilder::RunBenchmark(const Bvh& triangles, const AnalyticBvh& analytic, UINT instanceCount, UINT seed,
+		float density, UINT rayCount, float aoRadius, const BvhBuildDesc& desc) {
+	SceneGeneratorDesc sceneDesc;
+	sceneDesc.Seed = seed;
+	sceneDesc.InstanceCount = instanceCount;
+	sceneDesc.ShapeCount = 1;
+	sceneDesc.Density = density;
+
+	std::vector<SceneInstance> instances;
+	CheckIsValid(SceneGenerator::Generate(sceneDesc, instances));
+
+	TwoLevelBvh triangleTlas;
+	triangleTlas.Blases = { &triangles };
+	TwoLevelBvh analyticTlas;
+	analyticTlas.AnalyticBlases = { &analytic };
+	for (size_t i = 0; i < instances.size(); ++i) {
+		BvhInstance instance;
+		TwoLevelBvhBuilder::SetTransform(instance, instances[i].World);
+		instance.InstanceID = static_cast<UINT>(i);
+		instance.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+		triangleTlas.Instances.push_back(instance);
+
+		instance.Analytic = true;
+		analyticTlas.Instances.push_back(instance);
+	}
+	CheckIsValid(TwoLevelBvhBuilder::Build(triangleTlas, desc));
+	CheckIsValid(TwoLevelBvhBuilder::Build(analyticTlas, desc));
+
+	const BvhNode& root = triangleTlas.Nodes[0];
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto pointInBounds = [&]() {
+		return XMFLOAT3(
+			root.BoundsMin.x + unit(generator) * (root.BoundsMax.x - root.BoundsMin.x),
+			root.BoundsMin.y + unit(generator) * (root.BoundsMax.y - root.BoundsMin.y),
+			root.BoundsMin.z + unit(generator) * (root.BoundsMax.z - root.BoundsMin.z));
+	};
+
+	std::vector<BvhRay> downRays(rayCount);
+	for (auto& ray : downRays) {
+		ray.Origin = pointInBounds();
+		ray.Origin.y = root.BoundsMax.y + 1.0f;
+		ray.Direction = XMFLOAT3(0.2f * unit(generator) - 0.1f, -1.0f, 0.2f * unit(generator) - 0.1f);
+	}
+
+	std::vector<BvhRay> aoRays(rayCount);
+	for (auto& ray : aoRays) {
+		ray.Origin = pointInBounds();
+		ray.Direction = XMFLOAT3(2.0f * unit(generator) - 1.0f, 2.0f * unit(generator) - 1.0f, 2.0f * unit(generator) - 1.0f);
+		ray.TMax = aoRadius / std::max(1.0e-6f, XMVectorGetX(XMVector3Length(XMLoadFloat3(&ray.Direction))));
+	}
+
+	// Rays one version hits and the other misses, i.e. that land in the facets' gaps or bulges.
+	auto countDisagreements = [](const std::vector<BvhHit>& a, const std::vector<BvhHit>& b) {
+		UINT count = 0;
+		for (size_t i = 0, end = a.size(); i < end; ++i)
+			if (a[i].IsHit() != b[i].IsHit()) ++count;
+		return count;
+	};
+
+	std::vector<BvhHit> triangleHits;
+	std::vector<BvhHit> analyticHits;
+	const double downTriangle = TimeTrace(triangleTlas, downRays, BvhTraversal::EClosestHit, triangleHits);
+	const double downAnalytic = TimeTrace(analyticTlas, downRays, BvhTraversal::EClosestHit, analyticHits);
+	const UINT downDisagreements = countDisagreements(triangleHits, analyticHits);
+	const UINT downHits = CountHits(analyticHits);
+	const double aoTriangle = TimeTrace(triangleTlas, aoRays, BvhTraversal::EAnyHit, triangleHits);
+	const double aoAnalytic = TimeTrace(analyticTlas, aoRays, BvhTraversal::EAnyHit, analyticHits);
+	const UINT aoDisagreements = countDisagreements(triangleHits, analyticHits);
+	const UINT aoHits = CountHits(analyticHits);
+
+	const BvhMesh& mesh = triangles.Mesh;
+	const size_t triangleBytes = static_cast<size_t>(mesh.VertexCount) * sizeof(Vertex) +
+		static_cast<size_t>(mesh.IndexCount) * mesh.IndexStride + WideBvhBuilder::CalcMemoryBytes(triangles);
+
+	Logln("Analytic sphere benchmark: ", std::to_string(instances.size()), " spheres of ", std::to_string(mesh.TriangleCount()),
+		" triangles, ", std::to_string(Parallel::WorkerCount()), " threads, Mrays/s triangles/analytic");
+	Logln("    bottom level: triangles ", std::to_string(triangleBytes), " bytes (vertices, indices and BVH), analytic ",
+		std::to_string(CalcMemoryBytes(analytic)), " bytes");
+	Logln("    down (", std::to_string(downRays.size()), " rays, ", std::to_string(downHits), " hits): closest ",
+		std::to_string(downTriangle), "/", std::to_string(downAnalytic), ", ", std::to_string(downDisagreements), " disagree");
+	Logln("    AO (", std::to_string(aoRays.size()), " rays, ", std::to_string(aoHits), " occluded): any ",
+		std::to_string(aoTriangle), "/", std::to_string(aoAnalytic), ", ", std::to_string(aoDisagreements), " disagree");
+
+	return true;
+}
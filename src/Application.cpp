@@ -1,9 +1,13 @@
 #include "Application.h"
 #include "Logger.h"
 #include "Camera.h"
+#include "Stopwatch.h"
 
 #include <windowsx.h>
 
+#include <fstream>
+#include <sstream>
+
 #include <imgui.h>
 #include <backends/imgui_impl_win32.h>
 
@@ -14,6 +18,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 	try {
 		Application app;
 
+		if (!app.ParseCommandLine(cmdLine)) {
+			WLogln(L"Error Occured");
+			return -1;
+		}
+
 		if (!app.Initialize()) {
 			//ShowRemovedReason(app.GetRenderer());
 			WLogln(L"Error Occured");
@@ -54,6 +63,17 @@ namespace {
 
 	const LPCWSTR RasterCaption = L"DXR Application - Rasterization";
 	const LPCWSTR RaytraceCaption = L"DXR Application - Raytracing";
+
+	bool ParseUInt(const std::string& text, UINT& outValue) {
+		if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+
+		const unsigned long long value = std::stoull(text);
+		if (value > UINT_MAX) return false;
+
+		outValue = static_cast<UINT>(value);
+
+		return true;
+	}
 }
 
 Application* Application::sApp = nullptr;
@@ -81,6 +101,48 @@ Application::~Application() {
 		CleanUp();
 }
 
+bool Application::ParseCommandLine(LPCSTR cmdLine) {
+	std::istringstream sstream(cmdLine == nullptr ? "" : cmdLine);
+
+	std::string arg;
+	while (sstream >> arg) {
+		const auto equal = arg.find('=');
+		const std::string key = arg.substr(0, equal);
+		const std::string value = equal == std::string::npos ? std::string() : arg.substr(equal + 1);
+
+		if (key == "-benchmark") {
+			mBenchmarkDesc.Enabled = true;
+		}
+		else if (key == "-benchmark-counts") {
+			mBenchmarkDesc.InstanceCounts.clear();
+
+			std::istringstream counts(value);
+			std::string count;
+			while (std::getline(counts, count, ',')) {
+				UINT instanceCount;
+				if (!ParseUInt(count, instanceCount)) ReturnFalse(L"Invalid -benchmark-counts entry");
+				mBenchmarkDesc.InstanceCounts.push_back(instanceCount);
+			}
+			if (mBenchmarkDesc.InstanceCounts.empty()) ReturnFalse(L"-benchmark-counts needs at least one count");
+		}
+		else if (key == "-benchmark-seed") {
+			if (!ParseUInt(value, mBenchmarkDesc.Seed)) ReturnFalse(L"Invalid -benchmark-seed");
+		}
+		else if (key == "-benchmark-frames") {
+			if (!ParseUInt(value, mBenchmarkDesc.FrameCount) || mBenchmarkDesc.FrameCount == 0) ReturnFalse(L"Invalid -benchmark-frames");
+		}
+		else if (key == "-benchmark-out") {
+			if (value.empty()) ReturnFalse(L"-benchmark-out needs a filename");
+			mBenchmarkDesc.OutputFilename.assign(value.begin(), value.end());
+		}
+		else {
+			Logln("Ignoring unknown argument: ", arg);
+		}
+	}
+
+	return true;
+}
+
 bool Application::Initialize() {
 	CheckIsValid(InitMainWindow());
 	CheckIsValid(mCamera->Initialize(InitClientWidth, InitClientHeight, 0.25f * DirectX::XM_PI))
@@ -96,6 +158,12 @@ HRESULT Application::RunLoop() {
 
 	mTimer.Reset();
 
+	if (mBenchmarkDesc.Enabled) {
+		if (!RunBenchmark()) return E_FAIL;
+
+		return S_OK;
+	}
+
 	while (msg.message != WM_QUIT) {
 		// If there are Window messages then process them
 		if (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
@@ -190,6 +258,90 @@ bool Application::UpdateGame(const GameTimer& gt) {
 	return true;
 }
 
+bool Application::RunBenchmark() {
+	std::ofstream fout(mBenchmarkDesc.OutputFilename, std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create " + mBenchmarkDesc.OutputFilename);
+
+	fout << "instances,generate_ms,render_items_ms,tlas_instances_ms,tlas_build_ms,object_upload_ms,"
+		"lod_selection_ms,meshlet_culling_ms,shadow_recording_ms,gbuffer_recording_ms,frame_ms\n";
+
+	// Stress scenes instance the imported meshes, and swapping one in rebuilds the TLAS, so the
+	//  placeholders have to be gone before anything is timed.
+	while (mRenderer->GeometryLoadsPending()) {
+		MSG msg = { 0 };
+		while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+			if (msg.message == WM_QUIT) return true;
+
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+
+		mTimer.Tick();
+		CheckIsValid(Update(mTimer));
+		CheckIsValid(Draw());
+	}
+
+	for (const UINT instanceCount : mBenchmarkDesc.InstanceCounts) {
+		CheckIsValid(mRenderer->BuildStressScene(instanceCount, mBenchmarkDesc.Seed));
+
+		// Scene building is a one-off; the per-frame stages are averaged.
+		const Renderer::StageTimings buildTimings = mRenderer->GetStageTimings();
+		Renderer::StageTimings frameTimings = {};
+
+		Stopwatch frameTimer;
+		for (UINT frame = 0; frame < mBenchmarkDesc.FrameCount; ++frame) {
+			MSG msg = { 0 };
+			while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+				if (msg.message == WM_QUIT) return true;
+
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+
+			// Every object's constants are uploaded each frame, as if the whole scene moved.
+			mRenderer->InvalidateObjectConstants();
+
+			mTimer.Tick();
+			CheckIsValid(Update(mTimer));
+			CheckIsValid(Draw());
+
+			const auto& timings = mRenderer->GetStageTimings();
+			frameTimings.ObjectUpload += timings.ObjectUpload;
+			frameTimings.LodSelection += timings.LodSelection;
+			frameTimings.MeshletCulling += timings.MeshletCulling;
+			frameTimings.ShadowRecording += timings.ShadowRecording;
+			frameTimings.GBufferRecording += timings.GBufferRecording;
+		}
+
+		const double invFrameCount = 1.0 / mBenchmarkDesc.FrameCount;
+		const double frameMilliseconds = frameTimer.ElapsedMilliseconds() * invFrameCount;
+
+		fout << instanceCount << ','
+			<< buildTimings.SceneGeneration << ','
+			<< buildTimings.RenderItems << ','
+			<< buildTimings.TlasInstances << ','
+			<< buildTimings.TlasBuild << ','
+			<< frameTimings.ObjectUpload * invFrameCount << ','
+			<< frameTimings.LodSelection * invFrameCount << ','
+			<< frameTimings.MeshletCulling * invFrameCount << ','
+			<< frameTimings.ShadowRecording * invFrameCount << ','
+			<< frameTimings.GBufferRecording * invFrameCount << ','
+			<< frameMilliseconds << '\n';
+
+		Logln("Scene benchmark: ", std::to_string(instanceCount), " instances, TLAS instances ",
+			std::to_string(buildTimings.TlasInstances), " ms, TLAS build ", std::to_string(buildTimings.TlasBuild),
+			" ms, object upload ", std::to_string(frameTimings.ObjectUpload * invFrameCount),
+			" ms, culling ", std::to_string(frameTimings.MeshletCulling * invFrameCount),
+			" ms, frame ", std::to_string(frameMilliseconds), " ms");
+	}
+
+	if (!fout.good()) ReturnFalse(L"Failed to write " + mBenchmarkDesc.OutputFilename);
+
+	WLogln(L"Scene benchmark written to ", mBenchmarkDesc.OutputFilename);
+
+	return true;
+}
+
 void Application::OnMouseDown(WPARAM state, int x, int y) {
 	bMouseLeftButtonDowned = true;
 	mPrevMousePosX = x;
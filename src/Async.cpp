@@ -0,0 +1,116 @@
+#include "Async.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+using namespace Async;
+
+WorkerPool::~WorkerPool() {
+	CleanUp();
+}
+
+void WorkerPool::Initialize(size_t threadCount) {
+	CleanUp();
+
+	bStopping = false;
+
+	threadCount = std::max<size_t>(threadCount, 1);
+	mThreads.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i)
+		mThreads.emplace_back([this]() { WorkerMain(); });
+}
+
+void WorkerPool::CleanUp() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		bStopping = true;
+	}
+	mCondition.notify_all();
+
+	for (auto& thread : mThreads)
+		thread.join();
+	mThreads.clear();
+}
+
+void WorkerPool::Post(std::coroutine_handle<> handle) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.push_back(handle);
+	}
+	mCondition.notify_one();
+}
+
+void WorkerPool::WorkerMain() {
+	// The pool's threads already share the cores; work they resume runs its loops inline.
+	Parallel::MakeThreadSerial();
+
+	for (;;) {
+		std::coroutine_handle<> handle;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this]() { return bStopping || !mQueue.empty(); });
+			if (mQueue.empty()) return;
+
+			handle = mQueue.front();
+			mQueue.pop_front();
+		}
+
+		handle.resume();
+	}
+}
+
+void MemoryBudget::Initialize(UINT64 limit, WorkerPool* pResumePool) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mpResumePool = pResumePool;
+	mLimit = limit;
+	mReserved = 0;
+	mPeakReserved = 0;
+	mWaiters.clear();
+}
+
+void MemoryBudget::Release(UINT64 bytes) {
+	std::vector<std::coroutine_handle<>> admitted;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mReserved -= std::min(bytes, mReserved);
+
+		while (!mWaiters.empty() && Fits(mWaiters.front().Bytes)) {
+			mReserved += mWaiters.front().Bytes;
+			admitted.push_back(mWaiters.front().Handle);
+			mWaiters.pop_front();
+		}
+		mPeakReserved = std::max(mPeakReserved, mReserved);
+	}
+
+	for (auto handle : admitted)
+		mpResumePool->Post(handle);
+}
+
+UINT64 MemoryBudget::Limit() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mLimit;
+}
+
+UINT64 MemoryBudget::Reserved() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mReserved;
+}
+
+UINT64 MemoryBudget::PeakReserved() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPeakReserved;
+}
+
+bool MemoryBudget::Enqueue(std::coroutine_handle<> handle, UINT64 bytes) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mWaiters.empty() && Fits(bytes)) {
+		mReserved += bytes;
+		mPeakReserved = std::max(mPeakReserved, mReserved);
+		return false;
+	}
+
+	mWaiters.push_back({ handle, bytes });
+	return true;
+}
@@ -0,0 +1,298 @@
+#include "AsyncMeshLoader.h"
+#include "Logger.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+UINT64 LoadTrace::Now() const {
+	return static_cast<UINT64>(mClock.ElapsedSeconds() * 1.0e6);
+}
+
+void LoadTrace::Add(const std::string& name, const char* stage, UINT64 beginMicroseconds, UINT64 endMicroseconds) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const auto thread = mThreadIndices.emplace(std::this_thread::get_id(), static_cast<UINT>(mThreadIndices.size())).first;
+	mEvents.push_back({ name, stage, thread->second, beginMicroseconds, std::max(beginMicroseconds, endMicroseconds) });
+}
+
+std::vector<LoadTrace::Event> LoadTrace::Events() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEvents;
+}
+
+bool LoadTrace::Write(const std::wstring& inFilename) const {
+	const auto events = Events();
+
+	std::ofstream fout(inFilename, std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create " + inFilename);
+
+	fout << "{\"traceEvents\":[\n";
+	for (size_t i = 0, end = events.size(); i < end; ++i) {
+		const auto& e = events[i];
+
+		std::string name;
+		for (const char c : e.Name) {
+			if (c == '"' || c == '\\') name += '\\';
+			name += c;
+		}
+
+		fout << "{\"name\":\"" << name << "\",\"cat\":\"" << e.Stage << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.ThreadIndex
+			<< ",\"ts\":" << e.BeginMicroseconds << ",\"dur\":" << (e.EndMicroseconds - e.BeginMicroseconds)
+			<< ",\"args\":{\"stage\":\"" << e.Stage << "\"}}" << (i + 1 < end ? ",\n" : "\n");
+	}
+	fout << "]}\n";
+
+	if (!fout.good()) ReturnFalse(L"Failed to write " + inFilename);
+
+	return true;
+}
+
+AsyncMeshLoader::~AsyncMeshLoader() {
+	CleanUp();
+}
+
+bool AsyncMeshLoader::Initialize(UINT workerCount, UINT64 memoryBudget, float workingSetFactor) {
+	CleanUp();
+
+	if (workerCount == 0) {
+		const UINT hardwareCount = std::thread::hardware_concurrency();
+		workerCount = std::max(hardwareCount, 2u) - 1;
+	}
+
+	mWorkingSetFactor = workingSetFactor;
+
+	// One I/O thread; concurrent reads of whole files mostly just seek against each other.
+	mIoPool.Initialize(1);
+	mWorkerPool.Initialize(workerCount);
+	mBudget.Initialize(memoryBudget, &mWorkerPool);
+
+	mRequestedCount = 0;
+	mCompletedCount = 0;
+	mFailedCount = 0;
+
+	bInitialized = true;
+
+	return true;
+}
+
+void AsyncMeshLoader::CleanUp() {
+	if (!bInitialized) return;
+
+	// Loads blocked on the budget only move once ready meshes give their reservations back.
+	for (;;) {
+		std::unique_ptr<MeshGeometry> geo;
+		while (TryPopReady(geo))
+			geo.reset();
+
+		if (IsIdle()) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	mIoPool.CleanUp();
+	mWorkerPool.CleanUp();
+
+	bInitialized = false;
+}
+
+bool AsyncMeshLoader::Request(const AsyncMeshRequest& request) {
+	if (!bInitialized) ReturnFalse(L"Async mesh loader is not initialized");
+
+	MeshCache::SourceInfo source;
+	if (!MeshCache::QuerySourceInfo(request.Filename, source)) ReturnFalse(L"Failed to query " + request.Filename);
+
+	const UINT64 reservedBytes = static_cast<UINT64>(static_cast<double>(source.Size) * mWorkingSetFactor);
+
+	++mPendingCount;
+	++mRequestedCount;
+
+	Run(request, reservedBytes);
+
+	return true;
+}
+
+bool AsyncMeshLoader::TryPopReady(std::unique_ptr<MeshGeometry>& outGeo) {
+	ReadyMesh ready;
+	{
+		std::lock_guard<std::mutex> lock(mReadyMutex);
+		if (mReady.empty()) return false;
+
+		ready = std::move(mReady.front());
+		mReady.pop_front();
+	}
+
+	mTrace.Add(ready.Geometry->Name, "queued", ready.ReadyMicroseconds, mTrace.Now());
+	mBudget.Release(ready.ReservedBytes);
+
+	outGeo = std::move(ready.Geometry);
+
+	return true;
+}
+
+bool AsyncMeshLoader::IsIdle() const {
+	return mPendingCount == 0;
+}
+
+AsyncMeshLoaderStats AsyncMeshLoader::Stats() const {
+	AsyncMeshLoaderStats stats;
+	stats.RequestedCount = mRequestedCount;
+	stats.CompletedCount = mCompletedCount;
+	stats.FailedCount = mFailedCount;
+	stats.BudgetBytes = mBudget.Limit();
+	stats.PeakReservedBytes = mBudget.PeakReserved();
+	return stats;
+}
+
+Async::Detached AsyncMeshLoader::Run(AsyncMeshRequest request, UINT64 reservedBytes) {
+	const UINT64 requestedAt = mTrace.Now();
+	co_await mBudget.Acquire(reservedBytes);
+	mTrace.Add(request.Name, "budget", requestedAt, mTrace.Now());
+
+	std::unique_ptr<MeshGeometry> geo;
+	const bool bLoaded = co_await Load(request, geo);
+
+	if (bLoaded) {
+		std::lock_guard<std::mutex> lock(mReadyMutex);
+		mReady.push_back({ std::move(geo), reservedBytes, mTrace.Now() });
+		++mCompletedCount;
+	}
+	else {
+		mBudget.Release(reservedBytes);
+		++mFailedCount;
+	}
+
+	--mPendingCount;
+}
+
+Async::Task<bool> AsyncMeshLoader::Load(const AsyncMeshRequest& request, std::unique_ptr<MeshGeometry>& outGeo) {
+	std::vector<char> data;
+	CoCheckIsValid(co_await ReadFileAsync(request, data));
+
+	// On a worker from here on.
+	UINT64 begin = mTrace.Now();
+
+	ObjMesh mesh;
+	ObjLoadStats loadStats;
+	const bool bParsed = ObjLoader::Parse(data.data(), data.size(), request.Filename, mesh, request.LoadDesc, &loadStats);
+	data = std::vector<char>();
+
+	// Welding and the material libraries follow the parse and merge stages.
+	const UINT64 parseEnd = begin + static_cast<UINT64>((loadStats.ParseMilliseconds + loadStats.MergeMilliseconds) * 1000.0);
+	const UINT64 end = mTrace.Now();
+	mTrace.Add(request.Name, "parse", begin, std::min(parseEnd, end));
+	mTrace.Add(request.Name, "weld", std::min(parseEnd, end), end);
+
+	if (!bParsed) CoReturnFalse(L"Failed to parse " + request.Filename);
+
+	begin = mTrace.Now();
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = request.Name;
+	const bool bProcessed = request.Process(request.Name, mesh, geo.get());
+
+	mTrace.Add(request.Name, "process", begin, mTrace.Now());
+
+	if (!bProcessed) CoReturnFalse(L"Failed to process " + request.Filename);
+
+	outGeo = std::move(geo);
+
+	co_return true;
+}
+
+Async::Task<bool> AsyncMeshLoader::ReadFileAsync(const AsyncMeshRequest& request, std::vector<char>& outData) {
+	co_await mIoPool.Schedule();
+
+	const UINT64 begin = mTrace.Now();
+
+	bool bOpened = false;
+	{
+		MappedFile file;
+		bOpened = file.Open(request.Filename);
+		if (bOpened) {
+			// Copying touches every page, so the disk read happens here rather than in the parser.
+			const char* data = reinterpret_cast<const char*>(file.Data());
+			outData.assign(data, data + file.Size());
+		}
+	}
+
+	mTrace.Add(request.Name, "read", begin, mTrace.Now());
+
+	co_await mWorkerPool.Schedule();
+
+	if (!bOpened) CoReturnFalse(L"Failed to read " + request.Filename);
+
+	co_return true;
+}
+
+namespace {
+	bool SameBlob(ID3DBlob* lhs, ID3DBlob* rhs) {
+		return lhs->GetBufferSize() == rhs->GetBufferSize() &&
+			std::memcmp(lhs->GetBufferPointer(), rhs->GetBufferPointer(), lhs->GetBufferSize()) == 0;
+	}
+}
+
+bool AsyncMeshLoader::RunBenchmark(
+		const std::wstring& inFilename, UINT meshCount, UINT64 memoryBudget, UINT workerCount, float workingSetFactor,
+		const ObjLoadDesc& loadDesc, const AsyncMeshProcessFunc& process) {
+	MeshCache::SourceInfo source;
+	if (!MeshCache::QuerySourceInfo(inFilename, source)) ReturnFalse(L"Failed to query " + inFilename);
+
+	Stopwatch syncTimer;
+
+	ObjMesh referenceMesh;
+	CheckIsValid(ObjLoader::Load(inFilename, referenceMesh, loadDesc));
+
+	MeshGeometry reference;
+	CheckIsValid(process("reference", referenceMesh, &reference));
+
+	const double syncMs = syncTimer.ElapsedMilliseconds();
+
+	AsyncMeshLoader loader;
+	CheckIsValid(loader.Initialize(workerCount, memoryBudget, workingSetFactor));
+
+	Stopwatch asyncTimer;
+
+	for (UINT i = 0; i < meshCount; ++i) {
+		AsyncMeshRequest request;
+		request.Name = "stress" + std::to_string(i);
+		request.Filename = inFilename;
+		request.LoadDesc = loadDesc;
+		request.Process = process;
+		CheckIsValid(loader.Request(request));
+	}
+
+	UINT receivedCount = 0;
+	UINT mismatchCount = 0;
+	while (receivedCount + loader.Stats().FailedCount < meshCount) {
+		std::unique_ptr<MeshGeometry> geo;
+		while (loader.TryPopReady(geo)) {
+			++receivedCount;
+			if (!SameBlob(geo->VertexBufferCPU.Get(), reference.VertexBufferCPU.Get()) ||
+				!SameBlob(geo->IndexBufferCPU.Get(), reference.IndexBufferCPU.Get())) {
+				++mismatchCount;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	const double asyncMs = asyncTimer.ElapsedMilliseconds();
+	const auto stats = loader.Stats();
+
+	// A single reservation above the budget is admitted alone, so that is the real ceiling.
+	const UINT64 reservation = static_cast<UINT64>(static_cast<double>(source.Size) * workingSetFactor);
+	const UINT64 ceiling = std::max(stats.BudgetBytes, reservation);
+
+	Logln("Async load check: ", std::to_string(meshCount), " meshes in ", std::to_string(asyncMs), " ms (",
+		std::to_string(syncMs * meshCount), " ms sequential estimate), ", std::to_string(receivedCount), " received, ",
+		std::to_string(stats.FailedCount), " failed, ", std::to_string(mismatchCount), " mismatched, peak reservation ",
+		std::to_string(stats.PeakReservedBytes), " of ", std::to_string(stats.BudgetBytes), " bytes");
+
+	if (stats.FailedCount > 0 || mismatchCount > 0) ReturnFalse(L"Asynchronously loaded meshes differ from the synchronous load");
+	if (stats.PeakReservedBytes > ceiling) ReturnFalse(L"Asynchronous loads exceeded the memory budget");
+
+	return true;
+}
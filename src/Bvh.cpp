@@ -0,0 +1,558 @@
+#include "Bvh.h"
+#include "Logger.h"
+#include "GeometryGenerator.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+#include "VectorMeshSink.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+
+namespace {
+	const UINT MaxBinCount = 64;
+
+	// Ranges at least this large are binned in parallel and split before the subtree phase.
+	const size_t ParallelSplitThreshold = 1 << 16;
+	// Subtrees handed to every worker; a few per worker keeps uneven subtrees balanced.
+	const size_t SubtreesPerWorker = 8;
+	const size_t PrimitiveGrainSize = 1 << 14;
+	// Halving from here reaches single triangles within 32 more levels.
+	const UINT MedianSplitDepth = BvhMaxDepth - 32;
+
+	struct Aabb {
+		float Min[3];
+		float Max[3];
+
+		void Reset() {
+			for (int axis = 0; axis < 3; ++axis) {
+				Min[axis] = FLT_MAX;
+				Max[axis] = -FLT_MAX;
+			}
+		}
+
+		void Grow(const float point[3]) {
+			for (int axis = 0; axis < 3; ++axis) {
+				Min[axis] = std::min(Min[axis], point[axis]);
+				Max[axis] = std::max(Max[axis], point[axis]);
+			}
+		}
+
+		void Grow(const Aabb& other) {
+			for (int axis = 0; axis < 3; ++axis) {
+				Min[axis] = std::min(Min[axis], other.Min[axis]);
+				Max[axis] = std::max(Max[axis], other.Max[axis]);
+			}
+		}
+
+		// Half the surface area; SAH only ever uses ratios of it.
+		float HalfArea() const {
+			const float dx = Max[0] - Min[0];
+			const float dy = Max[1] - Min[1];
+			const float dz = Max[2] - Min[2];
+			if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	float HalfArea(const BvhNode& node) {
+		const float dx = node.BoundsMax.x - node.BoundsMin.x;
+		const float dy = node.BoundsMax.y - node.BoundsMin.y;
+		const float dz = node.BoundsMax.z - node.BoundsMin.z;
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	struct PrimRef {
+		Aabb Bounds;
+		float Centroid[3];
+		UINT Primitive;
+	};
+
+	// Bounds of a range's triangles and of their centroids.
+	struct RangeInfo {
+		Aabb Bounds;
+		Aabb CentroidBounds;
+
+		void Reset() {
+			Bounds.Reset();
+			CentroidBounds.Reset();
+		}
+
+		void Grow(const RangeInfo& other) {
+			Bounds.Grow(other.Bounds);
+			CentroidBounds.Grow(other.CentroidBounds);
+		}
+	};
+
+	struct Bin {
+		Aabb Bounds;
+		UINT Count;
+	};
+
+	struct BinSet {
+		Bin Bins[3][MaxBinCount];
+
+		void Reset(UINT binCount) {
+			for (int axis = 0; axis < 3; ++axis) {
+				for (UINT b = 0; b < binCount; ++b) {
+					Bins[axis][b].Bounds.Reset();
+					Bins[axis][b].Count = 0;
+				}
+			}
+		}
+	};
+
+	struct Split {
+		int Axis = -1;
+		// Bins [0, Bin] go left.
+		UINT Bin = 0;
+		float Cost = FLT_MAX;
+	};
+
+	// Maps centroids of one range onto bins.
+	class BinMapping {
+	public:
+		BinMapping(const Aabb& centroidBounds, UINT binCount) : mBinCount(binCount) {
+			for (int axis = 0; axis < 3; ++axis) {
+				const float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+				mMin[axis] = centroidBounds.Min[axis];
+				// Slightly under binCount / extent so the maximum centroid lands in the last bin.
+				mScale[axis] = extent > 0.0f ? static_cast<float>(binCount) * (1.0f - 1.0e-5f) / extent : 0.0f;
+			}
+		}
+
+	public:
+		bool IsSplittable(int axis) const {
+			return mScale[axis] > 0.0f;
+		}
+
+		UINT BinIndex(const PrimRef& prim, int axis) const {
+			const int index = static_cast<int>((prim.Centroid[axis] - mMin[axis]) * mScale[axis]);
+			return static_cast<UINT>(std::clamp(index, 0, static_cast<int>(mBinCount) - 1));
+		}
+
+	private:
+		UINT mBinCount;
+		float mMin[3];
+		float mScale[3];
+	};
+
+	RangeInfo ComputeRangeInfo(const PrimRef* prims, size_t begin, size_t end) {
+		RangeInfo info;
+		info.Reset();
+		for (size_t i = begin; i < end; ++i) {
+			info.Bounds.Grow(prims[i].Bounds);
+			info.CentroidBounds.Grow(prims[i].Centroid);
+		}
+		return info;
+	}
+
+	RangeInfo ComputeRangeInfoParallel(const PrimRef* prims, size_t begin, size_t end) {
+		const size_t chunkCount = (end - begin + PrimitiveGrainSize - 1) / PrimitiveGrainSize;
+
+		std::vector<RangeInfo> partials(chunkCount);
+		Parallel::ForEach(chunkCount, [&](size_t chunk) {
+			const size_t chunkBegin = begin + chunk * PrimitiveGrainSize;
+			partials[chunk] = ComputeRangeInfo(prims, chunkBegin, std::min(chunkBegin + PrimitiveGrainSize, end));
+		});
+
+		RangeInfo info;
+		info.Reset();
+		for (const auto& partial : partials)
+			info.Grow(partial);
+		return info;
+	}
+
+	void BinRange(const PrimRef* prims, size_t begin, size_t end, const BinMapping& mapping, UINT binCount, BinSet& outBins) {
+		outBins.Reset(binCount);
+		for (size_t i = begin; i < end; ++i) {
+			for (int axis = 0; axis < 3; ++axis) {
+				if (!mapping.IsSplittable(axis)) continue;
+
+				Bin& bin = outBins.Bins[axis][mapping.BinIndex(prims[i], axis)];
+				bin.Bounds.Grow(prims[i].Bounds);
+				++bin.Count;
+			}
+		}
+	}
+
+	void BinRangeParallel(const PrimRef* prims, size_t begin, size_t end, const BinMapping& mapping, UINT binCount, BinSet& outBins) {
+		const size_t chunkCount = (end - begin + PrimitiveGrainSize - 1) / PrimitiveGrainSize;
+
+		std::vector<BinSet> partials(chunkCount);
+		Parallel::ForEach(chunkCount, [&](size_t chunk) {
+			const size_t chunkBegin = begin + chunk * PrimitiveGrainSize;
+			BinRange(prims, chunkBegin, std::min(chunkBegin + PrimitiveGrainSize, end), mapping, binCount, partials[chunk]);
+		});
+
+		outBins.Reset(binCount);
+		for (const auto& partial : partials) {
+			for (int axis = 0; axis < 3; ++axis) {
+				for (UINT b = 0; b < binCount; ++b) {
+					outBins.Bins[axis][b].Bounds.Grow(partial.Bins[axis][b].Bounds);
+					outBins.Bins[axis][b].Count += partial.Bins[axis][b].Count;
+				}
+			}
+		}
+	}
+
+	// Sweeps every axis from both ends; costs are relative to the parent's area.
+	Split FindBestSplit(const BinSet& bins, const BinMapping& mapping, UINT binCount, const BvhBuildDesc& desc, float parentHalfArea) {
+		Split best;
+		if (parentHalfArea <= 0.0f) return best;
+
+		const float invParentArea = 1.0f / parentHalfArea;
+
+		float rightCosts[MaxBinCount];
+		for (int axis = 0; axis < 3; ++axis) {
+			if (!mapping.IsSplittable(axis)) continue;
+
+			const Bin* axisBins = bins.Bins[axis];
+
+			Aabb right;
+			right.Reset();
+			UINT rightCount = 0;
+			for (UINT b = binCount - 1; b > 0; --b) {
+				right.Grow(axisBins[b].Bounds);
+				rightCount += axisBins[b].Count;
+				rightCosts[b] = rightCount == 0 ? -1.0f : right.HalfArea() * static_cast<float>(rightCount);
+			}
+
+			Aabb left;
+			left.Reset();
+			UINT leftCount = 0;
+			for (UINT b = 0; b + 1 < binCount; ++b) {
+				left.Grow(axisBins[b].Bounds);
+				leftCount += axisBins[b].Count;
+				if (leftCount == 0 || rightCosts[b + 1] < 0.0f) continue;
+
+				const float cost = desc.TraversalCost +
+					desc.IntersectionCost * (left.HalfArea() * static_cast<float>(leftCount) + rightCosts[b + 1]) * invParentArea;
+				if (cost < best.Cost) {
+					best.Axis = axis;
+					best.Bin = b;
+					best.Cost = cost;
+				}
+			}
+		}
+
+		return best;
+	}
+
+	class Builder {
+	public:
+		Builder(const BvhBuildDesc& desc, std::vector<PrimRef>& prims) : mDesc(desc), mPrims(prims) {}
+
+	public:
+		// Partitions [begin, end) and returns the first index of the right half, or end when the
+		//  range should stay a leaf.
+		size_t SplitRange(size_t begin, size_t end, const RangeInfo& info, UINT depth, bool bParallel) {
+			const size_t count = end - begin;
+			if (count <= 1) return end;
+
+			if (depth >= MedianSplitDepth) {
+				if (count <= mDesc.MaxLeafSize) return end;
+				return SplitMedian(begin, end, info);
+			}
+
+			const BinMapping mapping(info.CentroidBounds, mDesc.BinCount);
+
+			BinSet bins;
+			if (bParallel) BinRangeParallel(mPrims.data(), begin, end, mapping, mDesc.BinCount, bins);
+			else BinRange(mPrims.data(), begin, end, mapping, mDesc.BinCount, bins);
+
+			const Split split = FindBestSplit(bins, mapping, mDesc.BinCount, mDesc, info.Bounds.HalfArea());
+
+			if (split.Axis < 0) {
+				if (count <= mDesc.MaxLeafSize) return end;
+
+				// Every centroid coincides (or the bounds are flat); any halving is as good as another.
+				return begin + count / 2;
+			}
+
+			const float leafCost = mDesc.IntersectionCost * static_cast<float>(count);
+			if (count <= mDesc.MaxLeafSize && split.Cost >= leafCost) return end;
+
+			const auto middle = std::partition(mPrims.begin() + begin, mPrims.begin() + end, [&](const PrimRef& prim) {
+				return mapping.BinIndex(prim, split.Axis) <= split.Bin;
+			});
+
+			return static_cast<size_t>(middle - mPrims.begin());
+		}
+
+		size_t SplitMedian(size_t begin, size_t end, const RangeInfo& info) {
+			int axis = 0;
+			float extent = -1.0f;
+			for (int a = 0; a < 3; ++a) {
+				const float e = info.CentroidBounds.Max[a] - info.CentroidBounds.Min[a];
+				if (e > extent) {
+					axis = a;
+					extent = e;
+				}
+			}
+
+			const size_t middle = begin + (end - begin) / 2;
+			std::nth_element(mPrims.begin() + begin, mPrims.begin() + middle, mPrims.begin() + end, [axis](const PrimRef& lhs, const PrimRef& rhs) {
+				return lhs.Centroid[axis] < rhs.Centroid[axis];
+			});
+
+			return middle;
+		}
+
+		void BuildSubtree(std::vector<BvhNode>& nodes, UINT nodeIndex, size_t begin, size_t end, const RangeInfo& info, UINT depth) {
+			SetBounds(nodes[nodeIndex], info.Bounds);
+
+			const size_t middle = SplitRange(begin, end, info, depth, false);
+			if (middle == end) {
+				SetLeaf(nodes[nodeIndex], begin, end);
+				return;
+			}
+
+			const UINT left = static_cast<UINT>(nodes.size());
+			nodes[nodeIndex].LeftFirst = left;
+			nodes[nodeIndex].TriangleCount = 0;
+			nodes.resize(nodes.size() + 2);
+
+			BuildSubtree(nodes, left, begin, middle, ComputeRangeInfo(mPrims.data(), begin, middle), depth + 1);
+			BuildSubtree(nodes, left + 1, middle, end, ComputeRangeInfo(mPrims.data(), middle, end), depth + 1);
+		}
+
+		static void SetBounds(BvhNode& node, const Aabb& bounds) {
+			node.BoundsMin = { bounds.Min[0], bounds.Min[1], bounds.Min[2] };
+			node.BoundsMax = { bounds.Max[0], bounds.Max[1], bounds.Max[2] };
+		}
+
+		static void SetLeaf(BvhNode& node, size_t begin, size_t end) {
+			node.LeftFirst = static_cast<UINT>(begin);
+			node.TriangleCount = static_cast<UINT>(end - begin);
+		}
+
+	private:
+		const BvhBuildDesc& mDesc;
+		std::vector<PrimRef>& mPrims;
+	};
+
+	struct PendingRange {
+		UINT Node;
+		size_t Begin;
+		size_t End;
+		UINT Depth;
+		RangeInfo Info;
+	};
+
+	// Builds the hierarchy over prims in place; leaves end up referencing ranges of their order.
+	void BuildNodes(const BvhBuildDesc& desc, std::vector<PrimRef>& prims, std::vector<BvhNode>& nodes, std::vector<UINT>& outPrimitiveIndices) {
+		Builder builder(desc, prims);
+
+		nodes.clear();
+		nodes.reserve(prims.size() * 2);
+		nodes.resize(1);
+
+		//
+		// Split the large ranges breadth-first with parallel binning.
+		//
+		const size_t targetSubtreeCount = Parallel::WorkerCount() * SubtreesPerWorker;
+
+		std::vector<PendingRange> open;
+		open.push_back({ 0, 0, prims.size(), 0, ComputeRangeInfoParallel(prims.data(), 0, prims.size()) });
+
+		std::vector<PendingRange> subtrees;
+		for (size_t i = 0; i < open.size(); ++i) {
+			const PendingRange range = open[i];
+			const size_t pendingCount = open.size() - i + subtrees.size();
+			if (range.End - range.Begin < ParallelSplitThreshold || pendingCount >= targetSubtreeCount) {
+				subtrees.push_back(range);
+				continue;
+			}
+
+			Builder::SetBounds(nodes[range.Node], range.Info.Bounds);
+
+			const size_t middle = builder.SplitRange(range.Begin, range.End, range.Info, range.Depth, true);
+			if (middle == range.End) {
+				Builder::SetLeaf(nodes[range.Node], range.Begin, range.End);
+				continue;
+			}
+
+			const UINT left = static_cast<UINT>(nodes.size());
+			nodes[range.Node].LeftFirst = left;
+			nodes[range.Node].TriangleCount = 0;
+			nodes.resize(nodes.size() + 2);
+
+			open.push_back({ left, range.Begin, middle, range.Depth + 1, ComputeRangeInfoParallel(prims.data(), range.Begin, middle) });
+			open.push_back({ left + 1, middle, range.End, range.Depth + 1, ComputeRangeInfoParallel(prims.data(), middle, range.End) });
+		}
+
+		//
+		// Build the remaining subtrees independently, then append them in order.
+		//
+		std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+		Parallel::ForEach(subtrees.size(), [&](size_t i) {
+			const auto& subtree = subtrees[i];
+
+			auto& local = subtreeNodes[i];
+			local.reserve((subtree.End - subtree.Begin) * 2);
+			local.resize(1);
+			builder.BuildSubtree(local, 0, subtree.Begin, subtree.End, subtree.Info, subtree.Depth);
+		});
+
+		for (size_t i = 0; i < subtrees.size(); ++i) {
+			const auto& local = subtreeNodes[i];
+
+			// Local node n > 0 lands at base + n - 1; the local root replaces the reserved slot.
+			const UINT base = static_cast<UINT>(nodes.size());
+			auto relocate = [base](BvhNode node) {
+				if (!node.IsLeaf()) node.LeftFirst = base + node.LeftFirst - 1;
+				return node;
+			};
+
+			nodes[subtrees[i].Node] = relocate(local[0]);
+			for (size_t n = 1; n < local.size(); ++n)
+				nodes.push_back(relocate(local[n]));
+		}
+		nodes.shrink_to_fit();
+
+		outPrimitiveIndices.resize(prims.size());
+		Parallel::ForRange(prims.size(), PrimitiveGrainSize, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				outPrimitiveIndices[i] = prims[i].Primitive;
+		});
+	}
+}
+
+bool BvhBuilder::Build(const BvhMesh& mesh, const BvhBuildDesc& desc, Bvh& outBvh, BvhBuildStats* pStats) {
+	if (mesh.Vertices == nullptr || mesh.Indices == nullptr) ReturnFalse(L"BVH mesh has no vertex or index data");
+	if (mesh.IndexStride != 2 && mesh.IndexStride != 4) ReturnFalse(L"BVH mesh index stride must be 2 or 4 bytes");
+	if (mesh.TriangleCount() == 0) ReturnFalse(L"BVH mesh has no triangles");
+	if (desc.BinCount < 2 || desc.BinCount > MaxBinCount) ReturnFalse(L"BVH bin count must be in [2, 64]");
+	if (desc.MaxLeafSize == 0) ReturnFalse(L"BVH leaves must hold at least one triangle");
+
+	Stopwatch timer;
+
+	const UINT triangleCount = mesh.TriangleCount();
+
+	std::vector<PrimRef> prims(triangleCount);
+	Parallel::ForRange(triangleCount, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			UINT i0, i1, i2;
+			mesh.Triangle(static_cast<UINT>(i), i0, i1, i2);
+
+			const DirectX::XMFLOAT3* positions[] = { &mesh.Position(i0), &mesh.Position(i1), &mesh.Position(i2) };
+
+			PrimRef& prim = prims[i];
+			prim.Bounds.Reset();
+			for (const auto pos : positions) {
+				const float point[] = { pos->x, pos->y, pos->z };
+				prim.Bounds.Grow(point);
+			}
+			for (int axis = 0; axis < 3; ++axis)
+				prim.Centroid[axis] = 0.5f * (prim.Bounds.Min[axis] + prim.Bounds.Max[axis]);
+			prim.Primitive = static_cast<UINT>(i);
+		}
+	});
+
+	BuildNodes(desc, prims, outBvh.Nodes, outBvh.TriangleIndices);
+	outBvh.Mesh = mesh;
+
+	if (pStats != nullptr) {
+		CalcStats(outBvh, desc, *pStats);
+		pStats->BuildMilliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+bool BvhBuilder::BuildOverBounds(const BvhBounds* pBounds, UINT count, const BvhBuildDesc& desc,
+		std::vector<BvhNode>& outNodes, std::vector<UINT>& outPrimitiveIndices) {
+	if (pBounds == nullptr || count == 0) ReturnFalse(L"BVH has no bounds to build over");
+	if (desc.BinCount < 2 || desc.BinCount > MaxBinCount) ReturnFalse(L"BVH bin count must be in [2, 64]");
+	if (desc.MaxLeafSize == 0) ReturnFalse(L"BVH leaves must hold at least one primitive");
+
+	std::vector<PrimRef> prims(count);
+	Parallel::ForRange(count, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const BvhBounds& bounds = pBounds[i];
+
+			PrimRef& prim = prims[i];
+			prim.Bounds.Reset();
+			const float boundsMin[] = { bounds.Min.x, bounds.Min.y, bounds.Min.z };
+			const float boundsMax[] = { bounds.Max.x, bounds.Max.y, bounds.Max.z };
+			prim.Bounds.Grow(boundsMin);
+			prim.Bounds.Grow(boundsMax);
+			for (int axis = 0; axis < 3; ++axis)
+				prim.Centroid[axis] = 0.5f * (prim.Bounds.Min[axis] + prim.Bounds.Max[axis]);
+			prim.Primitive = static_cast<UINT>(i);
+		}
+	});
+
+	BuildNodes(desc, prims, outNodes, outPrimitiveIndices);
+
+	return true;
+}
+
+void BvhBuilder::CalcStats(const Bvh& bvh, const BvhBuildDesc& desc, BvhBuildStats& outStats) {
+	CalcStats(bvh.Nodes, static_cast<UINT>(bvh.TriangleIndices.size()), desc, outStats);
+}
+
+void BvhBuilder::CalcStats(const std::vector<BvhNode>& nodes, UINT primitiveCount, const BvhBuildDesc& desc, BvhBuildStats& outStats) {
+	outStats = BvhBuildStats();
+	outStats.TriangleCount = primitiveCount;
+	outStats.NodeCount = static_cast<UINT>(nodes.size());
+	if (nodes.empty()) return;
+
+	const float rootArea = HalfArea(nodes[0]);
+	const float invRootArea = rootArea > 0.0f ? 1.0f / rootArea : 0.0f;
+
+	double sahCost = 0.0;
+
+	std::vector<std::pair<UINT, UINT>> stack;
+	stack.push_back({ 0, 0 });
+	while (!stack.empty()) {
+		const auto [index, depth] = stack.back();
+		stack.pop_back();
+
+		const BvhNode& node = nodes[index];
+		const double areaRatio = rootArea > 0.0f ? HalfArea(node) * invRootArea : 1.0;
+
+		outStats.MaxDepth = std::max(outStats.MaxDepth, depth);
+
+		if (node.IsLeaf()) {
+			++outStats.LeafCount;
+			sahCost += desc.IntersectionCost * node.TriangleCount * areaRatio;
+		}
+		else {
+			sahCost += desc.TraversalCost * areaRatio;
+			stack.push_back({ node.LeftFirst, depth + 1 });
+			stack.push_back({ node.LeftFirst + 1, depth + 1 });
+		}
+	}
+
+	outStats.SahCost = static_cast<float>(sahCost);
+	outStats.AverageLeafSize = outStats.LeafCount == 0 ? 0.0f : static_cast<float>(outStats.TriangleCount) / outStats.LeafCount;
+}
+
+bool BvhBuilder::RunBenchmark(UINT sphereSize, const BvhBuildDesc& desc) {
+	GeometryGenerator geoGen;
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	VectorMeshSink sink(vertices, indices);
+	CheckIsValid(geoGen.CreateSphere(1.0f, sphereSize, sphereSize, sink));
+
+	BvhMesh mesh;
+	mesh.Vertices = vertices.data();
+	mesh.VertexCount = static_cast<UINT>(vertices.size());
+	mesh.Indices = indices.data();
+	mesh.IndexCount = static_cast<UINT>(indices.size());
+	mesh.IndexStride = sizeof(std::uint32_t);
+
+	Bvh bvh;
+	BvhBuildStats stats;
+	CheckIsValid(Build(mesh, desc, bvh, &stats));
+
+	Logln("BVH build benchmark: sphere ", std::to_string(sphereSize), "x", std::to_string(sphereSize), ", ",
+		std::to_string(stats.TriangleCount), " triangles in ", std::to_string(stats.BuildMilliseconds), " ms (",
+		std::to_string(stats.Throughput()), " Mtris/s on ", std::to_string(Parallel::WorkerCount()),
+		" threads), ", std::to_string(stats.NodeCount), " nodes, depth ", std::to_string(stats.MaxDepth),
+		", SAH cost ", std::to_string(stats.SahCost));
+
+	return true;
+}
@@ -0,0 +1,326 @@
+#include "BvhCache.h"
+#include "GeometryGenerator.h"
+#include "Lbvh.h"
+#include "Logger.h"
+#include "MeshCache.h"
+#include "Stopwatch.h"
+#include "VectorMeshSink.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace BvhCache;
+
+namespace {
+	// Distinguishes the builders in CalcKey.
+	const UINT BinnedSahTag = 1;
+	const UINT LinearTag = 2;
+
+	const wchar_t Extension[] = L".bvhbin";
+
+	__forceinline UINT64 AlignSection(UINT64 offset) {
+		return (offset + SectionAlignment - 1) & ~static_cast<UINT64>(SectionAlignment - 1);
+	}
+
+	// Written so that a huge offset or count cannot wrap around.
+	__forceinline bool SectionInRange(UINT64 offset, UINT64 count, UINT64 stride, UINT64 fileSize) {
+		return offset <= fileSize && count <= (fileSize - offset) / stride;
+	}
+
+	UINT64 HashSections(const FileHeader& header, const BYTE* base) {
+		UINT64 hash = MeshCache::HashBytes(base + header.NodeOffset, static_cast<size_t>(header.NodeCount) * header.NodeStride);
+		hash = MeshCache::HashBytes(base + header.TriangleIndexOffset, static_cast<size_t>(header.TriangleIndexCount) * sizeof(UINT), hash);
+		return hash;
+	}
+
+	UINT64 HashMesh(const BvhMesh& mesh) {
+		UINT64 hash = MeshCache::HashBytes(mesh.Vertices, static_cast<size_t>(mesh.VertexCount) * sizeof(Vertex));
+		hash = MeshCache::HashBytes(mesh.Indices, static_cast<size_t>(mesh.IndexCount) * mesh.IndexStride, hash);
+		const UINT counts[] = { mesh.VertexCount, mesh.IndexCount, mesh.IndexStride };
+		return MeshCache::HashBytes(counts, sizeof(counts), hash);
+	}
+
+	// Children in range and after their parent, leaf ranges within the triangle indices, and
+	//  triangle indices within the mesh.
+	bool NodesInRange(const FileHeader& header, const BvhNode* nodes, const UINT* triangleIndices) {
+		if (header.NodeCount == 0) return false;
+
+		for (UINT i = 0; i < header.NodeCount; ++i) {
+			const BvhNode& node = nodes[i];
+			if (node.IsLeaf()) {
+				if (static_cast<UINT64>(node.LeftFirst) + node.TriangleCount > header.TriangleIndexCount) return false;
+			}
+			else if (node.LeftFirst <= i || static_cast<UINT64>(node.LeftFirst) + 1 >= header.NodeCount) {
+				return false;
+			}
+		}
+
+		for (UINT i = 0; i < header.TriangleIndexCount; ++i) {
+			if (triangleIndices[i] >= header.TriangleCount) return false;
+		}
+
+		return true;
+	}
+
+	const BYTE Padding[SectionAlignment] = {};
+
+	void WritePadding(std::ofstream& fout, UINT64 offset) {
+		const UINT64 aligned = AlignSection(offset);
+		if (aligned > offset) fout.write(reinterpret_cast<const char*>(Padding), static_cast<std::streamsize>(aligned - offset));
+	}
+}
+
+bool BvhCacheFile::Open(const std::wstring& inFilename, UINT64 key, bool bValidate) {
+	mHeader = nullptr;
+	mFile = std::make_unique<MappedFile>();
+
+	if (!mFile->Open(inFilename)) {
+		mFile.reset();
+		return false;
+	}
+
+	const UINT64 size = mFile->Size();
+	const BYTE* base = reinterpret_cast<const BYTE*>(mFile->Data());
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+
+	bool valid = size >= sizeof(FileHeader);
+	valid = valid && header->Magic == Magic && header->Version == Version && header->HeaderSize == sizeof(FileHeader);
+	valid = valid && header->NodeStride == sizeof(BvhNode) && header->Key == key;
+	valid = valid && header->FileSize == size;
+	valid = valid && header->NodeOffset % SectionAlignment == 0 && header->TriangleIndexOffset % SectionAlignment == 0;
+	valid = valid && SectionInRange(header->NodeOffset, header->NodeCount, header->NodeStride, size);
+	valid = valid && SectionInRange(header->TriangleIndexOffset, header->TriangleIndexCount, sizeof(UINT), size);
+
+	if (valid && bValidate) {
+		if (HashSections(*header, base) != header->ContentHash) {
+			WErrln(L"BVH cache content hash mismatch: " + inFilename);
+			valid = false;
+		}
+		else if (!NodesInRange(*header,
+				reinterpret_cast<const BvhNode*>(base + header->NodeOffset),
+				reinterpret_cast<const UINT*>(base + header->TriangleIndexOffset))) {
+			WErrln(L"BVH cache node out of range: " + inFilename);
+			valid = false;
+		}
+	}
+
+	if (!valid) {
+		mFile.reset();
+		return false;
+	}
+
+	mHeader = header;
+	return true;
+}
+
+const FileHeader& BvhCacheFile::Header() const {
+	return *mHeader;
+}
+
+const BvhNode* BvhCacheFile::Nodes() const {
+	return reinterpret_cast<const BvhNode*>(reinterpret_cast<const BYTE*>(mFile->Data()) + mHeader->NodeOffset);
+}
+
+const UINT* BvhCacheFile::TriangleIndices() const {
+	return reinterpret_cast<const UINT*>(reinterpret_cast<const BYTE*>(mFile->Data()) + mHeader->TriangleIndexOffset);
+}
+
+bool BvhCacheFile::Load(const BvhMesh& mesh, Bvh& outBvh) const {
+	if (mHeader == nullptr) ReturnFalse(L"BVH cache is not open");
+	if (mesh.TriangleCount() != mHeader->TriangleCount) ReturnFalse(L"BVH cache was built over a different mesh");
+
+	outBvh.Mesh = mesh;
+	outBvh.Nodes.assign(Nodes(), Nodes() + mHeader->NodeCount);
+	outBvh.TriangleIndices.assign(TriangleIndices(), TriangleIndices() + mHeader->TriangleIndexCount);
+
+	return true;
+}
+
+UINT64 BvhCache::CalcKey(const BvhMesh& mesh, const BvhBuildDesc& desc) {
+	const UINT settings[] = { BinnedSahTag, desc.BinCount, desc.MaxLeafSize };
+	const float costs[] = { desc.TraversalCost, desc.IntersectionCost };
+
+	UINT64 hash = HashMesh(mesh);
+	hash = MeshCache::HashBytes(settings, sizeof(settings), hash);
+	return MeshCache::HashBytes(costs, sizeof(costs), hash);
+}
+
+UINT64 BvhCache::CalcKey(const BvhMesh& mesh, const LbvhBuildDesc& desc) {
+	// Field by field; the struct has padding after its flags.
+	const UINT settings[] = { LinearTag, desc.Use63BitCodes ? 1u : 0u, desc.Rotate ? 1u : 0u, desc.MaxLeafSize };
+	const float costs[] = { desc.TraversalCost, desc.IntersectionCost };
+
+	UINT64 hash = HashMesh(mesh);
+	hash = MeshCache::HashBytes(settings, sizeof(settings), hash);
+	return MeshCache::HashBytes(costs, sizeof(costs), hash);
+}
+
+std::wstring BvhCache::Filename(const std::wstring& directory, UINT64 key) {
+	wchar_t name[17];
+	for (int i = 0; i < 16; ++i)
+		name[i] = L"0123456789abcdef"[(key >> (60 - 4 * i)) & 0xF];
+	name[16] = L'\0';
+
+	return directory + name + Extension;
+}
+
+bool BvhCache::Write(const std::wstring& inFilename, UINT64 key, const Bvh& bvh) {
+	if (bvh.Nodes.empty()) ReturnFalse(L"BVH cache needs a built hierarchy");
+
+	FileHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.HeaderSize = sizeof(FileHeader);
+	header.NodeStride = sizeof(BvhNode);
+	header.NodeCount = static_cast<UINT>(bvh.Nodes.size());
+	header.TriangleIndexCount = static_cast<UINT>(bvh.TriangleIndices.size());
+	header.TriangleCount = bvh.Mesh.TriangleCount();
+
+	const UINT64 nodeByteSize = static_cast<UINT64>(bvh.Nodes.size()) * sizeof(BvhNode);
+	const UINT64 indexByteSize = static_cast<UINT64>(bvh.TriangleIndices.size()) * sizeof(UINT);
+
+	header.NodeOffset = AlignSection(sizeof(FileHeader));
+	header.TriangleIndexOffset = AlignSection(header.NodeOffset + nodeByteSize);
+	header.FileSize = header.TriangleIndexOffset + indexByteSize;
+	header.Key = key;
+
+	UINT64 hash = MeshCache::HashBytes(bvh.Nodes.data(), static_cast<size_t>(nodeByteSize));
+	hash = MeshCache::HashBytes(bvh.TriangleIndices.data(), static_cast<size_t>(indexByteSize), hash);
+	header.ContentHash = hash;
+
+	// Renamed over the target only once complete, like MeshCache::Write.
+	const std::wstring tempFilename = inFilename + L".tmp";
+
+	std::ofstream fout(tempFilename, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create BVH cache: " + tempFilename);
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	WritePadding(fout, sizeof(FileHeader));
+	fout.write(reinterpret_cast<const char*>(bvh.Nodes.data()), static_cast<std::streamsize>(nodeByteSize));
+	WritePadding(fout, header.NodeOffset + nodeByteSize);
+	fout.write(reinterpret_cast<const char*>(bvh.TriangleIndices.data()), static_cast<std::streamsize>(indexByteSize));
+
+	fout.close();
+
+	if (!fout.good() || !MoveFileExW(tempFilename.c_str(), inFilename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileW(tempFilename.c_str());
+		ReturnFalse(L"Failed to write BVH cache: " + inFilename);
+	}
+
+	return true;
+}
+
+void BvhCache::Touch(const std::wstring& inFilename) {
+	// Attribute access only, so a view of the file may stay mapped.
+	const HANDLE hFile = CreateFileW(
+		inFilename.c_str(),
+		FILE_WRITE_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) return;
+
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	SetFileTime(hFile, nullptr, nullptr, &now);
+
+	CloseHandle(hFile);
+}
+
+void BvhCache::Trim(const std::wstring& directory, UINT64 maxBytes) {
+	struct CacheEntry {
+		UINT64 WriteTime;
+		UINT64 Size;
+		std::wstring Name;
+	};
+
+	WIN32_FIND_DATAW data;
+	const HANDLE hFind = FindFirstFileW((directory + L"*" + Extension).c_str(), &data);
+	if (hFind == INVALID_HANDLE_VALUE) return;
+
+	std::vector<CacheEntry> entries;
+	UINT64 totalBytes = 0;
+	do {
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+		CacheEntry entry;
+		entry.WriteTime = (static_cast<UINT64>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+		entry.Size = (static_cast<UINT64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		entry.Name = data.cFileName;
+
+		totalBytes += entry.Size;
+		entries.push_back(std::move(entry));
+	} while (FindNextFileW(hFind, &data));
+	FindClose(hFind);
+
+	if (totalBytes <= maxBytes) return;
+
+	std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) {
+		return a.WriteTime < b.WriteTime;
+	});
+
+	// A file another process still has open stays and keeps counting against the budget.
+	for (const auto& entry : entries) {
+		if (totalBytes <= maxBytes) break;
+		if (DeleteFileW((directory + entry.Name).c_str())) totalBytes -= entry.Size;
+	}
+}
+
+bool BvhCache::RunBenchmark(UINT sphereSize, const BvhBuildDesc& desc, const std::wstring& directory) {
+	GeometryGenerator geoGen;
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	VectorMeshSink sink(vertices, indices);
+	CheckIsValid(geoGen.CreateSphere(1.0f, sphereSize, sphereSize, sink));
+
+	BvhMesh mesh;
+	mesh.Vertices = vertices.data();
+	mesh.VertexCount = static_cast<UINT>(vertices.size());
+	mesh.Indices = indices.data();
+	mesh.IndexCount = static_cast<UINT>(indices.size());
+	mesh.IndexStride = sizeof(std::uint32_t);
+
+	CreateDirectoryW(directory.c_str(), nullptr);
+
+	Stopwatch coldTimer;
+	const UINT64 key = CalcKey(mesh, desc);
+	const double hashMs = coldTimer.ElapsedMilliseconds();
+	const std::wstring filename = Filename(directory, key);
+
+	Bvh bvh;
+	CheckIsValid(BvhBuilder::Build(mesh, desc, bvh));
+	CheckIsValid(Write(filename, key, bvh));
+	const double coldMs = coldTimer.ElapsedMilliseconds();
+
+	double warmMs[2] = {};
+	bool bSame = true;
+	for (UINT i = 0; i < 2; ++i) {
+		Stopwatch warmTimer;
+		BvhCacheFile cache;
+		CheckIsValid(cache.Open(filename, CalcKey(mesh, desc), i == 1));
+
+		Bvh loaded;
+		CheckIsValid(cache.Load(mesh, loaded));
+		warmMs[i] = warmTimer.ElapsedMilliseconds();
+
+		bSame = bSame && loaded.Nodes.size() == bvh.Nodes.size() && loaded.TriangleIndices == bvh.TriangleIndices &&
+			std::memcmp(loaded.Nodes.data(), bvh.Nodes.data(), bvh.Nodes.size() * sizeof(BvhNode)) == 0;
+	}
+
+	const UINT64 fileSize = static_cast<UINT64>(bvh.Nodes.size()) * sizeof(BvhNode) + bvh.TriangleIndices.size() * sizeof(UINT);
+	DeleteFileW(filename.c_str());
+
+	Logln("BVH cache benchmark: sphere ", std::to_string(sphereSize), "x", std::to_string(sphereSize), ", ",
+		std::to_string(mesh.TriangleCount()), " triangles, ", std::to_string(fileSize >> 20), " MB, key hashed in ",
+		std::to_string(hashMs), " ms");
+	Logln("    cold ", std::to_string(coldMs), " ms, warm ", std::to_string(warmMs[0]), " ms (",
+		std::to_string(warmMs[0] > 0.0 ? coldMs / warmMs[0] : 0.0), "x), warm validated ", std::to_string(warmMs[1]), " ms (",
+		std::to_string(warmMs[1] > 0.0 ? coldMs / warmMs[1] : 0.0), "x)", bSame ? "" : "; loaded hierarchy differs");
+
+	return true;
+}
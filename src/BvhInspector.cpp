@@ -0,0 +1,185 @@
+#include "BvhInspector.h"
+#include "Logger.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+#include "TwoLevelBvh.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace {
+	float HalfArea(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax) {
+		const float dx = std::max(0.0f, boundsMax.x - boundsMin.x);
+		const float dy = std::max(0.0f, boundsMax.y - boundsMin.y);
+		const float dz = std::max(0.0f, boundsMax.z - boundsMin.z);
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	// Area of the box two siblings share; zero unless they overlap along every axis.
+	float OverlapHalfArea(const BvhNode& a, const BvhNode& b) {
+		const XMFLOAT3 overlapMin(std::max(a.BoundsMin.x, b.BoundsMin.x), std::max(a.BoundsMin.y, b.BoundsMin.y), std::max(a.BoundsMin.z, b.BoundsMin.z));
+		const XMFLOAT3 overlapMax(std::min(a.BoundsMax.x, b.BoundsMax.x), std::min(a.BoundsMax.y, b.BoundsMax.y), std::min(a.BoundsMax.z, b.BoundsMax.z));
+		if (overlapMax.x < overlapMin.x || overlapMax.y < overlapMin.y || overlapMax.z < overlapMin.z) return 0.0f;
+		return HalfArea(overlapMin, overlapMax);
+	}
+
+	template <typename TraceRay>
+	bool TraceHeatmap(const BvhHeatmapDesc& desc, BvhHeatmap& outHeatmap, const TraceRay& traceRay) {
+		const UINT width = desc.Width;
+		const UINT height = desc.Height;
+		if (width == 0 || height == 0) ReturnFalse(L"Heatmap needs a size");
+
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+
+		outHeatmap = BvhHeatmap();
+		outHeatmap.Width = width;
+		outHeatmap.Height = height;
+		outHeatmap.NodeCounts.resize(pixelCount);
+		outHeatmap.TriangleCounts.resize(pixelCount);
+		outHeatmap.InstanceCounts.resize(pixelCount);
+
+		const XMMATRIX invViewProj = XMLoadFloat4x4(&desc.InvViewProj);
+
+		const UINT tileSize = BvhInspector::TileSize;
+		const UINT tileCountX = (width + tileSize - 1) / tileSize;
+		const UINT tileCountY = (height + tileSize - 1) / tileSize;
+
+		Stopwatch timer;
+
+		Parallel::ForEach(static_cast<size_t>(tileCountX) * tileCountY, [&](size_t tile) {
+			const UINT beginX = static_cast<UINT>(tile % tileCountX) * tileSize;
+			const UINT beginY = static_cast<UINT>(tile / tileCountX) * tileSize;
+			const UINT endX = std::min(beginX + tileSize, width);
+			const UINT endY = std::min(beginY + tileSize, height);
+
+			for (UINT y = beginY; y < endY; ++y) {
+				for (UINT x = beginX; x < endX; ++x) {
+					const float ndcX = (static_cast<float>(x) + 0.5f) / static_cast<float>(width) * 2.0f - 1.0f;
+					const float ndcY = 1.0f - (static_cast<float>(y) + 0.5f) / static_cast<float>(height) * 2.0f;
+					const XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invViewProj);
+					const XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invViewProj);
+
+					// Direction spans the frustum, so t in [0, 1] covers it.
+					BvhRay ray;
+					XMStoreFloat3(&ray.Origin, nearPoint);
+					XMStoreFloat3(&ray.Direction, farPoint - nearPoint);
+					ray.TMax = 1.0f;
+
+					BvhHit hit;
+					BvhTraceCounters counters;
+					traceRay(ray, hit, counters);
+
+					const size_t index = static_cast<size_t>(y) * width + x;
+					outHeatmap.NodeCounts[index] = static_cast<float>(counters.NodeCount);
+					outHeatmap.TriangleCounts[index] = static_cast<float>(counters.TriangleCount);
+					outHeatmap.InstanceCounts[index] = static_cast<float>(counters.InstanceCount);
+				}
+			}
+		});
+
+		outHeatmap.Milliseconds = timer.ElapsedMilliseconds();
+
+		// Exact integer sums, divided once, so the means don't drift with the pixel count.
+		UINT64 nodeSum = 0;
+		UINT64 triangleSum = 0;
+		UINT64 instanceSum = 0;
+		for (size_t i = 0; i < pixelCount; ++i) {
+			const UINT nodeCount = static_cast<UINT>(outHeatmap.NodeCounts[i]);
+			const UINT triangleCount = static_cast<UINT>(outHeatmap.TriangleCounts[i]);
+			const UINT instanceCount = static_cast<UINT>(outHeatmap.InstanceCounts[i]);
+
+			outHeatmap.Max.NodeCount = std::max(outHeatmap.Max.NodeCount, nodeCount);
+			outHeatmap.Max.TriangleCount = std::max(outHeatmap.Max.TriangleCount, triangleCount);
+			outHeatmap.Max.InstanceCount = std::max(outHeatmap.Max.InstanceCount, instanceCount);
+			nodeSum += nodeCount;
+			triangleSum += triangleCount;
+			instanceSum += instanceCount;
+		}
+		outHeatmap.MeanNodeCount = static_cast<double>(nodeSum) / pixelCount;
+		outHeatmap.MeanTriangleCount = static_cast<double>(triangleSum) / pixelCount;
+		outHeatmap.MeanInstanceCount = static_cast<double>(instanceSum) / pixelCount;
+
+		return true;
+	}
+}
+
+void BvhInspector::CalcStructureStats(const Bvh& bvh, const BvhBuildDesc& desc, BvhStructureStats& outStats) {
+	CalcStructureStats(bvh.Nodes, static_cast<UINT>(bvh.TriangleIndices.size()), desc, outStats);
+}
+
+void BvhInspector::CalcStructureStats(const std::vector<BvhNode>& nodes, UINT primitiveCount, const BvhBuildDesc& desc, BvhStructureStats& outStats) {
+	BvhBuildStats buildStats;
+	BvhBuilder::CalcStats(nodes, primitiveCount, desc, buildStats);
+
+	outStats = BvhStructureStats();
+	outStats.NodeCount = buildStats.NodeCount;
+	outStats.LeafCount = buildStats.LeafCount;
+	outStats.TriangleCount = buildStats.TriangleCount;
+	outStats.SahCost = buildStats.SahCost;
+	outStats.MaxDepth = buildStats.MaxDepth;
+	outStats.LeafSizeHistogram.assign(BvhStructureStats::LeafSizeBucketCount, 0);
+	outStats.LeafDepthHistogram.assign(static_cast<size_t>(buildStats.MaxDepth) + 1, 0);
+	if (nodes.empty()) return;
+
+	double depthSum = 0.0;
+	double overlapArea = 0.0;
+	double parentArea = 0.0;
+
+	std::vector<std::pair<UINT, UINT>> stack;
+	stack.push_back({ 0, 0 });
+	while (!stack.empty()) {
+		const auto [index, depth] = stack.back();
+		stack.pop_back();
+
+		const BvhNode& node = nodes[index];
+		if (node.IsLeaf()) {
+			++outStats.LeafSizeHistogram[std::min(node.TriangleCount, BvhStructureStats::LeafSizeBucketCount - 1)];
+			++outStats.LeafDepthHistogram[depth];
+			depthSum += depth;
+			continue;
+		}
+
+		const float area = HalfArea(node.BoundsMin, node.BoundsMax);
+		const float overlap = OverlapHalfArea(nodes[node.LeftFirst], nodes[node.LeftFirst + 1]);
+		overlapArea += overlap;
+		parentArea += area;
+		if (area > 0.0f) outStats.MaxSiblingOverlap = std::max(outStats.MaxSiblingOverlap, overlap / area);
+
+		stack.push_back({ node.LeftFirst, depth + 1 });
+		stack.push_back({ node.LeftFirst + 1, depth + 1 });
+	}
+
+	outStats.AverageLeafDepth = outStats.LeafCount == 0 ? 0.0f : static_cast<float>(depthSum / outStats.LeafCount);
+	outStats.SiblingOverlap = parentArea > 0.0 ? static_cast<float>(overlapArea / parentArea) : 0.0f;
+}
+
+bool BvhInspector::RenderHeatmap(const Bvh& bvh, const BvhHeatmapDesc& desc, BvhHeatmap& outHeatmap) {
+	return TraceHeatmap(desc, outHeatmap, [&](const BvhRay& ray, BvhHit& outHit, BvhTraceCounters& counters) {
+		BvhTraversal::Trace(bvh, ray, desc.Mode, outHit, counters, desc.Cull);
+	});
+}
+
+bool BvhInspector::RenderHeatmap(const TwoLevelBvh& tlas, const BvhHeatmapDesc& desc, BvhHeatmap& outHeatmap) {
+	return TraceHeatmap(desc, outHeatmap, [&](const BvhRay& ray, BvhHit& outHit, BvhTraceCounters& counters) {
+		BvhTraversal::Trace(tlas, ray, desc.Mode, outHit, counters, desc.Cull);
+	});
+}
+
+bool BvhInspector::WritePfm(const std::wstring& inFilename, UINT width, UINT height, const std::vector<float>& image) {
+	if (image.size() != static_cast<size_t>(width) * height) ReturnFalse(L"Image does not match its size");
+
+	std::ofstream fout(inFilename, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create image: " + inFilename);
+
+	// A negative scale marks little-endian samples; rows run from the bottom up.
+	const std::string header = "Pf\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+	fout.write(header.data(), static_cast<std::streamsize>(header.size()));
+	for (UINT y = height; y-- > 0;)
+		fout.write(reinterpret_cast<const char*>(image.data() + static_cast<size_t>(y) * width), static_cast<std::streamsize>(width * sizeof(float)));
+
+	if (!fout.good()) ReturnFalse(L"Failed to write image: " + inFilename);
+
+	return true;
+}
@@ -0,0 +1,1265 @@
+#include "BvhTraversal.h"
+#include "Logger.h"
+#include "AnalyticBvh.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+#include "TwoLevelBvh.h"
+#include "WideBvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <intrin.h>
+#include <random>
+#include <string>
+#include <vector>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace {
+	// 1 + 2 * gamma(3), gamma(n) = n * eps / (1 - n * eps) with eps = 2^-24, rounded up (Ize 2013).
+	const float FarScale = 1.00000036f;
+
+	// Direction components are kept at least this far from zero so 1 / d stays finite and the
+	//  slab test never computes 0 * inf.
+	const float MinDirection = 1.0e-20f;
+
+	float SafeReciprocal(float d) {
+		return 1.0f / (std::fabs(d) >= MinDirection ? d : std::copysign(MinDirection, d));
+	}
+
+	// Ray in the shear-transformed space of the watertight test; kz is the dominant axis.
+	struct TriangleRay {
+		int Kx;
+		int Ky;
+		int Kz;
+		float Sx;
+		float Sy;
+		float Sz;
+		float Origin[3];
+		BvhTraversal::Cull Cull;
+	};
+
+	bool SetupTriangleRay(const BvhRay& ray, BvhTraversal::Cull cull, TriangleRay& outRay) {
+		const float dir[] = { ray.Direction.x, ray.Direction.y, ray.Direction.z };
+
+		int kz = 0;
+		if (std::fabs(dir[1]) > std::fabs(dir[kz])) kz = 1;
+		if (std::fabs(dir[2]) > std::fabs(dir[kz])) kz = 2;
+		if (dir[kz] == 0.0f) return false;
+
+		int kx = (kz + 1) % 3;
+		int ky = (kx + 1) % 3;
+		// Keeps the winding of the projected triangle.
+		if (dir[kz] < 0.0f) std::swap(kx, ky);
+
+		outRay.Kx = kx;
+		outRay.Ky = ky;
+		outRay.Kz = kz;
+		outRay.Sx = dir[kx] / dir[kz];
+		outRay.Sy = dir[ky] / dir[kz];
+		outRay.Sz = 1.0f / dir[kz];
+		outRay.Origin[0] = ray.Origin.x;
+		outRay.Origin[1] = ray.Origin.y;
+		outRay.Origin[2] = ray.Origin.z;
+		outRay.Cull = cull;
+
+		return true;
+	}
+
+	bool IntersectTriangle(
+			const TriangleRay& ray, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2,
+			float tMin, float tMax, float& outT, float& outU, float& outV) {
+		const float a[] = { p0.x - ray.Origin[0], p0.y - ray.Origin[1], p0.z - ray.Origin[2] };
+		const float b[] = { p1.x - ray.Origin[0], p1.y - ray.Origin[1], p1.z - ray.Origin[2] };
+		const float c[] = { p2.x - ray.Origin[0], p2.y - ray.Origin[1], p2.z - ray.Origin[2] };
+
+		const float ax = a[ray.Kx] - ray.Sx * a[ray.Kz];
+		const float ay = a[ray.Ky] - ray.Sy * a[ray.Kz];
+		const float bx = b[ray.Kx] - ray.Sx * b[ray.Kz];
+		const float by = b[ray.Ky] - ray.Sy * b[ray.Kz];
+		const float cx = c[ray.Kx] - ray.Sx * c[ray.Kz];
+		const float cy = c[ray.Ky] - ray.Sy * c[ray.Kz];
+
+		float u = cx * by - cy * bx;
+		float v = ax * cy - ay * cx;
+		float w = bx * ay - by * ax;
+
+		// The ray passes (nearly) through an edge; only exact products decide which side.
+		if (u == 0.0f || v == 0.0f || w == 0.0f) {
+			u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+			v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+			w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+		}
+
+		if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) return false;
+
+		// A positive determinant means cross(p1 - p0, p2 - p0) faces the ray origin.
+		const float det = u + v + w;
+		if (det == 0.0f) return false;
+		if (ray.Cull == BvhTraversal::ECullFrontFacing && det > 0.0f) return false;
+		if (ray.Cull == BvhTraversal::ECullBackFacing && det < 0.0f) return false;
+
+		const float az = ray.Sz * a[ray.Kz];
+		const float bz = ray.Sz * b[ray.Kz];
+		const float cz = ray.Sz * c[ray.Kz];
+
+		const float invDet = 1.0f / det;
+		const float t = (u * az + v * bz + w * cz) * invDet;
+		if (!(t >= tMin && t <= tMax)) return false;
+
+		outT = t;
+		outU = v * invDet;
+		outV = w * invDet;
+
+		return true;
+	}
+
+	// Ray terms laid out for IntersectChildren: x and y twice each, then z twice.
+	struct BoxRay {
+		__m128 OriginXY;
+		__m128 OriginZ;
+		__m128 InvDirXY;
+		__m128 InvDirZ;
+	};
+
+	BoxRay SetupBoxRay(const BvhRay& ray) {
+		const float invX = SafeReciprocal(ray.Direction.x);
+		const float invY = SafeReciprocal(ray.Direction.y);
+		const float invZ = SafeReciprocal(ray.Direction.z);
+
+		BoxRay boxRay;
+		boxRay.OriginXY = _mm_setr_ps(ray.Origin.x, ray.Origin.x, ray.Origin.y, ray.Origin.y);
+		boxRay.OriginZ = _mm_set1_ps(ray.Origin.z);
+		boxRay.InvDirXY = _mm_setr_ps(invX, invX, invY, invY);
+		boxRay.InvDirZ = _mm_set1_ps(invZ);
+		return boxRay;
+	}
+
+	// Tests both children of an interior node at once, one in each of the two low lanes.
+	// Returns a mask with bit 0 set when the left child is entered within [tMin, tMax] and bit 1 for
+	//  the right one; pOutNear receives the entry distances.
+	__forceinline int IntersectChildren(const BvhNode* pChildren, const BoxRay& ray, __m128 tMin, __m128 tMax, float* pOutNear) {
+		const __m128 leftMin = _mm_loadu_ps(&pChildren[0].BoundsMin.x);
+		const __m128 leftMax = _mm_loadu_ps(&pChildren[0].BoundsMax.x);
+		const __m128 rightMin = _mm_loadu_ps(&pChildren[1].BoundsMin.x);
+		const __m128 rightMax = _mm_loadu_ps(&pChildren[1].BoundsMax.x);
+
+		// Left and right interleaved per axis; the high half of the z terms holds index fields.
+		const __m128 t0XY = _mm_mul_ps(_mm_sub_ps(_mm_unpacklo_ps(leftMin, rightMin), ray.OriginXY), ray.InvDirXY);
+		const __m128 t1XY = _mm_mul_ps(_mm_sub_ps(_mm_unpacklo_ps(leftMax, rightMax), ray.OriginXY), ray.InvDirXY);
+		const __m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_unpackhi_ps(leftMin, rightMin), ray.OriginZ), ray.InvDirZ);
+		const __m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_unpackhi_ps(leftMax, rightMax), ray.OriginZ), ray.InvDirZ);
+
+		const __m128 nearXY = _mm_min_ps(t0XY, t1XY);
+		const __m128 farXY = _mm_max_ps(t0XY, t1XY);
+
+		const __m128 tNear = _mm_max_ps(_mm_max_ps(nearXY, _mm_movehl_ps(nearXY, nearXY)), _mm_max_ps(_mm_min_ps(t0Z, t1Z), tMin));
+		const __m128 tFar = _mm_min_ps(
+			_mm_mul_ps(_mm_min_ps(_mm_min_ps(farXY, _mm_movehl_ps(farXY, farXY)), _mm_max_ps(t0Z, t1Z)), _mm_set1_ps(FarScale)),
+			tMax);
+
+		_mm_storel_pi(reinterpret_cast<__m64*>(pOutNear), tNear);
+		return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & 3;
+	}
+
+	// The root has no sibling; it is tested as its own pair.
+	bool IntersectRoot(const BvhNode& root, const BoxRay& ray, __m128 tMin, __m128 tMax) {
+		const BvhNode pair[] = { root, root };
+		float nearT[2];
+		return IntersectChildren(pair, ray, tMin, tMax, nearT) != 0;
+	}
+
+	//
+	// Packets
+	//
+
+	__forceinline int LaneCount(int mask) {
+		return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+	}
+
+	__forceinline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Per lane: x where isX, else y where isY, else z.
+	__forceinline __m128 Permute(__m128 x, __m128 y, __m128 z, __m128 isX, __m128 isY) {
+		return Select(isX, x, Select(isY, y, z));
+	}
+
+	struct PacketRays {
+		__m128 OriginX, OriginY, OriginZ;
+		__m128 InvDirX, InvDirY, InvDirZ;
+		__m128 TMin;
+
+		__m128 Sx, Sy, Sz;
+		__m128 KxIsX, KxIsY;
+		__m128 KyIsX, KyIsY;
+		__m128 KzIsX, KzIsY;
+
+		TriangleRay Lanes[BvhTraversal::PacketSize];
+		float LaneTMin[BvhTraversal::PacketSize];
+		BvhTraversal::Cull Cull;
+	};
+
+	// Returns the lanes that become active.
+	int SetupPacket(const BvhRay* pRays, BvhTraversal::Cull cull, PacketRays& outPacket) {
+		alignas(16) float ox[4], oy[4], oz[4], ix[4], iy[4], iz[4], tMin[4];
+		alignas(16) float sx[4], sy[4], sz[4];
+		alignas(16) UINT kxX[4], kxY[4], kyX[4], kyY[4], kzX[4], kzY[4];
+
+		int activeMask = 0;
+		for (int lane = 0; lane < 4; ++lane) {
+			const BvhRay& ray = pRays[lane];
+			TriangleRay& triRay = outPacket.Lanes[lane];
+
+			const bool bActive = ray.TMax >= ray.TMin && SetupTriangleRay(ray, cull, triRay);
+			if (bActive) activeMask |= 1 << lane;
+			else triRay = { 0, 1, 2, 0.0f, 0.0f, 1.0f, { 0.0f, 0.0f, 0.0f }, cull };
+
+			ox[lane] = ray.Origin.x;
+			oy[lane] = ray.Origin.y;
+			oz[lane] = ray.Origin.z;
+			ix[lane] = SafeReciprocal(ray.Direction.x);
+			iy[lane] = SafeReciprocal(ray.Direction.y);
+			iz[lane] = SafeReciprocal(ray.Direction.z);
+			tMin[lane] = ray.TMin;
+			outPacket.LaneTMin[lane] = ray.TMin;
+
+			sx[lane] = triRay.Sx;
+			sy[lane] = triRay.Sy;
+			sz[lane] = triRay.Sz;
+			kxX[lane] = triRay.Kx == 0 ? 0xFFFFFFFF : 0;
+			kxY[lane] = triRay.Kx == 1 ? 0xFFFFFFFF : 0;
+			kyX[lane] = triRay.Ky == 0 ? 0xFFFFFFFF : 0;
+			kyY[lane] = triRay.Ky == 1 ? 0xFFFFFFFF : 0;
+			kzX[lane] = triRay.Kz == 0 ? 0xFFFFFFFF : 0;
+			kzY[lane] = triRay.Kz == 1 ? 0xFFFFFFFF : 0;
+		}
+
+		outPacket.OriginX = _mm_load_ps(ox);
+		outPacket.OriginY = _mm_load_ps(oy);
+		outPacket.OriginZ = _mm_load_ps(oz);
+		outPacket.InvDirX = _mm_load_ps(ix);
+		outPacket.InvDirY = _mm_load_ps(iy);
+		outPacket.InvDirZ = _mm_load_ps(iz);
+		outPacket.TMin = _mm_load_ps(tMin);
+		outPacket.Sx = _mm_load_ps(sx);
+		outPacket.Sy = _mm_load_ps(sy);
+		outPacket.Sz = _mm_load_ps(sz);
+		outPacket.KxIsX = _mm_load_ps(reinterpret_cast<const float*>(kxX));
+		outPacket.KxIsY = _mm_load_ps(reinterpret_cast<const float*>(kxY));
+		outPacket.KyIsX = _mm_load_ps(reinterpret_cast<const float*>(kyX));
+		outPacket.KyIsY = _mm_load_ps(reinterpret_cast<const float*>(kyY));
+		outPacket.KzIsX = _mm_load_ps(reinterpret_cast<const float*>(kzX));
+		outPacket.KzIsY = _mm_load_ps(reinterpret_cast<const float*>(kzY));
+		outPacket.Cull = cull;
+
+		return activeMask;
+	}
+
+	// Lanes of active whose rays enter the node's bounds before tMax; outNear receives the entry distances.
+	__forceinline __m128 IntersectBox4(const BvhNode& node, const PacketRays& packet, __m128 active, __m128 tMax, __m128& outNear) {
+		const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMin.x), packet.OriginX), packet.InvDirX);
+		const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMax.x), packet.OriginX), packet.InvDirX);
+		const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMin.y), packet.OriginY), packet.InvDirY);
+		const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMax.y), packet.OriginY), packet.InvDirY);
+		const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMin.z), packet.OriginZ), packet.InvDirZ);
+		const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMax.z), packet.OriginZ), packet.InvDirZ);
+
+		const __m128 tNear = _mm_max_ps(
+			_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)),
+			_mm_max_ps(_mm_min_ps(tz0, tz1), packet.TMin));
+		const __m128 tFar = _mm_min_ps(
+			_mm_mul_ps(_mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_max_ps(tz0, tz1)), _mm_set1_ps(FarScale)),
+			tMax);
+
+		outNear = tNear;
+		return _mm_and_ps(active, _mm_cmple_ps(tNear, tFar));
+	}
+
+	// Watertight test of one triangle against every active lane; returns the lanes hit in [TMin, tMax].
+	__forceinline __m128 IntersectTriangle4(
+			const PacketRays& packet, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2,
+			__m128 active, __m128 tMax, __m128& outT, __m128& outU, __m128& outV) {
+		const __m128 ax = _mm_sub_ps(_mm_set1_ps(p0.x), packet.OriginX);
+		const __m128 ay = _mm_sub_ps(_mm_set1_ps(p0.y), packet.OriginY);
+		const __m128 az = _mm_sub_ps(_mm_set1_ps(p0.z), packet.OriginZ);
+		const __m128 bx = _mm_sub_ps(_mm_set1_ps(p1.x), packet.OriginX);
+		const __m128 by = _mm_sub_ps(_mm_set1_ps(p1.y), packet.OriginY);
+		const __m128 bz = _mm_sub_ps(_mm_set1_ps(p1.z), packet.OriginZ);
+		const __m128 cx = _mm_sub_ps(_mm_set1_ps(p2.x), packet.OriginX);
+		const __m128 cy = _mm_sub_ps(_mm_set1_ps(p2.y), packet.OriginY);
+		const __m128 cz = _mm_sub_ps(_mm_set1_ps(p2.z), packet.OriginZ);
+
+		const __m128 aKz = Permute(ax, ay, az, packet.KzIsX, packet.KzIsY);
+		const __m128 bKz = Permute(bx, by, bz, packet.KzIsX, packet.KzIsY);
+		const __m128 cKz = Permute(cx, cy, cz, packet.KzIsX, packet.KzIsY);
+
+		const __m128 axs = _mm_sub_ps(Permute(ax, ay, az, packet.KxIsX, packet.KxIsY), _mm_mul_ps(packet.Sx, aKz));
+		const __m128 ays = _mm_sub_ps(Permute(ax, ay, az, packet.KyIsX, packet.KyIsY), _mm_mul_ps(packet.Sy, aKz));
+		const __m128 bxs = _mm_sub_ps(Permute(bx, by, bz, packet.KxIsX, packet.KxIsY), _mm_mul_ps(packet.Sx, bKz));
+		const __m128 bys = _mm_sub_ps(Permute(bx, by, bz, packet.KyIsX, packet.KyIsY), _mm_mul_ps(packet.Sy, bKz));
+		const __m128 cxs = _mm_sub_ps(Permute(cx, cy, cz, packet.KxIsX, packet.KxIsY), _mm_mul_ps(packet.Sx, cKz));
+		const __m128 cys = _mm_sub_ps(Permute(cx, cy, cz, packet.KyIsX, packet.KyIsY), _mm_mul_ps(packet.Sy, cKz));
+
+		const __m128 u = _mm_sub_ps(_mm_mul_ps(cxs, bys), _mm_mul_ps(cys, bxs));
+		const __m128 v = _mm_sub_ps(_mm_mul_ps(axs, cys), _mm_mul_ps(ays, cxs));
+		const __m128 w = _mm_sub_ps(_mm_mul_ps(bxs, ays), _mm_mul_ps(bys, axs));
+
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 onEdge = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(u, zero), _mm_cmpeq_ps(v, zero)), _mm_cmpeq_ps(w, zero));
+		const __m128 anyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+		const __m128 anyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+
+		const __m128 det = _mm_add_ps(_mm_add_ps(u, v), w);
+		const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+		const __m128 t = _mm_mul_ps(
+			_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(packet.Sz, aKz)), _mm_mul_ps(v, _mm_mul_ps(packet.Sz, bKz))),
+				_mm_mul_ps(w, _mm_mul_ps(packet.Sz, cKz))),
+			invDet);
+
+		__m128 hit = _mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), active);
+		hit = _mm_andnot_ps(onEdge, hit);
+		hit = _mm_and_ps(hit, _mm_cmpneq_ps(det, zero));
+		if (packet.Cull == BvhTraversal::ECullFrontFacing) hit = _mm_and_ps(hit, _mm_cmplt_ps(det, zero));
+		else if (packet.Cull == BvhTraversal::ECullBackFacing) hit = _mm_and_ps(hit, _mm_cmpgt_ps(det, zero));
+		hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(t, packet.TMin), _mm_cmple_ps(t, tMax)));
+
+		outT = t;
+		outU = _mm_mul_ps(v, invDet);
+		outV = _mm_mul_ps(w, invDet);
+
+		// Rays through an edge redo the test per lane with the double-precision fallback.
+		const int edgeLanes = _mm_movemask_ps(_mm_and_ps(onEdge, active));
+		if (edgeLanes != 0) {
+			alignas(16) float ts[4], us[4], vs[4], tMaxs[4];
+			alignas(16) UINT hits[4];
+			_mm_store_ps(ts, outT);
+			_mm_store_ps(us, outU);
+			_mm_store_ps(vs, outV);
+			_mm_store_ps(tMaxs, tMax);
+			_mm_store_ps(reinterpret_cast<float*>(hits), hit);
+
+			for (int lane = 0; lane < 4; ++lane) {
+				if ((edgeLanes & (1 << lane)) == 0) continue;
+				hits[lane] = IntersectTriangle(packet.Lanes[lane], p0, p1, p2, packet.LaneTMin[lane], tMaxs[lane], ts[lane], us[lane], vs[lane]) ? 0xFFFFFFFF : 0;
+			}
+
+			outT = _mm_load_ps(ts);
+			outU = _mm_load_ps(us);
+			outV = _mm_load_ps(vs);
+			hit = _mm_load_ps(reinterpret_cast<const float*>(hits));
+		}
+
+		return hit;
+	}
+
+	//
+	// Analytic primitives
+	//
+
+	__forceinline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) {
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	__forceinline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) {
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	__forceinline XMFLOAT3 MultiplyAdd(const XMFLOAT3& a, float s, const XMFLOAT3& b) {
+		return XMFLOAT3(a.x * s + b.x, a.y * s + b.y, a.z * s + b.z);
+	}
+
+	// Nearest crossing of a primitive's surface in [tMin, tMax].
+	// Roots are solved along the normalized direction and scaled back, and spheres use the form
+	//  of Haines et al. (Ray Tracing Gems, chapter 7) that stays accurate far from the center.
+	bool IntersectAnalytic(const AnalyticPrimitive& primitive, const BvhRay& ray, float tMin, float tMax, float& outT) {
+		const float length = std::sqrt(Dot(ray.Direction, ray.Direction));
+		if (length == 0.0f) return false;
+
+		const float invLength = 1.0f / length;
+		const XMFLOAT3 dir(ray.Direction.x * invLength, ray.Direction.y * invLength, ray.Direction.z * invLength);
+		const float lo = tMin * length;
+		const float hi = tMax * length;
+
+		float nearest = INFINITY;
+		auto consider = [&](float t) {
+			if (t >= lo && t <= hi && t < nearest) nearest = t;
+		};
+
+		// Both crossings of a sphere, each kept only where keep(t) holds.
+		auto sphereRoots = [&](const XMFLOAT3& center, auto keep) {
+			const XMFLOAT3 oc = Subtract(ray.Origin, center);
+			const float b = Dot(oc, dir);
+			const XMFLOAT3 q = MultiplyAdd(dir, -b, oc);
+			const float h = primitive.Radius * primitive.Radius - Dot(q, q);
+			if (h < 0.0f) return;
+
+			const float s = std::sqrt(h);
+			if (keep(-b - s)) consider(-b - s);
+			if (keep(-b + s)) consider(-b + s);
+		};
+
+		switch (primitive.Shape) {
+		case AnalyticPrimitive::ESphere:
+			sphereRoots(primitive.P0, [](float) { return true; });
+			break;
+		case AnalyticPrimitive::ECapsule: {
+			// The side, where a point projects inside the segment, and a cap beyond each end.
+			const XMFLOAT3 ba = Subtract(primitive.P1, primitive.P0);
+			const XMFLOAT3 oa = Subtract(ray.Origin, primitive.P0);
+			const float baba = Dot(ba, ba);
+			const float bard = Dot(ba, dir);
+			const float baoa = Dot(ba, oa);
+
+			const float a = baba - bard * bard;
+			if (a > 0.0f) {
+				const float b = baba * Dot(dir, oa) - baoa * bard;
+				const float c = baba * Dot(oa, oa) - baoa * baoa - primitive.Radius * primitive.Radius * baba;
+				const float h = b * b - a * c;
+				if (h >= 0.0f) {
+					const float s = std::sqrt(h);
+					for (const float t : { (-b - s) / a, (-b + s) / a }) {
+						const float y = baoa + t * bard;
+						if (y > 0.0f && y < baba) consider(t);
+					}
+				}
+			}
+
+			sphereRoots(primitive.P0, [&](float t) { return baoa + t * bard <= 0.0f; });
+			sphereRoots(primitive.P1, [&](float t) { return baoa + t * bard >= baba; });
+			break;
+		}
+		default: {
+			const float origin[] = { ray.Origin.x, ray.Origin.y, ray.Origin.z };
+			const float d[] = { dir.x, dir.y, dir.z };
+			const float boxMin[] = { primitive.P0.x, primitive.P0.y, primitive.P0.z };
+			const float boxMax[] = { primitive.P1.x, primitive.P1.y, primitive.P1.z };
+
+			float tNear = -INFINITY;
+			float tFar = INFINITY;
+			for (int axis = 0; axis < 3; ++axis) {
+				const float inv = SafeReciprocal(d[axis]);
+				const float t0 = (boxMin[axis] - origin[axis]) * inv;
+				const float t1 = (boxMax[axis] - origin[axis]) * inv;
+				tNear = std::max(tNear, std::min(t0, t1));
+				tFar = std::min(tFar, std::max(t0, t1));
+			}
+			if (tNear <= tFar) {
+				consider(tNear);
+				consider(tFar);
+			}
+			break;
+		}
+		}
+
+		if (nearest == INFINITY) return false;
+
+		outT = nearest * invLength;
+		return true;
+	}
+
+	//
+	// Eight-wide nodes
+	//
+
+	// Every level pushes all but one of its children.
+	const UINT WideStackSize = (WideBvhWidth - 1) * BvhMaxDepth + 1;
+
+	struct WideStackEntry {
+		// Node index, or first entry of WideBvh::TriangleIndices when TriangleCount is set.
+		UINT Index;
+		UINT TriangleCount;
+		float Near;
+	};
+
+	struct WideBoxRay {
+		float Origin[3];
+		float InvDir[3];
+	};
+
+	bool DetectAvx2() {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// AVX, and the OS saving the upper halves of the YMM registers.
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+
+	const bool bHasAvx2 = DetectAvx2();
+
+	// 2^exponent; the builder keeps exponents of normal floats.
+	__forceinline float ExponentScale(std::int8_t exponent) {
+		return std::bit_cast<float>(static_cast<std::uint32_t>(exponent + 127) << 23);
+	}
+
+	// Slots holding a child.
+	__forceinline int OccupiedSlots(const WideBvhNode& node) {
+		std::uint64_t counts;
+		std::memcpy(&counts, node.TriangleCounts, sizeof(counts));
+		const int emptyLeaves = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_cvtsi64_si128(static_cast<long long>(counts)), _mm_setzero_si128())) & 0xFF;
+		return node.InteriorMask | (~emptyLeaves & 0xFF);
+	}
+
+	// Tests the boxes of all eight slots at once; returns a mask of the ones entered within
+	//  [tMin, tMax], empty slots included, and their entry distances.
+	// Kept out of line so the 256-bit code ends in a vzeroupper before the SSE code around it.
+	int IntersectWideChildrenAvx2(const WideBvhNode& node, const WideBoxRay& ray, float tMin, float tMax, float* pOutNear) {
+		__m256 tNear = _mm256_set1_ps(tMin);
+		__m256 tFar = _mm256_set1_ps(INFINITY);
+
+		for (UINT axis = 0; axis < 3; ++axis) {
+			const __m256 scale = _mm256_set1_ps(ExponentScale(node.Exponent[axis]));
+			const __m256 origin = _mm256_set1_ps((&node.Origin.x)[axis]);
+			const __m256 rayOrigin = _mm256_set1_ps(ray.Origin[axis]);
+			const __m256 invDir = _mm256_set1_ps(ray.InvDir[axis]);
+
+			const __m256 qMin = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(node.QuantizedMin[axis]))));
+			const __m256 qMax = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(node.QuantizedMax[axis]))));
+
+			const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(qMin, scale), origin), rayOrigin), invDir);
+			const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(qMax, scale), origin), rayOrigin), invDir);
+
+			tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+			tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+		}
+		tFar = _mm256_min_ps(_mm256_mul_ps(tFar, _mm256_set1_ps(FarScale)), _mm256_set1_ps(tMax));
+
+		_mm256_storeu_ps(pOutNear, tNear);
+		return _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+	}
+
+	__forceinline __m128 LoadQuantized4(const std::uint8_t* pQuantized) {
+		int bytes;
+		std::memcpy(&bytes, pQuantized, sizeof(bytes));
+		const __m128i zero = _mm_setzero_si128();
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+	}
+
+	// Same test in two SSE2 halves.
+	__forceinline int IntersectWideChildrenSse(const WideBvhNode& node, const WideBoxRay& ray, float tMin, float tMax, float* pOutNear) {
+		int mask = 0;
+		for (UINT half = 0; half < 2; ++half) {
+			__m128 tNear = _mm_set1_ps(tMin);
+			__m128 tFar = _mm_set1_ps(INFINITY);
+
+			for (UINT axis = 0; axis < 3; ++axis) {
+				const __m128 scale = _mm_set1_ps(ExponentScale(node.Exponent[axis]));
+				const __m128 origin = _mm_set1_ps((&node.Origin.x)[axis]);
+				const __m128 rayOrigin = _mm_set1_ps(ray.Origin[axis]);
+				const __m128 invDir = _mm_set1_ps(ray.InvDir[axis]);
+
+				const __m128 qMin = LoadQuantized4(node.QuantizedMin[axis] + half * 4);
+				const __m128 qMax = LoadQuantized4(node.QuantizedMax[axis] + half * 4);
+
+				const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(qMin, scale), origin), rayOrigin), invDir);
+				const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(qMax, scale), origin), rayOrigin), invDir);
+
+				tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+				tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+			}
+			tFar = _mm_min_ps(_mm_mul_ps(tFar, _mm_set1_ps(FarScale)), _mm_set1_ps(tMax));
+
+			_mm_storeu_ps(pOutNear + half * 4, tNear);
+			mask |= _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) << (half * 4);
+		}
+		return mask;
+	}
+
+	template <bool bAvx2>
+	bool TraceWide(const WideBvh& bvh, const BvhRay& ray, BvhTraversal::Mode mode, BvhHit& outHit, BvhTraversal::Cull cull) {
+		TriangleRay triRay;
+		if (!SetupTriangleRay(ray, cull, triRay)) return false;
+
+		const WideBoxRay boxRay = {
+			{ ray.Origin.x, ray.Origin.y, ray.Origin.z },
+			{ SafeReciprocal(ray.Direction.x), SafeReciprocal(ray.Direction.y), SafeReciprocal(ray.Direction.z) } };
+
+		const WideBvhNode* nodes = bvh.Nodes.data();
+		const BvhMesh& mesh = bvh.Mesh;
+		const float tMin = ray.TMin;
+		float tMax = ray.TMax;
+
+		WideStackEntry stack[WideStackSize];
+		UINT stackSize = 0;
+
+		WideStackEntry entry = { 0, 0, tMin };
+		for (;;) {
+			if (entry.TriangleCount != 0) {
+				for (UINT i = 0; i < entry.TriangleCount; ++i) {
+					const UINT triangle = bvh.TriangleIndices[entry.Index + i];
+
+					UINT i0, i1, i2;
+					mesh.Triangle(triangle, i0, i1, i2);
+
+					float t, u, v;
+					if (!IntersectTriangle(triRay, mesh.Position(i0), mesh.Position(i1), mesh.Position(i2), tMin, tMax, t, u, v)) continue;
+
+					outHit.T = t;
+					outHit.U = u;
+					outHit.V = v;
+					outHit.Triangle = triangle;
+					if (mode == BvhTraversal::EAnyHit) return true;
+
+					tMax = t;
+				}
+			}
+			else {
+				const WideBvhNode& node = nodes[entry.Index];
+
+				float nearT[WideBvhWidth];
+				const int mask = OccupiedSlots(node) & (bAvx2 ?
+					IntersectWideChildrenAvx2(node, boxRay, tMin, tMax, nearT) :
+					IntersectWideChildrenSse(node, boxRay, tMin, tMax, nearT));
+
+				if (mask != 0) {
+					// Hit children sorted farthest first; all but the nearest are pushed.
+					WideStackEntry hits[WideBvhWidth];
+					UINT hitCount = 0;
+					UINT triangleOffset = 0;
+					for (UINT slot = 0; slot < WideBvhWidth; ++slot) {
+						const UINT bit = 1u << slot;
+
+						WideStackEntry child;
+						if (node.InteriorMask & bit) {
+							child = { node.ChildBase + std::popcount(static_cast<UINT>(node.InteriorMask & (bit - 1))), 0, nearT[slot] };
+						}
+						else {
+							child = { node.TriangleBase + triangleOffset, node.TriangleCounts[slot], nearT[slot] };
+							triangleOffset += node.TriangleCounts[slot];
+						}
+						if ((mask & bit) == 0) continue;
+
+						UINT j = hitCount++;
+						for (; j > 0 && hits[j - 1].Near < child.Near; --j)
+							hits[j] = hits[j - 1];
+						hits[j] = child;
+					}
+
+					for (UINT i = 0; i + 1 < hitCount; ++i)
+						stack[stackSize++] = hits[i];
+					entry = hits[hitCount - 1];
+					continue;
+				}
+			}
+
+			do {
+				if (stackSize == 0) return outHit.IsHit();
+				--stackSize;
+			} while (stack[stackSize].Near > tMax);
+			entry = stack[stackSize];
+		}
+	}
+
+	// Facing is decided in object space against the instance's winding, as in DXR.
+	BvhTraversal::Cull InstanceCull(BvhTraversal::Cull cull, UINT flags) {
+		if (cull == BvhTraversal::ECullNone || (flags & D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_CULL_DISABLE)) return BvhTraversal::ECullNone;
+		if ((flags & D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE) == 0) return cull;
+		return cull == BvhTraversal::ECullFrontFacing ? BvhTraversal::ECullBackFacing : BvhTraversal::ECullFrontFacing;
+	}
+
+	// Affine for points, linear for directions; t is preserved since directions are not normalized.
+	__forceinline XMFLOAT3 TransformPoint(const XMFLOAT3X4& m, const XMFLOAT3& p) {
+		return XMFLOAT3(
+			m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3],
+			m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3],
+			m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3]);
+	}
+
+	__forceinline XMFLOAT3 TransformDirection(const XMFLOAT3X4& m, const XMFLOAT3& d) {
+		return XMFLOAT3(
+			m.m[0][0] * d.x + m.m[0][1] * d.y + m.m[0][2] * d.z,
+			m.m[1][0] * d.x + m.m[1][1] * d.y + m.m[1][2] * d.z,
+			m.m[2][0] * d.x + m.m[2][1] * d.y + m.m[2][2] * d.z);
+	}
+
+	// Single-ray traversals; with bCount they also tally their work, which compiles away otherwise.
+	template <bool bCount>
+	bool TraceBinary(const Bvh& bvh, const BvhRay& ray, BvhTraversal::Mode mode, BvhHit& outHit, BvhTraversal::Cull cull, BvhTraceCounters& counters) {
+		outHit = BvhHit();
+		if (bvh.Nodes.empty() || !(ray.TMax >= ray.TMin)) return false;
+
+		TriangleRay triRay;
+		if (!SetupTriangleRay(ray, cull, triRay)) return false;
+
+		const BoxRay boxRay = SetupBoxRay(ray);
+
+		const BvhNode* nodes = bvh.Nodes.data();
+		const BvhMesh& mesh = bvh.Mesh;
+		const float tMin = ray.TMin;
+		float tMax = ray.TMax;
+
+		if (!IntersectRoot(nodes[0], boxRay, _mm_set1_ps(tMin), _mm_set1_ps(tMax))) return false;
+
+		UINT stack[BvhMaxDepth];
+		float stackNear[BvhMaxDepth];
+		UINT stackSize = 0;
+
+		UINT index = 0;
+		for (;;) {
+			const BvhNode& node = nodes[index];
+			if constexpr (bCount) ++counters.NodeCount;
+			if (node.IsLeaf()) {
+				for (UINT i = 0; i < node.TriangleCount; ++i) {
+					const UINT triangle = bvh.TriangleIndices[node.LeftFirst + i];
+
+					if constexpr (bCount) ++counters.TriangleCount;
+
+					UINT i0, i1, i2;
+					mesh.Triangle(triangle, i0, i1, i2);
+
+					float t, u, v;
+					if (!IntersectTriangle(triRay, mesh.Position(i0), mesh.Position(i1), mesh.Position(i2), tMin, tMax, t, u, v)) continue;
+
+					outHit.T = t;
+					outHit.U = u;
+					outHit.V = v;
+					outHit.Triangle = triangle;
+					if (mode == BvhTraversal::EAnyHit) return true;
+
+					tMax = t;
+				}
+			}
+			else {
+				float nearT[2];
+				const int mask = IntersectChildren(nodes + node.LeftFirst, boxRay, _mm_set1_ps(tMin), _mm_set1_ps(tMax), nearT);
+
+				if (mask == 3) {
+					const bool bLeftFirst = nearT[0] <= nearT[1];
+					stack[stackSize] = bLeftFirst ? node.LeftFirst + 1 : node.LeftFirst;
+					stackNear[stackSize] = bLeftFirst ? nearT[1] : nearT[0];
+					++stackSize;
+					index = bLeftFirst ? node.LeftFirst : node.LeftFirst + 1;
+					continue;
+				}
+				if (mask != 0) {
+					index = node.LeftFirst + (mask >> 1);
+					continue;
+				}
+			}
+
+			// Skips subtrees a closer hit has made unreachable since they were pushed.
+			do {
+				if (stackSize == 0) return outHit.IsHit();
+				--stackSize;
+			} while (stackNear[stackSize] > tMax);
+			index = stack[stackSize];
+		}
+	}
+
+	template <bool bCount>
+	bool TraceAnalytic(const AnalyticBvh& bvh, const BvhRay& ray, BvhTraversal::Mode mode, BvhHit& outHit, BvhTraceCounters& counters) {
+		outHit = BvhHit();
+		if (bvh.Nodes.empty() || !(ray.TMax >= ray.TMin)) return false;
+
+		const BoxRay boxRay = SetupBoxRay(ray);
+
+		const BvhNode* nodes = bvh.Nodes.data();
+		const float tMin = ray.TMin;
+		float tMax = ray.TMax;
+
+		if (!IntersectRoot(nodes[0], boxRay, _mm_set1_ps(tMin), _mm_set1_ps(tMax))) return false;
+
+		UINT stack[BvhMaxDepth];
+		float stackNear[BvhMaxDepth];
+		UINT stackSize = 0;
+
+		UINT index = 0;
+		for (;;) {
+			const BvhNode& node = nodes[index];
+			if constexpr (bCount) ++counters.NodeCount;
+			if (node.IsLeaf()) {
+				for (UINT i = 0; i < node.TriangleCount; ++i) {
+					const UINT primitive = bvh.PrimitiveIndices[node.LeftFirst + i];
+					if constexpr (bCount) ++counters.TriangleCount;
+
+					float t;
+					if (!IntersectAnalytic(bvh.Primitives[primitive], ray, tMin, tMax, t)) continue;
+
+					outHit.T = t;
+					outHit.Triangle = primitive;
+					if (mode == BvhTraversal::EAnyHit) return true;
+
+					tMax = t;
+				}
+			}
+			else {
+				float nearT[2];
+				const int mask = IntersectChildren(nodes + node.LeftFirst, boxRay, _mm_set1_ps(tMin), _mm_set1_ps(tMax), nearT);
+
+				if (mask == 3) {
+					const bool bLeftFirst = nearT[0] <= nearT[1];
+					stack[stackSize] = bLeftFirst ? node.LeftFirst + 1 : node.LeftFirst;
+					stackNear[stackSize] = bLeftFirst ? nearT[1] : nearT[0];
+					++stackSize;
+					index = bLeftFirst ? node.LeftFirst : node.LeftFirst + 1;
+					continue;
+				}
+				if (mask != 0) {
+					index = node.LeftFirst + (mask >> 1);
+					continue;
+				}
+			}
+
+			do {
+				if (stackSize == 0) return outHit.IsHit();
+				--stackSize;
+			} while (stackNear[stackSize] > tMax);
+			index = stack[stackSize];
+		}
+	}
+
+	template <bool bCount>
+	bool TraceTwoLevel(const TwoLevelBvh& tlas, const BvhRay& ray, BvhTraversal::Mode mode, BvhHit& outHit, BvhTraversal::Cull cull, UINT instanceMask, BvhTraceCounters& counters) {
+		outHit = BvhHit();
+		if (tlas.Nodes.empty() || !(ray.TMax >= ray.TMin)) return false;
+
+		const BoxRay boxRay = SetupBoxRay(ray);
+
+		const BvhNode* nodes = tlas.Nodes.data();
+		const float tMin = ray.TMin;
+		float tMax = ray.TMax;
+
+		if (!IntersectRoot(nodes[0], boxRay, _mm_set1_ps(tMin), _mm_set1_ps(tMax))) return false;
+
+		UINT stack[BvhMaxDepth];
+		float stackNear[BvhMaxDepth];
+		UINT stackSize = 0;
+
+		UINT index = 0;
+		for (;;) {
+			const BvhNode& node = nodes[index];
+			if constexpr (bCount) ++counters.NodeCount;
+			if (node.IsLeaf()) {
+				for (UINT i = 0; i < node.TriangleCount; ++i) {
+					const UINT instanceIndex = tlas.InstanceIndices[node.LeftFirst + i];
+					const BvhInstance& instance = tlas.Instances[instanceIndex];
+					if ((instance.Mask & instanceMask & 0xFF) == 0) continue;
+
+					const XMFLOAT3X4& worldToObject = tlas.WorldToObject[instanceIndex];
+
+					BvhRay objectRay;
+					objectRay.Origin = TransformPoint(worldToObject, ray.Origin);
+					objectRay.Direction = TransformDirection(worldToObject, ray.Direction);
+					objectRay.TMin = tMin;
+					objectRay.TMax = tMax;
+
+					if constexpr (bCount) ++counters.InstanceCount;
+
+					BvhHit hit;
+					const bool bHit = instance.Analytic ?
+						TraceAnalytic<bCount>(*tlas.AnalyticBlases[instance.Blas], objectRay, mode, hit, counters) :
+						TraceBinary<bCount>(*tlas.Blases[instance.Blas], objectRay, mode, hit, InstanceCull(cull, instance.Flags), counters);
+					if (!bHit) continue;
+
+					outHit = hit;
+					outHit.Instance = instanceIndex;
+					if (mode == BvhTraversal::EAnyHit) return true;
+
+					tMax = hit.T;
+				}
+			}
+			else {
+				float nearT[2];
+				const int mask = IntersectChildren(nodes + node.LeftFirst, boxRay, _mm_set1_ps(tMin), _mm_set1_ps(tMax), nearT);
+
+				if (mask == 3) {
+					const bool bLeftFirst = nearT[0] <= nearT[1];
+					stack[stackSize] = bLeftFirst ? node.LeftFirst + 1 : node.LeftFirst;
+					stackNear[stackSize] = bLeftFirst ? nearT[1] : nearT[0];
+					++stackSize;
+					index = bLeftFirst ? node.LeftFirst : node.LeftFirst + 1;
+					continue;
+				}
+				if (mask != 0) {
+					index = node.LeftFirst + (mask >> 1);
+					continue;
+				}
+			}
+
+			do {
+				if (stackSize == 0) return outHit.IsHit();
+				--stackSize;
+			} while (stackNear[stackSize] > tMax);
+			index = stack[stackSize];
+		}
+	}
+}
+
+bool BvhTraversal::Trace(const Bvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit, Cull cull) {
+	BvhTraceCounters unused;
+	return TraceBinary<false>(bvh, ray, mode, outHit, cull, unused);
+}
+
+bool BvhTraversal::Trace(const Bvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit, BvhTraceCounters& counters, Cull cull) {
+	return TraceBinary<true>(bvh, ray, mode, outHit, cull, counters);
+}
+
+bool BvhTraversal::Trace(const AnalyticBvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit) {
+	BvhTraceCounters unused;
+	return TraceAnalytic<false>(bvh, ray, mode, outHit, unused);
+}
+
+void BvhTraversal::TracePacket(const Bvh& bvh, const BvhRay* pRays, Mode mode, BvhHit* pOutHits, Cull cull) {
+	for (UINT lane = 0; lane < PacketSize; ++lane)
+		pOutHits[lane] = BvhHit();
+	if (bvh.Nodes.empty()) return;
+
+	PacketRays packet;
+	const int activeLanes = SetupPacket(pRays, cull, packet);
+	if (activeLanes == 0) return;
+
+	alignas(16) UINT activeBits[4];
+	alignas(16) float tMaxs[4];
+	for (int lane = 0; lane < 4; ++lane) {
+		activeBits[lane] = (activeLanes & (1 << lane)) ? 0xFFFFFFFF : 0;
+		tMaxs[lane] = pRays[lane].TMax;
+	}
+	__m128 active = _mm_load_ps(reinterpret_cast<const float*>(activeBits));
+	__m128 tMax = _mm_load_ps(tMaxs);
+
+	__m128 hitT = _mm_set1_ps(FLT_MAX);
+	__m128 hitU = _mm_setzero_ps();
+	__m128 hitV = _mm_setzero_ps();
+	__m128i hitTriangle = _mm_set1_epi32(-1);
+
+	const BvhNode* nodes = bvh.Nodes.data();
+	const BvhMesh& mesh = bvh.Mesh;
+
+	__m128 rootNear;
+	if (_mm_movemask_ps(IntersectBox4(nodes[0], packet, active, tMax, rootNear)) == 0) return;
+
+	UINT stack[BvhMaxDepth];
+	__m128 stackNear[BvhMaxDepth];
+	UINT stackSize = 0;
+
+	UINT index = 0;
+	for (;;) {
+		const BvhNode& node = nodes[index];
+		if (node.IsLeaf()) {
+			for (UINT i = 0; i < node.TriangleCount; ++i) {
+				const UINT triangle = bvh.TriangleIndices[node.LeftFirst + i];
+
+				UINT i0, i1, i2;
+				mesh.Triangle(triangle, i0, i1, i2);
+
+				__m128 t, u, v;
+				const __m128 hit = IntersectTriangle4(packet, mesh.Position(i0), mesh.Position(i1), mesh.Position(i2), active, tMax, t, u, v);
+				if (_mm_movemask_ps(hit) == 0) continue;
+
+				hitT = Select(hit, t, hitT);
+				hitU = Select(hit, u, hitU);
+				hitV = Select(hit, v, hitV);
+				hitTriangle = _mm_castps_si128(Select(hit, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(triangle))), _mm_castsi128_ps(hitTriangle)));
+
+				if (mode == EAnyHit) {
+					active = _mm_andnot_ps(hit, active);
+					if (_mm_movemask_ps(active) == 0) break;
+				}
+				else {
+					tMax = Select(hit, t, tMax);
+				}
+			}
+			if (_mm_movemask_ps(active) == 0) break;
+		}
+		else {
+			__m128 nearLeft, nearRight;
+			const __m128 hitLeft = IntersectBox4(nodes[node.LeftFirst], packet, active, tMax, nearLeft);
+			const __m128 hitRight = IntersectBox4(nodes[node.LeftFirst + 1], packet, active, tMax, nearRight);
+			const int maskLeft = _mm_movemask_ps(hitLeft);
+			const int maskRight = _mm_movemask_ps(hitRight);
+
+			if (maskLeft != 0 && maskRight != 0) {
+				// Visits first the child that is nearer for most of the rays entering both.
+				const __m128 both = _mm_and_ps(hitLeft, hitRight);
+				const int leftNearer = _mm_movemask_ps(_mm_and_ps(both, _mm_cmple_ps(nearLeft, nearRight)));
+				const int rightNearer = _mm_movemask_ps(_mm_and_ps(both, _mm_cmplt_ps(nearRight, nearLeft)));
+				const bool bLeftFirst = LaneCount(leftNearer) >= LaneCount(rightNearer);
+
+				// Lanes that miss the pushed child never pass the check when it is popped.
+				const __m128 missNear = _mm_set1_ps(INFINITY);
+				stack[stackSize] = bLeftFirst ? node.LeftFirst + 1 : node.LeftFirst;
+				stackNear[stackSize] = bLeftFirst ? Select(hitRight, nearRight, missNear) : Select(hitLeft, nearLeft, missNear);
+				++stackSize;
+				index = bLeftFirst ? node.LeftFirst : node.LeftFirst + 1;
+				continue;
+			}
+			if (maskLeft != 0) {
+				index = node.LeftFirst;
+				continue;
+			}
+			if (maskRight != 0) {
+				index = node.LeftFirst + 1;
+				continue;
+			}
+		}
+
+		bool bFound = false;
+		while (stackSize > 0) {
+			--stackSize;
+			if (_mm_movemask_ps(_mm_and_ps(active, _mm_cmple_ps(stackNear[stackSize], tMax))) != 0) {
+				bFound = true;
+				break;
+			}
+		}
+		if (!bFound) break;
+		index = stack[stackSize];
+	}
+
+	alignas(16) float ts[4], us[4], vs[4];
+	alignas(16) UINT triangles[4];
+	_mm_store_ps(ts, hitT);
+	_mm_store_ps(us, hitU);
+	_mm_store_ps(vs, hitV);
+	_mm_store_si128(reinterpret_cast<__m128i*>(triangles), hitTriangle);
+
+	for (UINT lane = 0; lane < PacketSize; ++lane) {
+		if (triangles[lane] == BvhHit::Miss) continue;
+
+		pOutHits[lane].T = ts[lane];
+		pOutHits[lane].U = us[lane];
+		pOutHits[lane].V = vs[lane];
+		pOutHits[lane].Triangle = triangles[lane];
+	}
+}
+
+void BvhTraversal::TraceStream(const Bvh& bvh, const BvhRay* pRays, size_t count, Mode mode, bool bPackets, BvhHit* pOutHits, Cull cull) {
+	if (!bPackets) {
+		for (size_t i = 0; i < count; ++i)
+			Trace(bvh, pRays[i], mode, pOutHits[i], cull);
+		return;
+	}
+
+	size_t i = 0;
+	for (; i + PacketSize <= count; i += PacketSize)
+		TracePacket(bvh, pRays + i, mode, pOutHits + i, cull);
+
+	if (i == count) return;
+
+	// Pads the last packet with inactive rays.
+	BvhRay rays[PacketSize];
+	BvhHit hits[PacketSize];
+	for (UINT lane = 0; lane < PacketSize; ++lane) {
+		if (i + lane < count) {
+			rays[lane] = pRays[i + lane];
+		}
+		else {
+			rays[lane] = BvhRay();
+			rays[lane].Direction = { 0.0f, 0.0f, 1.0f };
+			rays[lane].TMin = 1.0f;
+			rays[lane].TMax = 0.0f;
+		}
+	}
+
+	TracePacket(bvh, rays, mode, hits, cull);
+
+	for (size_t lane = 0; i + lane < count; ++lane)
+		pOutHits[i + lane] = hits[lane];
+}
+
+bool BvhTraversal::Trace(const TwoLevelBvh& tlas, const BvhRay& ray, Mode mode, BvhHit& outHit, Cull cull, UINT instanceMask) {
+	BvhTraceCounters unused;
+	return TraceTwoLevel<false>(tlas, ray, mode, outHit, cull, instanceMask, unused);
+}
+
+bool BvhTraversal::Trace(const TwoLevelBvh& tlas, const BvhRay& ray, Mode mode, BvhHit& outHit, BvhTraceCounters& counters, Cull cull, UINT instanceMask) {
+	return TraceTwoLevel<true>(tlas, ray, mode, outHit, cull, instanceMask, counters);
+}
+
+bool BvhTraversal::Trace(const WideBvh& bvh, const BvhRay& ray, Mode mode, BvhHit& outHit, Cull cull) {
+	outHit = BvhHit();
+	if (bvh.Nodes.empty() || !(ray.TMax >= ray.TMin)) return false;
+
+	return bHasAvx2 ? TraceWide<true>(bvh, ray, mode, outHit, cull) : TraceWide<false>(bvh, ray, mode, outHit, cull);
+}
+
+void BvhTraversal::TraceStream(const WideBvh& bvh, const BvhRay* pRays, size_t count, Mode mode, BvhHit* pOutHits, Cull cull) {
+	for (size_t i = 0; i < count; ++i)
+		Trace(bvh, pRays[i], mode, pOutHits[i], cull);
+}
+
+bool BvhTraversal::HasAvx2() {
+	return bHasAvx2;
+}
+
+namespace {
+	// Ray counts per second in millions of a parallel trace over all rays, in packet-sized chunks;
+	//  traceChunk(pRays, count, pOutHits) traces one chunk.
+	template <typename TraceChunk>
+	double TimeChunkedTrace(const std::vector<BvhRay>& rays, std::vector<BvhHit>& outHits, const TraceChunk& traceChunk) {
+		outHits.resize(rays.size());
+
+		const size_t chunkSize = 256;
+		const size_t chunkCount = (rays.size() + chunkSize - 1) / chunkSize;
+
+		Stopwatch timer;
+		Parallel::ForRange(chunkCount, 4, [&](size_t begin, size_t end) {
+			const size_t first = begin * chunkSize;
+			const size_t last = std::min(end * chunkSize, rays.size());
+			traceChunk(rays.data() + first, last - first, outHits.data() + first);
+		});
+		const double elapsedMs = timer.ElapsedMilliseconds();
+
+		return elapsedMs > 0.0 ? rays.size() / (elapsedMs * 1000.0) : 0.0;
+	}
+
+	double TimeRayTrace(const Bvh& bvh, const std::vector<BvhRay>& rays, BvhTraversal::Mode mode, bool bPackets, std::vector<BvhHit>& outHits) {
+		return TimeChunkedTrace(rays, outHits, [&](const BvhRay* pRays, size_t count, BvhHit* pOutHits) {
+			BvhTraversal::TraceStream(bvh, pRays, count, mode, bPackets, pOutHits);
+		});
+	}
+
+	double TimeRayTrace(const WideBvh& bvh, const std::vector<BvhRay>& rays, BvhTraversal::Mode mode, std::vector<BvhHit>& outHits) {
+		return TimeChunkedTrace(rays, outHits, [&](const BvhRay* pRays, size_t count, BvhHit* pOutHits) {
+			BvhTraversal::TraceStream(bvh, pRays, count, mode, pOutHits);
+		});
+	}
+
+	UINT CountHits(const std::vector<BvhHit>& hits) {
+		UINT count = 0;
+		for (const auto& hit : hits)
+			if (hit.IsHit()) ++count;
+		return count;
+	}
+
+	// Closest hits of the packet or wide kernel that differ from the single-ray kernel's.
+	UINT CountMismatches(const std::vector<BvhHit>& a, const std::vector<BvhHit>& b) {
+		UINT count = 0;
+		for (size_t i = 0, end = a.size(); i < end; ++i)
+			if (a[i].Triangle != b[i].Triangle || a[i].T != b[i].T) ++count;
+		return count;
+	}
+}
+
+bool BvhTraversal::RunBenchmark(const std::string& name, const Bvh& bvh, UINT width, UINT height, UINT aoSampleCount, float aoRadius) {
+	if (bvh.Nodes.empty()) return true;
+
+	WideBvh wideBvh;
+	WideBvhStats wideStats;
+	CheckIsValid(WideBvhBuilder::Collapse(bvh, wideBvh, &wideStats));
+
+	const BvhNode& root = bvh.Nodes[0];
+	const XMVECTOR boundsMin = XMLoadFloat3(&root.BoundsMin);
+	const XMVECTOR boundsMax = XMLoadFloat3(&root.BoundsMax);
+	const XMVECTOR center = 0.5f * (boundsMin + boundsMax);
+	const float radius = 0.5f * XMVectorGetX(XMVector3Length(boundsMax - boundsMin));
+
+	const XMVECTOR eye = center + radius * XMVectorSet(0.3f, 0.4f, -1.6f, 0.0f);
+	const XMVECTOR forward = XMVector3Normalize(center - eye);
+	const XMVECTOR right = XMVector3Normalize(XMVector3Cross(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), forward));
+	const XMVECTOR up = XMVector3Cross(forward, right);
+	const float tanHalfFovY = std::tan(0.25f * XM_PI * 0.5f);
+	const float aspect = static_cast<float>(width) / static_cast<float>(height);
+
+	const UINT quadCountX = width / 2;
+	const UINT quadCountY = height / 2;
+
+	std::vector<BvhRay> primaryRays;
+	primaryRays.reserve(static_cast<size_t>(quadCountX) * quadCountY * 4);
+	for (UINT qy = 0; qy < quadCountY; ++qy) {
+		for (UINT qx = 0; qx < quadCountX; ++qx) {
+			for (UINT i = 0; i < 4; ++i) {
+				const float px = static_cast<float>(qx * 2 + (i & 1)) + 0.5f;
+				const float py = static_cast<float>(qy * 2 + (i >> 1)) + 0.5f;
+				const float sx = (2.0f * px / width - 1.0f) * tanHalfFovY * aspect;
+				const float sy = (1.0f - 2.0f * py / height) * tanHalfFovY;
+
+				BvhRay ray;
+				XMStoreFloat3(&ray.Origin, eye);
+				XMStoreFloat3(&ray.Direction, forward + sx * right + sy * up);
+				primaryRays.push_back(ray);
+			}
+		}
+	}
+
+	std::vector<BvhHit> primaryHits;
+	std::vector<BvhHit> packetHits;
+	std::vector<BvhHit> anyHits;
+	const double primarySingle = TimeRayTrace(bvh, primaryRays, EClosestHit, false, primaryHits);
+	const double primaryPacket = TimeRayTrace(bvh, primaryRays, EClosestHit, true, packetHits);
+	const double primaryAnySingle = TimeRayTrace(bvh, primaryRays, EAnyHit, false, anyHits);
+	const double primaryAnyPacket = TimeRayTrace(bvh, primaryRays, EAnyHit, true, anyHits);
+	UINT mismatchCount = CountMismatches(primaryHits, packetHits);
+
+	std::vector<BvhHit> wideHits;
+	const double primaryWide = TimeRayTrace(wideBvh, primaryRays, EClosestHit, wideHits);
+	UINT wideMismatchCount = CountMismatches(primaryHits, wideHits);
+	const double primaryAnyWide = TimeRayTrace(wideBvh, primaryRays, EAnyHit, anyHits);
+
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<BvhRay> aoRays;
+	aoRays.reserve(static_cast<size_t>(CountHits(primaryHits)) * aoSampleCount);
+	for (size_t i = 0, end = primaryRays.size(); i < end; ++i) {
+		const BvhHit& hit = primaryHits[i];
+		if (!hit.IsHit()) continue;
+
+		UINT i0, i1, i2;
+		bvh.Mesh.Triangle(hit.Triangle, i0, i1, i2);
+		const XMVECTOR p0 = XMLoadFloat3(&bvh.Mesh.Position(i0));
+		const XMVECTOR p1 = XMLoadFloat3(&bvh.Mesh.Position(i1));
+		const XMVECTOR p2 = XMLoadFloat3(&bvh.Mesh.Position(i2));
+
+		const XMVECTOR dir = XMLoadFloat3(&primaryRays[i].Direction);
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+		if (XMVectorGetX(XMVector3Dot(normal, dir)) > 0.0f) normal = -normal;
+
+		const XMVECTOR tangent = XMVector3Normalize(XMVector3Orthogonal(normal));
+		const XMVECTOR bitangent = XMVector3Cross(normal, tangent);
+		const XMVECTOR position = XMLoadFloat3(&primaryRays[i].Origin) + hit.T * dir + (1.0e-4f * radius) * normal;
+
+		for (UINT s = 0; s < aoSampleCount; ++s) {
+			const float r = std::sqrt(unit(generator));
+			const float phi = 2.0f * XM_PI * unit(generator);
+			const float z = std::sqrt(std::max(0.0f, 1.0f - r * r));
+
+			BvhRay ray;
+			XMStoreFloat3(&ray.Origin, position);
+			XMStoreFloat3(&ray.Direction, r * std::cos(phi) * tangent + r * std::sin(phi) * bitangent + z * normal);
+			ray.TMax = aoRadius * radius;
+			aoRays.push_back(ray);
+		}
+	}
+
+	std::vector<BvhHit> aoHits;
+	const double aoSingle = TimeRayTrace(bvh, aoRays, EClosestHit, false, aoHits);
+	const double aoPacket = TimeRayTrace(bvh, aoRays, EClosestHit, true, packetHits);
+	mismatchCount += CountMismatches(aoHits, packetHits);
+	const double aoAnySingle = TimeRayTrace(bvh, aoRays, EAnyHit, false, anyHits);
+	const double aoAnyPacket = TimeRayTrace(bvh, aoRays, EAnyHit, true, anyHits);
+	const double aoWide = TimeRayTrace(wideBvh, aoRays, EClosestHit, wideHits);
+	wideMismatchCount += CountMismatches(aoHits, wideHits);
+	const double aoAnyWide = TimeRayTrace(wideBvh, aoRays, EAnyHit, anyHits);
+
+	Logln("Ray traversal benchmark ", name, ": ", std::to_string(bvh.Mesh.TriangleCount()), " triangles, ",
+		std::to_string(Parallel::WorkerCount()), " threads, Mrays/s single/packet/8-wide (",
+		HasAvx2() ? "AVX2" : "SSE2", ")");
+	Logln("    memory: binary ", std::to_string(bvh.Nodes.size()), " nodes, ", std::to_string(WideBvhBuilder::CalcMemoryBytes(bvh) >> 10),
+		" KB; 8-wide ", std::to_string(wideStats.NodeCount), " nodes (", std::to_string(wideStats.AverageChildCount),
+		" children avg), ", std::to_string(wideStats.MemoryBytes >> 10), " KB, collapsed in ",
+		std::to_string(wideStats.CollapseMilliseconds), " ms");
+	Logln("    primary (", std::to_string(primaryRays.size()), " rays, ", std::to_string(CountHits(primaryHits)),
+		" hits): closest ", std::to_string(primarySingle), "/", std::to_string(primaryPacket), "/", std::to_string(primaryWide),
+		", any ", std::to_string(primaryAnySingle), "/", std::to_string(primaryAnyPacket), "/", std::to_string(primaryAnyWide));
+	Logln("    AO (", std::to_string(aoRays.size()), " rays, ", std::to_string(CountHits(aoHits)),
+		" occluded): closest ", std::to_string(aoSingle), "/", std::to_string(aoPacket), "/", std::to_string(aoWide),
+		", any ", std::to_string(aoAnySingle), "/", std::to_string(aoAnyPacket), "/", std::to_string(aoAnyWide));
+	if (mismatchCount != 0)
+		Logln("    ", std::to_string(mismatchCount), " packet closest hits differ from single-ray ones");
+	if (wideMismatchCount != 0)
+		Logln("    ", std::to_string(wideMismatchCount), " 8-wide closest hits differ from single-ray ones");
+
+	return true;
+}
@@ -29,12 +29,12 @@ bool DxrShadowClass::CompileShaders(const std::wstring& filePath) {
 	return true;
 }
 
-bool DxrShadowClass::BuildRootSignatures(const StaticSamplers& samplers, UINT geometryBufferCount) {
+bool DxrShadowClass::BuildRootSignatures(const StaticSamplers& samplers) {
 	CD3DX12_ROOT_PARAMETER slotRootParameter[DxrShadow::RootSignatureLayout::Count];
 
 	CD3DX12_DESCRIPTOR_RANGE texTables[4];
-	texTables[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, geometryBufferCount, 0, 1);
-	texTables[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, geometryBufferCount, 0, 2);
+	texTables[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 1);
+	texTables[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 2);
 	texTables[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3, 0);
 	texTables[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0);
 
@@ -3,11 +3,237 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "Logger.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
 
 using namespace DirectX;
 
+namespace
+{
+	// Triangles or edges per task in the parallel subdivision passes.
+	const size_t SubdivideGrain = 4096;
+
+	// Undirected edge key: both triangles sharing an edge produce the same value.
+	inline std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+	{
+		return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a;
+	}
+
+	// Vertices or indices per task in the parallel streaming generators.
+	const size_t GenerateGrain = 4096;
+
+	const GeometryGenerator::VertexLayout MeshDataLayout =
+	{
+		(std::uint32_t)sizeof(GeometryGenerator::Vertex),
+		(int)offsetof(GeometryGenerator::Vertex, Position),
+		(int)offsetof(GeometryGenerator::Vertex, Normal),
+		(int)offsetof(GeometryGenerator::Vertex, TangentU),
+		(int)offsetof(GeometryGenerator::Vertex, TexC),
+		-1
+	};
+
+	// Backs the MeshData overloads with the streaming generators.
+	class MeshDataSink : public GeometryGenerator::MeshSink
+	{
+	public:
+		explicit MeshDataSink(GeometryGenerator::MeshData& meshData) : mMeshData(meshData) {}
+
+		const GeometryGenerator::VertexLayout& Layout() const override { return MeshDataLayout; }
+
+		bool Allocate(std::uint32_t vertexCount, std::uint32_t indexCount, void*& outVertices, void*& outIndices, bool& bOutIndices16) override
+		{
+			mMeshData.Vertices.resize(vertexCount);
+			mMeshData.Indices32.resize(indexCount);
+
+			outVertices = mMeshData.Vertices.data();
+			outIndices = mMeshData.Indices32.data();
+			bOutIndices16 = false;
+
+			return true;
+		}
+
+	private:
+		GeometryGenerator::MeshData& mMeshData;
+	};
+
+	template <typename T>
+	inline void StoreAttribute(std::uint8_t* vertex, int offset, const T& value)
+	{
+		if(offset >= 0)
+			std::memcpy(vertex + offset, &value, sizeof(T));
+	}
+
+	inline void StoreVertex(
+		void* vertices, const GeometryGenerator::VertexLayout& layout, size_t index,
+		const XMFLOAT3& position, const XMFLOAT3& normal, const XMFLOAT3& tangentU, const XMFLOAT2& texC)
+	{
+		std::uint8_t* vertex = (std::uint8_t*)vertices + index*layout.Stride;
+		StoreAttribute(vertex, layout.PositionOffset, position);
+		StoreAttribute(vertex, layout.NormalOffset, normal);
+		StoreAttribute(vertex, layout.TangentUOffset, tangentU);
+		StoreAttribute(vertex, layout.TexCOffset, texC);
+		StoreAttribute(vertex, layout.TangentSignOffset, 1.0f);
+	}
+
+	template <typename Index>
+	void StoreSphereIndices(Index* indices, std::uint32_t sliceCount, std::uint32_t stackCount, std::uint32_t vertexCount)
+	{
+		//
+		// Compute indices for top stack.  The top stack was written first to the vertex buffer
+		// and connects the top pole to the first ring.
+		//
+
+		for(std::uint32_t i = 1; i <= sliceCount; ++i)
+		{
+			Index* tri = indices + (i-1)*3;
+			tri[0] = (Index)0;
+			tri[1] = (Index)(i+1);
+			tri[2] = (Index)i;
+		}
+
+		//
+		// Compute indices for inner stacks (not connected to poles).
+		//
+
+		// Offset the indices to the index of the first vertex in the first ring.
+		// This is just skipping the top pole vertex.
+		const std::uint32_t baseIndex = 1;
+		const std::uint32_t ringVertexCount = sliceCount + 1;
+		Index* inner = indices + sliceCount*3;
+
+		const size_t stackGrain = std::max<size_t>(1, GenerateGrain/(sliceCount*6));
+		Parallel::ForRange(stackCount-2, stackGrain, [&](size_t begin, size_t end)
+		{
+			for(std::uint32_t i = (std::uint32_t)begin; i < (std::uint32_t)end; ++i)
+			{
+				Index* quad = inner + (size_t)i*sliceCount*6;
+				for(std::uint32_t j = 0; j < sliceCount; ++j, quad += 6)
+				{
+					quad[0] = (Index)(baseIndex + i*ringVertexCount + j);
+					quad[1] = (Index)(baseIndex + i*ringVertexCount + j+1);
+					quad[2] = (Index)(baseIndex + (i+1)*ringVertexCount + j);
+
+					quad[3] = (Index)(baseIndex + (i+1)*ringVertexCount + j);
+					quad[4] = (Index)(baseIndex + i*ringVertexCount + j+1);
+					quad[5] = (Index)(baseIndex + (i+1)*ringVertexCount + j+1);
+				}
+			}
+		});
+
+		//
+		// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+		// and connects the bottom pole to the bottom ring.
+		//
+
+		// South pole vertex was added last.
+		const std::uint32_t southPoleIndex = vertexCount-1;
+
+		// Offset the indices to the index of the first vertex in the last ring.
+		const std::uint32_t bottomBaseIndex = southPoleIndex - ringVertexCount;
+		Index* bottom = inner + (size_t)(stackCount-2)*sliceCount*6;
+
+		for(std::uint32_t i = 0; i < sliceCount; ++i)
+		{
+			Index* tri = bottom + i*3;
+			tri[0] = (Index)southPoleIndex;
+			tri[1] = (Index)(bottomBaseIndex+i);
+			tri[2] = (Index)(bottomBaseIndex+i+1);
+		}
+	}
+
+	template <typename Index>
+	void StoreGridIndices(Index* indices, std::uint32_t m, std::uint32_t n)
+	{
+		// Iterate over each quad and compute indices.
+		const size_t rowGrain = std::max<size_t>(1, GenerateGrain/((n-1)*6));
+		Parallel::ForRange(m-1, rowGrain, [&](size_t begin, size_t end)
+		{
+			for(std::uint32_t i = (std::uint32_t)begin; i < (std::uint32_t)end; ++i)
+			{
+				Index* quad = indices + (size_t)i*(n-1)*6;
+				for(std::uint32_t j = 0; j < n-1; ++j, quad += 6)
+				{
+					quad[0] = (Index)(i*n+j);
+					quad[1] = (Index)(i*n+j+1);
+					quad[2] = (Index)((i+1)*n+j);
+
+					quad[3] = (Index)((i+1)*n+j);
+					quad[4] = (Index)(i*n+j+1);
+					quad[5] = (Index)((i+1)*n+j+1);
+				}
+			}
+		});
+	}
+
+	// Writes a finished MeshData out through a sink, for the shapes built by subdividing in place.
+	bool StoreMeshData(const GeometryGenerator::MeshData& meshData, GeometryGenerator::MeshSink& sink)
+	{
+		void* vertices = nullptr;
+		void* indices = nullptr;
+		bool bIndices16 = false;
+		if(!sink.Allocate((std::uint32_t)meshData.Vertices.size(), (std::uint32_t)meshData.Indices32.size(), vertices, indices, bIndices16))
+			return false;
+
+		const GeometryGenerator::VertexLayout& layout = sink.Layout();
+		for(size_t i = 0; i < meshData.Vertices.size(); ++i)
+		{
+			const GeometryGenerator::Vertex& v = meshData.Vertices[i];
+			StoreVertex(vertices, layout, i, v.Position, v.Normal, v.TangentU, v.TexC);
+		}
+
+		if(bIndices16)
+		{
+			for(size_t i = 0; i < meshData.Indices32.size(); ++i)
+				((std::uint16_t*)indices)[i] = (std::uint16_t)meshData.Indices32[i];
+		}
+		else
+		{
+			std::memcpy(indices, meshData.Indices32.data(), meshData.Indices32.size()*sizeof(std::uint32_t));
+		}
+
+		return true;
+	}
+
+	// Byte buffers in a caller's layout with 32-bit indices; stands in for a CPU blob.
+	class ByteMeshSink : public GeometryGenerator::MeshSink
+	{
+	public:
+		explicit ByteMeshSink(const GeometryGenerator::VertexLayout& layout) : mLayout(layout) {}
+
+		const GeometryGenerator::VertexLayout& Layout() const override { return mLayout; }
+
+		bool Allocate(std::uint32_t vertexCount, std::uint32_t indexCount, void*& outVertices, void*& outIndices, bool& bOutIndices16) override
+		{
+			Vertices.resize((size_t)vertexCount*mLayout.Stride);
+			Indices.resize(indexCount);
+
+			outVertices = Vertices.data();
+			outIndices = Indices.data();
+			bOutIndices16 = false;
+
+			return true;
+		}
+
+		std::uint64_t ByteSize() const { return Vertices.size() + Indices.size()*sizeof(std::uint32_t); }
+
+	public:
+		std::vector<std::uint8_t> Vertices;
+		std::vector<std::uint32_t> Indices;
+
+	private:
+		const GeometryGenerator::VertexLayout& mLayout;
+	};
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -93,7 +319,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	meshData.Indices32.assign(&i[0], &i[36]);
 
     // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+    numSubdivisions = std::min<uint32>(numSubdivisions, MaxSubdivisions);
 
     for(uint32 i = 0; i < numSubdivisions; ++i)
         Subdivide(meshData);
@@ -101,10 +327,42 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
     return meshData;
 }
 
+bool GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, MeshSink& sink)
+{
+	return StoreMeshData(CreateBox(width, height, depth, numSubdivisions), sink);
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
 
+	MeshDataSink sink(meshData);
+	const bool bGenerated = CreateSphere(radius, sliceCount, stackCount, sink);
+	assert(bGenerated && "CreateSphere needs at least 3 slices and 2 stacks");
+	(void)bGenerated;
+
+    return meshData;
+}
+
+bool GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshSink& sink)
+{
+	if(sliceCount < 3 || stackCount < 2)
+		return false;
+
+	// Poles plus one ring per stack boundary; the first and last vertex of a ring coincide
+	// so the texture seam gets its own coordinates.
+	const uint32 ringVertexCount = sliceCount + 1;
+	const uint32 vertexCount = 2 + (stackCount-1)*ringVertexCount;
+	const uint32 indexCount = sliceCount*6 + (stackCount-2)*sliceCount*6;
+
+	void* vertices = nullptr;
+	void* indices = nullptr;
+	bool bIndices16 = false;
+	if(!sink.Allocate(vertexCount, indexCount, vertices, indices, bIndices16))
+		return false;
+
+	const VertexLayout& layout = sink.Layout();
+
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
 	//
@@ -112,115 +370,57 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Poles: note that there will be texture coordinate distortion as there is
 	// not a unique point on the texture map to assign to the pole when mapping
 	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-
-	meshData.Vertices.push_back( topVertex );
+	StoreVertex(vertices, layout, 0,
+		XMFLOAT3(0.0f, +radius, 0.0f), XMFLOAT3(0.0f, +1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f));
+	StoreVertex(vertices, layout, vertexCount-1,
+		XMFLOAT3(0.0f, -radius, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 1.0f));
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
+	const size_t ringGrain = std::max<size_t>(1, GenerateGrain/ringVertexCount);
+	Parallel::ForRange(stackCount-1, ringGrain, [&](size_t begin, size_t end)
 	{
-		float phi = i*phiStep;
-
-		// Vertices of ring.
-        for(uint32 j = 0; j <= sliceCount; ++j)
+		for(uint32 i = (uint32)begin + 1; i <= (uint32)end; ++i)
 		{
-			float theta = j*thetaStep;
+			float phi = i*phiStep;
 
-			Vertex v;
+			// Vertices of ring.
+			for(uint32 j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j*thetaStep;
 
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+				// spherical to cartesian
+				XMFLOAT3 position(radius*sinf(phi)*cosf(theta), radius*cosf(phi), radius*sinf(phi)*sinf(theta));
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+				// Partial derivative of P with respect to theta
+				XMFLOAT3 tangentU(-radius*sinf(phi)*sinf(theta), 0.0f, +radius*sinf(phi)*cosf(theta));
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+				XMVECTOR T = XMLoadFloat3(&tangentU);
+				XMStoreFloat3(&tangentU, XMVector3Normalize(T));
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+				XMFLOAT3 normal;
+				XMVECTOR p = XMLoadFloat3(&position);
+				XMStoreFloat3(&normal, XMVector3Normalize(p));
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
+				XMFLOAT2 texC(theta / XM_2PI, phi / XM_PI);
 
-			meshData.Vertices.push_back( v );
+				StoreVertex(vertices, layout, 1 + (size_t)(i-1)*ringVertexCount + j, position, normal, tangentU, texC);
+			}
 		}
-	}
+	});
 
-	meshData.Vertices.push_back( bottomVertex );
+	if(bIndices16)
+		StoreSphereIndices((uint16*)indices, sliceCount, stackCount, vertexCount);
+	else
+		StoreSphereIndices((uint32*)indices, sliceCount, stackCount, vertexCount);
 
-	//
-	// Compute indices for top stack.  The top stack was written first to the vertex buffer
-	// and connects the top pole to the first ring.
-	//
-
-    for(uint32 i = 1; i <= sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
-	}
-	
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
-
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-    uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
-	{
-		for(uint32 j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
-		}
-	}
-
-	//
-	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-	// and connects the bottom pole to the bottom ring.
-	//
-
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
-
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
-	
-	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
-	}
-
-    return meshData;
+    return true;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
 	//       v1
 	//       *
 	//      / \
@@ -231,48 +431,89 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
-	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+	// Every edge is split once and the triangles sharing it share its midpoint, so a level
+	// adds one vertex per edge instead of three per triangle. The input vertices keep their
+	// indices and the midpoints are appended after them.
 
-		//
-		// Generate the midpoints.
-		//
+	const uint32 numTris = (uint32)meshData.Indices32.size()/3;
+	const uint32 numVertices = (uint32)meshData.Vertices.size();
 
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
+	//
+	// Key the three edges of every triangle, in (v0v1, v1v2, v0v2) order.
+	//
 
-		//
-		// Add new geometry.
-		//
+	std::vector<uint64> edgeKeys(numTris*3);
+	Parallel::ForRange(numTris, SubdivideGrain, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			const uint32* tri = &meshData.Indices32[i*3];
+			edgeKeys[i*3+0] = EdgeKey(tri[0], tri[1]);
+			edgeKeys[i*3+1] = EdgeKey(tri[1], tri[2]);
+			edgeKeys[i*3+2] = EdgeKey(tri[0], tri[2]);
+		}
+	});
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+	//
+	// Number the unique edges; the midpoint of edge e becomes vertex numVertices + e.
+	//
+
+	std::vector<uint64> edges;
+	edges.reserve(edgeKeys.size()/2 + 1);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+	std::unordered_map<uint64, uint32> edgeIndices;
+	edgeIndices.reserve(edgeKeys.size()/2 + 1);
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+	std::vector<uint32> midIndices(edgeKeys.size());
+	for(size_t i = 0; i < edgeKeys.size(); ++i)
+	{
+		const auto inserted = edgeIndices.emplace(edgeKeys[i], (uint32)edges.size());
+		if(inserted.second)
+			edges.push_back(edgeKeys[i]);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		midIndices[i] = numVertices + inserted.first->second;
 	}
+
+	//
+	// Generate the midpoints.
+	//
+
+	meshData.Vertices.resize(numVertices + edges.size());
+	Parallel::ForRange(edges.size(), SubdivideGrain, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			const uint32 a = (uint32)(edges[i] >> 32);
+			const uint32 b = (uint32)(edges[i] & 0xFFFFFFFF);
+			meshData.Vertices[numVertices + i] = MidPoint(meshData.Vertices[a], meshData.Vertices[b]);
+		}
+	});
+
+	//
+	// Add new geometry.
+	//
+
+	std::vector<uint32> indices(numTris*12);
+	Parallel::ForRange(numTris, SubdivideGrain, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			const uint32 v0 = meshData.Indices32[i*3+0];
+			const uint32 v1 = meshData.Indices32[i*3+1];
+			const uint32 v2 = meshData.Indices32[i*3+2];
+			const uint32 m0 = midIndices[i*3+0];
+			const uint32 m1 = midIndices[i*3+1];
+			const uint32 m2 = midIndices[i*3+2];
+
+			uint32* out = &indices[i*12];
+			out[0] = v0; out[1]  = m0; out[2]  = m2;
+			out[3] = m0; out[4]  = m1; out[5]  = m2;
+			out[6] = m2; out[7]  = m1; out[8]  = v2;
+			out[9] = m0; out[10] = v1; out[11] = m1;
+		}
+	});
+
+	meshData.Indices32.swap(indices);
 }
 
 GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
@@ -310,7 +551,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     MeshData meshData;
 
 	// Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+    numSubdivisions = std::min<uint32>(numSubdivisions, MaxSubdivisions);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -380,6 +621,11 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     return meshData;
 }
 
+bool GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, MeshSink& sink)
+{
+	return StoreMeshData(CreateGeosphere(radius, numSubdivisions), sink);
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
@@ -553,9 +799,30 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 {
     MeshData meshData;
 
+	MeshDataSink sink(meshData);
+	const bool bGenerated = CreateGrid(width, depth, m, n, sink);
+	assert(bGenerated && "CreateGrid needs at least 2 rows and 2 columns");
+	(void)bGenerated;
+
+    return meshData;
+}
+
+bool GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, MeshSink& sink)
+{
+	if(m < 2 || n < 2)
+		return false;
+
 	uint32 vertexCount = m*n;
 	uint32 faceCount   = (m-1)*(n-1)*2;
 
+	void* vertices = nullptr;
+	void* indices = nullptr;
+	bool bIndices16 = false;
+	if(!sink.Allocate(vertexCount, faceCount*3, vertices, indices, bIndices16)) // 3 indices per face
+		return false;
+
+	const VertexLayout& layout = sink.Layout();
+
 	//
 	// Create the vertices.
 	//
@@ -569,49 +836,35 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	const XMFLOAT3 normal(0.0f, 1.0f, 0.0f);
+	const XMFLOAT3 tangentU(1.0f, 0.0f, 0.0f);
+
+	const size_t rowGrain = std::max<size_t>(1, GenerateGrain/n);
+	Parallel::ForRange(m, rowGrain, [&](size_t begin, size_t end)
 	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
+		for(uint32 i = (uint32)begin; i < (uint32)end; ++i)
 		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			float z = halfDepth - i*dz;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				// Stretch texture over grid.
+				StoreVertex(vertices, layout, (size_t)i*n+j, XMFLOAT3(x, 0.0f, z), normal, tangentU, XMFLOAT2(j*du, i*dv));
+			}
 		}
-	}
- 
+	});
+
     //
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
-	{
-		for(uint32 j = 0; j < n-1; ++j)
-		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
-
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
-		}
-	}
+	if(bIndices16)
+		StoreGridIndices((uint16*)indices, m, n);
+	else
+		StoreGridIndices((uint32*)indices, m, n);
 
-    return meshData;
+    return true;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
@@ -656,3 +909,94 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 
     return meshData;
 }
+
+void GeometryGenerator::RunSubdivisionBenchmark(uint32 maxDepth)
+{
+	GeometryGenerator geoGen;
+
+	const uint64 meshVertexSize = sizeof(Vertex);
+	for(uint32 depth = 0; depth <= maxDepth; ++depth)
+	{
+		for(uint32 shape = 0; shape < 2; ++shape)
+		{
+			Stopwatch timer;
+			const MeshData mesh = shape == 0 ? geoGen.CreateGeosphere(1.0f, depth) : geoGen.CreateBox(1.0f, 1.0f, 1.0f, depth);
+			const double elapsedMs = timer.ElapsedMilliseconds();
+
+			const uint64 vertexCount = mesh.Vertices.size();
+			const uint64 triangleCount = mesh.Indices32.size()/3;
+			const uint64 formerVertexCount = depth == 0 ? vertexCount : triangleCount*6/4;
+			const uint64 bytes = vertexCount*meshVertexSize + mesh.Indices32.size()*sizeof(uint32);
+			const uint64 formerBytes = formerVertexCount*meshVertexSize + mesh.Indices32.size()*sizeof(uint32);
+
+			Logln("Subdivided ", shape == 0 ? "geosphere" : "box", " depth ", std::to_string(depth), ": ",
+				std::to_string(triangleCount), " triangles, ", std::to_string(vertexCount), " vertices (",
+				std::to_string(formerVertexCount), " unshared), ", std::to_string(bytes), " bytes (",
+				std::to_string(formerBytes), " unshared) in ", std::to_string(elapsedMs), " ms");
+		}
+	}
+}
+
+bool GeometryGenerator::RunSinkBenchmark(uint32 gridSize, uint32 sphereSize, const VertexLayout& layout)
+{
+	GeometryGenerator geoGen;
+
+	struct BenchmarkShape
+	{
+		std::string Name;
+		std::function<MeshData()> Generate;
+		std::function<bool(MeshSink&)> GenerateInto;
+	};
+	const BenchmarkShape shapes[] =
+	{
+		{
+			"grid_" + std::to_string(gridSize),
+			[&]() { return geoGen.CreateGrid(32.0f, 32.0f, gridSize, gridSize); },
+			[&](MeshSink& sink) { return geoGen.CreateGrid(32.0f, 32.0f, gridSize, gridSize, sink); }
+		},
+		{
+			"sphere_" + std::to_string(sphereSize),
+			[&]() { return geoGen.CreateSphere(1.0f, sphereSize, sphereSize); },
+			[&](MeshSink& sink) { return geoGen.CreateSphere(1.0f, sphereSize, sphereSize, sink); }
+		}
+	};
+
+	for(const BenchmarkShape& shape : shapes)
+	{
+		uint64 formerPeakBytes = 0;
+		double formerMs = 0.0;
+		{
+			Stopwatch timer;
+
+			const MeshData mesh = shape.Generate();
+
+			ByteMeshSink repacked(layout);
+			if(!StoreMeshData(mesh, repacked))
+				ReturnFalse(L"Failed to repack generated mesh");
+
+			const std::vector<std::uint8_t> vertexBuffer(repacked.Vertices.begin(), repacked.Vertices.end());
+			const std::vector<uint32> indexBuffer(repacked.Indices.begin(), repacked.Indices.end());
+
+			formerMs = timer.ElapsedMilliseconds();
+
+			// Everything above is still alive here.
+			formerPeakBytes =
+				mesh.Vertices.size()*sizeof(Vertex) + mesh.Indices32.size()*sizeof(uint32) +
+				2*repacked.ByteSize();
+		}
+
+		ByteMeshSink sink(layout);
+
+		Stopwatch timer;
+		if(!shape.GenerateInto(sink))
+			ReturnFalse(L"Failed to generate mesh through a sink");
+		const double sinkMs = timer.ElapsedMilliseconds();
+
+		Logln("Generated ", shape.Name, " (", std::to_string(sink.Indices.size()/3), " triangles): MeshData path ",
+			std::to_string(formerMs), " ms, ", std::to_string(formerPeakBytes >> 20), " MB peak; sink ",
+			std::to_string(sinkMs), " ms, ", std::to_string(sink.ByteSize() >> 20), " MB peak (",
+			std::to_string(sinkMs > 0.0 ? formerMs/sinkMs : 0.0), "x)");
+	}
+
+	return true;
+}
@@ -0,0 +1,101 @@
+#include "GeometryPool.h"
+#include "Logger.h"
+#include "D3D12Util.h"
+
+#include <d3dx12.h>
+#include <cstring>
+
+using namespace Microsoft::WRL;
+
+bool GeometryPool::Initialize(ID3D12Device* pDevice, UINT vertexByteStride, UINT vertexCapacity, UINT indexByteCapacity) {
+	md3dDevice = pDevice;
+
+	mVertexByteStride = vertexByteStride;
+	mVertexCapacity = vertexCapacity;
+	mIndexByteCapacity = indexByteCapacity & ~3u;
+
+	D3D12BufferCreateInfo vertexInfo(static_cast<UINT64>(mVertexCapacity) * mVertexByteStride, D3D12_RESOURCE_FLAG_NONE);
+	CheckIsValid(D3D12Util::CreateBuffer(md3dDevice, vertexInfo, mVertexBuffer.ReleaseAndGetAddressOf()));
+	mVertexBuffer->SetName(L"GeometryPoolVertices");
+
+	D3D12BufferCreateInfo indexInfo(mIndexByteCapacity, D3D12_RESOURCE_FLAG_NONE);
+	CheckIsValid(D3D12Util::CreateBuffer(md3dDevice, indexInfo, mIndexBuffer.ReleaseAndGetAddressOf()));
+	mIndexBuffer->SetName(L"GeometryPoolIndices");
+
+	mState = D3D12_RESOURCE_STATE_COMMON;
+
+	mVertexAllocator.Initialize(mVertexCapacity);
+	mIndexAllocator.Initialize(mIndexByteCapacity / sizeof(UINT));
+
+	return true;
+}
+
+bool GeometryPool::Upload(
+		ID3D12GraphicsCommandList* pCmdList,
+		const void* pVertices, UINT vertexCount,
+		const void* pIndices, UINT indexByteSize,
+		GeometryPoolAllocation& outAllocation) {
+	const UINT indexWordCount = (indexByteSize + 3) / 4;
+	const UINT64 vbByteSize = static_cast<UINT64>(vertexCount) * mVertexByteStride;
+	const UINT64 ibByteSize = static_cast<UINT64>(indexWordCount) * sizeof(UINT);
+
+	// Both ranges first, so a full arena fails before anything else is created.
+	const TlsfAllocation vertices = mVertexAllocator.Allocate(vertexCount);
+	if (!vertices.IsValid()) ReturnFalse(L"Geometry pool vertex arena is full");
+
+	const TlsfAllocation indices = mIndexAllocator.Allocate(indexWordCount);
+	if (!indices.IsValid()) {
+		mVertexAllocator.Free(vertices);
+		ReturnFalse(L"Geometry pool index arena is full");
+	}
+
+	ComPtr<ID3D12Resource> uploader;
+	BYTE* mapped = nullptr;
+	D3D12BufferCreateInfo uploadInfo(vbByteSize + ibByteSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	if (!D3D12Util::CreateBuffer(md3dDevice, uploadInfo, uploader.GetAddressOf()) ||
+			FAILED(uploader->Map(0, nullptr, reinterpret_cast<void**>(&mapped)))) {
+		mVertexAllocator.Free(vertices);
+		mIndexAllocator.Free(indices);
+		ReturnFalse(L"Failed to create the geometry pool staging buffer");
+	}
+
+	std::memcpy(mapped, pVertices, static_cast<size_t>(vbByteSize));
+	std::memcpy(mapped + vbByteSize, pIndices, indexByteSize);
+	// Pads a 16-bit buffer with an odd index count to a whole word.
+	std::memset(mapped + vbByteSize + indexByteSize, 0, static_cast<size_t>(ibByteSize - indexByteSize));
+	uploader->Unmap(0, nullptr);
+
+	if (mState != D3D12_RESOURCE_STATE_COPY_DEST) {
+		const D3D12_RESOURCE_BARRIER barriers[] = {
+			CD3DX12_RESOURCE_BARRIER::Transition(mVertexBuffer.Get(), mState, D3D12_RESOURCE_STATE_COPY_DEST),
+			CD3DX12_RESOURCE_BARRIER::Transition(mIndexBuffer.Get(), mState, D3D12_RESOURCE_STATE_COPY_DEST)
+		};
+		pCmdList->ResourceBarrier(_countof(barriers), barriers);
+	}
+
+	pCmdList->CopyBufferRegion(mVertexBuffer.Get(), vertices.Offset * mVertexByteStride, uploader.Get(), 0, vbByteSize);
+	pCmdList->CopyBufferRegion(mIndexBuffer.Get(), indices.Offset * sizeof(UINT), uploader.Get(), vbByteSize, ibByteSize);
+
+	const D3D12_RESOURCE_BARRIER barriers[] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(mVertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ),
+		CD3DX12_RESOURCE_BARRIER::Transition(mIndexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ)
+	};
+	pCmdList->ResourceBarrier(_countof(barriers), barriers);
+	mState = D3D12_RESOURCE_STATE_GENERIC_READ;
+
+	mUploaders.push_back(uploader);
+
+	outAllocation.Vertices = vertices;
+	outAllocation.Indices = indices;
+
+	return true;
+}
+
+void GeometryPool::Free(const GeometryPoolAllocation& allocation) {
+	mVertexAllocator.Free(allocation.Vertices);
+	mIndexAllocator.Free(allocation.Indices);
+}
+
+void GeometryPool::DisposeUploaders() {
+	mUploaders.clear();
+}
@@ -0,0 +1,65 @@
+#include "IndexCompaction.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+	const std::uint32_t Unassigned = 0xFFFFFFFF;
+}
+
+bool IndexCompaction::PackTo16Bit(
+		const std::uint32_t* pIndices, size_t indexCount,
+		std::unordered_map<std::string, SubmeshGeometry>& drawArgs,
+		std::vector<std::uint16_t>& outIndices,
+		IndexCompactionStats* pStats) {
+	// Vertex offset subtracted from each index location; overlapping submeshes must agree on it.
+	std::vector<std::uint32_t> offsets(indexCount, Unassigned);
+	std::vector<std::pair<SubmeshGeometry*, std::uint32_t>> rebases;
+	rebases.reserve(drawArgs.size());
+
+	for (auto& drawArg : drawArgs) {
+		auto& submesh = drawArg.second;
+		const size_t begin = submesh.StartIndexLocation;
+		const size_t end = begin + submesh.IndexCount;
+		if (end > indexCount) return false;
+		if (begin == end) continue;
+
+		const auto range = std::minmax_element(pIndices + begin, pIndices + end);
+		const std::uint32_t minimum = *range.first;
+		if (*range.second - minimum >= Max16BitVertexSpan) return false;
+
+		for (size_t i = begin; i < end; ++i) {
+			if (offsets[i] != Unassigned && offsets[i] != minimum) return false;
+			offsets[i] = minimum;
+		}
+
+		rebases.emplace_back(&submesh, minimum);
+	}
+
+	outIndices.resize(indexCount + (indexCount & 1));
+	for (size_t i = 0; i < indexCount; ++i) {
+		// Indices outside every submesh are kept as they are.
+		const std::uint32_t offset = offsets[i] == Unassigned ? 0 : offsets[i];
+		const std::uint32_t index = pIndices[i] - offset;
+		if (index >= Max16BitVertexSpan) return false;
+
+		outIndices[i] = static_cast<std::uint16_t>(index);
+	}
+	if (indexCount & 1) outIndices.back() = 0;
+
+	UINT rebasedCount = 0;
+	for (const auto& rebase : rebases) {
+		if (rebase.second == 0) continue;
+
+		rebase.first->BaseVertexLocation += static_cast<INT>(rebase.second);
+		++rebasedCount;
+	}
+
+	if (pStats != nullptr) {
+		pStats->SourceByteSize = indexCount * sizeof(std::uint32_t);
+		pStats->PackedByteSize = outIndices.size() * sizeof(std::uint16_t);
+		pStats->RebasedSubmeshCount = rebasedCount;
+	}
+
+	return true;
+}
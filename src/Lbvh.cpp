@@ -0,0 +1,570 @@
+#include "Lbvh.h"
+#include "Logger.h"
+#include "GeometryGenerator.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+#include "VectorMeshSink.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cfloat>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+	const size_t PrimitiveGrainSize = 1 << 14;
+	// Chunks per worker in the radix sort; each keeps its own digit histogram.
+	const size_t SortChunksPerWorker = 4;
+
+	const UINT RadixBits = 8;
+	const UINT RadixSize = 1 << RadixBits;
+
+	const UINT NoParent = 0xFFFFFFFF;
+	// Child references with this bit set name leaves, i.e. positions in the sorted order.
+	const UINT LeafBit = 0x80000000;
+
+	struct Aabb {
+		float Min[3];
+		float Max[3];
+
+		void Reset() {
+			for (int axis = 0; axis < 3; ++axis) {
+				Min[axis] = FLT_MAX;
+				Max[axis] = -FLT_MAX;
+			}
+		}
+
+		void Grow(const float point[3]) {
+			for (int axis = 0; axis < 3; ++axis) {
+				Min[axis] = std::min(Min[axis], point[axis]);
+				Max[axis] = std::max(Max[axis], point[axis]);
+			}
+		}
+
+		void Grow(const Aabb& other) {
+			for (int axis = 0; axis < 3; ++axis) {
+				Min[axis] = std::min(Min[axis], other.Min[axis]);
+				Max[axis] = std::max(Max[axis], other.Max[axis]);
+			}
+		}
+
+		float HalfArea() const {
+			const float dx = Max[0] - Min[0];
+			const float dy = Max[1] - Min[1];
+			const float dz = Max[2] - Min[2];
+			if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	__forceinline Aabb Union(const Aabb& a, const Aabb& b) {
+		Aabb result = a;
+		result.Grow(b);
+		return result;
+	}
+
+	// Spreads the low 10 bits of v two zero bits apart.
+	__forceinline std::uint64_t ExpandBits10(std::uint64_t v) {
+		v &= 0x3FF;
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	// Spreads the low 21 bits of v two zero bits apart.
+	__forceinline std::uint64_t ExpandBits21(std::uint64_t v) {
+		v &= 0x1FFFFF;
+		v = (v | (v << 32)) & 0x001F00000000FFFFull;
+		v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+		v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+		v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+		v = (v | (v << 2)) & 0x1249249249249249ull;
+		return v;
+	}
+
+	// Stable LSD radix sort of (key, value) pairs on the low keyBits bits, RadixBits per pass.
+	// Every pass counts digits per chunk, scans the counts digit-major so equal digits keep their
+	//  chunk order, and scatters each chunk on its own.
+	void RadixSort(std::vector<std::uint64_t>& keys, std::vector<UINT>& values, UINT keyBits) {
+		const size_t count = keys.size();
+		const size_t chunkCount = std::max<size_t>(1, std::min(Parallel::WorkerCount() * SortChunksPerWorker, (count + PrimitiveGrainSize - 1) / PrimitiveGrainSize));
+		const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+		std::vector<std::uint64_t> tempKeys(count);
+		std::vector<UINT> tempValues(count);
+		std::vector<size_t> offsets(chunkCount * RadixSize);
+
+		for (UINT shift = 0; shift < keyBits; shift += RadixBits) {
+			Parallel::ForEach(chunkCount, [&](size_t chunk) {
+				size_t* histogram = offsets.data() + chunk * RadixSize;
+				std::fill(histogram, histogram + RadixSize, 0);
+
+				const size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; ++i)
+					++histogram[(keys[i] >> shift) & (RadixSize - 1)];
+			});
+
+			size_t sum = 0;
+			for (UINT digit = 0; digit < RadixSize; ++digit) {
+				for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+					size_t& offset = offsets[chunk * RadixSize + digit];
+					const size_t digitCount = offset;
+					offset = sum;
+					sum += digitCount;
+				}
+			}
+
+			Parallel::ForEach(chunkCount, [&](size_t chunk) {
+				size_t* chunkOffsets = offsets.data() + chunk * RadixSize;
+
+				const size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; ++i) {
+					const size_t dst = chunkOffsets[(keys[i] >> shift) & (RadixSize - 1)]++;
+					tempKeys[dst] = keys[i];
+					tempValues[dst] = values[i];
+				}
+			});
+
+			keys.swap(tempKeys);
+			values.swap(tempValues);
+		}
+	}
+
+	// Binary radix tree over sorted Morton codes, with the per-node data the bottom-up pass fills.
+	class RadixTree {
+	public:
+		RadixTree(const LbvhBuildDesc& desc, const std::vector<std::uint64_t>& codes, const std::vector<Aabb>& leafBounds)
+				: mDesc(desc), mCodes(codes), mLeafBounds(leafBounds), mLeafCount(static_cast<UINT>(codes.size())) {
+			const size_t internalCount = mLeafCount - 1;
+			Children.resize(internalCount * 2);
+			Parents.assign(internalCount, NoParent);
+			LeafParents.assign(mLeafCount, NoParent);
+			Bounds.resize(internalCount);
+			TriangleCounts.resize(internalCount);
+			DescendantCounts.resize(internalCount);
+			Costs.resize(internalCount);
+			Collapsed.resize(internalCount);
+		}
+
+	public:
+		// Karras 2012, figure 4: the range and split of internal node i from its neighbours' codes.
+		void BuildNode(UINT i) {
+			const INT64 index = i;
+			const int direction = Delta(index, index + 1) > Delta(index, index - 1) ? 1 : -1;
+
+			// Upper bound on the range length, then its exact other end.
+			const int minDelta = Delta(index, index - direction);
+			INT64 maxLength = 2;
+			while (Delta(index, index + maxLength * direction) > minDelta)
+				maxLength *= 2;
+
+			INT64 length = 0;
+			for (INT64 step = maxLength / 2; step >= 1; step /= 2) {
+				if (Delta(index, index + (length + step) * direction) > minDelta)
+					length += step;
+			}
+			const INT64 other = index + length * direction;
+
+			// Where the common prefix of the range ends.
+			const int nodeDelta = Delta(index, other);
+			INT64 split = 0;
+			for (INT64 divisor = 2;; divisor *= 2) {
+				const INT64 step = (length + divisor - 1) / divisor;
+				if (Delta(index, index + (split + step) * direction) > nodeDelta)
+					split += step;
+				if (step == 1) break;
+			}
+			const UINT gamma = static_cast<UINT>(index + split * direction + std::min(direction, 0));
+
+			const UINT first = static_cast<UINT>(std::min(index, other));
+			const UINT last = static_cast<UINT>(std::max(index, other));
+
+			const UINT left = first == gamma ? (gamma | LeafBit) : gamma;
+			const UINT right = last == gamma + 1 ? ((gamma + 1) | LeafBit) : gamma + 1;
+
+			Children[i * 2] = left;
+			Children[i * 2 + 1] = right;
+			SetParent(left, i);
+			SetParent(right, i);
+		}
+
+		// Climbs from a leaf; the second child to reach a node finishes it and keeps climbing.
+		void FitFromLeaf(UINT leaf, std::vector<std::atomic<UINT>>& arrivals) {
+			UINT node = LeafParents[leaf];
+			while (node != NoParent) {
+				if (arrivals[node].fetch_add(1, std::memory_order_acq_rel) == 0) return;
+
+				if (mDesc.Rotate) Rotate(node);
+				Finish(node);
+
+				node = Parents[node];
+			}
+		}
+
+		UINT ParentOf(UINT ref) const {
+			return (ref & LeafBit) ? LeafParents[ref & ~LeafBit] : Parents[ref];
+		}
+
+		Aabb BoundsOf(UINT ref) const {
+			return (ref & LeafBit) ? mLeafBounds[ref & ~LeafBit] : Bounds[ref];
+		}
+
+		UINT TriangleCountOf(UINT ref) const {
+			return (ref & LeafBit) ? 1 : TriangleCounts[ref];
+		}
+
+		// Output nodes below the reference's own.
+		UINT DescendantCountOf(UINT ref) const {
+			return (ref & LeafBit) ? 0 : DescendantCounts[ref];
+		}
+
+		bool IsOutputLeaf(UINT ref) const {
+			return (ref & LeafBit) || Collapsed[ref];
+		}
+
+	private:
+		// Length of the common prefix of the codes at i and j, ties broken by the positions
+		//  themselves so duplicate codes still split; -1 outside the array.
+		int Delta(INT64 i, INT64 j) const {
+			if (j < 0 || j >= static_cast<INT64>(mLeafCount)) return -1;
+
+			const std::uint64_t a = mCodes[static_cast<size_t>(i)];
+			const std::uint64_t b = mCodes[static_cast<size_t>(j)];
+			if (a != b) return std::countl_zero(a ^ b);
+			return 64 + std::countl_zero(static_cast<std::uint32_t>(i ^ j));
+		}
+
+		float CostOf(UINT ref) const {
+			return (ref & LeafBit) ? mDesc.IntersectionCost * mLeafBounds[ref & ~LeafBit].HalfArea() : Costs[ref];
+		}
+
+		void SetParent(UINT ref, UINT parent) {
+			if (ref & LeafBit) LeafParents[ref & ~LeafBit] = parent;
+			else Parents[ref] = parent;
+		}
+
+		// Bounds, counts and SAH cost from the children, and whether the subtree stays a leaf.
+		// Costs are surface areas times the desc's costs, not yet relative to the root.
+		void Finish(UINT node) {
+			const UINT left = Children[node * 2];
+			const UINT right = Children[node * 2 + 1];
+
+			Bounds[node] = Union(BoundsOf(left), BoundsOf(right));
+			TriangleCounts[node] = TriangleCountOf(left) + TriangleCountOf(right);
+
+			const float area = Bounds[node].HalfArea();
+			const float splitCost = mDesc.TraversalCost * area + CostOf(left) + CostOf(right);
+			const float leafCost = mDesc.IntersectionCost * static_cast<float>(TriangleCounts[node]) * area;
+
+			Collapsed[node] = TriangleCounts[node] <= mDesc.MaxLeafSize && leafCost <= splitCost;
+			Costs[node] = Collapsed[node] ? leafCost : splitCost;
+			DescendantCounts[node] = Collapsed[node] ? 0 : 2 + DescendantCountOf(left) + DescendantCountOf(right);
+		}
+
+		// Swaps one child with a grandchild under the other child when that shrinks the other
+		//  child; the node's own bounds stay the same.
+		void Rotate(UINT node) {
+			float bestGain = 0.0f;
+			UINT bestSide = 0;
+			UINT bestGrandchild = 0;
+
+			for (UINT side = 0; side < 2; ++side) {
+				const UINT sibling = Children[node * 2 + (side ^ 1)];
+				if (sibling & LeafBit) continue;
+
+				const Aabb moved = BoundsOf(Children[node * 2 + side]);
+				const float siblingArea = Bounds[sibling].HalfArea();
+				for (UINT grandchild = 0; grandchild < 2; ++grandchild) {
+					// The grandchild that stays under the sibling.
+					const UINT kept = Children[sibling * 2 + (grandchild ^ 1)];
+					const float gain = siblingArea - Union(moved, BoundsOf(kept)).HalfArea();
+					if (gain > bestGain) {
+						bestGain = gain;
+						bestSide = side;
+						bestGrandchild = grandchild;
+					}
+				}
+			}
+
+			if (bestGain <= 0.0f) return;
+
+			const UINT sibling = Children[node * 2 + (bestSide ^ 1)];
+			UINT& child = Children[node * 2 + bestSide];
+			UINT& grandchild = Children[sibling * 2 + bestGrandchild];
+			std::swap(child, grandchild);
+			SetParent(child, node);
+			SetParent(grandchild, sibling);
+
+			Finish(sibling);
+		}
+
+	public:
+		// Two per internal node.
+		std::vector<UINT> Children;
+		std::vector<UINT> Parents;
+		std::vector<UINT> LeafParents;
+		std::vector<Aabb> Bounds;
+		std::vector<UINT> TriangleCounts;
+		std::vector<UINT> DescendantCounts;
+		std::vector<float> Costs;
+		std::vector<std::uint8_t> Collapsed;
+
+	private:
+		const LbvhBuildDesc& mDesc;
+		const std::vector<std::uint64_t>& mCodes;
+		const std::vector<Aabb>& mLeafBounds;
+		UINT mLeafCount;
+	};
+
+	// A reference placed at Node, whose triangles start at FirstTriangle and whose children, if
+	//  it keeps any, go to ChildBase and ChildBase + 1.
+	struct LayoutTask {
+		UINT Ref;
+		UINT Node;
+		UINT FirstTriangle;
+		UINT ChildBase;
+	};
+
+	void SetBounds(BvhNode& node, const Aabb& bounds) {
+		node.BoundsMin = { bounds.Min[0], bounds.Min[1], bounds.Min[2] };
+		node.BoundsMax = { bounds.Max[0], bounds.Max[1], bounds.Max[2] };
+	}
+}
+
+bool LbvhBuilder::Build(const BvhMesh& mesh, const LbvhBuildDesc& desc, Bvh& outBvh, BvhBuildStats* pStats) {
+	if (mesh.Vertices == nullptr || mesh.Indices == nullptr) ReturnFalse(L"BVH mesh has no vertex or index data");
+	if (mesh.IndexStride != 2 && mesh.IndexStride != 4) ReturnFalse(L"BVH mesh index stride must be 2 or 4 bytes");
+	if (mesh.TriangleCount() == 0) ReturnFalse(L"BVH mesh has no triangles");
+	if (mesh.TriangleCount() >= LeafBit) ReturnFalse(L"LBVH meshes must have fewer than 2^31 triangles");
+	if (desc.MaxLeafSize == 0) ReturnFalse(L"BVH leaves must hold at least one triangle");
+
+	Stopwatch timer;
+
+	const UINT triangleCount = mesh.TriangleCount();
+
+	//
+	// Triangle bounds and the bounds of their centroids.
+	//
+	std::vector<Aabb> triangleBounds(triangleCount);
+	const size_t chunkCount = (triangleCount + PrimitiveGrainSize - 1) / PrimitiveGrainSize;
+	std::vector<Aabb> chunkCentroidBounds(chunkCount);
+	Parallel::ForEach(chunkCount, [&](size_t chunk) {
+		Aabb& centroidBounds = chunkCentroidBounds[chunk];
+		centroidBounds.Reset();
+
+		const size_t end = std::min<size_t>(triangleCount, (chunk + 1) * PrimitiveGrainSize);
+		for (size_t i = chunk * PrimitiveGrainSize; i < end; ++i) {
+			UINT i0, i1, i2;
+			mesh.Triangle(static_cast<UINT>(i), i0, i1, i2);
+
+			const DirectX::XMFLOAT3* positions[] = { &mesh.Position(i0), &mesh.Position(i1), &mesh.Position(i2) };
+
+			Aabb& bounds = triangleBounds[i];
+			bounds.Reset();
+			for (const auto pos : positions) {
+				const float point[] = { pos->x, pos->y, pos->z };
+				bounds.Grow(point);
+			}
+
+			float centroid[3];
+			for (int axis = 0; axis < 3; ++axis)
+				centroid[axis] = 0.5f * (bounds.Min[axis] + bounds.Max[axis]);
+			centroidBounds.Grow(centroid);
+		}
+	});
+
+	Aabb centroidBounds;
+	centroidBounds.Reset();
+	for (const auto& bounds : chunkCentroidBounds)
+		centroidBounds.Grow(bounds);
+
+	//
+	// Morton codes, sorted.
+	//
+	const UINT axisBits = desc.Use63BitCodes ? 21 : 10;
+	const float cellCount = static_cast<float>(1u << axisBits);
+
+	float scale[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		const float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+		scale[axis] = extent > 0.0f ? cellCount / extent : 0.0f;
+	}
+
+	std::vector<std::uint64_t> codes(triangleCount);
+	std::vector<UINT> sortedTriangles(triangleCount);
+	Parallel::ForRange(triangleCount, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const Aabb& bounds = triangleBounds[i];
+
+			std::uint64_t cells[3];
+			for (int axis = 0; axis < 3; ++axis) {
+				const float centroid = 0.5f * (bounds.Min[axis] + bounds.Max[axis]);
+				const float cell = (centroid - centroidBounds.Min[axis]) * scale[axis];
+				cells[axis] = static_cast<std::uint64_t>(std::clamp(cell, 0.0f, cellCount - 1.0f));
+			}
+
+			codes[i] = desc.Use63BitCodes ?
+				(ExpandBits21(cells[0]) << 2) | (ExpandBits21(cells[1]) << 1) | ExpandBits21(cells[2]) :
+				(ExpandBits10(cells[0]) << 2) | (ExpandBits10(cells[1]) << 1) | ExpandBits10(cells[2]);
+			sortedTriangles[i] = static_cast<UINT>(i);
+		}
+	});
+
+	RadixSort(codes, sortedTriangles, axisBits * 3);
+
+	std::vector<Aabb> leafBounds(triangleCount);
+	Parallel::ForRange(triangleCount, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			leafBounds[i] = triangleBounds[sortedTriangles[i]];
+	});
+	triangleBounds.clear();
+	triangleBounds.shrink_to_fit();
+
+	std::vector<BvhNode>& nodes = outBvh.Nodes;
+	outBvh.Mesh = mesh;
+
+	if (triangleCount == 1) {
+		nodes.assign(1, BvhNode());
+		SetBounds(nodes[0], leafBounds[0]);
+		nodes[0].LeftFirst = 0;
+		nodes[0].TriangleCount = 1;
+		outBvh.TriangleIndices.assign(1, 0);
+	}
+	else {
+		//
+		// Radix tree, then bounds from the leaves up.
+		//
+		RadixTree tree(desc, codes, leafBounds);
+
+		const UINT internalCount = triangleCount - 1;
+		Parallel::ForRange(internalCount, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				tree.BuildNode(static_cast<UINT>(i));
+		});
+
+		std::vector<std::atomic<UINT>> arrivals(internalCount);
+		Parallel::ForRange(internalCount, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				arrivals[i].store(0, std::memory_order_relaxed);
+		});
+		Parallel::ForRange(triangleCount, PrimitiveGrainSize, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				tree.FitFromLeaf(static_cast<UINT>(i), arrivals);
+		});
+
+		//
+		// Lay the tree out level by level; every task knows where its subtree goes, so a level's
+		//  tasks are independent.
+		//
+		UINT root = 0;
+		while (tree.ParentOf(root) != NoParent)
+			root = tree.ParentOf(root);
+
+		nodes.assign(1 + static_cast<size_t>(tree.DescendantCountOf(root)), BvhNode());
+		outBvh.TriangleIndices.resize(triangleCount);
+
+		std::vector<LayoutTask> level = { { root, 0, 0, 1 } };
+		std::vector<LayoutTask> next;
+		for (UINT depth = 0; !level.empty(); ++depth) {
+			if (depth >= BvhMaxDepth) ReturnFalse(L"LBVH is deeper than BvhMaxDepth");
+
+			next.assign(level.size() * 2, { NoParent, 0, 0, 0 });
+			Parallel::ForRange(level.size(), 1024, [&](size_t begin, size_t end) {
+				std::vector<UINT> stack;
+				for (size_t i = begin; i < end; ++i) {
+					const LayoutTask& task = level[i];
+					BvhNode& node = nodes[task.Node];
+					SetBounds(node, tree.BoundsOf(task.Ref));
+
+					if (tree.IsOutputLeaf(task.Ref)) {
+						node.LeftFirst = task.FirstTriangle;
+						node.TriangleCount = tree.TriangleCountOf(task.Ref);
+
+						// Rotations may have mixed the sorted order, so the subtree is walked.
+						UINT out = task.FirstTriangle;
+						stack.assign(1, task.Ref);
+						while (!stack.empty()) {
+							const UINT ref = stack.back();
+							stack.pop_back();
+							if (ref & LeafBit) {
+								outBvh.TriangleIndices[out++] = sortedTriangles[ref & ~LeafBit];
+							}
+							else {
+								stack.push_back(tree.Children[ref * 2 + 1]);
+								stack.push_back(tree.Children[ref * 2]);
+							}
+						}
+						continue;
+					}
+
+					node.LeftFirst = task.ChildBase;
+					node.TriangleCount = 0;
+
+					const UINT left = tree.Children[task.Ref * 2];
+					const UINT right = tree.Children[task.Ref * 2 + 1];
+					next[i * 2] = { left, task.ChildBase, task.FirstTriangle, task.ChildBase + 2 };
+					next[i * 2 + 1] = { right, task.ChildBase + 1, task.FirstTriangle + tree.TriangleCountOf(left),
+						task.ChildBase + 2 + tree.DescendantCountOf(left) };
+				}
+			});
+
+			next.erase(std::remove_if(next.begin(), next.end(), [](const LayoutTask& task) { return task.Ref == NoParent; }), next.end());
+			level.swap(next);
+		}
+	}
+
+	if (pStats != nullptr) {
+		BvhBuildDesc statsDesc;
+		statsDesc.MaxLeafSize = desc.MaxLeafSize;
+		statsDesc.TraversalCost = desc.TraversalCost;
+		statsDesc.IntersectionCost = desc.IntersectionCost;
+		BvhBuilder::CalcStats(outBvh, statsDesc, *pStats);
+		pStats->BuildMilliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+bool LbvhBuilder::RunBenchmark(UINT sphereSize, const LbvhBuildDesc& desc, const BvhBuildDesc& referenceDesc) {
+	GeometryGenerator geoGen;
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	VectorMeshSink sink(vertices, indices);
+	CheckIsValid(geoGen.CreateSphere(1.0f, sphereSize, sphereSize, sink));
+
+	BvhMesh mesh;
+	mesh.Vertices = vertices.data();
+	mesh.VertexCount = static_cast<UINT>(vertices.size());
+	mesh.Indices = indices.data();
+	mesh.IndexCount = static_cast<UINT>(indices.size());
+	mesh.IndexStride = sizeof(std::uint32_t);
+
+	Bvh bvh;
+	BvhBuildStats stats;
+	CheckIsValid(BvhBuilder::Build(mesh, referenceDesc, bvh, &stats));
+
+	for (const bool b63BitCodes : { false, true }) {
+		for (const bool bRotate : { false, true }) {
+			LbvhBuildDesc variant = desc;
+			variant.Use63BitCodes = b63BitCodes;
+			variant.Rotate = bRotate;
+
+			Bvh lbvh;
+			BvhBuildStats linearStats;
+			CheckIsValid(Build(mesh, variant, lbvh, &linearStats));
+
+			Logln("    LBVH ", b63BitCodes ? "63" : "30", "-bit codes", bRotate ? ", rotated" : "", ": ",
+				std::to_string(linearStats.BuildMilliseconds), " ms (", std::to_string(linearStats.Throughput()),
+				" Mtris/s, ", std::to_string(linearStats.BuildMilliseconds > 0.0 ? stats.BuildMilliseconds / linearStats.BuildMilliseconds : 0.0),
+				"x faster), ", std::to_string(linearStats.NodeCount), " nodes, depth ", std::to_string(linearStats.MaxDepth),
+				", SAH cost ", std::to_string(linearStats.SahCost), " (", std::to_string(stats.SahCost > 0.0f ? linearStats.SahCost / stats.SahCost : 0.0f),
+				"x binned SAH)");
+		}
+	}
+
+	return true;
+}
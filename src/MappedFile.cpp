@@ -0,0 +1,77 @@
+#include "MappedFile.h"
+#include "Logger.h"
+
+MappedFile::MappedFile() {
+	mhFile = INVALID_HANDLE_VALUE;
+	mhMapping = NULL;
+
+	mData = nullptr;
+	mSize = 0;
+	mWriteTime = 0;
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const std::wstring& inFilename) {
+	Close();
+
+	mhFile = CreateFileW(
+		inFilename.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		NULL);
+	if (mhFile == INVALID_HANDLE_VALUE) ReturnFalse(L"Failed to open file: " + inFilename);
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mhFile, &size)) {
+		Close();
+		ReturnFalse(L"Failed to query file size: " + inFilename);
+	}
+	mSize = static_cast<UINT64>(size.QuadPart);
+
+	FILETIME writeTime;
+	if (GetFileTime(mhFile, nullptr, nullptr, &writeTime))
+		mWriteTime = (static_cast<UINT64>(writeTime.dwHighDateTime) << 32) | writeTime.dwLowDateTime;
+
+	// Empty files can not be mapped; they are still a valid (empty) view.
+	if (mSize == 0) {
+		static const char EmptyView = 0;
+		mData = &EmptyView;
+		return true;
+	}
+
+	mhMapping = CreateFileMappingW(mhFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mhMapping == NULL) {
+		Close();
+		ReturnFalse(L"Failed to create file mapping: " + inFilename);
+	}
+
+	mData = MapViewOfFile(mhMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == nullptr) {
+		Close();
+		ReturnFalse(L"Failed to map view of file: " + inFilename);
+	}
+
+	return true;
+}
+
+void MappedFile::Close() {
+	if (mhMapping != NULL) {
+		if (mData != nullptr) UnmapViewOfFile(mData);
+		CloseHandle(mhMapping);
+		mhMapping = NULL;
+	}
+	if (mhFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(mhFile);
+		mhFile = INVALID_HANDLE_VALUE;
+	}
+
+	mData = nullptr;
+	mSize = 0;
+	mWriteTime = 0;
+}
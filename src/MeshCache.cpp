@@ -0,0 +1,333 @@
+#include "MeshCache.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+using namespace MeshCache;
+
+namespace {
+	__forceinline UINT64 AlignSection(UINT64 offset) {
+		return (offset + SectionAlignment - 1) & ~static_cast<UINT64>(SectionAlignment - 1);
+	}
+
+	UINT64 HashSections(const FileHeader& header, const BYTE* base) {
+		UINT64 hash = HashBytes(base + header.VertexOffset, static_cast<size_t>(header.VertexCount) * header.VertexStride);
+		hash = HashBytes(base + header.IndexOffset, static_cast<size_t>(header.IndexCount) * header.IndexStride, hash);
+		hash = HashBytes(base + header.SubmeshOffset, static_cast<size_t>(header.SubmeshCount) * sizeof(SubmeshRecord), hash);
+		return hash;
+	}
+
+	// Compared against what is left of the file, so a corrupt offset cannot wrap around.
+	bool SectionInRange(UINT64 offset, UINT64 count, UINT64 stride, UINT64 fileSize) {
+		if (offset > fileSize) return false;
+		return stride == 0 || count <= (fileSize - offset) / stride;
+	}
+
+	template <typename IndexType>
+	bool IndicesInRange(const void* pIndices, UINT indexCount, UINT vertexCount) {
+		const IndexType* indices = reinterpret_cast<const IndexType*>(pIndices);
+		for (UINT i = 0; i < indexCount; ++i) {
+			if (indices[i] >= vertexCount) return false;
+		}
+		return true;
+	}
+
+	// Every index of the submesh, offset by its base vertex, has to land on a vertex.
+	template <typename IndexType>
+	bool SubmeshInRange(const void* pIndices, const SubmeshRecord& record, UINT vertexCount) {
+		const IndexType* indices = reinterpret_cast<const IndexType*>(pIndices) + record.StartIndexLocation;
+		for (UINT i = 0; i < record.IndexCount; ++i) {
+			const INT64 vertex = static_cast<INT64>(indices[i]) + record.BaseVertexLocation;
+			if (vertex < 0 || vertex >= vertexCount) return false;
+		}
+		return true;
+	}
+
+	bool SubmeshesInRange(const FileHeader& header, const BYTE* base, bool bCheckIndices) {
+		const SubmeshRecord* records = reinterpret_cast<const SubmeshRecord*>(base + header.SubmeshOffset);
+		const void* indices = base + header.IndexOffset;
+
+		for (UINT i = 0; i < header.SubmeshCount; ++i) {
+			const SubmeshRecord& record = records[i];
+			if (static_cast<UINT64>(record.StartIndexLocation) + record.IndexCount > header.IndexCount) return false;
+			if (record.BaseVertexLocation < 0 || static_cast<UINT>(record.BaseVertexLocation) > header.VertexCount) return false;
+			if (!bCheckIndices) continue;
+
+			const bool inRange = header.IndexStride == 2 ?
+				SubmeshInRange<std::uint16_t>(indices, record, header.VertexCount) :
+				SubmeshInRange<std::uint32_t>(indices, record, header.VertexCount);
+			if (!inRange) return false;
+		}
+		return true;
+	}
+
+	const BYTE Padding[SectionAlignment] = {};
+
+	void WritePadding(std::ofstream& fout, UINT64 offset) {
+		const UINT64 aligned = AlignSection(offset);
+		if (aligned > offset) fout.write(reinterpret_cast<const char*>(Padding), static_cast<std::streamsize>(aligned - offset));
+	}
+}
+
+UINT64 MeshCache::HashBytes(const void* pData, size_t size, UINT64 seed) {
+	const UINT64 Prime = 0x100000001B3ull;
+
+	const BYTE* bytes = reinterpret_cast<const BYTE*>(pData);
+	UINT64 hash = seed;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		UINT64 word;
+		std::memcpy(&word, bytes + i, sizeof(UINT64));
+		hash = (hash ^ word) * Prime;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ bytes[i]) * Prime;
+
+	return hash;
+}
+
+MappedBlob::MappedBlob(const std::shared_ptr<MappedFile>& file, const void* pData, SIZE_T size) :
+	mRefCount(1), mFile(file), mData(pData), mSize(size) {}
+
+HRESULT MappedBlob::QueryInterface(REFIID riid, void** ppvObject) {
+	if (ppvObject == nullptr) return E_POINTER;
+
+	if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3DBlob)) {
+		*ppvObject = static_cast<ID3DBlob*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppvObject = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG MappedBlob::AddRef() {
+	return ++mRefCount;
+}
+
+ULONG MappedBlob::Release() {
+	const ULONG count = --mRefCount;
+	if (count == 0) delete this;
+	return count;
+}
+
+LPVOID MappedBlob::GetBufferPointer() {
+	return const_cast<void*>(mData);
+}
+
+SIZE_T MappedBlob::GetBufferSize() {
+	return mSize;
+}
+
+bool MeshCacheFile::Open(const std::wstring& inFilename, const SourceInfo* pSource, bool bValidate) {
+	mHeader = nullptr;
+	mFile = std::make_shared<MappedFile>();
+
+	if (!mFile->Open(inFilename)) {
+		mFile.reset();
+		return false;
+	}
+
+	const UINT64 size = mFile->Size();
+	const BYTE* base = reinterpret_cast<const BYTE*>(mFile->Data());
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+
+	bool valid = size >= sizeof(FileHeader);
+	valid = valid && header->Magic == Magic && header->Version == Version && header->HeaderSize == sizeof(FileHeader);
+	valid = valid && header->VertexStride == sizeof(Vertex) && (header->IndexStride == 2 || header->IndexStride == 4);
+	valid = valid && header->FileSize == size;
+	valid = valid && SectionInRange(header->VertexOffset, header->VertexCount, header->VertexStride, size);
+	valid = valid && SectionInRange(header->IndexOffset, header->IndexCount, header->IndexStride, size);
+	valid = valid && SectionInRange(header->SubmeshOffset, header->SubmeshCount, sizeof(SubmeshRecord), size);
+	valid = valid && header->SubmeshOffset % alignof(SubmeshRecord) == 0;
+	// Cheap enough to always check; the per-index pass below is not.
+	if (valid && !SubmeshesInRange(*header, base, false)) {
+		WErrln(L"Mesh cache submesh out of range: " + inFilename);
+		valid = false;
+	}
+
+	if (valid && pSource != nullptr)
+		valid = header->SourceSize == pSource->Size && header->SourceWriteTime == pSource->WriteTime &&
+			header->BakeFlags == pSource->BakeFlags && header->SettingsHash == pSource->SettingsHash;
+
+	if (valid && bValidate) {
+		if (HashSections(*header, base) != header->ContentHash) {
+			WErrln(L"Mesh cache content hash mismatch: " + inFilename);
+			valid = false;
+		}
+		else {
+			const void* indices = base + header->IndexOffset;
+			bool inRange = header->IndexStride == 2 ?
+				IndicesInRange<std::uint16_t>(indices, header->IndexCount, header->VertexCount) :
+				IndicesInRange<std::uint32_t>(indices, header->IndexCount, header->VertexCount);
+			inRange = inRange && SubmeshesInRange(*header, base, true);
+			if (!inRange) {
+				WErrln(L"Mesh cache index out of range: " + inFilename);
+				valid = false;
+			}
+		}
+	}
+
+	if (!valid) {
+		mFile.reset();
+		return false;
+	}
+
+	mHeader = header;
+	return true;
+}
+
+const FileHeader& MeshCacheFile::Header() const {
+	return *mHeader;
+}
+
+const Vertex* MeshCacheFile::Vertices() const {
+	return reinterpret_cast<const Vertex*>(reinterpret_cast<const BYTE*>(mFile->Data()) + mHeader->VertexOffset);
+}
+
+const void* MeshCacheFile::Indices() const {
+	return reinterpret_cast<const BYTE*>(mFile->Data()) + mHeader->IndexOffset;
+}
+
+DXGI_FORMAT MeshCacheFile::IndexFormat() const {
+	return mHeader->IndexStride == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+UINT64 MeshCacheFile::VertexBufferByteSize() const {
+	return static_cast<UINT64>(mHeader->VertexCount) * mHeader->VertexStride;
+}
+
+UINT64 MeshCacheFile::IndexBufferByteSize() const {
+	return static_cast<UINT64>(mHeader->IndexCount) * mHeader->IndexStride;
+}
+
+void MeshCacheFile::GetSubmeshes(std::vector<NamedSubmesh>& outSubmeshes) const {
+	const SubmeshRecord* records = reinterpret_cast<const SubmeshRecord*>(
+		reinterpret_cast<const BYTE*>(mFile->Data()) + mHeader->SubmeshOffset);
+
+	outSubmeshes.resize(mHeader->SubmeshCount);
+	for (UINT i = 0; i < mHeader->SubmeshCount; ++i) {
+		const auto& record = records[i];
+		auto& submesh = outSubmeshes[i];
+
+		submesh.Name.assign(record.Name, strnlen(record.Name, MaxSubmeshNameLength));
+		submesh.Submesh.IndexCount = record.IndexCount;
+		submesh.Submesh.StartIndexLocation = record.StartIndexLocation;
+		submesh.Submesh.BaseVertexLocation = record.BaseVertexLocation;
+		submesh.Submesh.LodError = record.LodError;
+	}
+}
+
+ComPtr<ID3DBlob> MeshCacheFile::CreateVertexBlob() const {
+	ComPtr<ID3DBlob> blob;
+	blob.Attach(new MappedBlob(mFile, Vertices(), static_cast<SIZE_T>(VertexBufferByteSize())));
+	return blob;
+}
+
+ComPtr<ID3DBlob> MeshCacheFile::CreateIndexBlob() const {
+	ComPtr<ID3DBlob> blob;
+	blob.Attach(new MappedBlob(mFile, Indices(), static_cast<SIZE_T>(IndexBufferByteSize())));
+	return blob;
+}
+
+bool MeshCache::QuerySourceInfo(const std::wstring& inFilename, SourceInfo& outInfo) {
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(inFilename.c_str(), GetFileExInfoStandard, &data)) return false;
+
+	outInfo.Size = (static_cast<UINT64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	outInfo.WriteTime = (static_cast<UINT64>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+	return true;
+}
+
+bool MeshCache::Write(
+		const std::wstring& inFilename,
+		const Vertex* pVertices, UINT vertexCount,
+		const void* pIndices, UINT indexCount, UINT indexStride,
+		const std::vector<NamedSubmesh>& inSubmeshes,
+		const SourceInfo& inSource) {
+	if (indexStride != 2 && indexStride != 4) ReturnFalse(L"Index stride must be 2 or 4");
+
+	std::vector<SubmeshRecord> records(inSubmeshes.size());
+	for (size_t i = 0, end = inSubmeshes.size(); i < end; ++i) {
+		const auto& submesh = inSubmeshes[i];
+		auto& record = records[i];
+
+		std::memset(&record, 0, sizeof(SubmeshRecord));
+		std::memcpy(record.Name, submesh.Name.c_str(), std::min<size_t>(submesh.Name.size(), MaxSubmeshNameLength));
+		record.IndexCount = submesh.Submesh.IndexCount;
+		record.StartIndexLocation = submesh.Submesh.StartIndexLocation;
+		record.BaseVertexLocation = submesh.Submesh.BaseVertexLocation;
+		record.LodError = submesh.Submesh.LodError;
+	}
+
+	FileHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.HeaderSize = sizeof(FileHeader);
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = vertexCount;
+	header.IndexCount = indexCount;
+	header.IndexStride = indexStride;
+	header.SubmeshCount = static_cast<UINT>(records.size());
+
+	XMFLOAT3 minimum = { FLT_MAX, FLT_MAX, FLT_MAX };
+	XMFLOAT3 maximum = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (UINT i = 0; i < vertexCount; ++i) {
+		const auto& pos = pVertices[i].Pos;
+		minimum = { std::min(minimum.x, pos.x), std::min(minimum.y, pos.y), std::min(minimum.z, pos.z) };
+		maximum = { std::max(maximum.x, pos.x), std::max(maximum.y, pos.y), std::max(maximum.z, pos.z) };
+	}
+	header.BoundsMin = minimum;
+	header.BoundsMax = maximum;
+
+	const UINT64 vbByteSize = static_cast<UINT64>(vertexCount) * sizeof(Vertex);
+	const UINT64 ibByteSize = static_cast<UINT64>(indexCount) * indexStride;
+	const UINT64 smByteSize = static_cast<UINT64>(records.size()) * sizeof(SubmeshRecord);
+
+	header.VertexOffset = AlignSection(sizeof(FileHeader));
+	header.IndexOffset = AlignSection(header.VertexOffset + vbByteSize);
+	header.SubmeshOffset = AlignSection(header.IndexOffset + ibByteSize);
+	header.FileSize = header.SubmeshOffset + smByteSize;
+
+	header.SourceSize = inSource.Size;
+	header.SourceWriteTime = inSource.WriteTime;
+	header.BakeFlags = inSource.BakeFlags;
+	header.SettingsHash = inSource.SettingsHash;
+
+	UINT64 hash = HashBytes(pVertices, static_cast<size_t>(vbByteSize));
+	hash = HashBytes(pIndices, static_cast<size_t>(ibByteSize), hash);
+	hash = HashBytes(records.data(), static_cast<size_t>(smByteSize), hash);
+	header.ContentHash = hash;
+
+	// Written next to the target and renamed over it once complete, so a crash or a full disk
+	//  never leaves a truncated file under the cache's name.
+	const std::wstring tempFilename = inFilename + L".tmp";
+
+	std::ofstream fout(tempFilename, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create mesh cache: " + tempFilename);
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	WritePadding(fout, sizeof(FileHeader));
+	fout.write(reinterpret_cast<const char*>(pVertices), static_cast<std::streamsize>(vbByteSize));
+	WritePadding(fout, header.VertexOffset + vbByteSize);
+	fout.write(reinterpret_cast<const char*>(pIndices), static_cast<std::streamsize>(ibByteSize));
+	WritePadding(fout, header.IndexOffset + ibByteSize);
+	fout.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(smByteSize));
+
+	fout.close();
+
+	if (!fout.good() || !MoveFileExW(tempFilename.c_str(), inFilename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileW(tempFilename.c_str());
+		ReturnFalse(L"Failed to write mesh cache: " + inFilename);
+	}
+
+	return true;
+}
@@ -0,0 +1,308 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace DirectX;
+
+const float MeshOptimizer::DefaultOverdrawThreshold = 1.05f;
+
+namespace {
+	// Vertex -> triangle adjacency in CSR form.
+	struct TriangleAdjacency {
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+	};
+
+	void BuildAdjacency(const std::uint32_t* pIndices, size_t indexCount, size_t vertexCount, TriangleAdjacency& outAdjacency) {
+		outAdjacency.Offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			++outAdjacency.Offsets[pIndices[i] + 1];
+
+		for (size_t v = 0; v < vertexCount; ++v)
+			outAdjacency.Offsets[v + 1] += outAdjacency.Offsets[v];
+
+		std::vector<std::uint32_t> cursor(outAdjacency.Offsets.begin(), outAdjacency.Offsets.end() - 1);
+		outAdjacency.Triangles.resize(indexCount);
+		for (size_t i = 0; i < indexCount; ++i)
+			outAdjacency.Triangles[cursor[pIndices[i]]++] = static_cast<std::uint32_t>(i / 3);
+	}
+
+	// Cache misses per triangle for a FIFO cache of cacheSize entries.
+	void SimulateCacheMisses(const std::uint32_t* pIndices, size_t indexCount, size_t vertexCount, UINT cacheSize, std::vector<std::uint8_t>& outMisses) {
+		std::vector<std::uint32_t> timestamps(vertexCount, 0);
+		std::uint32_t time = cacheSize + 1;
+
+		outMisses.resize(indexCount / 3);
+		for (size_t t = 0, count = indexCount / 3; t < count; ++t) {
+			std::uint8_t misses = 0;
+			for (size_t k = 0; k < 3; ++k) {
+				const std::uint32_t v = pIndices[t * 3 + k];
+				if (time - timestamps[v] > cacheSize) {
+					timestamps[v] = time++;
+					++misses;
+				}
+			}
+			outMisses[t] = misses;
+		}
+	}
+
+	struct Cluster {
+		size_t Begin;
+		size_t End;
+		float SortKey;
+	};
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::uint32_t* pIndices, size_t indexCount, size_t vertexCount, UINT cacheSize) {
+	VertexCacheStats stats;
+	if (indexCount < 3) return stats;
+
+	std::vector<std::uint8_t> misses;
+	SimulateCacheMisses(pIndices, indexCount, vertexCount, cacheSize, misses);
+
+	std::vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		if (!referenced[pIndices[i]]) {
+			referenced[pIndices[i]] = true;
+			++referencedCount;
+		}
+	}
+
+	for (auto m : misses)
+		stats.TransformedVertexCount += m;
+
+	stats.ACMR = static_cast<float>(stats.TransformedVertexCount) / static_cast<float>(indexCount / 3);
+	stats.ATVR = static_cast<float>(stats.TransformedVertexCount) / static_cast<float>(referencedCount);
+
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::uint32_t* pIndices, size_t indexCount, size_t vertexCount, UINT cacheSize) {
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	TriangleAdjacency adjacency;
+	BuildAdjacency(pIndices, indexCount, vertexCount, adjacency);
+
+	// Number of not yet emitted triangles using each vertex.
+	std::vector<std::uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		liveTriangles[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+
+	std::vector<std::uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<std::uint32_t> deadEnd;
+	deadEnd.reserve(indexCount);
+
+	std::vector<std::uint32_t> candidates;
+	candidates.reserve(64);
+
+	std::vector<std::uint32_t> output;
+	output.reserve(indexCount);
+
+	std::uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	auto skipDeadEnd = [&]() -> std::int64_t {
+		while (!deadEnd.empty()) {
+			const std::uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[v] > 0) return v;
+		}
+		while (cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0) return static_cast<std::int64_t>(cursor);
+			++cursor;
+		}
+		return -1;
+	};
+
+	std::int64_t fanning = skipDeadEnd();
+	while (fanning >= 0) {
+		candidates.clear();
+
+		const std::uint32_t f = static_cast<std::uint32_t>(fanning);
+		for (std::uint32_t a = adjacency.Offsets[f], end = adjacency.Offsets[f + 1]; a < end; ++a) {
+			const std::uint32_t t = adjacency.Triangles[a];
+			if (emitted[t]) continue;
+
+			for (size_t k = 0; k < 3; ++k) {
+				const std::uint32_t v = pIndices[t * 3 + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+
+				if (time - cacheTimestamps[v] > cacheSize)
+					cacheTimestamps[v] = time++;
+			}
+
+			emitted[t] = true;
+		}
+
+		// Picks the candidate that stays in the cache after emitting all its live triangles,
+		//  preferring the oldest one.
+		std::int64_t best = -1;
+		std::int64_t bestPriority = -1;
+		for (auto v : candidates) {
+			if (liveTriangles[v] == 0) continue;
+
+			std::int64_t priority = 0;
+			if (time - cacheTimestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = time - cacheTimestamps[v];
+
+			if (priority > bestPriority) {
+				best = v;
+				bestPriority = priority;
+			}
+		}
+
+		fanning = best >= 0 ? best : skipDeadEnd();
+	}
+
+	std::copy(output.begin(), output.end(), pIndices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(
+		std::uint32_t* pIndices, size_t indexCount,
+		const Vertex* pVertices, size_t vertexCount,
+		UINT cacheSize,
+		float threshold) {
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	std::vector<std::uint8_t> misses;
+	SimulateCacheMisses(pIndices, indexCount, vertexCount, cacheSize, misses);
+
+	// Hard boundaries: triangles that miss on all three vertices restart the cache, so
+	//  reordering across them costs nothing.
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		if (t == 0 || misses[t] == 3)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries: within a hard cluster, start a new piece with a cold cache and cut it
+	//  as soon as its own ACMR is within threshold of the whole cluster's.
+	std::vector<Cluster> clusters;
+	std::vector<std::uint32_t> timestamps(vertexCount, 0);
+	std::uint32_t time = 0;
+
+	for (size_t h = 0, hEnd = hardBoundaries.size() - 1; h < hEnd; ++h) {
+		const size_t begin = hardBoundaries[h];
+		const size_t end = hardBoundaries[h + 1];
+
+		size_t clusterMisses = 0;
+		for (size_t t = begin; t < end; ++t)
+			clusterMisses += misses[t];
+		const float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+		size_t pieceBegin = begin;
+		size_t pieceMisses = 0;
+		time += cacheSize + 1;
+
+		for (size_t t = begin; t < end; ++t) {
+			for (size_t k = 0; k < 3; ++k) {
+				const std::uint32_t v = pIndices[t * 3 + k];
+				if (time - timestamps[v] > cacheSize) {
+					timestamps[v] = time++;
+					++pieceMisses;
+				}
+			}
+
+			const size_t pieceTriangles = t + 1 - pieceBegin;
+			if (t + 1 < end && static_cast<float>(pieceMisses) / static_cast<float>(pieceTriangles) <= limit) {
+				clusters.push_back({ pieceBegin, t + 1, 0.0f });
+				pieceBegin = t + 1;
+				pieceMisses = 0;
+				time += cacheSize + 1;
+			}
+		}
+		clusters.push_back({ pieceBegin, end, 0.0f });
+	}
+
+	// Area-weighted centroid and normal per cluster.
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+
+	std::vector<XMFLOAT3> clusterCentroids(clusters.size());
+	std::vector<XMFLOAT3> clusterNormals(clusters.size());
+
+	for (size_t c = 0, end = clusters.size(); c < end; ++c) {
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for (size_t t = clusters[c].Begin; t < clusters[c].End; ++t) {
+			const XMVECTOR p0 = XMLoadFloat3(&pVertices[pIndices[t * 3 + 0]].Pos);
+			const XMVECTOR p1 = XMLoadFloat3(&pVertices[pIndices[t * 3 + 1]].Pos);
+			const XMVECTOR p2 = XMLoadFloat3(&pVertices[pIndices[t * 3 + 2]].Pos);
+
+			const XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			const float a = XMVectorGetX(XMVector3Length(n));
+
+			centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), a / 3.0f));
+			normal = XMVectorAdd(normal, n);
+			area += a;
+		}
+
+		meshCentroid = XMVectorAdd(meshCentroid, centroid);
+		meshArea += area;
+
+		XMStoreFloat3(&clusterCentroids[c], area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : centroid);
+		XMStoreFloat3(&clusterNormals[c], XMVector3Normalize(normal));
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+	for (size_t c = 0, end = clusters.size(); c < end; ++c) {
+		const XMVECTOR toCluster = XMVectorSubtract(XMLoadFloat3(&clusterCentroids[c]), meshCentroid);
+		clusters[c].SortKey = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&clusterNormals[c])));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+		return a.SortKey > b.SortKey;
+	});
+
+	std::vector<std::uint32_t> reordered;
+	reordered.reserve(triangleCount * 3);
+	for (const auto& cluster : clusters)
+		reordered.insert(reordered.end(), pIndices + cluster.Begin * 3, pIndices + cluster.End * 3);
+
+	std::copy(reordered.begin(), reordered.end(), pIndices);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(std::uint32_t* pIndices, size_t indexCount, std::vector<Vertex>& ioVertices) {
+	const std::uint32_t Unused = 0xFFFFFFFF;
+
+	std::vector<std::uint32_t> remap(ioVertices.size(), Unused);
+	std::vector<Vertex> vertices;
+	vertices.reserve(ioVertices.size());
+
+	for (size_t i = 0; i < indexCount; ++i) {
+		std::uint32_t& newIndex = remap[pIndices[i]];
+		if (newIndex == Unused) {
+			newIndex = static_cast<std::uint32_t>(vertices.size());
+			vertices.push_back(ioVertices[pIndices[i]]);
+		}
+		pIndices[i] = newIndex;
+	}
+
+	ioVertices.swap(vertices);
+	return ioVertices.size();
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& ioVertices, std::vector<std::uint32_t>& ioIndices, UINT flags, UINT cacheSize) {
+	if (flags & EVertexCache)
+		OptimizeVertexCache(ioIndices.data(), ioIndices.size(), ioVertices.size(), cacheSize);
+
+	if (flags & EOverdraw)
+		OptimizeOverdraw(ioIndices.data(), ioIndices.size(), ioVertices.data(), ioVertices.size(), cacheSize);
+
+	if (flags & EVertexFetch)
+		OptimizeVertexFetch(ioIndices.data(), ioIndices.size(), ioVertices);
+}
@@ -0,0 +1,468 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace {
+	const std::uint32_t Invalid = 0xFFFFFFFF;
+
+	// Border edges are held in place by planes perpendicular to the adjacent face, weighted well
+	//  above the face planes so outlines survive.
+	const double BorderWeight = 10.0;
+
+	enum VertexKind : std::uint8_t {
+		EManifold = 0,
+		EBorder,
+		ELocked
+	};
+
+	struct Quadric {
+		double A00 = 0.0, A11 = 0.0, A22 = 0.0;
+		double A01 = 0.0, A02 = 0.0, A12 = 0.0;
+		double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+		double C = 0.0;
+		double Weight = 0.0;
+
+		// Plane a*x + b*y + c*z + d = 0 with a unit normal.
+		static Quadric FromPlane(double a, double b, double c, double d, double weight) {
+			Quadric q;
+			q.A00 = a * a * weight; q.A11 = b * b * weight; q.A22 = c * c * weight;
+			q.A01 = a * b * weight; q.A02 = a * c * weight; q.A12 = b * c * weight;
+			q.B0 = a * d * weight; q.B1 = b * d * weight; q.B2 = c * d * weight;
+			q.C = d * d * weight;
+			q.Weight = weight;
+			return q;
+		}
+
+		void Add(const Quadric& q) {
+			A00 += q.A00; A11 += q.A11; A22 += q.A22;
+			A01 += q.A01; A02 += q.A02; A12 += q.A12;
+			B0 += q.B0; B1 += q.B1; B2 += q.B2;
+			C += q.C;
+			Weight += q.Weight;
+		}
+
+		// Weighted mean squared distance to the accumulated planes.
+		double Error(const XMFLOAT3& p) const {
+			const double x = p.x, y = p.y, z = p.z;
+			const double r =
+				A00 * x * x + A11 * y * y + A22 * z * z +
+				2.0 * (A01 * x * y + A02 * x * z + A12 * y * z) +
+				2.0 * (B0 * x + B1 * y + B2 * z) +
+				C;
+			return Weight > 0.0 ? std::max(r, 0.0) / Weight : 0.0;
+		}
+	};
+
+	struct Collapse {
+		std::uint32_t From;
+		std::uint32_t To;
+		double Error;
+		double Cost;
+	};
+
+	__forceinline std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b) {
+		return a < b ? (static_cast<std::uint64_t>(a) << 32) | b : (static_cast<std::uint64_t>(b) << 32) | a;
+	}
+
+	__forceinline XMVECTOR FaceNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2) {
+		const XMVECTOR v0 = XMLoadFloat3(&p0);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&p1), v0), XMVectorSubtract(XMLoadFloat3(&p2), v0));
+	}
+
+	// Groups vertices with bit-identical positions; outPositionIds maps vertex -> position and
+	//  outWedges lists the vertices of each position (CSR).
+	UINT WeldPositions(
+			const Vertex* pVertices, size_t vertexCount,
+			std::vector<std::uint32_t>& outPositionIds,
+			std::vector<std::uint32_t>& outWedgeOffsets,
+			std::vector<std::uint32_t>& outWedges) {
+		std::vector<std::uint32_t> order(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+			order[i] = static_cast<std::uint32_t>(i);
+
+		auto less = [&](std::uint32_t a, std::uint32_t b) {
+			const auto& pa = pVertices[a].Pos;
+			const auto& pb = pVertices[b].Pos;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			return pa.z < pb.z;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		outPositionIds.resize(vertexCount);
+		outWedgeOffsets.clear();
+		outWedges.clear();
+		outWedges.reserve(vertexCount);
+
+		UINT positionCount = 0;
+		for (size_t i = 0; i < vertexCount; ++i) {
+			if (i == 0 || less(order[i - 1], order[i])) {
+				outWedgeOffsets.push_back(static_cast<std::uint32_t>(outWedges.size()));
+				++positionCount;
+			}
+			outPositionIds[order[i]] = positionCount - 1;
+			outWedges.push_back(order[i]);
+		}
+		outWedgeOffsets.push_back(static_cast<std::uint32_t>(outWedges.size()));
+
+		return positionCount;
+	}
+
+	// Triangles per position over the live triangle list (CSR).
+	void BuildAdjacency(
+			const std::vector<std::uint32_t>& indices,
+			const std::vector<std::uint32_t>& positionIds,
+			size_t positionCount,
+			std::vector<std::uint32_t>& outOffsets,
+			std::vector<std::uint32_t>& outTriangles) {
+		outOffsets.assign(positionCount + 1, 0);
+		for (auto v : indices)
+			++outOffsets[positionIds[v] + 1];
+		for (size_t p = 0; p < positionCount; ++p)
+			outOffsets[p + 1] += outOffsets[p];
+
+		std::vector<std::uint32_t> cursor(outOffsets.begin(), outOffsets.end() - 1);
+		outTriangles.resize(indices.size());
+		for (size_t i = 0, end = indices.size(); i < end; ++i)
+			outTriangles[cursor[positionIds[indices[i]]]++] = static_cast<std::uint32_t>(i / 3);
+	}
+}
+
+float MeshSimplifier::CalcExtent(const Vertex* pVertices, size_t vertexCount) {
+	XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const XMVECTOR pos = XMLoadFloat3(&pVertices[i].Pos);
+		minimum = XMVectorMin(minimum, pos);
+		maximum = XMVectorMax(maximum, pos);
+	}
+
+	if (vertexCount == 0) return 0.0f;
+
+	XMFLOAT3 size;
+	XMStoreFloat3(&size, XMVectorSubtract(maximum, minimum));
+	return std::max(size.x, std::max(size.y, size.z));
+}
+
+float MeshSimplifier::Simplify(
+		const Vertex* pVertices, size_t vertexCount,
+		const std::uint32_t* pIndices, size_t indexCount,
+		const SimplifyDesc& desc,
+		std::vector<std::uint32_t>& outIndices) {
+	outIndices.assign(pIndices, pIndices + indexCount);
+	if (indexCount <= desc.TargetIndexCount || vertexCount == 0) return 0.0f;
+
+	std::vector<std::uint32_t> positionIds;
+	std::vector<std::uint32_t> wedgeOffsets;
+	std::vector<std::uint32_t> wedges;
+	const UINT positionCount = WeldPositions(pVertices, vertexCount, positionIds, wedgeOffsets, wedges);
+
+	// Positions scaled to a unit extent so errors and weights are scale independent.
+	const float extent = CalcExtent(pVertices, vertexCount);
+	const float invExtent = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+	std::vector<XMFLOAT3> positions(positionCount);
+	{
+		XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+		for (size_t i = 0; i < vertexCount; ++i)
+			minimum = XMVectorMin(minimum, XMLoadFloat3(&pVertices[i].Pos));
+
+		for (UINT p = 0; p < positionCount; ++p) {
+			const XMVECTOR pos = XMLoadFloat3(&pVertices[wedges[wedgeOffsets[p]]].Pos);
+			XMStoreFloat3(&positions[p], XMVectorScale(XMVectorSubtract(pos, minimum), invExtent));
+		}
+	}
+
+	//
+	// Classifies positions by the edges around them.
+	//
+	std::vector<std::uint64_t> edgeKeys;
+	edgeKeys.reserve(indexCount);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		for (size_t k = 0; k < 3; ++k) {
+			const std::uint32_t a = positionIds[pIndices[i + k]];
+			const std::uint32_t b = positionIds[pIndices[i + (k + 1) % 3]];
+			if (a != b) edgeKeys.push_back(EdgeKey(a, b));
+		}
+	}
+	std::sort(edgeKeys.begin(), edgeKeys.end());
+
+	std::vector<VertexKind> kinds(positionCount, EManifold);
+	std::vector<std::uint8_t> borderEdgeCounts(positionCount, 0);
+	std::vector<std::uint64_t> borderEdges;
+
+	for (size_t i = 0, end = edgeKeys.size(); i < end;) {
+		size_t run = i + 1;
+		while (run < end && edgeKeys[run] == edgeKeys[i]) ++run;
+
+		const std::uint32_t a = static_cast<std::uint32_t>(edgeKeys[i] >> 32);
+		const std::uint32_t b = static_cast<std::uint32_t>(edgeKeys[i]);
+		const size_t faceCount = run - i;
+
+		if (faceCount == 1) {
+			borderEdges.push_back(edgeKeys[i]);
+			borderEdgeCounts[a] = static_cast<std::uint8_t>(std::min(borderEdgeCounts[a] + 1, 255));
+			borderEdgeCounts[b] = static_cast<std::uint8_t>(std::min(borderEdgeCounts[b] + 1, 255));
+		}
+		else if (faceCount > 2) {
+			kinds[a] = ELocked;
+			kinds[b] = ELocked;
+		}
+
+		i = run;
+	}
+
+	for (UINT p = 0; p < positionCount; ++p) {
+		if (kinds[p] == ELocked || borderEdgeCounts[p] == 0) continue;
+		// Corners where several borders meet have no single direction to slide along.
+		kinds[p] = desc.LockBorders || borderEdgeCounts[p] != 2 ? ELocked : EBorder;
+	}
+
+	//
+	// Accumulates face and border quadrics.
+	//
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		const std::uint32_t p0 = positionIds[pIndices[i + 0]];
+		const std::uint32_t p1 = positionIds[pIndices[i + 1]];
+		const std::uint32_t p2 = positionIds[pIndices[i + 2]];
+
+		const XMVECTOR n = FaceNormal(positions[p0], positions[p1], positions[p2]);
+		const float length = XMVectorGetX(XMVector3Length(n));
+		if (length <= FLT_EPSILON) continue;
+
+		XMFLOAT3 unit;
+		XMStoreFloat3(&unit, XMVectorScale(n, 1.0f / length));
+		const double d = -(unit.x * positions[p0].x + unit.y * positions[p0].y + unit.z * positions[p0].z);
+		const Quadric q = Quadric::FromPlane(unit.x, unit.y, unit.z, d, 0.5 * length);
+
+		const std::uint32_t corners[3] = { p0, p1, p2 };
+		for (size_t k = 0; k < 3; ++k)
+			quadrics[corners[k]].Add(q);
+
+		for (size_t k = 0; k < 3; ++k) {
+			const std::uint32_t a = corners[k];
+			const std::uint32_t b = corners[(k + 1) % 3];
+			if (!std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(a, b))) continue;
+
+			const XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&positions[b]), XMLoadFloat3(&positions[a]));
+			const float edgeLength = XMVectorGetX(XMVector3Length(edge));
+			if (edgeLength <= FLT_EPSILON) continue;
+
+			XMFLOAT3 perpendicular;
+			XMStoreFloat3(&perpendicular, XMVector3Normalize(XMVector3Cross(edge, n)));
+			const double pd = -(perpendicular.x * positions[a].x + perpendicular.y * positions[a].y + perpendicular.z * positions[a].z);
+			const Quadric bq = Quadric::FromPlane(perpendicular.x, perpendicular.y, perpendicular.z, pd, BorderWeight * edgeLength * edgeLength);
+
+			quadrics[a].Add(bq);
+			quadrics[b].Add(bq);
+		}
+	}
+
+	//
+	// Collapses in passes of independent edges, cheapest first.
+	//
+	const double maxErrorSq = static_cast<double>(desc.MaxError) * desc.MaxError;
+	const size_t targetIndexCount = desc.TargetIndexCount - desc.TargetIndexCount % 3;
+
+	std::vector<std::uint32_t> vertexRemap(vertexCount);
+	std::vector<std::uint32_t> collapseTargets(positionCount);
+	std::vector<std::uint8_t> passLocked(positionCount);
+
+	std::vector<std::uint32_t> adjacencyOffsets;
+	std::vector<std::uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+
+	double resultErrorSq = 0.0;
+
+	// Sum over the source's wedges of the distance to their best match on the target, and the
+	//  matches themselves when outRemap is given.
+	auto attributeCost = [&](std::uint32_t from, std::uint32_t to, std::uint32_t* outRemap) {
+		double cost = 0.0;
+		for (std::uint32_t i = wedgeOffsets[from]; i < wedgeOffsets[from + 1]; ++i) {
+			const Vertex& source = pVertices[wedges[i]];
+
+			double best = DBL_MAX;
+			std::uint32_t bestVertex = wedges[wedgeOffsets[to]];
+			for (std::uint32_t j = wedgeOffsets[to]; j < wedgeOffsets[to + 1]; ++j) {
+				const Vertex& target = pVertices[wedges[j]];
+
+				const double nx = source.Normal.x - target.Normal.x;
+				const double ny = source.Normal.y - target.Normal.y;
+				const double nz = source.Normal.z - target.Normal.z;
+				const double u = source.TexC.x - target.TexC.x;
+				const double v = source.TexC.y - target.TexC.y;
+				const double distance = desc.NormalWeight * (nx * nx + ny * ny + nz * nz) + desc.TexCoordWeight * (u * u + v * v);
+
+				if (distance < best) {
+					best = distance;
+					bestVertex = wedges[j];
+				}
+			}
+
+			cost += best;
+			if (outRemap != nullptr) outRemap[wedges[i]] = bestVertex;
+		}
+		return cost;
+	};
+
+	auto canCollapse = [&](std::uint32_t from, std::uint32_t to) {
+		if (kinds[from] == ELocked) return false;
+		if (kinds[from] == EBorder) return std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(from, to));
+		return true;
+	};
+
+	// Rejects collapses that would turn any remaining face around from's position.
+	auto flipsTriangle = [&](std::uint32_t from, std::uint32_t to) {
+		for (std::uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i) {
+			const std::uint32_t t = adjacency[i];
+			std::uint32_t corners[3] = {
+				positionIds[outIndices[t * 3 + 0]],
+				positionIds[outIndices[t * 3 + 1]],
+				positionIds[outIndices[t * 3 + 2]]
+			};
+			if (corners[0] == to || corners[1] == to || corners[2] == to) continue;
+
+			const XMVECTOR before = FaceNormal(positions[corners[0]], positions[corners[1]], positions[corners[2]]);
+			for (size_t k = 0; k < 3; ++k) {
+				if (corners[k] == from) corners[k] = to;
+			}
+			const XMVECTOR after = FaceNormal(positions[corners[0]], positions[corners[1]], positions[corners[2]]);
+
+			const float dot = XMVectorGetX(XMVector3Dot(before, after));
+			const float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+			if (dot <= 0.25f * lengths) return true;
+		}
+		return false;
+	};
+
+	while (outIndices.size() > targetIndexCount) {
+		BuildAdjacency(outIndices, positionIds, positionCount, adjacencyOffsets, adjacency);
+
+		edgeKeys.clear();
+		for (size_t i = 0, end = outIndices.size(); i < end; i += 3) {
+			for (size_t k = 0; k < 3; ++k) {
+				const std::uint32_t a = positionIds[outIndices[i + k]];
+				const std::uint32_t b = positionIds[outIndices[i + (k + 1) % 3]];
+				edgeKeys.push_back(EdgeKey(a, b));
+			}
+		}
+		std::sort(edgeKeys.begin(), edgeKeys.end());
+		edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+
+		collapses.clear();
+		for (auto key : edgeKeys) {
+			const std::uint32_t a = static_cast<std::uint32_t>(key >> 32);
+			const std::uint32_t b = static_cast<std::uint32_t>(key);
+
+			Collapse best = { Invalid, Invalid, 0.0, DBL_MAX };
+			const std::uint32_t directions[2][2] = { { a, b }, { b, a } };
+			for (const auto& direction : directions) {
+				const std::uint32_t from = direction[0];
+				const std::uint32_t to = direction[1];
+				if (!canCollapse(from, to)) continue;
+
+				Quadric q = quadrics[from];
+				q.Add(quadrics[to]);
+
+				const double error = q.Error(positions[to]);
+				const double cost = error + attributeCost(from, to, nullptr);
+				if (cost < best.Cost) best = { from, to, error, cost };
+			}
+
+			if (best.From != Invalid && best.Error <= maxErrorSq) collapses.push_back(best);
+		}
+
+		if (collapses.empty()) break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+			return lhs.Cost < rhs.Cost;
+		});
+
+		for (size_t i = 0; i < vertexCount; ++i)
+			vertexRemap[i] = static_cast<std::uint32_t>(i);
+		for (UINT p = 0; p < positionCount; ++p)
+			collapseTargets[p] = p;
+		std::fill(passLocked.begin(), passLocked.end(), static_cast<std::uint8_t>(0));
+
+		// Most collapses remove two triangles.
+		const size_t collapseGoal = (outIndices.size() - targetIndexCount) / 6 + 1;
+		size_t collapseCount = 0;
+
+		for (const auto& collapse : collapses) {
+			if (collapseCount >= collapseGoal) break;
+			if (passLocked[collapse.From] || passLocked[collapse.To]) continue;
+			if (flipsTriangle(collapse.From, collapse.To)) continue;
+
+			attributeCost(collapse.From, collapse.To, vertexRemap.data());
+			collapseTargets[collapse.From] = collapse.To;
+			quadrics[collapse.To].Add(quadrics[collapse.From]);
+
+			// The one-ring changes shape, so its other collapses wait for the next pass.
+			for (std::uint32_t j = adjacencyOffsets[collapse.From]; j < adjacencyOffsets[collapse.From + 1]; ++j) {
+				const std::uint32_t t = adjacency[j];
+				for (size_t k = 0; k < 3; ++k)
+					passLocked[positionIds[outIndices[t * 3 + k]]] = 1;
+			}
+
+			resultErrorSq = std::max(resultErrorSq, collapse.Error);
+			++collapseCount;
+		}
+
+		if (collapseCount == 0) break;
+
+		size_t writeIndex = 0;
+		for (size_t i = 0, end = outIndices.size(); i < end; i += 3) {
+			std::uint32_t corners[3];
+			for (size_t k = 0; k < 3; ++k)
+				corners[k] = vertexRemap[outIndices[i + k]];
+
+			const std::uint32_t p0 = positionIds[corners[0]];
+			const std::uint32_t p1 = positionIds[corners[1]];
+			const std::uint32_t p2 = positionIds[corners[2]];
+			if (p0 == p1 || p1 == p2 || p2 == p0) continue;
+
+			outIndices[writeIndex++] = corners[0];
+			outIndices[writeIndex++] = corners[1];
+			outIndices[writeIndex++] = corners[2];
+		}
+		outIndices.resize(writeIndex);
+	}
+
+	return static_cast<float>(std::sqrt(resultErrorSq));
+}
+
+void MeshSimplifier::BuildLodChain(
+		const Vertex* pVertices, size_t vertexCount,
+		const std::uint32_t* pIndices, size_t indexCount,
+		UINT maxLevelCount, float ratio,
+		const SimplifyDesc& desc,
+		std::vector<LodLevel>& outLevels) {
+	outLevels.clear();
+
+	const float extent = CalcExtent(pVertices, vertexCount);
+
+	SimplifyDesc levelDesc = desc;
+	const std::uint32_t* pSource = pIndices;
+	size_t sourceCount = indexCount;
+	float sourceError = 0.0f;
+
+	for (UINT level = 0; level < maxLevelCount; ++level) {
+		levelDesc.TargetIndexCount = static_cast<size_t>(static_cast<float>(sourceCount) * ratio);
+
+		LodLevel lod;
+		const float error = Simplify(pVertices, vertexCount, pSource, sourceCount, levelDesc, lod.Indices);
+		if (lod.Indices.empty() || lod.Indices.size() * 10 > sourceCount * 9) break;
+
+		lod.Error = sourceError + error * extent;
+		outLevels.push_back(std::move(lod));
+
+		pSource = outLevels.back().Indices.data();
+		sourceCount = outLevels.back().Indices.size();
+		sourceError = outLevels.back().Error;
+	}
+}
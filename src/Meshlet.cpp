@@ -0,0 +1,337 @@
+#include "Meshlet.h"
+#include "Logger.h"
+#include "GeometryGenerator.h"
+#include "MeshOptimizer.h"
+#include "Stopwatch.h"
+#include "VectorMeshSink.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace {
+	const UINT Unused = 0xFFFFFFFF;
+
+	// Packed primitive indices are 10 bits wide; the D3D12 mesh shader limits are tighter still.
+	const UINT MaxMeshletVertices = 256;
+	const UINT MaxMeshletTriangles = 256;
+
+	// Cones wider than this (normals reaching within ~6 degrees of the cone's tangent plane)
+	//  almost never pass the test, so they are marked as never culled.
+	const float MinConeSpread = 0.1f;
+
+	void ComputeBounds(const Vertex* pVertices, const MeshletGeometry& geometry, const Meshlet& meshlet, MeshletBounds& outBounds) {
+		const UINT* uniqueIndices = geometry.UniqueVertexIndices.data() + meshlet.VertexOffset;
+
+		XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+		for (UINT i = 0; i < meshlet.VertexCount; ++i) {
+			const XMVECTOR pos = XMLoadFloat3(&pVertices[uniqueIndices[i]].Pos);
+			minimum = XMVectorMin(minimum, pos);
+			maximum = XMVectorMax(maximum, pos);
+		}
+
+		const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+		float radiusSq = 0.0f;
+		for (UINT i = 0; i < meshlet.VertexCount; ++i) {
+			const XMVECTOR pos = XMLoadFloat3(&pVertices[uniqueIndices[i]].Pos);
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(pos, center))));
+		}
+
+		XMStoreFloat3(&outBounds.Center, center);
+		outBounds.Radius = std::sqrt(radiusSq);
+
+		// Cone around the average of the unit face normals; degenerate triangles do not vote.
+		std::vector<XMFLOAT3> normals;
+		normals.reserve(meshlet.TriangleCount);
+
+		XMVECTOR axis = XMVectorZero();
+		for (UINT t = 0; t < meshlet.TriangleCount; ++t) {
+			UINT i0, i1, i2;
+			MeshletBuilder::UnpackTriangle(geometry.PrimitiveIndices[meshlet.TriangleOffset + t], i0, i1, i2);
+
+			const XMVECTOR p0 = XMLoadFloat3(&pVertices[uniqueIndices[i0]].Pos);
+			const XMVECTOR p1 = XMLoadFloat3(&pVertices[uniqueIndices[i1]].Pos);
+			const XMVECTOR p2 = XMLoadFloat3(&pVertices[uniqueIndices[i2]].Pos);
+
+			const XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			const float length = XMVectorGetX(XMVector3Length(n));
+			if (length <= FLT_EPSILON) continue;
+
+			const XMVECTOR unit = XMVectorScale(n, 1.0f / length);
+			normals.emplace_back();
+			XMStoreFloat3(&normals.back(), unit);
+			axis = XMVectorAdd(axis, unit);
+		}
+
+		outBounds.ConeAxis = { 0.0f, 0.0f, 1.0f };
+		outBounds.ConeCutoff = 1.0f;
+
+		const float axisLength = XMVectorGetX(XMVector3Length(axis));
+		if (normals.empty() || axisLength <= FLT_EPSILON) return;
+
+		axis = XMVectorScale(axis, 1.0f / axisLength);
+
+		float minDot = 1.0f;
+		for (const auto& n : normals)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&n), axis)));
+
+		XMStoreFloat3(&outBounds.ConeAxis, axis);
+		if (minDot > MinConeSpread)
+			outBounds.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	void TransposeBounds(MeshletGeometry& geometry) {
+		const size_t count = geometry.Bounds.size();
+		geometry.CullBounds.resize((count + 3) / 4);
+
+		for (size_t block = 0, end = geometry.CullBounds.size(); block < end; ++block) {
+			float lanes[8][4];
+			for (size_t lane = 0; lane < 4; ++lane) {
+				const size_t index = block * 4 + lane;
+				if (index < count) {
+					const auto& bounds = geometry.Bounds[index];
+					lanes[0][lane] = bounds.Center.x;
+					lanes[1][lane] = bounds.Center.y;
+					lanes[2][lane] = bounds.Center.z;
+					lanes[3][lane] = bounds.Radius;
+					lanes[4][lane] = bounds.ConeAxis.x;
+					lanes[5][lane] = bounds.ConeAxis.y;
+					lanes[6][lane] = bounds.ConeAxis.z;
+					lanes[7][lane] = bounds.ConeCutoff;
+				}
+				else {
+					for (size_t i = 0; i < 8; ++i)
+						lanes[i][lane] = 0.0f;
+					lanes[3][lane] = -INFINITY;
+					lanes[7][lane] = 1.0f;
+				}
+			}
+
+			auto& x4 = geometry.CullBounds[block];
+			x4.CenterX = XMVectorSet(lanes[0][0], lanes[0][1], lanes[0][2], lanes[0][3]);
+			x4.CenterY = XMVectorSet(lanes[1][0], lanes[1][1], lanes[1][2], lanes[1][3]);
+			x4.CenterZ = XMVectorSet(lanes[2][0], lanes[2][1], lanes[2][2], lanes[2][3]);
+			x4.Radius = XMVectorSet(lanes[3][0], lanes[3][1], lanes[3][2], lanes[3][3]);
+			x4.ConeAxisX = XMVectorSet(lanes[4][0], lanes[4][1], lanes[4][2], lanes[4][3]);
+			x4.ConeAxisY = XMVectorSet(lanes[5][0], lanes[5][1], lanes[5][2], lanes[5][3]);
+			x4.ConeAxisZ = XMVectorSet(lanes[6][0], lanes[6][1], lanes[6][2], lanes[6][3]);
+			x4.ConeCutoff = XMVectorSet(lanes[7][0], lanes[7][1], lanes[7][2], lanes[7][3]);
+		}
+	}
+}
+
+bool MeshletBuilder::Build(
+		const Vertex* pVertices, size_t vertexCount,
+		const std::uint32_t* pIndices, size_t indexCount,
+		MeshletGeometry& outGeometry,
+		UINT maxVertices,
+		UINT maxTriangles) {
+	if (maxVertices < 3 || maxVertices > MaxMeshletVertices) ReturnFalse(L"Meshlet vertex limit out of range");
+	if (maxTriangles < 1 || maxTriangles > MaxMeshletTriangles) ReturnFalse(L"Meshlet triangle limit out of range");
+	if (indexCount % 3 != 0) ReturnFalse(L"Meshlets require a triangle list");
+
+	outGeometry = MeshletGeometry();
+	outGeometry.UniqueVertexIndices.reserve(indexCount / 3);
+	outGeometry.PrimitiveIndices.reserve(indexCount / 3);
+
+	// Global vertex -> meshlet-local index for the meshlet being filled.
+	std::vector<UINT> localIndices(vertexCount, Unused);
+
+	Meshlet current = {};
+	auto flush = [&]() {
+		if (current.TriangleCount == 0) return;
+
+		for (UINT i = 0; i < current.VertexCount; ++i)
+			localIndices[outGeometry.UniqueVertexIndices[current.VertexOffset + i]] = Unused;
+
+		outGeometry.Meshlets.push_back(current);
+
+		current.VertexOffset = static_cast<UINT>(outGeometry.UniqueVertexIndices.size());
+		current.TriangleOffset = static_cast<UINT>(outGeometry.PrimitiveIndices.size());
+		current.VertexCount = 0;
+		current.TriangleCount = 0;
+	};
+
+	for (size_t i = 0; i < indexCount; i += 3) {
+		const std::uint32_t v0 = pIndices[i + 0];
+		const std::uint32_t v1 = pIndices[i + 1];
+		const std::uint32_t v2 = pIndices[i + 2];
+		if (v0 >= vertexCount || v1 >= vertexCount || v2 >= vertexCount) ReturnFalse(L"Index out of range while building meshlets");
+
+		const UINT newVertexCount =
+			(localIndices[v0] == Unused ? 1 : 0) +
+			(localIndices[v1] == Unused && v1 != v0 ? 1 : 0) +
+			(localIndices[v2] == Unused && v2 != v0 && v2 != v1 ? 1 : 0);
+
+		if (current.VertexCount + newVertexCount > maxVertices || current.TriangleCount == maxTriangles)
+			flush();
+
+		UINT local[3];
+		const std::uint32_t triangle[3] = { v0, v1, v2 };
+		for (size_t k = 0; k < 3; ++k) {
+			UINT& index = localIndices[triangle[k]];
+			if (index == Unused) {
+				index = current.VertexCount++;
+				outGeometry.UniqueVertexIndices.push_back(triangle[k]);
+			}
+			local[k] = index;
+		}
+
+		outGeometry.PrimitiveIndices.push_back(PackTriangle(local[0], local[1], local[2]));
+		++current.TriangleCount;
+	}
+	flush();
+
+	outGeometry.Bounds.resize(outGeometry.Meshlets.size());
+	for (size_t m = 0, end = outGeometry.Meshlets.size(); m < end; ++m)
+		ComputeBounds(pVertices, outGeometry, outGeometry.Meshlets[m], outGeometry.Bounds[m]);
+
+	TransposeBounds(outGeometry);
+
+	return true;
+}
+
+UINT MeshletCuller::Cull(
+		const MeshletGeometry& inGeometry,
+		FXMMATRIX worldViewProj,
+		FXMVECTOR eyePosL,
+		std::vector<UINT>& outVisible,
+		MeshletCullStats* pStats) {
+	// Clip planes in object space (Gribb/Hartmann, D3D depth range 0 <= z <= w); the rows of
+	//  the transpose are the columns of worldViewProj.
+	const XMMATRIX columns = XMMatrixTranspose(worldViewProj);
+	const XMVECTOR planes[6] = {
+		XMPlaneNormalize(XMVectorAdd(columns.r[3], columns.r[0])),
+		XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[0])),
+		XMPlaneNormalize(XMVectorAdd(columns.r[3], columns.r[1])),
+		XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[1])),
+		XMPlaneNormalize(columns.r[2]),
+		XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[2]))
+	};
+
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (size_t p = 0; p < 6; ++p) {
+		planeX[p] = XMVectorSplatX(planes[p]);
+		planeY[p] = XMVectorSplatY(planes[p]);
+		planeZ[p] = XMVectorSplatZ(planes[p]);
+		planeW[p] = XMVectorSplatW(planes[p]);
+	}
+
+	const XMVECTOR eyeX = XMVectorSplatX(eyePosL);
+	const XMVECTOR eyeY = XMVectorSplatY(eyePosL);
+	const XMVECTOR eyeZ = XMVectorSplatZ(eyePosL);
+
+	const size_t meshletCount = inGeometry.Meshlets.size();
+	const size_t firstVisible = outVisible.size();
+
+	for (size_t block = 0, end = inGeometry.CullBounds.size(); block < end; ++block) {
+		const MeshletBoundsX4& bounds = inGeometry.CullBounds[block];
+
+		// Outside if the sphere lies entirely behind any plane.
+		const XMVECTOR negRadius = XMVectorNegate(bounds.Radius);
+		XMVECTOR visible = XMVectorTrueInt();
+		for (size_t p = 0; p < 6; ++p) {
+			XMVECTOR distance = XMVectorMultiplyAdd(planeX[p], bounds.CenterX, planeW[p]);
+			distance = XMVectorMultiplyAdd(planeY[p], bounds.CenterY, distance);
+			distance = XMVectorMultiplyAdd(planeZ[p], bounds.CenterZ, distance);
+			visible = XMVectorAndInt(visible, XMVectorGreaterOrEqual(distance, negRadius));
+		}
+
+		const XMVECTOR toCenterX = XMVectorSubtract(bounds.CenterX, eyeX);
+		const XMVECTOR toCenterY = XMVectorSubtract(bounds.CenterY, eyeY);
+		const XMVECTOR toCenterZ = XMVectorSubtract(bounds.CenterZ, eyeZ);
+
+		XMVECTOR lengthSq = XMVectorMultiply(toCenterX, toCenterX);
+		lengthSq = XMVectorMultiplyAdd(toCenterY, toCenterY, lengthSq);
+		lengthSq = XMVectorMultiplyAdd(toCenterZ, toCenterZ, lengthSq);
+
+		XMVECTOR axisDot = XMVectorMultiply(toCenterX, bounds.ConeAxisX);
+		axisDot = XMVectorMultiplyAdd(toCenterY, bounds.ConeAxisY, axisDot);
+		axisDot = XMVectorMultiplyAdd(toCenterZ, bounds.ConeAxisZ, axisDot);
+
+		const XMVECTOR backfacing = XMVectorGreaterOrEqual(
+			axisDot, XMVectorMultiplyAdd(bounds.ConeCutoff, XMVectorSqrt(lengthSq), bounds.Radius));
+		visible = XMVectorAndCInt(visible, backfacing);
+
+		int mask = _mm_movemask_ps(visible);
+		for (UINT lane = 0; mask != 0; ++lane, mask >>= 1) {
+			if (mask & 1) outVisible.push_back(static_cast<UINT>(block * 4 + lane));
+		}
+	}
+
+	const UINT visibleCount = static_cast<UINT>(outVisible.size() - firstVisible);
+
+	if (pStats != nullptr) {
+		pStats->MeshletCount += static_cast<UINT>(meshletCount);
+		pStats->VisibleMeshletCount += visibleCount;
+		for (const auto& meshlet : inGeometry.Meshlets)
+			pStats->TriangleCount += meshlet.TriangleCount;
+		for (size_t i = firstVisible, end = outVisible.size(); i < end; ++i)
+			pStats->VisibleTriangleCount += inGeometry.Meshlets[outVisible[i]].TriangleCount;
+	}
+
+	return visibleCount;
+}
+
+bool MeshletCuller::RunBenchmark(UINT frameCount, UINT maxVertices, UINT maxTriangles) {
+	GeometryGenerator geoGen;
+
+	struct BenchmarkMesh {
+		const char* Name;
+		std::function<bool(GeometryGenerator::MeshSink&)> Generate;
+		float CameraDistance;
+	};
+	const BenchmarkMesh meshes[] = {
+		{ "sphere_512", [&](GeometryGenerator::MeshSink& sink) { return geoGen.CreateSphere(1.0f, 512, 512, sink); }, 3.0f },
+		{ "geosphere_6", [&](GeometryGenerator::MeshSink& sink) { return geoGen.CreateGeosphere(1.0f, 6, sink); }, 3.0f },
+		{ "grid_512", [&](GeometryGenerator::MeshSink& sink) { return geoGen.CreateGrid(32.0f, 32.0f, 512, 512, sink); }, 12.0f }
+	};
+
+	const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	for (const auto& mesh : meshes) {
+		std::vector<Vertex> vertices;
+		std::vector<std::uint32_t> indices;
+		VectorMeshSink sink(vertices, indices);
+		CheckIsValid(mesh.Generate(sink));
+
+		MeshOptimizer::Optimize(vertices, indices, MeshOptimizer::EVertexCache);
+
+		MeshletGeometry meshlets;
+		CheckIsValid(MeshletBuilder::Build(vertices.data(), vertices.size(), indices.data(), indices.size(), meshlets, maxVertices, maxTriangles));
+
+		MeshletCullStats stats;
+		std::vector<UINT> visible;
+		visible.reserve(meshlets.Meshlets.size());
+
+		double elapsedMs = 0.0;
+		for (UINT frame = 0; frame < frameCount; ++frame) {
+			const float phi = XM_2PI * static_cast<float>(frame) / static_cast<float>(frameCount);
+			const float distance = mesh.CameraDistance;
+			const XMVECTOR eye = XMVectorSet(distance * std::cos(phi), 0.5f * distance, distance * std::sin(phi), 1.0f);
+			const XMMATRIX view = XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+			visible.clear();
+
+			Stopwatch timer;
+			MeshletCuller::Cull(meshlets, XMMatrixMultiply(view, proj), eye, visible, &stats);
+			elapsedMs += timer.ElapsedMilliseconds();
+		}
+
+		const double frames = static_cast<double>(frameCount);
+		const double rejectedTriangles = static_cast<double>(stats.TriangleCount - stats.VisibleTriangleCount) / frames;
+		Logln("Meshlet culling ", mesh.Name, ": ", std::to_string(meshlets.Meshlets.size()), " meshlets, ",
+			std::to_string(indices.size() / 3), " triangles, ",
+			std::to_string(elapsedMs / frames), " ms/frame, ",
+			std::to_string(static_cast<double>(stats.MeshletCount - stats.VisibleMeshletCount) / frames), " meshlets and ",
+			std::to_string(rejectedTriangles), " triangles rejected/frame (",
+			std::to_string(100.0 * rejectedTriangles / static_cast<double>(indices.size() / 3)), "%)");
+	}
+
+	return true;
+}
@@ -0,0 +1,710 @@
+#include "ObjLoader.h"
+#include "Logger.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tinyobjloader/tiny_obj_loader.h>
+
+using namespace DirectX;
+
+namespace {
+	enum ERelativeIndex : std::uint8_t {
+		ERelativePosition	= 1 << 0,
+		ERelativeTexCoord	= 1 << 1,
+		ERelativeNormal		= 1 << 2
+	};
+
+	// Position/texcoord/normal indices of one triangle corner.
+	// Absolute indices are zero-based (-1 if missing); relative ones are flagged in
+	//  RelativeMask and still need the owning chunk's attribute base added.
+	struct FaceCorner {
+		std::int32_t	Index[3];
+		std::uint8_t	RelativeMask;
+	};
+
+	struct ChunkEvent {
+		enum Type {
+			EObject,
+			EGroup,
+			EUseMaterial
+		};
+
+		Type		EventType;
+		std::string	Name;
+		size_t		CornerOffset;
+	};
+
+	struct ObjChunk {
+		const char* Begin;
+		const char* End;
+
+		std::vector<XMFLOAT3> Positions;
+		std::vector<XMFLOAT2> TexCoords;
+		std::vector<XMFLOAT3> Normals;
+		std::vector<FaceCorner> Corners;
+		std::vector<ChunkEvent> Events;
+		std::vector<std::string> MaterialLibs;
+
+		size_t PositionBase;
+		size_t TexCoordBase;
+		size_t NormalBase;
+		size_t CornerBase;
+
+		// Whether object/group/material events and material libraries are recorded.
+		bool bSplitSubmeshes;
+		bool bLoadMaterials;
+		bool bFailed;
+	};
+
+	const double Pow10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	__forceinline bool IsSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	__forceinline bool IsDigit(char c) {
+		return static_cast<unsigned>(c - '0') < 10u;
+	}
+
+	__forceinline void SkipSpaces(const char*& p, const char* end) {
+		while (p < end && IsSpace(*p)) ++p;
+	}
+
+	// Parses a decimal float ([+-]digits[.digits][(e|E)[+-]digits]).
+	// Up to 19 significant digits are accumulated as an integer and scaled once by a
+	//  power of ten, which matches strtod to within an ulp for the values exporters write.
+	bool ParseFloat(const char*& p, const char* end, float& out) {
+		SkipSpaces(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+
+		std::uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		bool any = false;
+
+		while (p < end && IsDigit(*p)) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+				if (mantissa != 0) ++digits;
+			}
+			else {
+				++exponent;
+			}
+			++p;
+			any = true;
+		}
+
+		if (p < end && *p == '.') {
+			++p;
+			while (p < end && IsDigit(*p)) {
+				if (digits < 19) {
+					mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+					if (mantissa != 0) ++digits;
+					--exponent;
+				}
+				++p;
+				any = true;
+			}
+		}
+
+		if (!any) return false;
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			++p;
+			bool negativeExp = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExp = *p == '-';
+				++p;
+			}
+			int e = 0;
+			while (p < end && IsDigit(*p)) {
+				if (e < 10000) e = e * 10 + (*p - '0');
+				++p;
+			}
+			exponent += negativeExp ? -e : e;
+		}
+
+		double value = static_cast<double>(mantissa);
+		if (value != 0.0) {
+			while (exponent > 22) {
+				value *= 1e22;
+				exponent -= 22;
+			}
+			while (exponent < -22) {
+				value /= 1e22;
+				exponent += 22;
+			}
+			value = exponent < 0 ? value / Pow10[-exponent] : value * Pow10[exponent];
+		}
+
+		out = static_cast<float>(negative ? -value : value);
+		return true;
+	}
+
+	bool ParseInt(const char*& p, const char* end, int& out) {
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+
+		if (p >= end || !IsDigit(*p)) return false;
+
+		int value = 0;
+		while (p < end && IsDigit(*p)) {
+			const int digit = *p - '0';
+			// Rejected rather than wrapped into a plausible-looking index.
+			if (value > (INT_MAX - digit) / 10) return false;
+			value = value * 10 + digit;
+			++p;
+		}
+
+		out = negative ? -value : value;
+		return true;
+	}
+
+	bool ParseFloat3(const char*& p, const char* end, XMFLOAT3& out) {
+		return ParseFloat(p, end, out.x) && ParseFloat(p, end, out.y) && ParseFloat(p, end, out.z);
+	}
+
+	__forceinline bool MatchKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+		return static_cast<size_t>(end - p) > length && std::memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+	}
+
+	std::string ReadName(const char* p, const char* end) {
+		SkipSpaces(p, end);
+		while (end > p && IsSpace(end[-1])) --end;
+		return std::string(p, end);
+	}
+
+	// Converts a 1-based (or negative, relative) OBJ index into the FaceCorner encoding.
+	__forceinline std::int32_t ResolveIndex(int index, size_t localCount, std::uint8_t relativeFlag, std::uint8_t& mask) {
+		if (index > 0) return index - 1;
+		if (index < 0) {
+			mask |= relativeFlag;
+			return static_cast<std::int32_t>(localCount) + index;
+		}
+		return -1;
+	}
+
+	bool ParseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<FaceCorner>& polygon) {
+		polygon.clear();
+
+		while (true) {
+			SkipSpaces(p, end);
+			if (p >= end) break;
+
+			FaceCorner corner = { { -1, -1, -1 }, 0 };
+
+			int index;
+			if (!ParseInt(p, end, index)) return false;
+			corner.Index[0] = ResolveIndex(index, chunk.Positions.size(), ERelativePosition, corner.RelativeMask);
+
+			if (p < end && *p == '/') {
+				++p;
+				if (p < end && *p != '/') {
+					if (!ParseInt(p, end, index)) return false;
+					corner.Index[1] = ResolveIndex(index, chunk.TexCoords.size(), ERelativeTexCoord, corner.RelativeMask);
+				}
+				if (p < end && *p == '/') {
+					++p;
+					if (!ParseInt(p, end, index)) return false;
+					corner.Index[2] = ResolveIndex(index, chunk.Normals.size(), ERelativeNormal, corner.RelativeMask);
+				}
+			}
+
+			polygon.push_back(corner);
+		}
+
+		if (polygon.size() < 3) return false;
+
+		// Fan triangulation.
+		for (size_t i = 1, end = polygon.size() - 1; i < end; ++i) {
+			chunk.Corners.push_back(polygon[0]);
+			chunk.Corners.push_back(polygon[i]);
+			chunk.Corners.push_back(polygon[i + 1]);
+		}
+
+		return true;
+	}
+
+	void ParseChunk(ObjChunk& chunk) {
+		std::vector<FaceCorner> polygon;
+
+		const char* p = chunk.Begin;
+		while (p < chunk.End) {
+			const char* lineEnd = reinterpret_cast<const char*>(std::memchr(p, '\n', chunk.End - p));
+			if (lineEnd == nullptr) lineEnd = chunk.End;
+
+			const char* line = p;
+			p = lineEnd + 1;
+
+			SkipSpaces(line, lineEnd);
+			if (line >= lineEnd) continue;
+
+			switch (line[0]) {
+			case 'v':
+				if (MatchKeyword(line, lineEnd, "v", 1)) {
+					const char* q = line + 1;
+					XMFLOAT3 v;
+					if (!ParseFloat3(q, lineEnd, v)) {
+						chunk.bFailed = true;
+						return;
+					}
+					chunk.Positions.push_back(v);
+				}
+				else if (MatchKeyword(line, lineEnd, "vt", 2)) {
+					const char* q = line + 2;
+					XMFLOAT2 vt;
+					if (!ParseFloat(q, lineEnd, vt.x)) {
+						chunk.bFailed = true;
+						return;
+					}
+					if (!ParseFloat(q, lineEnd, vt.y)) vt.y = 0.0f;
+					chunk.TexCoords.push_back(vt);
+				}
+				else if (MatchKeyword(line, lineEnd, "vn", 2)) {
+					const char* q = line + 2;
+					XMFLOAT3 vn;
+					if (!ParseFloat3(q, lineEnd, vn)) {
+						chunk.bFailed = true;
+						return;
+					}
+					chunk.Normals.push_back(vn);
+				}
+				break;
+			case 'f':
+				if (MatchKeyword(line, lineEnd, "f", 1)) {
+					if (!ParseFace(line + 1, lineEnd, chunk, polygon)) {
+						chunk.bFailed = true;
+						return;
+					}
+				}
+				break;
+			case 'o':
+				if (chunk.bSplitSubmeshes && MatchKeyword(line, lineEnd, "o", 1))
+					chunk.Events.push_back({ ChunkEvent::EObject, ReadName(line + 1, lineEnd), chunk.Corners.size() });
+				break;
+			case 'g':
+				if (chunk.bSplitSubmeshes && MatchKeyword(line, lineEnd, "g", 1))
+					chunk.Events.push_back({ ChunkEvent::EGroup, ReadName(line + 1, lineEnd), chunk.Corners.size() });
+				break;
+			case 'u':
+				if (chunk.bSplitSubmeshes && MatchKeyword(line, lineEnd, "usemtl", 6))
+					chunk.Events.push_back({ ChunkEvent::EUseMaterial, ReadName(line + 6, lineEnd), chunk.Corners.size() });
+				break;
+			case 'm':
+				if (chunk.bLoadMaterials && MatchKeyword(line, lineEnd, "mtllib", 6))
+					chunk.MaterialLibs.push_back(ReadName(line + 6, lineEnd));
+				break;
+			default:
+				// Comments, smoothing groups, lines and points are ignored.
+				break;
+			}
+		}
+	}
+
+	// Splits [data, data + size) into ranges that start right after a newline.
+	void SplitChunks(const char* data, UINT64 size, UINT64 minChunkSize, std::vector<ObjChunk>& outChunks) {
+		const UINT64 targetCount = std::max<UINT64>(1, Parallel::WorkerCount() * 4);
+		const UINT64 chunkSize = std::max<UINT64>(minChunkSize, (size + targetCount - 1) / targetCount);
+
+		const char* end = data + size;
+		const char* begin = data;
+		while (begin < end) {
+			const char* split = begin + std::min<UINT64>(chunkSize, static_cast<UINT64>(end - begin));
+			if (split < end) {
+				const char* newline = reinterpret_cast<const char*>(std::memchr(split, '\n', end - split));
+				split = newline == nullptr ? end : newline + 1;
+			}
+
+			ObjChunk chunk = {};
+			chunk.Begin = begin;
+			chunk.End = split;
+			outChunks.push_back(std::move(chunk));
+
+			begin = split;
+		}
+	}
+
+	std::wstring DirectoryOf(const std::wstring& filename) {
+		const size_t pos = filename.find_last_of(L"/\\");
+		return pos == std::wstring::npos ? std::wstring() : filename.substr(0, pos + 1);
+	}
+
+	// Texture statements may carry options ("-bm 0.5", "-o 0 0 0", ...) before the file name,
+	//  and the file name itself may contain spaces.
+	std::string ReadMapName(const char* p, const char* end) {
+		SkipSpaces(p, end);
+		while (p < end && *p == '-') {
+			while (p < end && !IsSpace(*p)) ++p;
+			SkipSpaces(p, end);
+
+			float arg;
+			const char* q = p;
+			while (q < end && (IsDigit(*q) || *q == '-' || *q == '+' || *q == '.') && ParseFloat(q, end, arg) && (q >= end || IsSpace(*q))) {
+				SkipSpaces(q, end);
+				p = q;
+			}
+		}
+		return ReadName(p, end);
+	}
+
+	__forceinline double ToMegabytesPerSecond(UINT64 bytes, double elapsedMs) {
+		return elapsedMs > 0.0 ? (bytes / (1024.0 * 1024.0)) / (elapsedMs / 1000.0) : 0.0;
+	}
+}
+
+bool ObjLoader::Load(const std::wstring& inFilename, ObjMesh& outMesh, const ObjLoadDesc& inDesc, ObjLoadStats* pOutStats) {
+	Stopwatch mapTimer;
+
+	MappedFile file;
+	CheckIsValid(file.Open(inFilename));
+
+	const double mapMs = mapTimer.ElapsedMilliseconds();
+
+	CheckIsValid(Parse(file.Data(), file.Size(), inFilename, outMesh, inDesc, pOutStats));
+
+	if (pOutStats != nullptr) {
+		pOutStats->MapMilliseconds = mapMs;
+		pOutStats->TotalMilliseconds += mapMs;
+	}
+
+	return true;
+}
+
+bool ObjLoader::Parse(
+		const void* pData, UINT64 size,
+		const std::wstring& inFilename,
+		ObjMesh& outMesh,
+		const ObjLoadDesc& inDesc,
+		ObjLoadStats* pOutStats) {
+	ObjLoadStats stats;
+	Stopwatch totalTimer;
+	Stopwatch stageTimer;
+
+	const char* data = reinterpret_cast<const char*>(pData);
+	stats.FileSize = size;
+
+	//
+	// Parses line-aligned chunks in parallel.
+	//
+	std::vector<ObjChunk> chunks;
+	SplitChunks(data, size, inDesc.MinChunkSize, chunks);
+	stats.ChunkCount = chunks.size();
+
+	for (auto& chunk : chunks) {
+		chunk.bSplitSubmeshes = inDesc.SplitSubmeshes;
+		chunk.bLoadMaterials = inDesc.LoadMaterials;
+	}
+
+	Parallel::ForEach(chunks.size(), [&](size_t i) {
+		ParseChunk(chunks[i]);
+	});
+
+	for (size_t i = 0, end = chunks.size(); i < end; ++i) {
+		if (chunks[i].bFailed) {
+			std::wstringstream wsstream;
+			wsstream << L"Failed to parse " << inFilename << L" near byte " << (chunks[i].Begin - data);
+			ReturnFalse(wsstream.str());
+		}
+	}
+
+	stats.ParseMilliseconds = stageTimer.ElapsedMilliseconds();
+
+	//
+	// Prefix-sums the per-chunk counts and merges the attribute arrays.
+	//
+	stageTimer.Restart();
+
+	size_t positionCount = 0;
+	size_t texCoordCount = 0;
+	size_t normalCount = 0;
+	size_t cornerCount = 0;
+	for (auto& chunk : chunks) {
+		chunk.PositionBase = positionCount;
+		chunk.TexCoordBase = texCoordCount;
+		chunk.NormalBase = normalCount;
+		chunk.CornerBase = cornerCount;
+
+		positionCount += chunk.Positions.size();
+		texCoordCount += chunk.TexCoords.size();
+		normalCount += chunk.Normals.size();
+		cornerCount += chunk.Corners.size();
+	}
+
+	if (cornerCount > UINT32_MAX) ReturnFalse(L"Too many face corners: " + inFilename);
+
+	std::vector<XMFLOAT3> positions(positionCount);
+	std::vector<XMFLOAT2> texCoords(texCoordCount);
+	std::vector<XMFLOAT3> normals(normalCount);
+
+	Parallel::ForEach(chunks.size(), [&](size_t i) {
+		auto& chunk = chunks[i];
+		std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + chunk.PositionBase);
+		std::copy(chunk.TexCoords.begin(), chunk.TexCoords.end(), texCoords.begin() + chunk.TexCoordBase);
+		std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + chunk.NormalBase);
+
+		chunk.Positions = std::vector<XMFLOAT3>();
+		chunk.TexCoords = std::vector<XMFLOAT2>();
+		chunk.Normals = std::vector<XMFLOAT3>();
+	});
+
+	// Expands every triangle corner into the final Vertex layout.
+	std::vector<Vertex> corners(cornerCount);
+	std::atomic<bool> bIndexOutOfRange(false);
+
+	Parallel::ForEach(chunks.size(), [&](size_t i) {
+		auto& chunk = chunks[i];
+		Vertex* dst = corners.data() + chunk.CornerBase;
+
+		for (const auto& corner : chunk.Corners) {
+			Vertex vertex = {};
+
+			std::int64_t pos = corner.Index[0];
+			std::int64_t tex = corner.Index[1];
+			std::int64_t nrm = corner.Index[2];
+			if (corner.RelativeMask & ERelativePosition) pos += chunk.PositionBase;
+			if (corner.RelativeMask & ERelativeTexCoord) tex += chunk.TexCoordBase;
+			if (corner.RelativeMask & ERelativeNormal) nrm += chunk.NormalBase;
+
+			if (pos < 0 || pos >= static_cast<std::int64_t>(positionCount) ||
+				tex >= static_cast<std::int64_t>(texCoordCount) ||
+				nrm >= static_cast<std::int64_t>(normalCount)) {
+				bIndexOutOfRange = true;
+				return;
+			}
+
+			vertex.Pos = positions[static_cast<size_t>(pos)];
+			if (tex >= 0) vertex.TexC = texCoords[static_cast<size_t>(tex)];
+			if (nrm >= 0) vertex.Normal = normals[static_cast<size_t>(nrm)];
+
+			*dst++ = vertex;
+		}
+
+		chunk.Corners = std::vector<FaceCorner>();
+	});
+
+	if (bIndexOutOfRange) ReturnFalse(L"Face index out of range: " + inFilename);
+
+	positions = std::vector<XMFLOAT3>();
+	texCoords = std::vector<XMFLOAT2>();
+	normals = std::vector<XMFLOAT3>();
+
+	//
+	// Splits the index stream at object/group/material changes.
+	//
+	outMesh.Submeshes.clear();
+	outMesh.Materials.clear();
+
+	ObjSubmesh current;
+	current.Name = "default";
+
+	for (const auto& chunk : chunks) {
+		for (const auto& e : chunk.Events) {
+			const UINT offset = static_cast<UINT>(chunk.CornerBase + e.CornerOffset);
+			if (offset > current.StartIndexLocation) {
+				current.IndexCount = offset - current.StartIndexLocation;
+				outMesh.Submeshes.push_back(current);
+				current.StartIndexLocation = offset;
+			}
+
+			if (e.EventType == ChunkEvent::EUseMaterial) current.MaterialName = e.Name;
+			else current.Name = e.Name;
+		}
+	}
+	if (cornerCount > current.StartIndexLocation) {
+		current.IndexCount = static_cast<UINT>(cornerCount) - current.StartIndexLocation;
+		outMesh.Submeshes.push_back(current);
+	}
+
+	stats.TriangleCount = cornerCount / 3;
+	stats.MergeMilliseconds = stageTimer.ElapsedMilliseconds();
+
+	//
+	// Welds the corners into an indexed mesh.
+	//
+	stageTimer.Restart();
+
+	outMesh.Indices.clear();
+
+	VertexWelder welder(inDesc.WeldTolerance, cornerCount / 4);
+	welder.Insert(corners.data(), corners.size(), outMesh.Indices);
+	welder.Release(outMesh.Vertices);
+
+	stats.Weld = welder.Stats();
+	stats.WeldMilliseconds = stageTimer.ElapsedMilliseconds();
+
+	if (inDesc.LoadMaterials) {
+		const std::wstring directory = DirectoryOf(inFilename);
+
+		// Exporters repeat mtllib per object; each library is read once, in first-use order.
+		std::vector<std::string> libs;
+		for (const auto& chunk : chunks) {
+			for (const auto& lib : chunk.MaterialLibs) {
+				if (std::find(libs.begin(), libs.end(), lib) == libs.end()) libs.push_back(lib);
+			}
+		}
+
+		for (const auto& lib : libs) {
+			std::wstring libPath(lib.begin(), lib.end());
+			CheckIsValid(LoadMaterials(directory + libPath, outMesh.Materials));
+		}
+
+		for (auto& submesh : outMesh.Submeshes) {
+			for (size_t i = 0, end = outMesh.Materials.size(); i < end; ++i) {
+				if (outMesh.Materials[i].Name == submesh.MaterialName) {
+					submesh.MaterialIndex = static_cast<int>(i);
+					break;
+				}
+			}
+		}
+	}
+
+	stats.TotalMilliseconds = totalTimer.ElapsedMilliseconds();
+	if (pOutStats != nullptr) *pOutStats = stats;
+
+	return true;
+}
+
+bool ObjLoader::LoadMaterials(const std::wstring& inFilename, std::vector<ObjMaterial>& outMaterials) {
+	MappedFile file;
+	CheckIsValid(file.Open(inFilename));
+
+	const char* p = reinterpret_cast<const char*>(file.Data());
+	const char* end = p + file.Size();
+
+	ObjMaterial* material = nullptr;
+
+	while (p < end) {
+		const char* lineEnd = reinterpret_cast<const char*>(std::memchr(p, '\n', end - p));
+		if (lineEnd == nullptr) lineEnd = end;
+
+		const char* line = p;
+		p = lineEnd + 1;
+
+		SkipSpaces(line, lineEnd);
+		if (line >= lineEnd || *line == '#') continue;
+
+		if (MatchKeyword(line, lineEnd, "newmtl", 6)) {
+			ObjMaterial newMaterial;
+			newMaterial.Name = ReadName(line + 6, lineEnd);
+			outMaterials.push_back(newMaterial);
+			material = &outMaterials.back();
+			continue;
+		}
+
+		if (material == nullptr) continue;
+
+		const char* q;
+		if (MatchKeyword(line, lineEnd, "Ka", 2)) {
+			q = line + 2;
+			ParseFloat3(q, lineEnd, material->Ambient);
+		}
+		else if (MatchKeyword(line, lineEnd, "Kd", 2)) {
+			q = line + 2;
+			ParseFloat3(q, lineEnd, material->Diffuse);
+		}
+		else if (MatchKeyword(line, lineEnd, "Ks", 2)) {
+			q = line + 2;
+			ParseFloat3(q, lineEnd, material->Specular);
+		}
+		else if (MatchKeyword(line, lineEnd, "Ns", 2)) {
+			q = line + 2;
+			ParseFloat(q, lineEnd, material->Shininess);
+		}
+		else if (MatchKeyword(line, lineEnd, "d", 1)) {
+			q = line + 1;
+			ParseFloat(q, lineEnd, material->Dissolve);
+		}
+		else if (MatchKeyword(line, lineEnd, "map_Kd", 6)) {
+			material->DiffuseMap = ReadMapName(line + 6, lineEnd);
+		}
+		else if (MatchKeyword(line, lineEnd, "map_Bump", 8) || MatchKeyword(line, lineEnd, "map_bump", 8)) {
+			material->NormalMap = ReadMapName(line + 8, lineEnd);
+		}
+		else if (MatchKeyword(line, lineEnd, "bump", 4) || MatchKeyword(line, lineEnd, "norm", 4)) {
+			material->NormalMap = ReadMapName(line + 4, lineEnd);
+		}
+	}
+
+	return true;
+}
+
+bool ObjLoader::RunBenchmark(const std::wstring& inFilename, const ObjLoadStats& nativeStats) {
+	const std::string filename(inFilename.begin(), inFilename.end());
+	const std::string mtlBaseDir = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+	Stopwatch timer;
+
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str(), mtlBaseDir.c_str())) {
+		std::wstringstream wsstream;
+		wsstream << warn.c_str() << err.c_str();
+		ReturnFalse(wsstream.str());
+	}
+
+	const double parseMs = timer.ElapsedMilliseconds();
+
+	VertexWelder welder;
+	std::vector<std::uint32_t> indices;
+
+	for (const auto& shape : shapes) {
+		for (const auto& index : shape.mesh.indices) {
+			Vertex vertex = {};
+			vertex.Pos = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]
+			};
+			if (index.normal_index >= 0) {
+				vertex.Normal = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2]
+				};
+			}
+			if (index.texcoord_index >= 0) {
+				vertex.TexC = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1]
+				};
+			}
+			indices.push_back(welder.Insert(vertex));
+		}
+	}
+
+	const double totalMs = timer.ElapsedMilliseconds();
+
+	Logln("tinyobj ", filename, ": parse ", std::to_string(parseMs), " ms, total ", std::to_string(totalMs), " ms (",
+		std::to_string(ToMegabytesPerSecond(nativeStats.FileSize, totalMs)), " MB/s) vs native ",
+		std::to_string(nativeStats.TotalMilliseconds), " ms (",
+		std::to_string(ToMegabytesPerSecond(nativeStats.FileSize, nativeStats.TotalMilliseconds)), " MB/s)");
+
+	if (welder.Vertices().size() != nativeStats.Weld.UniqueVertexCount || indices.size() != nativeStats.TriangleCount * 3)
+		Logln("tinyobj ", filename, ": mesh differs from the native loader (", std::to_string(welder.Vertices().size()), " vertices, ",
+			std::to_string(indices.size()), " indices)");
+
+	return true;
+}
@@ -21,17 +21,45 @@
 #include "ShadingHelpers.h"
 #include "Debug.h"
 #include "BackBuffer.h"
-
+#include "VertexWelder.h"
+#include "ObjLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "VertexCompression.h"
+#include "IndexCompaction.h"
+#include "TangentGenerator.h"
+#include "GeometryPool.h"
+#include "AsyncMeshLoader.h"
+#include "SceneGenerator.h"
+#include "Bvh.h"
+#include "BvhCache.h"
+#include "BvhInspector.h"
+#include "Lbvh.h"
+#include "AnalyticBvh.h"
+#include "BvhTraversal.h"
+#include "TwoLevelBvh.h"
+#include "WideBvh.h"
+#include "RtaoReference.h"
+#include "ShadowReference.h"
+#include "Stopwatch.h"
+#include "Parallel.h"
+#include "VectorMeshSink.h"
+
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <d3dcompiler.h>
+#include <functional>
 
 #include <imgui.h>
 #include <backends/imgui_impl_win32.h>
 #include <backends/imgui_impl_dx12.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tinyobjloader/tiny_obj_loader.h>
-
 #undef min
 #undef max
 
@@ -70,6 +98,822 @@ namespace {
 
 	const DXGI_FORMAT NormalMapFormat = DXGI_FORMAT_R8G8B8A8_SNORM;
 	const DXGI_FORMAT SpecularMapFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	void LogWeldStats(const std::string& name, const VertexWelder::WeldStats& stats, double elapsedMs) {
+		const double mverts = elapsedMs > 0.0 ? stats.InputVertexCount / (elapsedMs * 1000.0) : 0.0;
+		const double probes = stats.InputVertexCount > 0 ? static_cast<double>(stats.ProbeCount) / stats.InputVertexCount : 0.0;
+
+		Logln("Welded ", name, ": ",
+			std::to_string(stats.InputVertexCount), " -> ", std::to_string(stats.UniqueVertexCount), " vertices in ",
+			std::to_string(elapsedMs), " ms (", std::to_string(mverts), " Mverts/s, ",
+			std::to_string(probes), " probes/vertex)");
+	}
+
+	__forceinline double ToMegabytesPerSecond(UINT64 bytes, double elapsedMs) {
+		return elapsedMs > 0.0 ? (bytes / (1024.0 * 1024.0)) / (elapsedMs / 1000.0) : 0.0;
+	}
+
+	void LogObjLoadStats(const std::string& name, const ObjLoadStats& stats) {
+		Logln("Loaded ", name, ": ",
+			std::to_string(stats.FileSize), " bytes, ", std::to_string(stats.TriangleCount), " triangles in ",
+			std::to_string(stats.TotalMilliseconds), " ms (", std::to_string(ToMegabytesPerSecond(stats.FileSize, stats.TotalMilliseconds)), " MB/s; ",
+			"map ", std::to_string(stats.MapMilliseconds), " ms, parse ", std::to_string(stats.ParseMilliseconds),
+			" ms over ", std::to_string(stats.ChunkCount), " chunks, merge ", std::to_string(stats.MergeMilliseconds), " ms)");
+
+		LogWeldStats(name, stats.Weld, stats.WeldMilliseconds);
+	}
+
+	void OptimizeMesh(const std::string& name, std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, UINT flags, UINT cacheSize) {
+		if (flags == MeshOptimizer::ENone) return;
+
+		const auto before = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), cacheSize);
+
+		Stopwatch timer;
+		MeshOptimizer::Optimize(vertices, indices, flags, cacheSize);
+		const double elapsedMs = timer.ElapsedMilliseconds();
+
+		const auto after = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), cacheSize);
+
+		Logln("Optimized ", name, " in ", std::to_string(elapsedMs), " ms: ACMR ",
+			std::to_string(before.ACMR), " -> ", std::to_string(after.ACMR), ", ATVR ",
+			std::to_string(before.ATVR), " -> ", std::to_string(after.ATVR));
+	}
+
+	void GenerateTangents(const std::string& name, std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices) {
+		Stopwatch timer;
+
+		TangentGenerationStats stats;
+		TangentGenerator::Generate(vertices, indices, &stats);
+
+		Logln("Generated tangents for ", name, " in ", std::to_string(timer.ElapsedMilliseconds()), " ms (",
+			std::to_string(stats.SplitVertexCount), " vertices split, ", std::to_string(stats.DegenerateTriangleCount), " degenerate triangles)");
+	}
+
+	std::string LodDrawArgName(const std::string& name, UINT level) {
+		return level == 0 ? name : name + "_lod" + std::to_string(level);
+	}
+
+	// Appends each simplified level to indices and registers it as name_lodN in drawArgs; levels
+	//  index the full-detail vertex buffer.
+	void BuildLods(
+			const std::string& name,
+			const std::vector<Vertex>& vertices,
+			std::vector<std::uint32_t>& indices,
+			UINT maxLevelCount, float ratio, const SimplifyDesc& desc, UINT cacheSize,
+			std::unordered_map<std::string, SubmeshGeometry>& drawArgs) {
+		if (maxLevelCount == 0) return;
+
+		Stopwatch timer;
+
+		std::vector<LodLevel> levels;
+		MeshSimplifier::BuildLodChain(vertices.data(), vertices.size(), indices.data(), indices.size(), maxLevelCount, ratio, desc, levels);
+
+		std::string report;
+		for (size_t i = 0, end = levels.size(); i < end; ++i) {
+			auto& level = levels[i];
+			MeshOptimizer::OptimizeVertexCache(level.Indices.data(), level.Indices.size(), vertices.size(), cacheSize);
+
+			SubmeshGeometry submesh;
+			submesh.IndexCount = static_cast<UINT>(level.Indices.size());
+			submesh.StartIndexLocation = static_cast<UINT>(indices.size());
+			submesh.BaseVertexLocation = 0;
+			submesh.LodError = level.Error;
+			drawArgs[LodDrawArgName(name, static_cast<UINT>(i + 1))] = submesh;
+
+			indices.insert(indices.end(), level.Indices.begin(), level.Indices.end());
+
+			report += " " + std::to_string(submesh.IndexCount / 3);
+		}
+
+		Logln("Built ", std::to_string(levels.size()), " LODs for ", name, " in ", std::to_string(timer.ElapsedMilliseconds()), " ms (triangles:", report, ")");
+	}
+
+	// Collects the LOD chain registered for the named submesh and the bounds used to pick a level.
+	void SetupLods(RenderItem* ritem, const std::string& name) {
+		const auto geo = ritem->Geo;
+
+		ritem->Lods.clear();
+		for (UINT level = 0; ; ++level) {
+			const auto iter = geo->DrawArgs.find(LodDrawArgName(name, level));
+			if (iter == geo->DrawArgs.end()) break;
+
+			RenderItemLod lod;
+			lod.IndexCount = iter->second.IndexCount;
+			lod.StartIndexLocation = iter->second.StartIndexLocation;
+			lod.BaseVertexLocation = iter->second.BaseVertexLocation;
+			lod.Error = iter->second.LodError;
+
+			const auto meshlets = geo->Meshlets.find(iter->first);
+			lod.Meshlets = meshlets != geo->Meshlets.end() ? &meshlets->second : nullptr;
+
+			ritem->Lods.push_back(lod);
+		}
+
+		ritem->LodIndex = 0;
+		ritem->Meshlets = ritem->Lods.empty() ? nullptr : ritem->Lods.front().Meshlets;
+
+		const Vertex* vertices = reinterpret_cast<const Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+		const size_t vertexCount = geo->VertexBufferCPU->GetBufferSize() / sizeof(Vertex);
+		BoundingSphere::CreateFromPoints(ritem->Bounds, vertexCount, &vertices[0].Pos, sizeof(Vertex));
+	}
+
+	// Stores indices in geo->IndexBufferCPU, 16 bits wide when every submesh in geo->DrawArgs fits
+	//  after rebasing; call once the draw arguments are complete.
+	bool CreateIndexBlob(MeshGeometry* geo, const std::vector<std::uint32_t>& indices, bool bAllow16Bit) {
+		std::vector<std::uint16_t> packed;
+		IndexCompactionStats stats;
+		if (bAllow16Bit && IndexCompaction::PackTo16Bit(indices.data(), indices.size(), geo->DrawArgs, packed, &stats)) {
+			const UINT ibByteSize = static_cast<UINT>(packed.size() * sizeof(std::uint16_t));
+
+			CheckHResult(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+			CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), packed.data(), ibByteSize);
+			geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+
+			Logln("Packed ", geo->Name, " indices to 16 bits: ", std::to_string(stats.SourceByteSize), " -> ",
+				std::to_string(stats.PackedByteSize), " bytes (", std::to_string(stats.RebasedSubmeshCount), " submeshes rebased)");
+
+			return true;
+		}
+
+		if (bAllow16Bit) Logln("Kept 32-bit indices for ", geo->Name, ": a submesh spans more than 65536 vertices");
+
+		const UINT ibByteSize = static_cast<UINT>(indices.size() * sizeof(std::uint32_t));
+
+		CheckHResult(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+
+		return true;
+	}
+
+	UINT IndexByteStride(DXGI_FORMAT format) {
+		return format == DXGI_FORMAT_R16_UINT ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+	}
+
+	// Generates straight into a geometry's CPU blobs, with 16-bit indices whenever the vertex
+	//  count allows.
+	class BlobMeshSink : public GeometryGenerator::MeshSink {
+	public:
+		BlobMeshSink(MeshGeometry* geo, bool bAllow16Bit) : mGeo(geo), bAllow16Bit(bAllow16Bit) {}
+
+		const GeometryGenerator::VertexLayout& Layout() const override { return GeneratorVertexLayout; }
+
+		bool Allocate(std::uint32_t vertexCount, std::uint32_t indexCount, void*& outVertices, void*& outIndices, bool& bOutIndices16) override {
+			bOutIndices16 = bAllow16Bit && vertexCount <= 0x10000;
+
+			const UINT indexStride = bOutIndices16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+			CheckHResult(D3DCreateBlob(vertexCount * sizeof(Vertex), &mGeo->VertexBufferCPU));
+			CheckHResult(D3DCreateBlob(indexCount * indexStride, &mGeo->IndexBufferCPU));
+
+			mGeo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
+			mGeo->IndexFormat = bOutIndices16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+			mIndexCount = indexCount;
+
+			outVertices = mGeo->VertexBufferCPU->GetBufferPointer();
+			outIndices = mGeo->IndexBufferCPU->GetBufferPointer();
+
+			return true;
+		}
+
+		__forceinline UINT IndexCount() const { return mIndexCount; }
+
+	private:
+		MeshGeometry* mGeo;
+		bool bAllow16Bit;
+		UINT mIndexCount = 0;
+	};
+
+	// Index count of an uploaded geometry without the padding a 16-bit buffer may carry.
+	size_t CalcIndexCount(const MeshGeometry* geo) {
+		size_t count = 0;
+		for (const auto& drawArg : geo->DrawArgs)
+			count = std::max<size_t>(count, drawArg.second.StartIndexLocation + drawArg.second.IndexCount);
+		return count - GeometryPool::IndexByteOffset(geo->PoolAllocation) / IndexByteStride(geo->IndexFormat);
+	}
+
+	// The full-detail range of a geometry's CPU buffers, which is what its BLAS covers.
+	BvhMesh GeometryBvhMesh(const MeshGeometry* geo) {
+		const auto& fullDetail = geo->DrawArgs.at(geo->Name);
+		const UINT indexStride = IndexByteStride(geo->IndexFormat);
+		// Draw arguments are pool-relative once the geometry is uploaded.
+		const UINT baseVertex = fullDetail.BaseVertexLocation - GeometryPool::VertexOffset(geo->PoolAllocation);
+		const UINT startIndex = fullDetail.StartIndexLocation - GeometryPool::IndexByteOffset(geo->PoolAllocation) / indexStride;
+
+		BvhMesh mesh;
+		mesh.Vertices = reinterpret_cast<const Vertex*>(geo->VertexBufferCPU->GetBufferPointer()) + baseVertex;
+		mesh.VertexCount = static_cast<UINT>(geo->VertexBufferCPU->GetBufferSize() / sizeof(Vertex)) - baseVertex;
+		mesh.Indices = reinterpret_cast<const std::uint8_t*>(geo->IndexBufferCPU->GetBufferPointer()) + static_cast<size_t>(startIndex) * indexStride;
+		mesh.IndexCount = fullDetail.IndexCount;
+		mesh.IndexStride = indexStride;
+		return mesh;
+	}
+
+	// Bakes instances of the shapes into one triangle soup in world space.
+	void FlattenInstances(const std::vector<SceneInstance>& instances, const std::vector<BvhMesh>& shapes,
+			std::vector<Vertex>& outVertices, std::vector<std::uint32_t>& outIndices) {
+		outVertices.clear();
+		outIndices.clear();
+
+		for (const auto& instance : instances) {
+			const BvhMesh& shape = shapes[instance.ShapeIndex];
+			const XMMATRIX world = XMLoadFloat4x4(&instance.World);
+			const std::uint32_t baseVertex = static_cast<std::uint32_t>(outVertices.size());
+			// Ray tracing decides facing in object space, so mirroring transforms keep their winding.
+			const bool bMirrored = XMVectorGetX(XMMatrixDeterminant(world)) < 0.0f;
+
+			for (UINT i = 0; i < shape.VertexCount; ++i) {
+				Vertex vertex = {};
+				XMStoreFloat3(&vertex.Pos, XMVector3TransformCoord(XMLoadFloat3(&shape.Position(i)), world));
+				outVertices.push_back(vertex);
+			}
+
+			for (UINT t = 0, end = shape.TriangleCount(); t < end; ++t) {
+				UINT i0, i1, i2;
+				shape.Triangle(t, i0, i1, i2);
+				if (bMirrored) std::swap(i1, i2);
+				outIndices.push_back(baseVertex + i0);
+				outIndices.push_back(baseVertex + i1);
+				outIndices.push_back(baseVertex + i2);
+			}
+		}
+	}
+
+	// DXGI_FORMAT_D24_UNORM_S8_UINT texel: 24-bit UNORM depth in the low bits, stencil in the high byte.
+	__forceinline float DecodeDepthStencilTexel(UINT texel) {
+		return static_cast<float>(texel & 0xFFFFFF) / 16777215.0f;
+	}
+
+	// Fills Lights[1, lightCount) with copies of the first light turned evenly about the world y-axis,
+	//  so every light keeps its elevation.
+	void SpreadDirectionalLights(PassConstants& cb, UINT lightCount) {
+		const Light& first = cb.Lights[0];
+		for (UINT i = 1; i < lightCount; ++i) {
+			const XMMATRIX rotation = XMMatrixRotationY(XM_2PI * static_cast<float>(i) / static_cast<float>(lightCount));
+
+			Light& light = cb.Lights[i];
+			light = first;
+			XMStoreFloat3(&light.Direction, XMVector3TransformNormal(XMLoadFloat3(&first.Direction), rotation));
+		}
+	}
+
+	void ReportGeometryPool(const GeometryPool& pool) {
+		const auto vertexStats = pool.VertexStats();
+		const auto indexStats = pool.IndexStats();
+
+		Logln("Geometry pool: ", std::to_string(vertexStats.AllocationCount), " geometries, ",
+			std::to_string(vertexStats.UsedSize), "/", std::to_string(vertexStats.Capacity), " vertices, ",
+			std::to_string(indexStats.UsedSize * sizeof(UINT)), "/", std::to_string(indexStats.Capacity * sizeof(UINT)), " index bytes");
+	}
+
+	void ReportIndexCompaction(const std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& geometries) {
+		size_t wideByteSize = 0;
+		size_t byteSize = 0;
+		UINT packedCount = 0;
+
+		for (const auto& pair : geometries) {
+			const MeshGeometry* geo = pair.second.get();
+
+			wideByteSize += CalcIndexCount(geo) * sizeof(std::uint32_t);
+			byteSize += geo->IndexBufferCPU->GetBufferSize();
+			if (geo->IndexFormat == DXGI_FORMAT_R16_UINT) ++packedCount;
+		}
+
+		if (wideByteSize == 0) return;
+
+		Logln("Index buffers: ", std::to_string(packedCount), " of ", std::to_string(geometries.size()), " geometries 16-bit, ",
+			std::to_string(byteSize), " bytes instead of ", std::to_string(wideByteSize), " (",
+			std::to_string(wideByteSize - std::min(wideByteSize, byteSize)), " bytes saved)");
+	}
+
+	bool BuildMeshlets(MeshGeometry* geo, UINT maxVertices, UINT maxTriangles) {
+		const Vertex* vertices = reinterpret_cast<const Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+		const size_t vertexCount = geo->VertexBufferCPU->GetBufferSize() / sizeof(Vertex);
+
+		std::vector<std::uint32_t> wideIndices;
+		for (const auto& drawArg : geo->DrawArgs) {
+			const auto& submesh = drawArg.second;
+
+			const std::uint32_t* indices = nullptr;
+			if (geo->IndexFormat == DXGI_FORMAT_R16_UINT) {
+				const std::uint16_t* narrowIndices =
+					reinterpret_cast<const std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer()) + submesh.StartIndexLocation;
+				wideIndices.assign(narrowIndices, narrowIndices + submesh.IndexCount);
+				indices = wideIndices.data();
+			}
+			else {
+				indices = reinterpret_cast<const std::uint32_t*>(geo->IndexBufferCPU->GetBufferPointer()) + submesh.StartIndexLocation;
+			}
+
+			CheckIsValid(MeshletBuilder::Build(
+				vertices + submesh.BaseVertexLocation, vertexCount - submesh.BaseVertexLocation,
+				indices, submesh.IndexCount,
+				geo->Meshlets[drawArg.first],
+				maxVertices, maxTriangles));
+		}
+
+		return true;
+	}
+
+	// Logs what PackedVertex would save per geometry and what it would lose in precision.
+	void ReportVertexCompression(const std::unordered_map<std::string, std::unique_ptr<MeshGeometry>>& geometries) {
+		size_t sourceByteSize = 0;
+		size_t packedByteSize = 0;
+
+		for (const auto& pair : geometries) {
+			const MeshGeometry* geo = pair.second.get();
+			if (geo->VertexByteStride != sizeof(Vertex)) continue;
+
+			const Vertex* vertices = reinterpret_cast<const Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+			const size_t vertexCount = geo->VertexBufferCPU->GetBufferSize() / sizeof(Vertex);
+
+			Stopwatch timer;
+			const auto report = VertexCompression::Analyze(vertices, vertexCount);
+			const double elapsedMs = timer.ElapsedMilliseconds();
+
+			Logln("Vertex compression ", geo->Name, ": ", std::to_string(report.VertexCount), " vertices, ",
+				std::to_string(report.SourceByteSize), " -> ", std::to_string(report.PackedByteSize), " bytes in ",
+				std::to_string(elapsedMs), " ms, position error max ", std::to_string(report.MaxPositionError),
+				" mean ", std::to_string(report.MeanPositionError), ", normal ", std::to_string(report.MaxNormalError),
+				" deg, tangent ", std::to_string(report.MaxTangentError), " deg (", std::to_string(report.TangentSignMismatchCount),
+				" handedness flips), texcoord ", std::to_string(report.MaxTexCoordError));
+
+			sourceByteSize += report.SourceByteSize;
+			packedByteSize += report.PackedByteSize;
+		}
+
+		if (sourceByteSize == 0) return;
+
+		Logln("Vertex compression total: ", std::to_string(sourceByteSize), " -> ", std::to_string(packedByteSize), " bytes (",
+			std::to_string(100.0 * static_cast<double>(sourceByteSize - packedByteSize) / static_cast<double>(sourceByteSize)), "% saved)");
+	}
+
+	// Nonzero buckets as "bucket:count", the last leaf-size bucket marked as open-ended.
+	std::string FormatHistogram(const std::vector<UINT>& histogram, bool bOpenEnded) {
+		std::string text;
+		for (size_t i = 0; i < histogram.size(); ++i) {
+			if (histogram[i] == 0) continue;
+			if (!text.empty()) text += " ";
+			text += std::to_string(i) + (bOpenEnded && i + 1 == histogram.size() ? "+:" : ":") + std::to_string(histogram[i]);
+		}
+		return text;
+	}
+
+	void LogStructureStats(const std::string& name, const BvhStructureStats& stats) {
+		Logln(name, " structure: SAH cost ", std::to_string(stats.SahCost), ", sibling overlap ", std::to_string(stats.SiblingOverlap),
+			" (worst ", std::to_string(stats.MaxSiblingOverlap), "), leaf depth avg ", std::to_string(stats.AverageLeafDepth),
+			" max ", std::to_string(stats.MaxDepth));
+		Logln("    leaf sizes ", FormatHistogram(stats.LeafSizeHistogram, true));
+		Logln("    leaf depths ", FormatHistogram(stats.LeafDepthHistogram, false));
+	}
+}
+
+namespace MeshArgs {
+	// Zero welds bit-exactly; otherwise the grid cell size used to snap each attribute.
+	namespace VertexWeld {
+		float PositionTolerance = 0.0f;
+		float NormalTolerance = 0.0f;
+		float TexCoordTolerance = 0.0f;
+	}
+
+	namespace ObjLoad {
+		// Also runs the tinyobjloader path on every loaded OBJ and logs both throughputs.
+		bool CompareWithTinyObj = false;
+	}
+
+	// Baked .meshbin files written next to the source OBJ.
+	namespace Cache {
+		bool Enabled = true;
+		// Recomputes the content hash and range-checks every index on load.
+		bool Validate = false;
+		// Also parses the source OBJ after a cache hit and logs both load times.
+		bool CompareWithObj = false;
+	}
+
+	// Imported meshes are parsed on worker threads while a placeholder box stands in for them.
+	namespace AsyncLoad {
+		bool Enabled = true;
+		// Zero keeps one hardware thread for rendering and gives the rest to the loader.
+		UINT WorkerCount = 0;
+		// Bounds the estimated working set of every load in flight or waiting for upload.
+		UINT64 MemoryBudget = 256ull << 20;
+		// Bytes reserved per byte of OBJ text.
+		float WorkingSetFactor = 8.0f;
+		// Chrome trace of every load stage, written once the last requested mesh is uploaded.
+		bool WriteTrace = false;
+		std::wstring TraceFilename = L"./load_trace.json";
+		// Loads VerifyMeshCount copies of the monkey on their own loader and fails initialization
+		//  unless each matches a synchronous load.
+		bool Verify = false;
+		UINT VerifyMeshCount = 4;
+		// Loads StressMeshCount copies of the monkey concurrently under StressMemoryBudget and
+		//  checks each against a synchronous load.
+		bool RunStressTest = false;
+		UINT StressMeshCount = 48;
+		UINT64 StressMemoryBudget = 4ull << 20;
+	}
+
+	// MeshOptimizer::Flags per geometry; imported meshes bake the result into their cache.
+	namespace Optimize {
+		UINT CacheSize = MeshOptimizer::DefaultCacheSize;
+		UINT SphereFlags = MeshOptimizer::EAll;
+		// The flat ground grid is already in row order and skips the optimizer, so it is generated
+		//  straight into its blobs.
+		UINT GridFlags = MeshOptimizer::ENone;
+		UINT MonkeyFlags = MeshOptimizer::EAll;
+	}
+
+	namespace Tangents {
+		// Imported meshes only; generated shapes come with analytic tangents.
+		bool Generate = true;
+		bool RunBenchmark = false;
+		UINT BenchmarkIterationCount = 4;
+	}
+
+	namespace Generator {
+		// Times large generated grids and spheres through MeshData and straight into blobs.
+		bool RunBenchmark = false;
+		UINT BenchmarkGridSize = 1024;
+		UINT BenchmarkSphereSize = 1024;
+	}
+
+	namespace Subdivision {
+		// Logs GeometryGenerator's subdivided shapes at every depth up to BenchmarkMaxDepth.
+		bool RunBenchmark = false;
+		UINT BenchmarkMaxDepth = GeometryGenerator::MaxSubdivisions;
+	}
+
+	namespace Meshlets {
+		UINT MaxVertices = DefaultMeshletMaxVertices;
+		UINT MaxTriangles = DefaultMeshletMaxTriangles;
+		// Runs the CPU cluster culler against the camera every frame (statistics only).
+		bool CullEnabled = false;
+		bool RunCullBenchmark = false;
+		UINT CullBenchmarkFrameCount = 256;
+	}
+
+	namespace Lod {
+		UINT MaxLevelCount = 4;
+		// The ground grid stays close to the camera and keeps full detail.
+		UINT GridLevelCount = 0;
+		// Target index count of each level relative to the previous one.
+		float Ratio = 0.5f;
+		// Geometric error allowed per level, relative to the mesh extent.
+		float MaxError = 0.05f;
+		float NormalWeight = 0.5f;
+		float TexCoordWeight = 1.0f;
+		bool LockBorders = false;
+		// Coarsest level whose error projects to at most this many pixels is drawn.
+		float MaxScreenSpaceError = 1.0f;
+	}
+
+	// Shared vertex/index arenas every geometry is sub-allocated from.
+	namespace Pool {
+		UINT VertexCapacity = 1 << 20;
+		UINT IndexByteCapacity = 1 << 24;
+		bool RunChurnBenchmark = false;
+		UINT ChurnOperationCount = 1 << 20;
+		float ChurnTargetOccupancy = 0.7f;
+	}
+
+	// Generated instances scattered around the hand-placed scene; the -benchmark command line
+	//  rebuilds it at growing sizes.
+	namespace Scene {
+		UINT InstanceCount = 0;
+		UINT Seed = 1;
+		// Instances per square unit of ground.
+		float Density = 0.25f;
+	}
+
+	// CPU BVHs mirroring every geometry's BLAS.
+	namespace CpuBvh {
+		// CPU BVHs of every geometry; the CPU TLAS and the CPU ray-tracing benchmarks need them.
+		bool Build = false;
+		UINT BinCount = 16;
+		UINT MaxLeafSize = 8;
+		// Logs build time and SAH cost per geometry.
+		bool Report = false;
+		// Geometries built with the Morton-code LBVH instead of binned SAH: quicker to rebuild,
+		//  slower to trace.
+		std::vector<std::string> LinearBuildGeometries = {};
+		bool LinearUse63BitCodes = false;
+		bool LinearRotate = true;
+		// Also builds every geometry with the other builder and logs throughput and the SAH
+		//  cost ratio, to pick LinearBuildGeometries from; skipped for hierarchies loaded from Cache.
+		bool CompareLinearBuilds = false;
+		// Times both builders, and LBVH code widths with and without rotations, on a sphere of
+		//  BenchmarkSphereSize.
+		bool RunBenchmark = false;
+		UINT BenchmarkSphereSize = 2048;
+		// Loads hierarchies from CacheDirectory when one was saved for the same vertices, indices
+		//  and build settings, and saves every hierarchy it has to build except placeholders'.
+		bool Cache = false;
+		// Recomputes the content hash and range-checks every node on load.
+		bool ValidateCache = true;
+		std::wstring CacheDirectory = L"./bvhcache/";
+		// After each save, the least recently loaded or saved files are deleted until the rest fit.
+		UINT64 CacheMaxBytes = 256ull << 20;
+		// Times building, saving and loading, with and without validation, on the same sphere.
+		bool RunCacheBenchmark = false;
+	}
+
+	// CPU two-level hierarchy over the opaque render items, mirroring the TLAS over the CPU BVHs.
+	namespace CpuTlas {
+		bool Build = false;
+		// Times rebuilds against refits of stress scenes from BenchmarkMinInstanceCount up to
+		//  BenchmarkMaxInstanceCount, ten times larger each step, once every mesh is loaded.
+		bool RunBenchmark = false;
+		UINT BenchmarkMinInstanceCount = 10000;
+		UINT BenchmarkMaxInstanceCount = 1000000;
+		// Largest move along each axis between the build and a refit.
+		float BenchmarkDrift = 1.0f;
+		// Instances moved for the incremental refit.
+		float BenchmarkMovingFraction = 0.01f;
+	}
+
+	// Analytic stand-ins in the CPU two-level hierarchy.
+	namespace Analytic {
+		// Traces the three spheres of the static scene as spheres instead of their triangles.
+		bool Spheres = true;
+		// Traces the same rays through a field of tessellated and of analytic spheres, logging
+		//  memory, Mrays/s and how often the two disagree.
+		bool RunBenchmark = false;
+		UINT BenchmarkInstanceCount = 10000;
+		UINT BenchmarkRayCount = 1 << 20;
+		float BenchmarkAoRadius = 0.5f;
+	}
+
+	// Where the CPU hierarchies spend their traversal time.
+	namespace BvhInspect {
+		// Logs the leaf-size and leaf-depth histograms and sibling overlap of every CPU BVH and of
+		//  the CPU TLAS's top level.
+		bool ReportStructure = false;
+		// Traces the CPU TLAS from the camera of the ray-traced frame whose RtaoConstants::FrameCount
+		//  matches and writes nodes, triangles and instances visited per pixel; zero disables it.
+		//  Needs CpuBvh::Build and CpuTlas::Build.
+		UINT HeatmapFrame = 0;
+		UINT HeatmapWidth = 640;
+		UINT HeatmapHeight = 360;
+		std::wstring NodeHeatmapFilename = L"./heatmap_nodes.pfm";
+		std::wstring TriangleHeatmapFilename = L"./heatmap_triangles.pfm";
+		std::wstring InstanceHeatmapFilename = L"./heatmap_instances.pfm";
+	}
+
+	// CPU ray queries against the CPU BVHs.
+	namespace RayTraversal {
+		// Traces primary and AO rays against the monkey and a flattened stress scene once every
+		//  mesh is loaded, logging Mrays/s for single rays, packets and the eight-wide layout, and
+		//  the memory of both layouts.
+		bool RunBenchmark = false;
+		UINT BenchmarkWidth = 640;
+		UINT BenchmarkHeight = 360;
+		UINT BenchmarkAoSampleCount = 4;
+		// Fraction of the scene's bounding radius.
+		float BenchmarkAoRadius = 0.1f;
+		UINT BenchmarkStressInstanceCount = 64;
+	}
+
+	// CPU reference of the RTAO ray-generation pass.
+	namespace CpuRtao {
+		// Reads back the ray-traced frame whose RtaoConstants::FrameCount matches, reruns the pass
+		//  on the CPU over its G-buffer and logs rays/s and the differences; zero disables it.
+		UINT CompareFrame = 0;
+		// Relative to max(1, |GPU value|); the GPU writes 16-bit floats.
+		float Tolerance = 1.0f / 512.0f;
+		// Dumps both frames for RtaoReference::Read.
+		bool WriteFrames = true;
+		std::wstring GpuFrameFilename = L"./rtao_gpu.bin";
+		std::wstring CpuFrameFilename = L"./rtao_cpu.bin";
+		// Ray scheduling of the compared frame; see RtaoTraceDesc.
+		bool Packets = false;
+		bool SortRays = false;
+		// Then retraces the captured frame at 1, 2, 4, ... up to this many samples per pixel with
+		//  single rays and packets, each unsorted and sorted; zero skips it.
+		UINT BenchmarkMaxSamplesPerPixel = 8;
+	}
+
+	// CPU reference of the ray-traced shadow pass.
+	namespace CpuShadow {
+		// Skips the blur of the ray-traced frame whose RtaoConstants::FrameCount matches, reads back
+		//  its depth and shadow mask, reruns the pass on the CPU and logs rays/s and the differences;
+		//  zero disables it.
+		UINT CompareFrame = 0;
+		// The GPU writes 16-bit UNORM factors.
+		float Tolerance = 1.0f / 1024.0f;
+		bool WriteFrames = true;
+		std::wstring GpuFrameFilename = L"./shadow_gpu.bin";
+		std::wstring CpuFrameFilename = L"./shadow_cpu.bin";
+		// Then traces the captured frame against 1, 2, 4, ... up to this many directional lights
+		//  spread around the scene's light; zero skips it.
+		UINT BenchmarkMaxLightCount = MaxLights;
+	}
+
+	namespace IndexFormat {
+		// Packs a geometry's indices to 16 bits whenever each submesh spans at most 65536 vertices.
+		bool Allow16Bit = true;
+	}
+
+	namespace VertexCompression {
+		// Logs the packed vertex format's savings and round-trip error for every geometry.
+		bool Report = false;
+	}
+}
+
+namespace {
+	// Shapes the stress scene scatters: a generated one and an imported one.
+	const char* const StressSceneShapes[] = { "sphere", "monkey" };
+
+	struct AnalyticStandIn {
+		const char* Geometry;
+		AnalyticPrimitive Primitive;
+	};
+
+	// In the geometry's object space; "sphere" is CreateSphere with radius 1.
+	const AnalyticStandIn AnalyticStandIns[] = {
+		{ "sphere", { AnalyticPrimitive::ESphere, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f } }
+	};
+
+	SimplifyDesc LodSimplifyDesc() {
+		SimplifyDesc desc;
+		desc.MaxError = MeshArgs::Lod::MaxError;
+		desc.NormalWeight = MeshArgs::Lod::NormalWeight;
+		desc.TexCoordWeight = MeshArgs::Lod::TexCoordWeight;
+		desc.LockBorders = MeshArgs::Lod::LockBorders;
+		return desc;
+	}
+
+	BvhBuildDesc CpuBvhBuildDesc() {
+		BvhBuildDesc desc;
+		desc.BinCount = MeshArgs::CpuBvh::BinCount;
+		desc.MaxLeafSize = MeshArgs::CpuBvh::MaxLeafSize;
+		return desc;
+	}
+
+	LbvhBuildDesc CpuLbvhBuildDesc() {
+		LbvhBuildDesc desc;
+		desc.Use63BitCodes = MeshArgs::CpuBvh::LinearUse63BitCodes;
+		desc.Rotate = MeshArgs::CpuBvh::LinearRotate;
+		desc.MaxLeafSize = MeshArgs::CpuBvh::MaxLeafSize;
+		return desc;
+	}
+
+	bool UsesLinearBuild(const std::string& geometryName) {
+		const auto& names = MeshArgs::CpuBvh::LinearBuildGeometries;
+		return std::find(names.begin(), names.end(), geometryName) != names.end();
+	}
+
+	// A failed write only costs the next launch another build.
+	void WriteBvhCache(const std::wstring& cacheFilename, UINT64 key, const Bvh& bvh) {
+		CreateDirectoryW(MeshArgs::CpuBvh::CacheDirectory.c_str(), nullptr);
+		if (!BvhCache::Write(cacheFilename, key, bvh)) {
+			WLogln(L"Failed to save BVH cache: ", cacheFilename);
+			return;
+		}
+		BvhCache::Trim(MeshArgs::CpuBvh::CacheDirectory, MeshArgs::CpuBvh::CacheMaxBytes);
+	}
+
+	ObjLoadDesc MeshLoadDesc() {
+		ObjLoadDesc desc;
+		desc.WeldTolerance = VertexWelder::WeldTolerance(
+			MeshArgs::VertexWeld::PositionTolerance,
+			MeshArgs::VertexWeld::NormalTolerance,
+			MeshArgs::VertexWeld::TexCoordTolerance);
+		// BuildObjGeometry draws the whole mesh as one submesh with a renderer material.
+		desc.SplitSubmeshes = false;
+		desc.LoadMaterials = false;
+		return desc;
+	}
+
+	std::wstring MeshCacheFilename(const std::wstring& inFilename) {
+		return inFilename.substr(0, inFilename.find_last_of(L'.')) + L".meshbin";
+	}
+
+	// Returns false when the source file cannot be queried; the bake flags and settings hash are set
+	//  either way.
+	bool QueryMeshSource(const std::wstring& inFilename, UINT optimizeFlags, UINT lodLevelCount, MeshCache::SourceInfo& outSource) {
+		const bool bHasSource = MeshCache::QuerySourceInfo(inFilename, outSource);
+		// Low half: MeshOptimizer::Flags with bit 14 set when tangents are generated and bit 15 when
+		//  16-bit indices are allowed, high half: LOD level count.
+		outSource.BakeFlags = (optimizeFlags & 0x3FFF) |
+			(MeshArgs::Tangents::Generate ? 0x4000 : 0) |
+			(MeshArgs::IndexFormat::Allow16Bit ? 0x8000 : 0) |
+			(lodLevelCount << 16);
+
+		const float weldTolerances[] = {
+			MeshArgs::VertexWeld::PositionTolerance,
+			MeshArgs::VertexWeld::NormalTolerance,
+			MeshArgs::VertexWeld::TexCoordTolerance
+		};
+		UINT64 hash = MeshCache::HashBytes(weldTolerances, sizeof(weldTolerances));
+		hash = MeshCache::HashBytes(&MeshArgs::Optimize::CacheSize, sizeof(MeshArgs::Optimize::CacheSize), hash);
+
+		const float lodSettings[] = {
+			MeshArgs::Lod::Ratio,
+			MeshArgs::Lod::MaxError,
+			MeshArgs::Lod::NormalWeight,
+			MeshArgs::Lod::TexCoordWeight,
+			MeshArgs::Lod::LockBorders ? 1.0f : 0.0f
+		};
+		hash = MeshCache::HashBytes(lodSettings, sizeof(lodSettings), hash);
+		outSource.SettingsHash = hash;
+
+		return bHasSource;
+	}
+
+	// Everything between parsing an OBJ and uploading it; touches no renderer state, so the
+	//  asynchronous loader runs it on its worker threads.
+	using GenerateMeshFunc = std::function<bool(GeometryGenerator::MeshSink& sink)>;
+
+	// Without optimization or LODs the generator writes straight into the geometry's blobs;
+	//  otherwise into the vectors those passes rework, which are copied into the blobs once.
+	bool BuildGeneratedGeometry(const std::string& name, const GenerateMeshFunc& generate, UINT optimizeFlags, UINT lodLevelCount, MeshGeometry* geo) {
+		geo->Name = name;
+
+		SubmeshGeometry submesh;
+		submesh.BaseVertexLocation = 0;
+		submesh.StartIndexLocation = 0;
+
+		if (optimizeFlags == MeshOptimizer::ENone && lodLevelCount == 0) {
+			BlobMeshSink sink(geo, MeshArgs::IndexFormat::Allow16Bit);
+			if (!generate(sink)) ReturnFalse(L"Failed to generate procedural geometry");
+
+			submesh.IndexCount = sink.IndexCount();
+			geo->DrawArgs[name] = submesh;
+
+			return true;
+		}
+
+		std::vector<Vertex> vertices;
+		std::vector<std::uint32_t> indices;
+		VectorMeshSink sink(vertices, indices);
+		if (!generate(sink)) ReturnFalse(L"Failed to generate procedural geometry");
+
+		OptimizeMesh(name, vertices, indices, optimizeFlags, MeshArgs::Optimize::CacheSize);
+
+		submesh.IndexCount = static_cast<UINT>(indices.size());
+		BuildLods(name, vertices, indices,
+			lodLevelCount, MeshArgs::Lod::Ratio, LodSimplifyDesc(), MeshArgs::Optimize::CacheSize,
+			geo->DrawArgs);
+
+		geo->DrawArgs[name] = submesh;
+		geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
+
+		const UINT vbByteSize = static_cast<UINT>(vertices.size() * sizeof(Vertex));
+
+		CheckHResult(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+		CheckIsValid(CreateIndexBlob(geo, indices, MeshArgs::IndexFormat::Allow16Bit));
+
+		return true;
+	}
+
+	bool BuildObjGeometry(const std::string& name, ObjMesh& mesh, UINT optimizeFlags, UINT lodLevelCount, MeshGeometry* geo) {
+		// Before optimization, which renumbers the vertices the split appends.
+		if (MeshArgs::Tangents::Generate) GenerateTangents(name, mesh.Vertices, mesh.Indices);
+
+		// The whole mesh is drawn as a single submesh, so triangles may move across material ranges.
+		OptimizeMesh(name, mesh.Vertices, mesh.Indices, optimizeFlags, MeshArgs::Optimize::CacheSize);
+
+		const UINT fullDetailIndexCount = static_cast<UINT>(mesh.Indices.size());
+		BuildLods(name, mesh.Vertices, mesh.Indices,
+			lodLevelCount, MeshArgs::Lod::Ratio, LodSimplifyDesc(), MeshArgs::Optimize::CacheSize,
+			geo->DrawArgs);
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = fullDetailIndexCount;
+		submesh.BaseVertexLocation = 0;
+		submesh.StartIndexLocation = 0;
+
+		geo->DrawArgs[name] = submesh;
+		geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
+
+		const UINT vbByteSize = static_cast<UINT>(mesh.Vertices.size() * sizeof(Vertex));
+
+		CheckHResult(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mesh.Vertices.data(), vbByteSize);
+
+		CheckIsValid(CreateIndexBlob(geo, mesh.Indices, MeshArgs::IndexFormat::Allow16Bit));
+
+		return true;
+	}
+
+	void WriteMeshCache(const std::wstring& cacheFilename, const ObjMesh& mesh, const MeshGeometry* geo, const MeshCache::SourceInfo& source) {
+		std::vector<MeshCache::NamedSubmesh> submeshes;
+		for (const auto& drawArg : geo->DrawArgs)
+			submeshes.push_back({ drawArg.first, drawArg.second });
+
+		const UINT indexStride = IndexByteStride(geo->IndexFormat);
+
+		// A failed write only costs the next launch another OBJ parse.
+		if (!MeshCache::Write(
+				cacheFilename,
+				mesh.Vertices.data(), static_cast<UINT>(mesh.Vertices.size()),
+				geo->IndexBufferCPU->GetBufferPointer(), static_cast<UINT>(geo->IndexBufferCPU->GetBufferSize() / indexStride), indexStride,
+				submeshes,
+				source)) {
+			WLogln(L"Failed to bake mesh cache: ", cacheFilename);
+		}
+	}
 }
 
 namespace ShaderArgs {
@@ -146,7 +990,12 @@ Renderer::Renderer() {
 	bDisplayMaps = true;
 
 	mCurrFrameResourceIndex = 0;
-	mGeometryBufferCount = 0;
+
+	mSubmittedTriangleCount = 0;
+	mFullDetailTriangleCount = 0;
+
+	mStaticRitemCount = 0;
+	mObjectCapacity = gNumObjects + MeshArgs::Scene::InstanceCount;
 
 	mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	float widthSquared = 32.0f * 32.0f;
@@ -161,7 +1010,11 @@ Renderer::Renderer() {
 	mShaderManager = std::make_unique<ShaderManager>();
 	mMainPassCB = std::make_unique<PassConstants>();
 	mShadowPassCB = std::make_unique<PassConstants>();
+	mRtaoCB = std::make_unique<RtaoConstants>();
 	mTLAS = std::make_unique<AccelerationStructureBuffer>();
+	mGeometryPool = std::make_unique<GeometryPool>();
+	mAsyncMeshLoader = std::make_unique<AsyncMeshLoader>();
+	bLoadsFinished = false;
 
 	mGaussianFilter = std::make_unique<GaussianFilter::GaussianFilterClass>();
 	mGaussianFilterCS = std::make_unique<GaussianFilterCS::GaussianFilterCSClass>();
@@ -226,6 +1079,18 @@ bool Renderer::Initialize(HWND hMainWnd, UINT width, UINT height) {
 	// Ray-tracing
 	CheckIsValid(BuildBLAS());
 	CheckIsValid(BuildTLAS());
+	if (MeshArgs::CpuBvh::Build) {
+		CheckIsValid(BuildCpuBvhs());
+		CheckIsValid(BuildCpuAnalyticBvhs());
+	}
+	if (MeshArgs::CpuBvh::Build && MeshArgs::CpuTlas::Build) CheckIsValid(BuildCpuTlas());
+	if (MeshArgs::Analytic::RunBenchmark && MeshArgs::CpuBvh::Build) {
+		CheckIsValid(AnalyticBvhBuilder::RunBenchmark(*mCpuBvhs.at("sphere"), *mCpuAnalyticBvhs.at("sphere"), MeshArgs::Analytic::BenchmarkInstanceCount,
+			MeshArgs::Scene::Seed, MeshArgs::Scene::Density, MeshArgs::Analytic::BenchmarkRayCount, MeshArgs::Analytic::BenchmarkAoRadius, CpuBvhBuildDesc()));
+	}
+	// Imported meshes are still placeholders while they load; see IntegrateLoadedGeometries.
+	if ((MeshArgs::RayTraversal::RunBenchmark || MeshArgs::CpuTlas::RunBenchmark) && MeshArgs::CpuBvh::Build && !MeshArgs::AsyncLoad::Enabled)
+		CheckIsValid(RunCpuRayTracingBenchmarks());
 	CheckIsValid(BuildDXRPSOs());
 	CheckIsValid(BuildShaderTables());
 	
@@ -234,6 +1099,8 @@ bool Renderer::Initialize(HWND hMainWnd, UINT width, UINT height) {
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 	CheckIsValid(FlushCommandQueue());
 
+	mGeometryPool->DisposeUploaders();
+
 	CheckIsValid(InitImGui());
 
 	bInitialized = true;
@@ -241,6 +1108,8 @@ bool Renderer::Initialize(HWND hMainWnd, UINT width, UINT height) {
 }
 
 void Renderer::CleanUp() {
+	mAsyncMeshLoader->CleanUp();
+
 	CleanUpImGui();
 	mShaderManager->CleanUp();
 
@@ -250,6 +1119,8 @@ void Renderer::CleanUp() {
 }
 
 bool Renderer::Update(const GameTimer& gt) {
+	CheckIsValid(IntegrateLoadedGeometries());
+
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
@@ -262,12 +1133,24 @@ bool Renderer::Update(const GameTimer& gt) {
 		CloseHandle(eventHandle);
 	}
 
+	Stopwatch stageTimer;
 	CheckIsValid(UpdateObjectCB(gt));
+	mStageTimings.ObjectUpload = stageTimer.ElapsedMilliseconds();
+
 	CheckIsValid(UpdatePassCB(gt));
 	CheckIsValid(UpdateDebugCB(gt));
 	CheckIsValid(UpdateShadowPassCB(gt));
 	CheckIsValid(UpdateMaterialCB(gt));
 	CheckIsValid(UpdateBlurPassCB(gt));
+
+	stageTimer.Restart();
+	CheckIsValid(SelectLods());
+	mStageTimings.LodSelection = stageTimer.ElapsedMilliseconds();
+
+	stageTimer.Restart();
+	CheckIsValid(CullMeshlets());
+	mStageTimings.MeshletCulling = stageTimer.ElapsedMilliseconds();
+
 	if (!bRaytracing) {
 		CheckIsValid(UpdateSsaoPassCB(gt));
 	}
@@ -299,6 +1182,13 @@ bool Renderer::Draw() {
 	mCurrFrameResource->Fence = static_cast<UINT>(IncCurrentFence());
 	mCommandQueue->Signal(mFence.Get(), GetCurrentFence());
 
+	if (bRaytracing && MeshArgs::CpuRtao::CompareFrame != 0 && mRtaoCB->FrameCount == MeshArgs::CpuRtao::CompareFrame)
+		CheckIsValid(CompareRtaoWithCpu());
+	if (bRaytracing && MeshArgs::CpuShadow::CompareFrame != 0 && mRtaoCB->FrameCount == MeshArgs::CpuShadow::CompareFrame)
+		CheckIsValid(CompareShadowsWithCpu());
+	if (bRaytracing && MeshArgs::BvhInspect::HeatmapFrame != 0 && mRtaoCB->FrameCount == MeshArgs::BvhInspect::HeatmapFrame && mCpuTlas != nullptr)
+		CheckIsValid(RenderCpuHeatmaps());
+
 	return true;
 }
 
@@ -347,6 +1237,59 @@ void Renderer::DisplayImGui(bool state) {
 	bDisplayImgGui = state;
 }
 
+bool Renderer::BuildStressScene(UINT instanceCount, UINT seed) {
+	if (instanceCount > SceneGenerator::MaxInstanceCount) ReturnFalse(L"Scene instance count exceeds SceneGenerator::MaxInstanceCount");
+
+	// Frame resources and the TLAS are about to be replaced.
+	CheckIsValid(FlushCommandQueue());
+
+	mAllRitems.resize(mStaticRitemCount);
+	auto& opaques = mRitems[RenderItem::RenderType::EOpaque];
+	opaques.erase(
+		std::remove_if(opaques.begin(), opaques.end(), [&](const RenderItem* ritem) { return ritem->ObjSBIndex >= mStaticRitemCount; }),
+		opaques.end());
+
+	const UINT objectCount = mStaticRitemCount + instanceCount;
+	if (objectCount > mObjectCapacity) {
+		mObjectCapacity = objectCount;
+		mFrameResources.clear();
+		CheckIsValid(BuildFrameResources());
+
+		// The current frame resource went with the old ones.
+		mCurrFrameResourceIndex = 0;
+		mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
+	}
+
+	CheckIsValid(AddStressSceneItems(instanceCount, seed));
+	InvalidateObjectConstants();
+
+	CheckHResult(mDirectCmdListAlloc->Reset());
+	CheckHResult(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+
+	Stopwatch timer;
+	CheckIsValid(BuildTLAS());
+
+	CheckHResult(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	CheckIsValid(FlushCommandQueue());
+
+	mStageTimings.TlasBuild = timer.ElapsedMilliseconds();
+
+	if (MeshArgs::CpuBvh::Build && MeshArgs::CpuTlas::Build) CheckIsValid(BuildCpuTlas());
+
+	return true;
+}
+
+bool Renderer::GeometryLoadsPending() const {
+	return mAsyncMeshLoader->Stats().RequestedCount > 0 && !bLoadsFinished;
+}
+
+void Renderer::InvalidateObjectConstants() {
+	for (auto& ritem : mAllRitems)
+		ritem->NumFramesDirty = gNumFrameResources;
+}
+
 bool Renderer::CreateRtvAndDsvDescriptorHeaps() {
 	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
 	rtvHeapDesc.NumDescriptors = SwapChainBufferCount + GBuffer::Resources::Count + Ssao::NumRenderTargets;
@@ -465,7 +1408,7 @@ bool Renderer::CompileShaders() {
 
 bool Renderer::BuildFrameResources() {
 	for (int i = 0; i < gNumFrameResources; i++) {
-		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), 2, gNumObjects, gNumMaterials));
+		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), 2, mObjectCapacity, gNumMaterials));
 		CheckIsValid(mFrameResources.back()->Initialize());
 	}
 
@@ -473,235 +1416,362 @@ bool Renderer::BuildFrameResources() {
 }
 
 bool Renderer::BuildGeometries() {
+	CheckIsValid(mGeometryPool->Initialize(
+		md3dDevice.Get(), sizeof(Vertex), MeshArgs::Pool::VertexCapacity, MeshArgs::Pool::IndexByteCapacity));
+
 	GeometryGenerator geoGen;
 	//
 	// Builds sphere geometry.
 	//
 	{
-		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, 32, 32);
-
-		SubmeshGeometry sphereSubmesh;
-		sphereSubmesh.IndexCount = static_cast<UINT>(sphere.Indices32.size());
-		sphereSubmesh.BaseVertexLocation = 0;
-		sphereSubmesh.StartIndexLocation = 0;
-
-		std::vector<Vertex> vertices(sphere.Vertices.size());
-		for (size_t i = 0, end = vertices.size(); i < end; ++i) {
-			vertices[i].Pos = sphere.Vertices[i].Position;
-			vertices[i].Normal = sphere.Vertices[i].Normal;
-			vertices[i].TexC = sphere.Vertices[i].TexC;
-			vertices[i].Tangent = sphere.Vertices[i].TangentU;
-		}
+		auto geo = std::make_unique<MeshGeometry>();
+		CheckIsValid(BuildGeneratedGeometry(
+			"sphere",
+			[&](GeometryGenerator::MeshSink& sink) { return geoGen.CreateSphere(1.0f, 32, 32, sink); },
+			MeshArgs::Optimize::SphereFlags, MeshArgs::Lod::MaxLevelCount,
+			geo.get()));
 
-		std::vector<std::uint32_t> indices;
-		indices.insert(indices.end(), std::begin(sphere.Indices32), std::end(sphere.Indices32));
+		CheckIsValid(UploadGeometry(std::move(geo)));
+	}
+	//
+	// Build grid geometry
+	//
+	{
+		auto geo = std::make_unique<MeshGeometry>();
+		CheckIsValid(BuildGeneratedGeometry(
+			"grid",
+			[&](GeometryGenerator::MeshSink& sink) { return geoGen.CreateGrid(32.0f, 32.0f, 16, 16, sink); },
+			MeshArgs::Optimize::GridFlags, MeshArgs::Lod::GridLevelCount,
+			geo.get()));
 
-		const UINT vbByteSize = static_cast<UINT>(vertices.size() * sizeof(Vertex));
-		const UINT ibByteSize = static_cast<UINT>(indices.size() * sizeof(std::uint32_t));
+		CheckIsValid(UploadGeometry(std::move(geo)));
+	}
 
-		auto geo = std::make_unique<MeshGeometry>();
-		geo->Name = "sphere";
+	// Load monkey geometry
+	if (MeshArgs::AsyncLoad::Enabled) {
+		CheckIsValid(mAsyncMeshLoader->Initialize(
+			MeshArgs::AsyncLoad::WorkerCount, MeshArgs::AsyncLoad::MemoryBudget, MeshArgs::AsyncLoad::WorkingSetFactor));
 
-		CheckHResult(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+		CheckIsValid(RequestGeometry("monkey", L"./../../assets/meshes/monkey.obj", MeshArgs::Optimize::MonkeyFlags, MeshArgs::Lod::MaxLevelCount));
+	}
+	else {
+		CheckIsValid(LoadGeometry("monkey", L"./../../assets/meshes/monkey.obj", MeshArgs::Optimize::MonkeyFlags, MeshArgs::Lod::MaxLevelCount));
+	}
 
-		CheckHResult(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	if (MeshArgs::AsyncLoad::Verify || MeshArgs::AsyncLoad::RunStressTest) {
+		const auto process = [](const std::string& name, ObjMesh& mesh, MeshGeometry* geo) {
+			return BuildObjGeometry(name, mesh, MeshArgs::Optimize::MonkeyFlags, MeshArgs::Lod::MaxLevelCount, geo);
+		};
 
-		CheckIsValid(D3D12Util::CreateDefaultBuffer(
-			md3dDevice.Get(),
-			mCommandList.Get(),
-			vertices.data(),
-			vbByteSize,
-			geo->VertexBufferUploader,
-			geo->VertexBufferGPU)
-		);
+		if (MeshArgs::AsyncLoad::Verify) {
+			CheckIsValid(AsyncMeshLoader::RunBenchmark(
+				L"./../../assets/meshes/monkey.obj",
+				MeshArgs::AsyncLoad::VerifyMeshCount, MeshArgs::AsyncLoad::MemoryBudget,
+				MeshArgs::AsyncLoad::WorkerCount, MeshArgs::AsyncLoad::WorkingSetFactor,
+				MeshLoadDesc(), process));
+		}
 
-		CheckIsValid(D3D12Util::CreateDefaultBuffer(
-			md3dDevice.Get(),
-			mCommandList.Get(),
-			indices.data(),
-			ibByteSize,
-			geo->IndexBufferUploader,
-			geo->IndexBufferGPU)
-		);
+		if (MeshArgs::AsyncLoad::RunStressTest) {
+			CheckIsValid(AsyncMeshLoader::RunBenchmark(
+				L"./../../assets/meshes/monkey.obj",
+				MeshArgs::AsyncLoad::StressMeshCount, MeshArgs::AsyncLoad::StressMemoryBudget,
+				MeshArgs::AsyncLoad::WorkerCount, MeshArgs::AsyncLoad::WorkingSetFactor,
+				MeshLoadDesc(), process));
+		}
+	}
 
-		geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
-		geo->VertexBufferByteSize = vbByteSize;
-		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-		geo->IndexBufferByteSize = ibByteSize;
-		geo->GeometryIndex = static_cast<UINT>(mGeometries.size());
+	if (MeshArgs::Tangents::RunBenchmark) {
+		CheckIsValid(TangentGenerator::RunBenchmark(MeshArgs::Tangents::BenchmarkIterationCount));
+	}
 
-		geo->DrawArgs["sphere"] = sphereSubmesh; 
+	if (MeshArgs::Generator::RunBenchmark) {
+		CheckIsValid(GeometryGenerator::RunSinkBenchmark(MeshArgs::Generator::BenchmarkGridSize, MeshArgs::Generator::BenchmarkSphereSize, GeneratorVertexLayout));
+	}
 
-		mGeometries[geo->Name] = std::move(geo);
+	if (MeshArgs::Subdivision::RunBenchmark) {
+		GeometryGenerator::RunSubdivisionBenchmark(MeshArgs::Subdivision::BenchmarkMaxDepth);
 	}
-	//
-	// Build grid geometry
-	//
-	{
-		GeometryGenerator::MeshData grid = geoGen.CreateGrid(32.0f, 32.0f, 16, 16);
-
-		SubmeshGeometry gridSubmesh;
-		gridSubmesh.IndexCount = static_cast<UINT>(grid.Indices32.size());
-		gridSubmesh.BaseVertexLocation = 0;
-		gridSubmesh.StartIndexLocation = 0;
-
-		std::vector<Vertex> vertices(grid.Vertices.size());
-		for (size_t i = 0, end = vertices.size(); i < end; ++i) {
-			vertices[i].Pos = grid.Vertices[i].Position;
-			vertices[i].Normal = grid.Vertices[i].Normal;
-			vertices[i].TexC = grid.Vertices[i].TexC;
-			vertices[i].Tangent = grid.Vertices[i].TangentU;
-		}
 
-		std::vector<std::uint32_t> indices;
-		indices.insert(indices.end(), std::begin(grid.Indices32), std::end(grid.Indices32));
+	if (MeshArgs::CpuBvh::RunBenchmark) {
+		CheckIsValid(BvhBuilder::RunBenchmark(MeshArgs::CpuBvh::BenchmarkSphereSize, CpuBvhBuildDesc()));
+		CheckIsValid(LbvhBuilder::RunBenchmark(MeshArgs::CpuBvh::BenchmarkSphereSize, CpuLbvhBuildDesc(), CpuBvhBuildDesc()));
+	}
 
-		const UINT vbByteSize = static_cast<UINT>(vertices.size() * sizeof(Vertex));
-		const UINT ibByteSize = static_cast<UINT>(indices.size() * sizeof(std::uint32_t));
+	if (MeshArgs::CpuBvh::RunCacheBenchmark) {
+		CheckIsValid(BvhCache::RunBenchmark(MeshArgs::CpuBvh::BenchmarkSphereSize, CpuBvhBuildDesc(), MeshArgs::CpuBvh::CacheDirectory));
+	}
 
-		auto geo = std::make_unique<MeshGeometry>();
-		geo->Name = "grid";
+	if (MeshArgs::Meshlets::RunCullBenchmark) {
+		CheckIsValid(MeshletCuller::RunBenchmark(
+			MeshArgs::Meshlets::CullBenchmarkFrameCount, MeshArgs::Meshlets::MaxVertices, MeshArgs::Meshlets::MaxTriangles));
+	}
 
-		CheckHResult(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	ReportGeometryPool(*mGeometryPool);
+	ReportIndexCompaction(mGeometries);
 
-		CheckHResult(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	if (MeshArgs::Pool::RunChurnBenchmark) {
+		TlsfAllocator::RunBenchmark(
+			MeshArgs::Pool::VertexCapacity, MeshArgs::Pool::ChurnOperationCount, MeshArgs::Pool::ChurnTargetOccupancy);
+	}
+	if (MeshArgs::VertexCompression::Report) ReportVertexCompression(mGeometries);
 
-		CheckIsValid(D3D12Util::CreateDefaultBuffer(
-			md3dDevice.Get(),
-			mCommandList.Get(),
-			vertices.data(),
-			vbByteSize,
-			geo->VertexBufferUploader,
-			geo->VertexBufferGPU)
-		);
+	return true;
+}
 
-		CheckIsValid(D3D12Util::CreateDefaultBuffer(
-			md3dDevice.Get(),
-			mCommandList.Get(),
-			indices.data(),
-			ibByteSize,
-			geo->IndexBufferUploader,
-			geo->IndexBufferGPU)
-		);
+bool Renderer::LoadGeometry(const std::string& name, const std::wstring& inFilename, UINT optimizeFlags, UINT lodLevelCount) {
+	const std::wstring cacheFilename = MeshCacheFilename(inFilename);
 
-		geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
-		geo->VertexBufferByteSize = vbByteSize;
-		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-		geo->IndexBufferByteSize = ibByteSize;
-		geo->GeometryIndex = static_cast<UINT>(mGeometries.size());
+	MeshCache::SourceInfo source;
+	const bool bHasSource = QueryMeshSource(inFilename, optimizeFlags, lodLevelCount, source);
+
+	Stopwatch cacheTimer;
+
+	MeshCache::MeshCacheFile cache;
+	if (MeshArgs::Cache::Enabled && cache.Open(cacheFilename, bHasSource ? &source : nullptr, MeshArgs::Cache::Validate))
+		return LoadCachedGeometry(name, inFilename, cache, bHasSource, cacheTimer);
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+	geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
+
+	ObjMesh mesh;
+	ObjLoadStats loadStats;
+	CheckIsValid(ObjLoader::Load(inFilename, mesh, MeshLoadDesc(), &loadStats));
 
-		geo->DrawArgs["grid"] = gridSubmesh;
+	LogObjLoadStats(name, loadStats);
+	if (MeshArgs::ObjLoad::CompareWithTinyObj) CheckIsValid(ObjLoader::RunBenchmark(inFilename, loadStats));
 
-		mGeometries[geo->Name] = std::move(geo);
+	CheckIsValid(BuildObjGeometry(name, mesh, optimizeFlags, lodLevelCount, geo.get()));
+
+	if (MeshArgs::Cache::Enabled && bHasSource) WriteMeshCache(cacheFilename, mesh, geo.get(), source);
+
+	CheckIsValid(UploadGeometry(std::move(geo)));
+
+	return true;
+}
+
+bool Renderer::LoadCachedGeometry(const std::string& name, const std::wstring& inFilename, const MeshCache::MeshCacheFile& cache, bool bHasSource, const Stopwatch& cacheTimer) {
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+	geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
+
+	// Vertex and index blobs reference the mapped file directly; the upload below is
+	//  the only copy.
+	geo->VertexBufferCPU = cache.CreateVertexBlob();
+	geo->IndexBufferCPU = cache.CreateIndexBlob();
+	geo->IndexFormat = cache.IndexFormat();
+
+	std::vector<MeshCache::NamedSubmesh> submeshes;
+	cache.GetSubmeshes(submeshes);
+	for (const auto& submesh : submeshes)
+		geo->DrawArgs[submesh.Name] = submesh.Submesh;
+
+	const double cacheMs = cacheTimer.ElapsedMilliseconds();
+	Logln("Loaded ", name, " from mesh cache in ", std::to_string(cacheMs), " ms (",
+		std::to_string(cache.Header().VertexCount), " vertices, ", std::to_string(cache.Header().IndexCount), " indices)");
+
+	if (MeshArgs::Cache::CompareWithObj && bHasSource) {
+		Stopwatch objTimer;
+
+		ObjMesh mesh;
+		CheckIsValid(ObjLoader::Load(inFilename, mesh, MeshLoadDesc()));
+
+		const double objMs = objTimer.ElapsedMilliseconds();
+		Logln("Mesh cache for ", name, ": ", std::to_string(cacheMs), " ms vs OBJ ", std::to_string(objMs), " ms (",
+			std::to_string(cacheMs > 0.0 ? objMs / cacheMs : 0.0), "x)");
 	}
 
-	// Load monkey geometry
-	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
+	CheckIsValid(UploadGeometry(std::move(geo)));
 
-		{
-			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, 
-				"./../../assets/meshes/monkey.obj", "./../../assets/meshes/")) {
-				std::wstringstream wsstream;
-				wsstream << warn.c_str() << err.c_str();
-				ReturnFalse(wsstream.str());
-			}
+	return true;
+}
+
+bool Renderer::RequestGeometry(const std::string& name, const std::wstring& inFilename, UINT optimizeFlags, UINT lodLevelCount) {
+	// A valid cache is one mapped file and uploads straight away; only OBJ parses go to the workers.
+	if (MeshArgs::Cache::Enabled) {
+		MeshCache::SourceInfo source;
+		const bool bHasSource = QueryMeshSource(inFilename, optimizeFlags, lodLevelCount, source);
+
+		Stopwatch cacheTimer;
+
+		MeshCache::MeshCacheFile cache;
+		if (cache.Open(MeshCacheFilename(inFilename), bHasSource ? &source : nullptr, MeshArgs::Cache::Validate))
+			return LoadCachedGeometry(name, inFilename, cache, bHasSource, cacheTimer);
+	}
+
+	CheckIsValid(BuildPlaceholderGeometry(name));
+
+	const std::wstring cacheFilename = MeshCacheFilename(inFilename);
+
+	AsyncMeshRequest request;
+	request.Name = name;
+	request.Filename = inFilename;
+	request.LoadDesc = MeshLoadDesc();
+	request.Process = [=](const std::string& geoName, ObjMesh& mesh, MeshGeometry* geo) {
+		CheckIsValid(BuildObjGeometry(geoName, mesh, optimizeFlags, lodLevelCount, geo));
+
+		MeshCache::SourceInfo source;
+		if (MeshArgs::Cache::Enabled && QueryMeshSource(inFilename, optimizeFlags, lodLevelCount, source))
+			WriteMeshCache(cacheFilename, mesh, geo, source);
+
+		return true;
+	};
+
+	CheckIsValid(mAsyncMeshLoader->Request(request));
+
+	return true;
+}
+
+bool Renderer::BuildPlaceholderGeometry(const std::string& name) {
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+	geo->Placeholder = true;
+
+	GeometryGenerator geoGen;
+	BlobMeshSink sink(geo.get(), MeshArgs::IndexFormat::Allow16Bit);
+	if (!geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0, sink)) ReturnFalse(L"Failed to generate placeholder geometry");
+
+	SubmeshGeometry boxSubmesh;
+	boxSubmesh.IndexCount = sink.IndexCount();
+	boxSubmesh.BaseVertexLocation = 0;
+	boxSubmesh.StartIndexLocation = 0;
+	geo->DrawArgs[name] = boxSubmesh;
+
+	CheckIsValid(UploadGeometry(std::move(geo)));
+
+	return true;
+}
+
+bool Renderer::IntegrateLoadedGeometries() {
+	std::unique_ptr<MeshGeometry> geo;
+	if (!mAsyncMeshLoader->TryPopReady(geo)) {
+		const auto stats = mAsyncMeshLoader->Stats();
+		if (!bLoadsFinished && stats.RequestedCount > 0 && mAsyncMeshLoader->IsIdle()) {
+			Logln("Async mesh loads: ", std::to_string(stats.CompletedCount), " of ", std::to_string(stats.RequestedCount),
+				" completed, ", std::to_string(stats.FailedCount), " failed, peak reservation ", std::to_string(stats.PeakReservedBytes),
+				" of ", std::to_string(stats.BudgetBytes), " bytes");
+
+			if (MeshArgs::AsyncLoad::WriteTrace && !mAsyncMeshLoader->Trace().Write(MeshArgs::AsyncLoad::TraceFilename))
+				WLogln(L"Failed to write load trace: ", MeshArgs::AsyncLoad::TraceFilename);
+
+			bLoadsFinished = true;
+
+			if ((MeshArgs::RayTraversal::RunBenchmark || MeshArgs::CpuTlas::RunBenchmark) && MeshArgs::CpuBvh::Build)
+				CheckIsValid(RunCpuRayTracingBenchmarks());
 		}
+		return true;
+	}
 
-		Mesh mesh = {};
+	// The placeholders being replaced may still be in use, and their pool ranges get reused.
+	CheckIsValid(FlushCommandQueue());
 
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex = {};
+	CheckHResult(mDirectCmdListAlloc->Reset());
+	CheckHResult(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
-				int first = 3 * index.vertex_index + 0;
-				int second = 3 * index.vertex_index + 1;
-				int third = 3 * index.vertex_index + 2;
+	// The list is closed on failure too, so the next Reset finds it closed.
+	const bool bRecorded = RecordLoadedGeometries(std::move(geo));
+	CheckHResult(mCommandList->Close());
+	if (!bRecorded) ReturnFalse(L"Failed to integrate loaded geometries");
 
-				vertex.Pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	CheckIsValid(FlushCommandQueue());
 
-				vertex.Normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
+	mGeometryPool->DisposeUploaders();
 
-				float texY = attrib.texcoords[2 * index.texcoord_index + 1];
-				vertex.TexC = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					texY,
-				};
+	return true;
+}
 
+bool Renderer::RecordLoadedGeometries(std::unique_ptr<MeshGeometry> geo) {
+	std::vector<ID3D12Resource*> builtBLASs;
+	do {
+		const std::string name = geo->Name;
+		const UINT64 begin = mAsyncMeshLoader->Trace().Now();
 
-				if (mesh.UniqueVertices.count(vertex) == 0) {
-					mesh.UniqueVertices[vertex] = static_cast<std::uint32_t>(mesh.Vertices.size());
-					mesh.Vertices.push_back(vertex);
-				}
+		std::unique_ptr<MeshGeometry> placeholder;
+		const auto iter = mGeometries.find(name);
+		if (iter != mGeometries.end()) placeholder = std::move(iter->second);
 
-				mesh.Indices.push_back(static_cast<std::uint32_t>(mesh.UniqueVertices[vertex]));
-			}
+		// The placeholder keeps its ranges, and stays in place, until the loaded mesh is in the pool.
+		if (!UploadGeometry(std::move(geo))) {
+			if (placeholder) mGeometries[name] = std::move(placeholder);
+			ReturnFalse(L"Failed to upload loaded geometry");
 		}
-		
-		auto& vertices = mesh.Vertices;
-		auto& indices = mesh.Indices;
+		if (placeholder) mGeometryPool->Free(placeholder->PoolAllocation);
 
-		SubmeshGeometry monkeySubmesh;
-		monkeySubmesh.IndexCount = static_cast<UINT>(indices.size());
-		monkeySubmesh.BaseVertexLocation = 0;
-		monkeySubmesh.StartIndexLocation = 0;
+		const auto loaded = mGeometries[name].get();
+		// Keeps the slot shaders already know the geometry by.
+		if (placeholder) loaded->GeometryIndex = placeholder->GeometryIndex;
 
-		const UINT vbByteSize = static_cast<UINT>(vertices.size() * sizeof(Vertex));
-		const UINT ibByteSize = static_cast<UINT>(indices.size() * sizeof(std::uint32_t));
+		CheckIsValid(BuildBLAS(loaded));
+		builtBLASs.push_back(mBLASs[name]->Result.Get());
 
-		auto geo = std::make_unique<MeshGeometry>();
-		geo->Name = "monkey";
+		if (MeshArgs::CpuBvh::Build) CheckIsValid(BuildCpuBvh(loaded));
 
-		CheckHResult(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+		// Levels and bounds are set up once; stress scenes can hold many instances of the geometry.
+		const RenderItem* prototype = nullptr;
+		for (const auto& ritem : mAllRitems) {
+			if (placeholder == nullptr || ritem->Geo != placeholder.get()) continue;
 
-		CheckHResult(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+			const auto& drawArg = loaded->DrawArgs[name];
+			ritem->Geo = loaded;
+			ritem->IndexCount = drawArg.IndexCount;
+			ritem->StartIndexLocation = drawArg.StartIndexLocation;
+			ritem->BaseVertexLocation = drawArg.BaseVertexLocation;
 
-		CheckIsValid(D3D12Util::CreateDefaultBuffer(
-			md3dDevice.Get(),
-			mCommandList.Get(),
-			vertices.data(),
-			vbByteSize,
-			geo->VertexBufferUploader,
-			geo->VertexBufferGPU)
-		);
+			if (prototype == nullptr) {
+				SetupLods(ritem.get(), name);
+				prototype = ritem.get();
+			}
+			else {
+				ritem->Lods = prototype->Lods;
+				ritem->LodIndex = 0;
+				ritem->Meshlets = prototype->Meshlets;
+				ritem->Bounds = prototype->Bounds;
+			}
+		}
+
+		mAsyncMeshLoader->Trace().Add(name, "upload", begin, mAsyncMeshLoader->Trace().Now());
+	} while (mAsyncMeshLoader->TryPopReady(geo));
 
-		CheckIsValid(D3D12Util::CreateDefaultBuffer(
-			md3dDevice.Get(),
-			mCommandList.Get(),
-			indices.data(),
-			ibByteSize,
-			geo->IndexBufferUploader,
-			geo->IndexBufferGPU)
-		);
+	D3D12Util::UavBarriers(mCommandList.Get(), builtBLASs.data(), builtBLASs.size());
 
-		geo->VertexByteStride = static_cast<UINT>(sizeof(Vertex));
-		geo->VertexBufferByteSize = vbByteSize;
-		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-		geo->IndexBufferByteSize = ibByteSize;
-		geo->GeometryIndex = static_cast<UINT>(mGeometries.size());
+	CheckIsValid(BuildTLAS());
+	// The CPU BVHs of the loaded geometries were just replaced.
+	if (MeshArgs::CpuBvh::Build && MeshArgs::CpuTlas::Build) CheckIsValid(BuildCpuTlas());
 
-		geo->DrawArgs["monkey"] = monkeySubmesh;
+	return true;
+}
 
-		mGeometries[geo->Name] = std::move(geo);
+bool Renderer::UploadGeometry(std::unique_ptr<MeshGeometry> geo) {
+	const UINT vbByteSize = static_cast<UINT>(geo->VertexBufferCPU->GetBufferSize());
+	const UINT ibByteSize = static_cast<UINT>(geo->IndexBufferCPU->GetBufferSize());
+
+	// Meshlets index the geometry's own buffers, so they are built before the draw arguments
+	//  move into the pool.
+	CheckIsValid(BuildMeshlets(geo.get(), MeshArgs::Meshlets::MaxVertices, MeshArgs::Meshlets::MaxTriangles));
+
+	CheckIsValid(mGeometryPool->Upload(
+		mCommandList.Get(),
+		geo->VertexBufferCPU->GetBufferPointer(), vbByteSize / geo->VertexByteStride,
+		geo->IndexBufferCPU->GetBufferPointer(), ibByteSize,
+		geo->PoolAllocation));
+
+	geo->VertexBufferGPU = mGeometryPool->VertexBuffer();
+	geo->IndexBufferGPU = mGeometryPool->IndexBuffer();
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexBufferByteSize = ibByteSize;
+	geo->GeometryIndex = static_cast<UINT>(mGeometries.size());
+
+	const UINT vertexOffset = GeometryPool::VertexOffset(geo->PoolAllocation);
+	const UINT indexOffset = GeometryPool::IndexByteOffset(geo->PoolAllocation) / IndexByteStride(geo->IndexFormat);
+	for (auto& drawArg : geo->DrawArgs) {
+		drawArg.second.BaseVertexLocation += vertexOffset;
+		drawArg.second.StartIndexLocation += indexOffset;
 	}
 
+	mGeometries[geo->Name] = std::move(geo);
+
 	return true;
 }
 
@@ -866,7 +1936,7 @@ bool Renderer::BuildRootSignatures() {
 	CheckIsValid(mGaussianFilter->BuildRootSignature(md3dDevice.Get(), samplers));
 	CheckIsValid(mGaussianFilterCS->BuildRootSignature(md3dDevice.Get(), samplers));
 	CheckIsValid(mGaussianFilter3x3CS->BuildRootSignature(md3dDevice.Get(), samplers));
-	CheckIsValid(mDxrShadow->BuildRootSignatures(samplers, gNumGeometryBuffers));
+	CheckIsValid(mDxrShadow->BuildRootSignatures(samplers));
 	CheckIsValid(mRtao->BuildRootSignatures(samplers));
 	CheckIsValid(mDebug->BuildRootSignature(samplers));
 	CheckIsValid(mBackBuffer->BuildRootSignature(samplers));
@@ -904,29 +1974,25 @@ bool Renderer::BuildDescriptors() {
 	indexSrvDesc.Buffer.StructureByteStride = 0;
 	indexSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
-	for (const auto& g : mGeometries) {
-		auto geo = g.second.get();
-
-		vertexSrvDesc.Buffer.FirstElement = 0;
-		vertexSrvDesc.Buffer.NumElements = static_cast<UINT>(geo->VertexBufferCPU->GetBufferSize() / sizeof(Vertex));
+	// One view per arena covers every geometry in the pool.
+	vertexSrvDesc.Buffer.FirstElement = 0;
+	vertexSrvDesc.Buffer.NumElements = mGeometryPool->VertexCapacity();
 
-		md3dDevice->CreateShaderResourceView(
-			geo->VertexBufferGPU.Get(),
-			&vertexSrvDesc,
-			D3D12Util::GetCpuHandle(pDescHeap, EDescriptors::ES_Vertices + mGeometryBufferCount, descSize)
-		);
-
-		indexSrvDesc.Buffer.FirstElement = 0;
-		indexSrvDesc.Buffer.NumElements = static_cast<UINT>(geo->IndexBufferCPU->GetBufferSize() / sizeof(std::uint32_t));
+	md3dDevice->CreateShaderResourceView(
+		mGeometryPool->VertexBuffer(),
+		&vertexSrvDesc,
+		D3D12Util::GetCpuHandle(pDescHeap, EDescriptors::ES_Vertices, descSize)
+	);
 
-		md3dDevice->CreateShaderResourceView(
-			geo->IndexBufferGPU.Get(),
-			&indexSrvDesc,
-			D3D12Util::GetCpuHandle(pDescHeap, EDescriptors::ES_Indices + mGeometryBufferCount, descSize)
-		);
+	// Raw views count 32-bit words whatever the index format; pool ranges are word-aligned.
+	indexSrvDesc.Buffer.FirstElement = 0;
+	indexSrvDesc.Buffer.NumElements = mGeometryPool->IndexByteCapacity() / sizeof(std::uint32_t);
 
-		++mGeometryBufferCount;
-	}
+	md3dDevice->CreateShaderResourceView(
+		mGeometryPool->IndexBuffer(),
+		&indexSrvDesc,
+		D3D12Util::GetCpuHandle(pDescHeap, EDescriptors::ES_Indices, descSize)
+	);
 
 	std::array<ID3D12Resource*, SwapChainBufferCount> backBuffers;
 	for (int i = 0; i < SwapChainBufferCount; ++i) {
@@ -953,7 +2019,7 @@ bool Renderer::BuildPSOs() {
 		{ "POSITION",	0, DXGI_FORMAT_R32G32B32_FLOAT,			0, 0,	D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "NORMAL",		0, DXGI_FORMAT_R32G32B32_FLOAT,			0, 12,	D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD",	0, DXGI_FORMAT_R32G32_FLOAT,			0, 24,	D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TANGENT",	0, DXGI_FORMAT_R32G32B32_FLOAT,			0, 32,	D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+		{ "TANGENT",	0, DXGI_FORMAT_R32G32B32A32_FLOAT,		0, 32,	D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
 	};
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC defaultPsoDesc;
@@ -1056,6 +2122,8 @@ bool Renderer::BuildRenderItems() {
 		sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		SetupLods(sphereRitem.get(), "sphere");
+		sphereRitem->AnalyticRayTracing = MeshArgs::Analytic::Spheres;
 		mRitems[RenderItem::RenderType::EOpaque].push_back(sphereRitem.get());
 		mAllRitems.push_back(std::move(sphereRitem));
 	}
@@ -1069,6 +2137,8 @@ bool Renderer::BuildRenderItems() {
 		sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		SetupLods(sphereRitem.get(), "sphere");
+		sphereRitem->AnalyticRayTracing = MeshArgs::Analytic::Spheres;
 		mRitems[RenderItem::RenderType::EOpaque].push_back(sphereRitem.get());
 		mAllRitems.push_back(std::move(sphereRitem));
 	}
@@ -1082,6 +2152,8 @@ bool Renderer::BuildRenderItems() {
 		sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		SetupLods(sphereRitem.get(), "sphere");
+		sphereRitem->AnalyticRayTracing = MeshArgs::Analytic::Spheres;
 		mRitems[RenderItem::RenderType::EOpaque].push_back(sphereRitem.get());
 		mAllRitems.push_back(std::move(sphereRitem));
 	}
@@ -1095,6 +2167,7 @@ bool Renderer::BuildRenderItems() {
 		gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 		gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 		gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+		SetupLods(gridRitem.get(), "grid");
 		mRitems[RenderItem::RenderType::EOpaque].push_back(gridRitem.get());
 		mAllRitems.push_back(std::move(gridRitem));
 	}
@@ -1108,69 +2181,88 @@ bool Renderer::BuildRenderItems() {
 		monkeyRitem->IndexCount = monkeyRitem->Geo->DrawArgs["monkey"].IndexCount;
 		monkeyRitem->StartIndexLocation = monkeyRitem->Geo->DrawArgs["monkey"].StartIndexLocation;
 		monkeyRitem->BaseVertexLocation = monkeyRitem->Geo->DrawArgs["monkey"].BaseVertexLocation;
+		SetupLods(monkeyRitem.get(), "monkey");
 		mRitems[RenderItem::RenderType::EOpaque].push_back(monkeyRitem.get());
 		mAllRitems.push_back(std::move(monkeyRitem));
 	}
 
+	mStaticRitemCount = count;
+
+	if (MeshArgs::Scene::InstanceCount > 0)
+		CheckIsValid(AddStressSceneItems(MeshArgs::Scene::InstanceCount, MeshArgs::Scene::Seed));
+
+	return true;
+}
+
+bool Renderer::AddStressSceneItems(UINT instanceCount, UINT seed) {
+	std::vector<Material*> materials;
+	for (const auto& pair : mMaterials)
+		materials.push_back(pair.second.get());
+	// Map order is unspecified; the generator's material indices must mean the same everywhere.
+	std::sort(materials.begin(), materials.end(), [](const Material* a, const Material* b) { return a->MatSBIndex < b->MatSBIndex; });
+
+	SceneGeneratorDesc desc;
+	desc.Seed = seed;
+	desc.InstanceCount = instanceCount;
+	desc.ShapeCount = _countof(StressSceneShapes);
+	desc.MaterialCount = static_cast<UINT>(materials.size());
+	desc.Density = MeshArgs::Scene::Density;
+
+	Stopwatch timer;
+
+	std::vector<SceneInstance> instances;
+	CheckIsValid(SceneGenerator::Generate(desc, instances));
+
+	mStageTimings.SceneGeneration = timer.ElapsedMilliseconds();
+	timer.Restart();
+
+	// Levels, meshlets and bounds only depend on the geometry; instances copy them from one
+	//  prototype per shape instead of recomputing the bounds from every vertex.
+	std::vector<RenderItem> prototypes(_countof(StressSceneShapes));
+	for (size_t i = 0; i < prototypes.size(); ++i) {
+		const auto iter = mGeometries.find(StressSceneShapes[i]);
+		if (iter == mGeometries.end()) ReturnFalse(L"Stress scene shape geometry is missing");
+
+		auto& prototype = prototypes[i];
+		const auto& drawArg = iter->second->DrawArgs[StressSceneShapes[i]];
+		prototype.Geo = iter->second.get();
+		prototype.PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		prototype.IndexCount = drawArg.IndexCount;
+		prototype.StartIndexLocation = drawArg.StartIndexLocation;
+		prototype.BaseVertexLocation = drawArg.BaseVertexLocation;
+		SetupLods(&prototype, StressSceneShapes[i]);
+	}
+
+	auto& opaques = mRitems[RenderItem::RenderType::EOpaque];
+	mAllRitems.reserve(mStaticRitemCount + instanceCount);
+	opaques.reserve(opaques.size() + instanceCount);
+
+	for (UINT i = 0; i < instanceCount; ++i) {
+		const auto& instance = instances[i];
+
+		auto ritem = std::make_unique<RenderItem>(prototypes[instance.ShapeIndex]);
+		ritem->World = instance.World;
+		ritem->ObjSBIndex = mStaticRitemCount + i;
+		ritem->Mat = materials[instance.MaterialIndex];
+		opaques.push_back(ritem.get());
+		mAllRitems.push_back(std::move(ritem));
+	}
+
+	mStageTimings.RenderItems = timer.ElapsedMilliseconds();
+
+	// Keeps the shadow map's orthographic frustum around the scattered instances.
+	const float reach = SceneGenerator::HalfExtent(desc) * std::sqrt(2.0f) + desc.MaxHeight + desc.MaxScale;
+	mSceneBounds.Radius = std::max(mSceneBounds.Radius, reach);
+
+	Logln("Stress scene: ", std::to_string(instanceCount), " instances (seed ", std::to_string(seed), ") generated in ",
+		std::to_string(mStageTimings.SceneGeneration), " ms, render items built in ", std::to_string(mStageTimings.RenderItems), " ms");
+
 	return true;
 }
 
 bool Renderer::BuildBLAS() {
-	for (const auto& pair : mGeometries) {
-		auto geo = pair.second.get();
-
-		D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
-		geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-		geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-		geometryDesc.Triangles.VertexCount = static_cast<UINT>(geo->VertexBufferCPU->GetBufferSize() / sizeof(Vertex));
-		geometryDesc.Triangles.VertexBuffer.StartAddress = geo->VertexBufferGPU->GetGPUVirtualAddress();
-		geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
-		geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
-		geometryDesc.Triangles.IndexCount = static_cast<UINT>(geo->IndexBufferCPU->GetBufferSize() / sizeof(std::uint32_t));
-		geometryDesc.Triangles.IndexBuffer = geo->IndexBufferGPU->GetGPUVirtualAddress();
-		geometryDesc.Triangles.Transform3x4 = 0;
-		// Mark the geometry as opaque. 
-		// PERFORMANCE TIP: mark geometry as opaque whenever applicable as it can enable important ray processing optimizations.
-		// Note: When rays encounter opaque geometry an any hit shader will not be executed whether it is present or not.
-		geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-
-		// Get the size requirements for the BLAS buffers
-		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
-		inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-		inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		inputs.pGeometryDescs = &geometryDesc;
-		inputs.NumDescs = 1;
-		inputs.Flags = buildFlags;
-
-		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
-		md3dDevice->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
-
-		prebuildInfo.ScratchDataSizeInBytes = Align(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, prebuildInfo.ScratchDataSizeInBytes);
-		prebuildInfo.ResultDataMaxSizeInBytes = Align(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, prebuildInfo.ResultDataMaxSizeInBytes);
-
-		std::unique_ptr<AccelerationStructureBuffer> blas = std::make_unique<AccelerationStructureBuffer>();
-
-		// Create the BLAS scratch buffer
-		D3D12BufferCreateInfo bufferInfo(prebuildInfo.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
-		bufferInfo.Alignment = std::max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
-		CheckIsValid(D3D12Util::CreateBuffer(md3dDevice.Get(), bufferInfo, blas->Scratch.GetAddressOf(), mInfoQueue.Get()));
-
-		// Create the BLAS buffer
-		bufferInfo.Size = prebuildInfo.ResultDataMaxSizeInBytes;
-		bufferInfo.State = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
-		CheckIsValid(D3D12Util::CreateBuffer(md3dDevice.Get(), bufferInfo, blas->Result.GetAddressOf(), mInfoQueue.Get()));
-
-		// Describe and build the bottom level acceleration structure
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
-		buildDesc.Inputs = inputs;
-		buildDesc.ScratchAccelerationStructureData = blas->Scratch->GetGPUVirtualAddress();
-		buildDesc.DestAccelerationStructureData = blas->Result->GetGPUVirtualAddress();
-
-		mCommandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
-
-		mBLASs[geo->Name] = std::move(blas);
-	}
+	for (const auto& pair : mGeometries)
+		CheckIsValid(BuildBLAS(pair.second.get()));
 
 	// Wait for the BLAS build to complete
 	std::vector<ID3D12Resource*> resources;
@@ -1182,94 +2274,128 @@ bool Renderer::BuildBLAS() {
 	return true;
 }
 
+bool Renderer::BuildBLAS(MeshGeometry* geo) {
+	D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
+	geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+	// Simplified levels follow the full-detail range in the index buffer; rays only see the latter.
+	// DXR has no base vertex, so the vertex buffer starts at the range's base in the pool instead.
+	const auto& fullDetail = geo->DrawArgs[geo->Name];
+	const UINT indexStride = IndexByteStride(geo->IndexFormat);
+	const UINT localBaseVertex = fullDetail.BaseVertexLocation - GeometryPool::VertexOffset(geo->PoolAllocation);
+
+	geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+	geometryDesc.Triangles.VertexCount = geo->VertexBufferByteSize / geo->VertexByteStride - localBaseVertex;
+	geometryDesc.Triangles.VertexBuffer.StartAddress = geo->VertexBufferGPU->GetGPUVirtualAddress() +
+		static_cast<UINT64>(fullDetail.BaseVertexLocation) * geo->VertexByteStride;
+	geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
+	geometryDesc.Triangles.IndexFormat = geo->IndexFormat;
+	geometryDesc.Triangles.IndexCount = fullDetail.IndexCount;
+	geometryDesc.Triangles.IndexBuffer = geo->IndexBufferGPU->GetGPUVirtualAddress() + fullDetail.StartIndexLocation * indexStride;
+	geometryDesc.Triangles.Transform3x4 = 0;
+	// Mark the geometry as opaque. 
+	// PERFORMANCE TIP: mark geometry as opaque whenever applicable as it can enable important ray processing optimizations.
+	// Note: When rays encounter opaque geometry an any hit shader will not be executed whether it is present or not.
+	geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+
+	// Get the size requirements for the BLAS buffers
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
+	inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+	inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+	inputs.pGeometryDescs = &geometryDesc;
+	inputs.NumDescs = 1;
+	inputs.Flags = buildFlags;
+
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+	md3dDevice->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
+
+	prebuildInfo.ScratchDataSizeInBytes = Align(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, prebuildInfo.ScratchDataSizeInBytes);
+	prebuildInfo.ResultDataMaxSizeInBytes = Align(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, prebuildInfo.ResultDataMaxSizeInBytes);
+
+	std::unique_ptr<AccelerationStructureBuffer> blas = std::make_unique<AccelerationStructureBuffer>();
+
+	// Create the BLAS scratch buffer
+	D3D12BufferCreateInfo bufferInfo(prebuildInfo.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+	bufferInfo.Alignment = std::max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	CheckIsValid(D3D12Util::CreateBuffer(md3dDevice.Get(), bufferInfo, blas->Scratch.GetAddressOf(), mInfoQueue.Get()));
+
+	// Create the BLAS buffer
+	bufferInfo.Size = prebuildInfo.ResultDataMaxSizeInBytes;
+	bufferInfo.State = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
+	CheckIsValid(D3D12Util::CreateBuffer(md3dDevice.Get(), bufferInfo, blas->Result.GetAddressOf(), mInfoQueue.Get()));
+
+	// Describe and build the bottom level acceleration structure
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
+	buildDesc.Inputs = inputs;
+	buildDesc.ScratchAccelerationStructureData = blas->Scratch->GetGPUVirtualAddress();
+	buildDesc.DestAccelerationStructureData = blas->Result->GetGPUVirtualAddress();
+
+	mCommandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+
+	mBLASs[geo->Name] = std::move(blas);
+
+	return true;
+}
+
 bool Renderer::BuildTLAS() {
-	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+	Stopwatch instanceTimer;
 
-	// Describe the TLAS geometry instance(s)
-	{
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-		instanceDesc.InstanceID = instanceDescs.size();
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 0xFF;
-		instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1.0f;
-		instanceDesc.Transform[1][3] = 1.75f;
-		instanceDesc.AccelerationStructure = mBLASs["sphere"]->Result->GetGPUVirtualAddress();
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
-		instanceDescs.push_back(instanceDesc);
-	}
-	{
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-		instanceDesc.InstanceID = instanceDescs.size();
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 0xFF;
-		instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1.0f;
-		instanceDesc.Transform[0][3] = 1.75f;
-		instanceDesc.AccelerationStructure = mBLASs["sphere"]->Result->GetGPUVirtualAddress();
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
-		instanceDescs.push_back(instanceDesc);
-	}
-	{
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-		instanceDesc.InstanceID = instanceDescs.size();
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 0xFF;
-		instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1.0f;
-		instanceDesc.Transform[0][3] = -1.75f;
-		instanceDesc.AccelerationStructure = mBLASs["sphere"]->Result->GetGPUVirtualAddress();
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
-		instanceDescs.push_back(instanceDesc);
-	}
-	{
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-		instanceDesc.InstanceID = instanceDescs.size();
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 0xFF;
-		instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1.0f;
-		instanceDesc.Transform[1][3] = -1.25f;
-		instanceDesc.AccelerationStructure = mBLASs["grid"]->Result->GetGPUVirtualAddress();
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
-		instanceDescs.push_back(instanceDesc);
-	}
-	{
-		XMFLOAT4X4 mat;
-		XMStoreFloat4x4(&mat, XMMatrixTranspose(XMMatrixRotationAxis(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XM_PI)));
-
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-		instanceDesc.InstanceID = instanceDescs.size();
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 0xFF;
-		for (int i = 0; i < 3; ++i) {
-			for (int j = 0; j < 4; ++j) {
-				instanceDesc.Transform[i][j] = mat.m[i][j];
-			}
-		}
-		instanceDesc.AccelerationStructure = mBLASs["monkey"]->Result->GetGPUVirtualAddress();
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
-		instanceDescs.push_back(instanceDesc);
-	}
+	const auto& ritems = mRitems[RenderItem::RenderType::EOpaque];
+	const UINT instanceCount = static_cast<UINT>(ritems.size());
 
+	std::unordered_map<const MeshGeometry*, D3D12_GPU_VIRTUAL_ADDRESS> blasAddresses;
+	for (const auto ritem : ritems) {
+		if (blasAddresses.find(ritem->Geo) != blasAddresses.end()) continue;
+
+		const auto iter = mBLASs.find(ritem->Geo->Name);
+		if (iter == mBLASs.end()) ReturnFalse(L"Render item geometry has no BLAS");
+		blasAddresses[ritem->Geo] = iter->second->Result->GetGPUVirtualAddress();
+	}
 
 	// Create the TLAS instance buffer
 	D3D12BufferCreateInfo instanceBufferInfo;
-	instanceBufferInfo.Size = instanceDescs.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+	instanceBufferInfo.Size = std::max<UINT64>(instanceCount, 1) * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
 	instanceBufferInfo.HeapType = D3D12_HEAP_TYPE_UPLOAD;
 	instanceBufferInfo.Flags = D3D12_RESOURCE_FLAG_NONE;
 	instanceBufferInfo.State = D3D12_RESOURCE_STATE_GENERIC_READ;
 	CheckIsValid(D3D12Util::CreateBuffer(md3dDevice.Get(), instanceBufferInfo, mTLAS->InstanceDesc.GetAddressOf(), mInfoQueue.Get()));
 
-	// Copy the instance data to the buffer
-	void* pData;
-	CheckHResult(mTLAS->InstanceDesc->Map(0, nullptr, &pData));
-	std::memcpy(pData, instanceDescs.data(), instanceDescs.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
+	// Describe one instance per render item straight into the upload buffer; InstanceID follows
+	//  the render item order.
+	D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDescs = nullptr;
+	CheckHResult(mTLAS->InstanceDesc->Map(0, nullptr, reinterpret_cast<void**>(&pInstanceDescs)));
+	Parallel::ForRange(instanceCount, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const auto ritem = ritems[i];
+
+			XMFLOAT4X4 transform;
+			XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&ritem->World)));
+
+			D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
+			instanceDesc.InstanceID = static_cast<UINT>(i);
+			instanceDesc.InstanceContributionToHitGroupIndex = 0;
+			instanceDesc.InstanceMask = 0xFF;
+			for (int row = 0; row < 3; ++row) {
+				for (int col = 0; col < 4; ++col) {
+					instanceDesc.Transform[row][col] = transform.m[row][col];
+				}
+			}
+			instanceDesc.AccelerationStructure = blasAddresses.find(ritem->Geo)->second;
+			instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+			pInstanceDescs[i] = instanceDesc;
+		}
+	});
 	mTLAS->InstanceDesc->Unmap(0, nullptr);
 
+	mStageTimings.TlasInstances = instanceTimer.ElapsedMilliseconds();
+
 	// Get the size requirements for the TLAS buffers
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
 	inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 	inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 	inputs.InstanceDescs = mTLAS->InstanceDesc->GetGPUVirtualAddress();
-	inputs.NumDescs = static_cast<UINT>(instanceDescs.size());
+	inputs.NumDescs = instanceCount;
 	inputs.Flags = buildFlags;
 
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
@@ -1305,6 +2431,581 @@ bool Renderer::BuildTLAS() {
 	return true;
 }
 
+bool Renderer::BuildCpuBvhs() {
+	for (const auto& pair : mGeometries)
+		CheckIsValid(BuildCpuBvh(pair.second.get()));
+
+	return true;
+}
+
+bool Renderer::BuildCpuBvh(const MeshGeometry* geo) {
+	if (geo->VertexByteStride != sizeof(Vertex)) ReturnFalse(L"CPU BVHs need full-precision vertices");
+
+	const BvhMesh mesh = GeometryBvhMesh(geo);
+	const bool bLinear = UsesLinearBuild(geo->Name);
+
+	auto bvh = std::make_unique<Bvh>();
+
+	BvhBuildStats stats;
+	bool bCached = false;
+	if (MeshArgs::CpuBvh::Cache && !geo->Placeholder) {
+		Stopwatch timer;
+		const UINT64 key = bLinear ? BvhCache::CalcKey(mesh, CpuLbvhBuildDesc()) : BvhCache::CalcKey(mesh, CpuBvhBuildDesc());
+		const std::wstring cacheFilename = BvhCache::Filename(MeshArgs::CpuBvh::CacheDirectory, key);
+
+		BvhCache::BvhCacheFile cache;
+		bCached = cache.Open(cacheFilename, key, MeshArgs::CpuBvh::ValidateCache) && cache.Load(mesh, *bvh);
+		if (bCached) {
+			BvhCache::Touch(cacheFilename);
+			if (MeshArgs::CpuBvh::Report) BvhBuilder::CalcStats(*bvh, CpuBvhBuildDesc(), stats);
+			stats.BuildMilliseconds = timer.ElapsedMilliseconds();
+		}
+		else {
+			if (bLinear) CheckIsValid(LbvhBuilder::Build(mesh, CpuLbvhBuildDesc(), *bvh, &stats));
+			else CheckIsValid(BvhBuilder::Build(mesh, CpuBvhBuildDesc(), *bvh, &stats));
+			WriteBvhCache(cacheFilename, key, *bvh);
+		}
+	}
+	else if (bLinear) {
+		CheckIsValid(LbvhBuilder::Build(mesh, CpuLbvhBuildDesc(), *bvh, &stats));
+	}
+	else {
+		CheckIsValid(BvhBuilder::Build(mesh, CpuBvhBuildDesc(), *bvh, &stats));
+	}
+
+	if (MeshArgs::CpuBvh::Report) {
+		Logln("CPU BVH ", geo->Name, bLinear ? " (LBVH)" : "", ": ", std::to_string(stats.TriangleCount), " triangles, ",
+			std::to_string(stats.NodeCount), " nodes, ", std::to_string(stats.LeafCount), " leaves (",
+			std::to_string(stats.AverageLeafSize), " triangles avg), depth ", std::to_string(stats.MaxDepth),
+			", SAH cost ", std::to_string(stats.SahCost), bCached ? ", loaded from cache in " : ", built in ",
+			std::to_string(stats.BuildMilliseconds), " ms");
+	}
+
+	if (MeshArgs::CpuBvh::CompareLinearBuilds && !bCached) {
+		Bvh other;
+		BvhBuildStats otherStats;
+		if (bLinear) CheckIsValid(BvhBuilder::Build(mesh, CpuBvhBuildDesc(), other, &otherStats));
+		else CheckIsValid(LbvhBuilder::Build(mesh, CpuLbvhBuildDesc(), other, &otherStats));
+
+		const BvhBuildStats& sahStats = bLinear ? otherStats : stats;
+		const BvhBuildStats& linearStats = bLinear ? stats : otherStats;
+		Logln("    binned SAH ", std::to_string(sahStats.Throughput()), " Mtris/s, LBVH ",
+			std::to_string(linearStats.Throughput()), " Mtris/s; LBVH SAH cost ",
+			std::to_string(sahStats.SahCost > 0.0f ? linearStats.SahCost / sahStats.SahCost : 0.0f), "x binned SAH");
+	}
+
+	if (MeshArgs::BvhInspect::ReportStructure) {
+		BvhStructureStats structure;
+		BvhInspector::CalcStructureStats(*bvh, CpuBvhBuildDesc(), structure);
+		LogStructureStats("CPU BVH " + geo->Name, structure);
+	}
+
+	mCpuBvhs[geo->Name] = std::move(bvh);
+
+	return true;
+}
+
+bool Renderer::BuildCpuAnalyticBvhs() {
+	mCpuAnalyticBvhs.clear();
+
+	for (const auto& standIn : AnalyticStandIns) {
+		if (mGeometries.find(standIn.Geometry) == mGeometries.end()) continue;
+
+		auto bvh = std::make_unique<AnalyticBvh>();
+		bvh->Primitives.push_back(standIn.Primitive);
+		CheckIsValid(AnalyticBvhBuilder::Build(*bvh, CpuBvhBuildDesc()));
+
+		mCpuAnalyticBvhs[standIn.Geometry] = std::move(bvh);
+	}
+
+	return true;
+}
+
+bool Renderer::RunCpuRayTracingBenchmarks() {
+	std::vector<BvhMesh> shapes;
+	std::vector<const Bvh*> blases;
+	for (const char* shape : StressSceneShapes) {
+		const auto iter = mCpuBvhs.find(shape);
+		if (iter == mCpuBvhs.end()) ReturnFalse(L"Ray traversal benchmark needs CPU BVHs of the stress-scene shapes");
+		shapes.push_back(iter->second->Mesh);
+		blases.push_back(iter->second.get());
+	}
+
+	if (MeshArgs::RayTraversal::RunBenchmark) {
+		const UINT width = MeshArgs::RayTraversal::BenchmarkWidth;
+		const UINT height = MeshArgs::RayTraversal::BenchmarkHeight;
+		const UINT aoSampleCount = MeshArgs::RayTraversal::BenchmarkAoSampleCount;
+		const float aoRadius = MeshArgs::RayTraversal::BenchmarkAoRadius;
+
+		CheckIsValid(BvhTraversal::RunBenchmark("monkey", *mCpuBvhs["monkey"], width, height, aoSampleCount, aoRadius));
+
+		// BvhTraversal::RunBenchmark traces single-level hierarchies, so the stress scene is baked into one mesh.
+		SceneGeneratorDesc desc;
+		desc.Seed = MeshArgs::Scene::Seed;
+		desc.InstanceCount = MeshArgs::RayTraversal::BenchmarkStressInstanceCount;
+		desc.ShapeCount = _countof(StressSceneShapes);
+		desc.Density = MeshArgs::Scene::Density;
+
+		std::vector<SceneInstance> instances;
+		CheckIsValid(SceneGenerator::Generate(desc, instances));
+
+		std::vector<Vertex> vertices;
+		std::vector<std::uint32_t> indices;
+		FlattenInstances(instances, shapes, vertices, indices);
+
+		BvhMesh mesh;
+		mesh.Vertices = vertices.data();
+		mesh.VertexCount = static_cast<UINT>(vertices.size());
+		mesh.Indices = indices.data();
+		mesh.IndexCount = static_cast<UINT>(indices.size());
+		mesh.IndexStride = sizeof(std::uint32_t);
+
+		Bvh bvh;
+		CheckIsValid(BvhBuilder::Build(mesh, CpuBvhBuildDesc(), bvh));
+
+		CheckIsValid(BvhTraversal::RunBenchmark("stress scene (" + std::to_string(instances.size()) + " instances)", bvh, width, height, aoSampleCount, aoRadius));
+	}
+
+	if (MeshArgs::CpuTlas::RunBenchmark) {
+		const UINT maxCount = std::min(MeshArgs::CpuTlas::BenchmarkMaxInstanceCount, SceneGenerator::MaxInstanceCount);
+		for (UINT count = MeshArgs::CpuTlas::BenchmarkMinInstanceCount; count > 0 && count <= maxCount; count *= 10) {
+			CheckIsValid(TwoLevelBvhBuilder::RunBenchmark(blases, count, MeshArgs::Scene::Seed, MeshArgs::Scene::Density,
+				MeshArgs::CpuTlas::BenchmarkDrift, MeshArgs::CpuTlas::BenchmarkMovingFraction, CpuBvhBuildDesc()));
+			if (count > maxCount / 10) break;
+		}
+	}
+
+	return true;
+}
+
+bool Renderer::BuildCpuTlas() {
+	const auto& ritems = mRitems[RenderItem::RenderType::EOpaque];
+
+	auto tlas = std::make_unique<TwoLevelBvh>();
+	tlas->Instances.resize(ritems.size());
+
+	std::unordered_map<const MeshGeometry*, UINT> blasIndices;
+	std::unordered_map<const MeshGeometry*, UINT> analyticBlasIndices;
+	for (size_t i = 0; i < ritems.size(); ++i) {
+		const auto ritem = ritems[i];
+		// Items without a stand-in fall back to their triangles.
+		const auto analyticIter = ritem->AnalyticRayTracing ? mCpuAnalyticBvhs.find(ritem->Geo->Name) : mCpuAnalyticBvhs.end();
+		const bool bAnalytic = analyticIter != mCpuAnalyticBvhs.end();
+
+		UINT blas;
+		if (bAnalytic) {
+			auto iter = analyticBlasIndices.find(ritem->Geo);
+			if (iter == analyticBlasIndices.end()) {
+				iter = analyticBlasIndices.emplace(ritem->Geo, static_cast<UINT>(tlas->AnalyticBlases.size())).first;
+				tlas->AnalyticBlases.push_back(analyticIter->second.get());
+			}
+			blas = iter->second;
+		}
+		else {
+			auto iter = blasIndices.find(ritem->Geo);
+			if (iter == blasIndices.end()) {
+				const auto bvhIter = mCpuBvhs.find(ritem->Geo->Name);
+				if (bvhIter == mCpuBvhs.end()) ReturnFalse(L"Render item geometry has no CPU BVH");
+
+				iter = blasIndices.emplace(ritem->Geo, static_cast<UINT>(tlas->Blases.size())).first;
+				tlas->Blases.push_back(bvhIter->second.get());
+			}
+			blas = iter->second;
+		}
+
+		// Same description as the TLAS instance of the render item.
+		BvhInstance& instance = tlas->Instances[i];
+		TwoLevelBvhBuilder::SetTransform(instance, ritem->World);
+		instance.InstanceID = static_cast<UINT>(i);
+		instance.Mask = 0xFF;
+		instance.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+		instance.Blas = blas;
+		instance.Analytic = bAnalytic;
+	}
+
+	mCpuTlas.reset();
+	if (tlas->Instances.empty()) return true;
+
+	CheckIsValid(TwoLevelBvhBuilder::Build(*tlas, CpuBvhBuildDesc()));
+	mCpuTlas = std::move(tlas);
+
+	if (MeshArgs::BvhInspect::ReportStructure) {
+		BvhStructureStats structure;
+		BvhInspector::CalcStructureStats(mCpuTlas->Nodes, static_cast<UINT>(mCpuTlas->Instances.size()), CpuBvhBuildDesc(), structure);
+		LogStructureStats("CPU TLAS", structure);
+	}
+
+	return true;
+}
+
+bool Renderer::BuildCpuSceneBvh(std::vector<Vertex>& outVertices, std::vector<std::uint32_t>& outIndices, Bvh& outBvh) {
+	std::vector<BvhMesh> shapes;
+	std::unordered_map<const MeshGeometry*, UINT> shapeIndices;
+	std::vector<SceneInstance> instances;
+
+	for (const auto ritem : mRitems[RenderItem::RenderType::EOpaque]) {
+		auto iter = shapeIndices.find(ritem->Geo);
+		if (iter == shapeIndices.end()) {
+			const auto bvhIter = mCpuBvhs.find(ritem->Geo->Name);
+			if (bvhIter == mCpuBvhs.end()) ReturnFalse(L"Render item geometry has no CPU BVH");
+
+			iter = shapeIndices.emplace(ritem->Geo, static_cast<UINT>(shapes.size())).first;
+			shapes.push_back(bvhIter->second->Mesh);
+		}
+
+		SceneInstance instance;
+		instance.World = ritem->World;
+		instance.ShapeIndex = iter->second;
+		instance.MaterialIndex = 0;
+		instances.push_back(instance);
+	}
+
+	FlattenInstances(instances, shapes, outVertices, outIndices);
+
+	BvhMesh mesh;
+	mesh.Vertices = outVertices.data();
+	mesh.VertexCount = static_cast<UINT>(outVertices.size());
+	mesh.Indices = outIndices.data();
+	mesh.IndexCount = static_cast<UINT>(outIndices.size());
+	mesh.IndexStride = sizeof(std::uint32_t);
+
+	CheckIsValid(BvhBuilder::Build(mesh, CpuBvhBuildDesc(), outBvh));
+
+	return true;
+}
+
+bool Renderer::ReadbackTextures(UINT count, ID3D12Resource* const* pSources, const D3D12_RESOURCE_STATES* pStates,
+		Microsoft::WRL::ComPtr<ID3D12Resource>* pOutReadbacks, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* pOutFootprints) {
+	CheckIsValid(FlushCommandQueue());
+
+	CheckHResult(mDirectCmdListAlloc->Reset());
+	CheckHResult(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+
+	const auto cmdList = mCommandList.Get();
+
+	for (UINT i = 0; i < count; ++i) {
+		const auto desc = pSources[i]->GetDesc();
+
+		// Subresource 0 of the depth-stencil buffer is its depth plane.
+		UINT64 byteSize = 0;
+		md3dDevice->GetCopyableFootprints(&desc, 0, 1, 0, &pOutFootprints[i], nullptr, nullptr, &byteSize);
+
+		D3D12BufferCreateInfo readbackInfo(byteSize, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_STATE_COPY_DEST);
+		CheckIsValid(D3D12Util::CreateBuffer(md3dDevice.Get(), readbackInfo, pOutReadbacks[i].ReleaseAndGetAddressOf(), mInfoQueue.Get()));
+
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pSources[i], pStates[i], D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+		const CD3DX12_TEXTURE_COPY_LOCATION dst(pOutReadbacks[i].Get(), pOutFootprints[i]);
+		const CD3DX12_TEXTURE_COPY_LOCATION src(pSources[i], 0);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pSources[i], D3D12_RESOURCE_STATE_COPY_SOURCE, pStates[i]));
+	}
+
+	CheckHResult(cmdList->Close());
+	ID3D12CommandList* cmdsLists[] = { cmdList };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	CheckIsValid(FlushCommandQueue());
+
+	return true;
+}
+
+bool Renderer::CaptureRtaoFrame(RtaoFrame& outFrame) {
+	const auto& gbufferResources = mGBuffer->Resources();
+	const auto& aoResources = mRtao->AOResources();
+
+	enum { ENormalDepth = 0, EDepth, EAOCoefficient, ERayHitDistance, SourceCount };
+
+	// Each texture with the state a ray-traced frame leaves it in.
+	ID3D12Resource* const sources[SourceCount] = {
+		gbufferResources[GBuffer::Resources::ENormalDepth].Get(),
+		mDepthStencilBuffer.Get(),
+		aoResources[Rtao::AOResources::EAmbientCoefficient].Get(),
+		aoResources[Rtao::AOResources::ERayHitDistance].Get()
+	};
+	const D3D12_RESOURCE_STATES states[SourceCount] = {
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		D3D12_RESOURCE_STATE_DEPTH_READ,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+	};
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[SourceCount];
+	Microsoft::WRL::ComPtr<ID3D12Resource> readbacks[SourceCount];
+	CheckIsValid(ReadbackTextures(SourceCount, sources, states, readbacks, footprints));
+
+	// RtaoRayGen indexes the G-buffer with its own launch indices, also at quarter resolution.
+	const UINT width = mRtao->Width();
+	const UINT height = mRtao->Height();
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+
+	outFrame = RtaoFrame();
+	outFrame.Width = width;
+	outFrame.Height = height;
+	outFrame.Constants = *mRtaoCB;
+	outFrame.Normals.resize(pixelCount);
+	outFrame.Depths.resize(pixelCount);
+	outFrame.AOCoefficients.resize(pixelCount);
+	outFrame.RayHitDistances.resize(pixelCount);
+
+	for (UINT i = 0; i < SourceCount; ++i) {
+		void* pData = nullptr;
+		CheckHResult(readbacks[i]->Map(0, nullptr, &pData));
+
+		const BYTE* base = reinterpret_cast<const BYTE*>(pData) + footprints[i].Offset;
+		const UINT rowPitch = footprints[i].Footprint.RowPitch;
+
+		for (UINT y = 0; y < height; ++y) {
+			const BYTE* row = base + static_cast<size_t>(y) * rowPitch;
+			for (UINT x = 0; x < width; ++x) {
+				const size_t index = static_cast<size_t>(y) * width + x;
+				switch (i) {
+				case ENormalDepth: {
+					// R8G8B8A8_SNORM
+					const INT8* texel = reinterpret_cast<const INT8*>(row) + x * 4;
+					outFrame.Normals[index] = XMFLOAT3(
+						std::max(texel[0] / 127.0f, -1.0f),
+						std::max(texel[1] / 127.0f, -1.0f),
+						std::max(texel[2] / 127.0f, -1.0f));
+					break;
+				}
+				case EDepth:
+					outFrame.Depths[index] = DecodeDepthStencilTexel(reinterpret_cast<const UINT*>(row)[x]);
+					break;
+				case EAOCoefficient:
+					outFrame.AOCoefficients[index] = XMConvertHalfToFloat(reinterpret_cast<const HALF*>(row)[x]);
+					break;
+				case ERayHitDistance:
+					outFrame.RayHitDistances[index] = XMConvertHalfToFloat(reinterpret_cast<const HALF*>(row)[x]);
+					break;
+				}
+			}
+		}
+
+		readbacks[i]->Unmap(0, nullptr);
+	}
+
+	return true;
+}
+
+bool Renderer::CompareRtaoWithCpu() {
+	RtaoFrame gpuFrame;
+	CheckIsValid(CaptureRtaoFrame(gpuFrame));
+
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	Bvh bvh;
+	CheckIsValid(BuildCpuSceneBvh(vertices, indices, bvh));
+
+	RtaoFrame cpuFrame;
+	cpuFrame.Width = gpuFrame.Width;
+	cpuFrame.Height = gpuFrame.Height;
+	cpuFrame.Constants = gpuFrame.Constants;
+	cpuFrame.Normals = gpuFrame.Normals;
+	cpuFrame.Depths = gpuFrame.Depths;
+
+	RtaoTraceDesc traceDesc;
+	traceDesc.Packets = MeshArgs::CpuRtao::Packets;
+	traceDesc.SortRays = MeshArgs::CpuRtao::SortRays;
+
+	RtaoReferenceStats stats;
+	CheckIsValid(RtaoReference::Run(bvh, cpuFrame, traceDesc, &stats));
+
+	RtaoComparison comparison;
+	CheckIsValid(RtaoReference::Compare(cpuFrame, gpuFrame, MeshArgs::CpuRtao::Tolerance, comparison));
+
+	Logln("CPU RTAO frame ", std::to_string(gpuFrame.Constants.FrameCount), ": ", std::to_string(gpuFrame.Width), "x",
+		std::to_string(gpuFrame.Height), ", ", std::to_string(stats.RayCount), " rays in ", std::to_string(stats.Milliseconds), " ms (",
+		std::to_string(stats.Milliseconds > 0.0 ? stats.RayCount / (stats.Milliseconds * 1000.0) : 0.0), " Mrays/s on ",
+		std::to_string(Parallel::WorkerCount()), " threads) over ", std::to_string(bvh.Mesh.TriangleCount()), " triangles");
+	Logln("    vs GPU: ", std::to_string(comparison.CoverageMismatchCount), " coverage mismatches, AO ",
+		std::to_string(comparison.AOMismatchCount), " mismatches (max ", std::to_string(comparison.AOMaxError), ", mean ",
+		std::to_string(comparison.AOMeanError), "), hit distance ", std::to_string(comparison.HitDistanceMismatchCount),
+		" mismatches (max ", std::to_string(comparison.HitDistanceMaxError), ", mean ", std::to_string(comparison.HitDistanceMeanError), ")");
+
+	if (MeshArgs::CpuRtao::WriteFrames) {
+		CheckIsValid(RtaoReference::Write(MeshArgs::CpuRtao::GpuFrameFilename, gpuFrame));
+		CheckIsValid(RtaoReference::Write(MeshArgs::CpuRtao::CpuFrameFilename, cpuFrame));
+	}
+
+	const UINT maxSamplesPerPixel = MeshArgs::CpuRtao::BenchmarkMaxSamplesPerPixel;
+	if (maxSamplesPerPixel > 0) Logln("    ray scheduling, ms single unsorted/sorted, packets unsorted/sorted:");
+
+	for (UINT samplesPerPixel = 1; samplesPerPixel <= maxSamplesPerPixel; samplesPerPixel <<= 1) {
+		RtaoFrame unsortedFrame;
+		double milliseconds[4] = {};
+		UINT64 rayCount = 0;
+		bool bSame = true;
+
+		for (UINT i = 0; i < 4; ++i) {
+			RtaoTraceDesc desc;
+			desc.Packets = i >= 2;
+			desc.SortRays = (i & 1) != 0;
+			desc.SamplesPerPixel = samplesPerPixel;
+
+			RtaoFrame frame = cpuFrame;
+			RtaoReferenceStats frameStats;
+			CheckIsValid(RtaoReference::Run(bvh, frame, desc, &frameStats));
+			milliseconds[i] = frameStats.Milliseconds;
+			rayCount = frameStats.RayCount;
+
+			if (i == 0) unsortedFrame = std::move(frame);
+			else bSame = bSame && frame.AOCoefficients == unsortedFrame.AOCoefficients && frame.RayHitDistances == unsortedFrame.RayHitDistances;
+		}
+
+		Logln("        ", std::to_string(samplesPerPixel), " spp: ", std::to_string(rayCount), " rays, ", std::to_string(milliseconds[0]), "/",
+			std::to_string(milliseconds[1]), ", ", std::to_string(milliseconds[2]), "/", std::to_string(milliseconds[3]),
+			bSame ? "" : ", images differ");
+	}
+
+	return true;
+}
+
+bool Renderer::CaptureShadowFrame(ShadowFrame& outFrame) {
+	const auto& dxrShadowResources = mDxrShadow->Resources();
+
+	enum { EDepth = 0, EShadow, SourceCount };
+
+	ID3D12Resource* const sources[SourceCount] = {
+		mDepthStencilBuffer.Get(),
+		dxrShadowResources[DxrShadow::Resources::EShadow].Get()
+	};
+	const D3D12_RESOURCE_STATES states[SourceCount] = {
+		D3D12_RESOURCE_STATE_DEPTH_READ,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+	};
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[SourceCount];
+	Microsoft::WRL::ComPtr<ID3D12Resource> readbacks[SourceCount];
+	CheckIsValid(ReadbackTextures(SourceCount, sources, states, readbacks, footprints));
+
+	// ShadowRayGen is dispatched over the whole client area, one ray per depth texel.
+	const UINT width = mDxrShadow->Width();
+	const UINT height = mDxrShadow->Height();
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+
+	outFrame = ShadowFrame();
+	outFrame.Width = width;
+	outFrame.Height = height;
+	outFrame.LightCount = 1;
+	outFrame.Constants = *mMainPassCB;
+	outFrame.Depths.resize(pixelCount);
+	outFrame.ShadowFactors.resize(pixelCount);
+
+	for (UINT i = 0; i < SourceCount; ++i) {
+		void* pData = nullptr;
+		CheckHResult(readbacks[i]->Map(0, nullptr, &pData));
+
+		const BYTE* base = reinterpret_cast<const BYTE*>(pData) + footprints[i].Offset;
+		const UINT rowPitch = footprints[i].Footprint.RowPitch;
+
+		for (UINT y = 0; y < height; ++y) {
+			const BYTE* row = base + static_cast<size_t>(y) * rowPitch;
+			for (UINT x = 0; x < width; ++x) {
+				const size_t index = static_cast<size_t>(y) * width + x;
+				if (i == EDepth) {
+					outFrame.Depths[index] = DecodeDepthStencilTexel(reinterpret_cast<const UINT*>(row)[x]);
+				}
+				else {
+					// R16_UNORM
+					outFrame.ShadowFactors[index] = static_cast<float>(reinterpret_cast<const UINT16*>(row)[x]) / 65535.0f;
+				}
+			}
+		}
+
+		readbacks[i]->Unmap(0, nullptr);
+	}
+
+	return true;
+}
+
+bool Renderer::CompareShadowsWithCpu() {
+	ShadowFrame gpuFrame;
+	CheckIsValid(CaptureShadowFrame(gpuFrame));
+
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	Bvh bvh;
+	CheckIsValid(BuildCpuSceneBvh(vertices, indices, bvh));
+
+	ShadowFrame cpuFrame;
+	cpuFrame.Width = gpuFrame.Width;
+	cpuFrame.Height = gpuFrame.Height;
+	cpuFrame.Constants = gpuFrame.Constants;
+	cpuFrame.Depths = gpuFrame.Depths;
+
+	ShadowReferenceStats stats;
+	CheckIsValid(ShadowReference::Run(bvh, cpuFrame, ShadowTraceDesc(), &stats));
+
+	ShadowComparison comparison;
+	CheckIsValid(ShadowReference::Compare(cpuFrame, gpuFrame, MeshArgs::CpuShadow::Tolerance, comparison));
+
+	Logln("CPU shadow frame ", std::to_string(mRtaoCB->FrameCount), ": ", std::to_string(gpuFrame.Width), "x",
+		std::to_string(gpuFrame.Height), ", ", std::to_string(stats.RayCount), " rays (", std::to_string(stats.OccludedCount),
+		" occluded) in ", std::to_string(stats.Milliseconds), " ms (",
+		std::to_string(stats.Milliseconds > 0.0 ? stats.RayCount / (stats.Milliseconds * 1000.0) : 0.0), " Mrays/s on ",
+		std::to_string(Parallel::WorkerCount()), " threads) over ", std::to_string(bvh.Mesh.TriangleCount()), " triangles");
+	Logln("    vs GPU: ", std::to_string(comparison.MismatchCount), " of ", std::to_string(comparison.PixelCount),
+		" pixels differ (max ", std::to_string(comparison.MaxError), ", mean ", std::to_string(comparison.MeanError), ")");
+
+	if (MeshArgs::CpuShadow::WriteFrames) {
+		CheckIsValid(ShadowReference::Write(MeshArgs::CpuShadow::GpuFrameFilename, gpuFrame));
+		CheckIsValid(ShadowReference::Write(MeshArgs::CpuShadow::CpuFrameFilename, cpuFrame));
+	}
+
+	const UINT maxLightCount = std::min<UINT>(MeshArgs::CpuShadow::BenchmarkMaxLightCount, MaxLights);
+	if (maxLightCount > 0) Logln("    light count scaling, ms single/packet:");
+
+	for (UINT lightCount = 1; lightCount <= maxLightCount; lightCount <<= 1) {
+		ShadowFrame frame;
+		frame.Width = gpuFrame.Width;
+		frame.Height = gpuFrame.Height;
+		frame.LightCount = lightCount;
+		frame.Constants = gpuFrame.Constants;
+		frame.Depths = gpuFrame.Depths;
+		SpreadDirectionalLights(frame.Constants, lightCount);
+
+		ShadowTraceDesc singleDesc;
+		singleDesc.Packets = false;
+
+		ShadowReferenceStats singleStats;
+		ShadowReferenceStats packetStats;
+		CheckIsValid(ShadowReference::Run(bvh, frame, singleDesc, &singleStats));
+		CheckIsValid(ShadowReference::Run(bvh, frame, ShadowTraceDesc(), &packetStats));
+
+		Logln("        ", std::to_string(lightCount), " lights: ", std::to_string(packetStats.RayCount), " rays (",
+			std::to_string(packetStats.OccludedCount), " occluded), ", std::to_string(singleStats.Milliseconds), "/",
+			std::to_string(packetStats.Milliseconds));
+	}
+
+	return true;
+}
+
+bool Renderer::RenderCpuHeatmaps() {
+	if (mCpuTlas == nullptr) ReturnFalse(L"Heatmaps need the CPU TLAS");
+
+	BvhHeatmapDesc desc;
+	desc.Width = MeshArgs::BvhInspect::HeatmapWidth;
+	desc.Height = MeshArgs::BvhInspect::HeatmapHeight;
+	const XMMATRIX viewProj = XMMatrixMultiply(mCamera->GetViewMatrix(), mCamera->GetProjectionMatrix());
+	XMStoreFloat4x4(&desc.InvViewProj, XMMatrixInverse(nullptr, viewProj));
+
+	BvhHeatmap heatmap;
+	CheckIsValid(BvhInspector::RenderHeatmap(*mCpuTlas, desc, heatmap));
+
+	Logln("CPU TLAS heatmap ", std::to_string(heatmap.Width), "x", std::to_string(heatmap.Height), " in ",
+		std::to_string(heatmap.Milliseconds), " ms: nodes avg ", std::to_string(heatmap.MeanNodeCount), " max ",
+		std::to_string(heatmap.Max.NodeCount), ", triangles avg ", std::to_string(heatmap.MeanTriangleCount), " max ",
+		std::to_string(heatmap.Max.TriangleCount), ", instances avg ", std::to_string(heatmap.MeanInstanceCount), " max ",
+		std::to_string(heatmap.Max.InstanceCount));
+
+	CheckIsValid(BvhInspector::WritePfm(MeshArgs::BvhInspect::NodeHeatmapFilename, heatmap.Width, heatmap.Height, heatmap.NodeCounts));
+	CheckIsValid(BvhInspector::WritePfm(MeshArgs::BvhInspect::TriangleHeatmapFilename, heatmap.Width, heatmap.Height, heatmap.TriangleCounts));
+	CheckIsValid(BvhInspector::WritePfm(MeshArgs::BvhInspect::InstanceHeatmapFilename, heatmap.Width, heatmap.Height, heatmap.InstanceCounts));
+
+	return true;
+}
+
 bool Renderer::BuildDXRPSOs() {
 	CheckIsValid(mDxrShadow->BuildDXRPSO());
 	CheckIsValid(mRtao->BuildDXRPSO());
@@ -1546,6 +3247,7 @@ bool Renderer::UpdateRtaoPassCB(const GameTimer& gt) {
 		rtaoCB.SampleCount = ShaderArgs::RaytracedAO::SampleCount;
 		
 		prev = mMainPassCB->View;
+		*mRtaoCB = rtaoCB;
 
 		auto& currRtaoCB = mCurrFrameResource->RtaoCB;
 		currRtaoCB.CopyData(0, rtaoCB);
@@ -1638,9 +3340,82 @@ bool Renderer::UpdateRtaoPassCB(const GameTimer& gt) {
 	return true;
 }
 
+bool Renderer::SelectLods() {
+	mSubmittedTriangleCount = 0;
+	mFullDetailTriangleCount = 0;
+
+	const XMVECTOR eyePosW = XMLoadFloat3(&mCamera->GetCameraPosition());
+	// Pixels covered by one unit of object-space error at unit distance.
+	const float pixelsPerUnit = static_cast<float>(mClientHeight) / (2.0f * std::tan(0.5f * mCamera->FovY()));
+
+	for (const auto ritem : mRitems[RenderItem::RenderType::EOpaque]) {
+		if (ritem->Lods.empty()) continue;
+
+		const XMMATRIX world = XMLoadFloat4x4(&ritem->World);
+		const float scale = std::max(
+			XMVectorGetX(XMVector3Length(world.r[0])),
+			std::max(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+
+		const XMVECTOR centerW = XMVector3TransformCoord(XMLoadFloat3(&ritem->Bounds.Center), world);
+		const float distance = std::max(
+			XMVectorGetX(XMVector3Length(XMVectorSubtract(centerW, eyePosW))) - ritem->Bounds.Radius * scale,
+			1e-3f);
+
+		UINT level = 0;
+		for (UINT i = 1, end = static_cast<UINT>(ritem->Lods.size()); i < end; ++i) {
+			const float projectedError = ritem->Lods[i].Error * scale * pixelsPerUnit / distance;
+			if (projectedError > MeshArgs::Lod::MaxScreenSpaceError) break;
+			level = i;
+		}
+
+		const auto& lod = ritem->Lods[level];
+		ritem->LodIndex = level;
+		ritem->IndexCount = lod.IndexCount;
+		ritem->StartIndexLocation = lod.StartIndexLocation;
+		ritem->BaseVertexLocation = lod.BaseVertexLocation;
+		ritem->Meshlets = lod.Meshlets;
+
+		mSubmittedTriangleCount += lod.IndexCount / 3;
+		mFullDetailTriangleCount += ritem->Lods.front().IndexCount / 3;
+	}
+
+	return true;
+}
+
+bool Renderer::CullMeshlets() {
+	mMeshletCullStats = MeshletCullStats();
+	if (!MeshArgs::Meshlets::CullEnabled) return true;
+
+	const XMMATRIX viewProj = XMMatrixMultiply(mCamera->GetViewMatrix(), mCamera->GetProjectionMatrix());
+	const XMVECTOR eyePosW = XMLoadFloat3(&mCamera->GetCameraPosition());
+
+	for (const auto ritem : mRitems[RenderItem::RenderType::EOpaque]) {
+		if (ritem->Meshlets == nullptr) continue;
+
+		const XMMATRIX world = XMLoadFloat4x4(&ritem->World);
+		const XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+
+		mVisibleMeshlets.clear();
+		MeshletCuller::Cull(
+			*ritem->Meshlets,
+			XMMatrixMultiply(world, viewProj),
+			XMVector3TransformCoord(eyePosW, invWorld),
+			mVisibleMeshlets,
+			&mMeshletCullStats);
+	}
+
+	return true;
+}
+
 bool Renderer::Rasterize() {
+	Stopwatch stageTimer;
 	CheckIsValid(DrawShadowMap());
+	mStageTimings.ShadowRecording = stageTimer.ElapsedMilliseconds();
+
+	stageTimer.Restart();
 	CheckIsValid(DrawGBuffer());
+	mStageTimings.GBufferRecording = stageTimer.ElapsedMilliseconds();
+
 	CheckIsValid(DrawSsao());
 	CheckIsValid(DrawBackBuffer());
 
@@ -2059,6 +3834,12 @@ bool Renderer::DrawImGui() {
 	{
 		ImGui::Begin("Main Panel");
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		ImGui::Text("LOD triangles %u/%u submitted", mSubmittedTriangleCount, mFullDetailTriangleCount);
+		if (MeshArgs::Meshlets::CullEnabled) {
+			ImGui::Text("Meshlets %u/%u visible, %u/%u triangles rejected",
+				mMeshletCullStats.VisibleMeshletCount, mMeshletCullStats.MeshletCount,
+				mMeshletCullStats.TriangleCount - mMeshletCullStats.VisibleTriangleCount, mMeshletCullStats.TriangleCount);
+		}
 		ImGui::NewLine();
 
 		static const auto BuildDebugDescriptors = [&](bool& mode, D3D12_GPU_DESCRIPTOR_HANDLE handle, UINT mask) {
@@ -2313,6 +4094,9 @@ bool Renderer::dxrDrawShadowMap() {
 	const auto shadow = dxrShadowResources[DxrShadow::Resources::EShadow].Get();
 	const auto temporary = dxrShadowResources[DxrShadow::Resources::ETemporary].Get();
 
+	// The CPU reference compares against the unblurred mask.
+	const bool bCaptureRawShadow = MeshArgs::CpuShadow::CompareFrame != 0 && mRtaoCB->FrameCount == MeshArgs::CpuShadow::CompareFrame;
+
 	ID3D12Resource* resources[DxrShadow::Resources::Count] = { shadow, temporary };
 	{
 		D3D12_RESOURCE_BARRIER barriers[] = {
@@ -2372,7 +4156,7 @@ bool Renderer::dxrDrawShadowMap() {
 		dxrShadowGpuDescriptors[DxrShadow::Resources::Descriptors::EU_Temporary],
 		GaussianFilterCS::Filter::Type::R16,
 		mDxrShadow->Width(), mDxrShadow->Height(),
-		ShaderArgs::DxrShadow::BlurCount
+		bCaptureRawShadow ? 0 : ShaderArgs::DxrShadow::BlurCount
 	);
 	
 	CheckHResult(cmdList->Close());
@@ -0,0 +1,418 @@
+#include "RtaoReference.h"
+#include "Bvh.h"
+#include "BvhTraversal.h"
+#include "Logger.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace {
+	// Rtao.hlsli
+	const float RayHitDistanceOnMiss = 0.0f;
+	const float InvalidAOCoefficientValue = -1.0f;
+
+	// Distance RtaoRayGen nudges ray origins along the surface normal.
+	const float OriginOffset = 0.01f;
+
+	struct FileHeader {
+		UINT Magic;
+		UINT Version;
+		UINT HeaderSize;
+		UINT ConstantsSize;
+		UINT Width;
+		UINT Height;
+		// Whether AO coefficients and hit distances follow the inputs.
+		UINT HasOutputs;
+		UINT FileHeaderPad;
+	};
+
+	// Constant buffers hold transposed matrices; this is element [row][col] of the matrix the
+	//  shader sees.
+	__forceinline float ShaderMatrix(const XMFLOAT4X4& m, int row, int col) {
+		return m.m[col][row];
+	}
+
+	// mul(v, m) with v as a row vector.
+	XMFLOAT4 Mul(const XMFLOAT4& v, const XMFLOAT4X4& m) {
+		float r[4];
+		for (int col = 0; col < 4; ++col)
+			r[col] = v.x * ShaderMatrix(m, 0, col) + v.y * ShaderMatrix(m, 1, col) + v.z * ShaderMatrix(m, 2, col) + v.w * ShaderMatrix(m, 3, col);
+		return XMFLOAT4(r[0], r[1], r[2], r[3]);
+	}
+
+	__forceinline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) {
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	__forceinline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) {
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	__forceinline float Sign(float x) {
+		return x > 0.0f ? 1.0f : (x < 0.0f ? -1.0f : 0.0f);
+	}
+
+	// InitRand in Rtao.hlsl: tiny encryption algorithm rounds over the two inputs.
+	UINT InitRand(UINT val0, UINT val1, UINT backoff = 16) {
+		UINT v0 = val0;
+		UINT v1 = val1;
+		UINT s0 = 0;
+
+		for (UINT n = 0; n < backoff; ++n) {
+			s0 += 0x9e3779b9;
+			v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+			v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+		}
+
+		return v0;
+	}
+
+	// RandGenerator.hlsli
+	float NextRand(UINT& s) {
+		s = (1664525u * s + 1013904223u);
+		return static_cast<float>(s & 0x00FFFFFF) / static_cast<float>(0x01000000);
+	}
+
+	XMFLOAT3 PerpendicularVector(const XMFLOAT3& u) {
+		const XMFLOAT3 a(std::fabs(u.x), std::fabs(u.y), std::fabs(u.z));
+		const UINT xm = ((a.x - a.y) < 0 && (a.x - a.z) < 0) ? 1 : 0;
+		const UINT ym = (a.y - a.z) < 0 ? (1 ^ xm) : 0;
+		const UINT zm = 1 ^ (xm | ym);
+		return Cross(u, XMFLOAT3(static_cast<float>(xm), static_cast<float>(ym), static_cast<float>(zm)));
+	}
+
+	XMFLOAT3 CosHemisphereSample(UINT& seed, const XMFLOAT3& hitNorm) {
+		const float randX = NextRand(seed);
+		const float randY = NextRand(seed);
+
+		const XMFLOAT3 bitangent = PerpendicularVector(hitNorm);
+		const XMFLOAT3 tangent = Cross(bitangent, hitNorm);
+		const float r = std::sqrt(randX);
+		const float phi = 2.0f * 3.14159265f * randY;
+
+		const float t = r * std::cos(phi);
+		const float b = r * std::sin(phi);
+		const float n = std::sqrt(1 - randX);
+		return XMFLOAT3(
+			tangent.x * t + bitangent.x * b + hitNorm.x * n,
+			tangent.y * t + bitangent.y * b + hitNorm.y * n,
+			tangent.z * t + bitangent.z * b + hitNorm.z * n);
+	}
+
+	// ShadingHelpers.hlsli
+	float OcclusionFunction(float distZ, float epsilon, float fadeStart, float fadeEnd) {
+		float occlusion = 0.0f;
+		if (distZ > epsilon) {
+			const float fadeLength = fadeEnd - fadeStart;
+			occlusion = std::min(std::max((fadeEnd - distZ) / fadeLength, 0.0f), 1.0f);
+		}
+		return occlusion;
+	}
+
+	// CalculateHitPositionAndSurfaceNormal in Rtao.hlsl, minus the normal fetch.
+	XMFLOAT3 CalcHitPosition(const RtaoConstants& cb, float depth, UINT x, UINT y, UINT width, UINT height) {
+		const float texX = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+		const float texY = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+		const XMFLOAT4 posH(texX * 2 - 1, (1 - texY) * 2 - 1, 0.0f, 1.0f);
+
+		XMFLOAT4 posV = Mul(posH, cb.InvProj);
+		const float w = posV.w;
+		posV = XMFLOAT4(posV.x / w, posV.y / w, posV.z / w, posV.w / w);
+
+		// NdcDepthToViewDepth
+		const float dv = ShaderMatrix(cb.Proj, 3, 2) / (depth - ShaderMatrix(cb.Proj, 2, 2));
+		const float scale = dv / posV.z;
+
+		const XMFLOAT4 posW = Mul(XMFLOAT4(scale * posV.x, scale * posV.y, scale * posV.z, 1.0f), cb.InvView);
+		return XMFLOAT3(posW.x, posW.y, posW.z);
+	}
+
+	// Spreads the low six bits of v to the even bits.
+	UINT Part1By1(UINT v) {
+		UINT result = 0;
+		for (UINT bit = 0; bit < 6; ++bit)
+			result |= ((v >> bit) & 1) << (2 * bit);
+		return result;
+	}
+
+	// Octant in the high bits, then the direction's place within the octant on a 64x64 grid of
+	//  |x| and |y| over the L1 length, in Morton order so nearby cells stay nearby.
+	UINT DirectionKey(const XMFLOAT3& d) {
+		const UINT octant = (d.x < 0.0f ? 1 : 0) | (d.y < 0.0f ? 2 : 0) | (d.z < 0.0f ? 4 : 0);
+
+		const float length = std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z);
+		if (!(length > 0.0f)) return octant << 12;
+
+		const UINT u = std::min(static_cast<UINT>(std::fabs(d.x) / length * 64.0f), 63u);
+		const UINT v = std::min(static_cast<UINT>(std::fabs(d.y) / length * 64.0f), 63u);
+		return (octant << 12) | Part1By1(u) | (Part1By1(v) << 1);
+	}
+
+	float CompareError(float reference, float gpu) {
+		return std::fabs(reference - gpu) / std::max(1.0f, std::fabs(gpu));
+	}
+
+	template <typename T>
+	void WriteArray(std::ofstream& fout, const std::vector<T>& values) {
+		fout.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+	}
+
+	template <typename T>
+	void ReadArray(std::ifstream& fin, size_t count, std::vector<T>& outValues) {
+		outValues.resize(count);
+		fin.read(reinterpret_cast<char*>(outValues.data()), static_cast<std::streamsize>(count * sizeof(T)));
+	}
+}
+
+bool RtaoReference::Run(const Bvh& bvh, RtaoFrame& frame, const RtaoTraceDesc& desc, RtaoReferenceStats* pStats) {
+	const UINT width = frame.Width;
+	const UINT height = frame.Height;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	if (frame.Normals.size() != pixelCount || frame.Depths.size() != pixelCount) ReturnFalse(L"RTAO frame inputs do not match its size");
+
+	const RtaoConstants& cb = frame.Constants;
+
+	frame.AOCoefficients.assign(pixelCount, InvalidAOCoefficientValue);
+	frame.RayHitDistances.assign(pixelCount, cb.OcclusionRadius);
+
+	// With no samples the shader never traces and leaves every ray a miss.
+	const UINT samplesPerPixel = desc.SamplesPerPixel;
+	const bool bTrace = samplesPerPixel > 0 || cb.SampleCount > 0;
+	const UINT rayCountPerPixel = std::max(samplesPerPixel, 1u);
+
+	const UINT tileCountX = (width + TileSize - 1) / TileSize;
+	const UINT tileCountY = (height + TileSize - 1) / TileSize;
+	std::atomic<UINT64> rayCount(0);
+
+	Stopwatch timer;
+
+	Parallel::ForEach(static_cast<size_t>(tileCountX) * tileCountY, [&](size_t tile) {
+		const UINT beginX = static_cast<UINT>(tile % tileCountX) * TileSize;
+		const UINT beginY = static_cast<UINT>(tile / tileCountX) * TileSize;
+		const UINT endX = std::min(beginX + TileSize, width);
+		const UINT endY = std::min(beginY + TileSize, height);
+
+		// Rays of a pixel are consecutive.
+		std::vector<BvhRay> rays;
+		rays.reserve(static_cast<size_t>(TileSize) * TileSize * rayCountPerPixel);
+		XMFLOAT3 positions[TileSize * TileSize];
+		size_t pixels[TileSize * TileSize];
+		UINT count = 0;
+
+		for (UINT y = beginY; y < endY; ++y) {
+			for (UINT x = beginX; x < endX; ++x) {
+				const size_t index = static_cast<size_t>(y) * width + x;
+
+				const float depth = frame.Depths[index];
+				if (!(depth < 1)) continue;
+
+				const XMFLOAT3 hitPosition = CalcHitPosition(cb, depth, x, y, width, height);
+				const XMFLOAT3& surfaceNormal = frame.Normals[index];
+
+				UINT seed = InitRand(x + y * width, cb.FrameCount);
+
+				for (UINT s = 0; s < rayCountPerPixel; ++s) {
+					XMFLOAT3 direction = CosHemisphereSample(seed, surfaceNormal);
+					const float flip = Sign(Dot(direction, surfaceNormal));
+					direction = XMFLOAT3(flip * direction.x, flip * direction.y, flip * direction.z);
+
+					// TraceAORayAndReportIfHit
+					BvhRay ray;
+					ray.Origin = XMFLOAT3(
+						hitPosition.x + OriginOffset * surfaceNormal.x,
+						hitPosition.y + OriginOffset * surfaceNormal.y,
+						hitPosition.z + OriginOffset * surfaceNormal.z);
+					ray.Direction = direction;
+					ray.TMin = 0.0f;
+					ray.TMax = cb.OcclusionRadius;
+					rays.push_back(ray);
+				}
+
+				positions[count] = hitPosition;
+				pixels[count] = index;
+				++count;
+			}
+		}
+
+		std::vector<BvhHit> hits(rays.size());
+		if (bTrace && desc.SortRays) {
+			// Ray index in the low half keeps pixel order, and with it origin coherence, within a bin.
+			std::vector<UINT64> keys(rays.size());
+			for (size_t i = 0, end = rays.size(); i < end; ++i)
+				keys[i] = (static_cast<UINT64>(DirectionKey(rays[i].Direction)) << 32) | i;
+			std::sort(keys.begin(), keys.end());
+
+			std::vector<BvhRay> sortedRays(rays.size());
+			for (size_t i = 0, end = keys.size(); i < end; ++i)
+				sortedRays[i] = rays[static_cast<UINT>(keys[i])];
+
+			std::vector<BvhHit> sortedHits(rays.size());
+			BvhTraversal::TraceStream(bvh, sortedRays.data(), sortedRays.size(), BvhTraversal::EClosestHit, desc.Packets, sortedHits.data(), BvhTraversal::ECullBackFacing);
+
+			for (size_t i = 0, end = keys.size(); i < end; ++i)
+				hits[static_cast<UINT>(keys[i])] = sortedHits[i];
+		}
+		else if (bTrace) {
+			BvhTraversal::TraceStream(bvh, rays.data(), rays.size(), BvhTraversal::EClosestHit, desc.Packets, hits.data(), BvhTraversal::ECullBackFacing);
+		}
+
+		for (UINT i = 0; i < count; ++i) {
+			float occlusionSum = 0.0f;
+			float nearestHit = RayHitDistanceOnMiss;
+
+			for (UINT s = 0; s < rayCountPerPixel; ++s) {
+				const size_t r = static_cast<size_t>(i) * rayCountPerPixel + s;
+				const float tHit = hits[r].IsHit() ? hits[r].T : RayHitDistanceOnMiss;
+
+				// CalculateAO measures from the position before the nudge.
+				float occlusion = 0.0f;
+				if (tHit != RayHitDistanceOnMiss) {
+					const XMFLOAT3& origin = positions[i];
+					const XMFLOAT3& direction = rays[r].Direction;
+					const XMFLOAT3 delta(
+						(origin.x + tHit * direction.x) - origin.x,
+						(origin.y + tHit * direction.y) - origin.y,
+						(origin.z + tHit * direction.z) - origin.z);
+					const float distZ = std::sqrt(Dot(delta, delta));
+					occlusion = OcclusionFunction(distZ, cb.SurfaceEpsilon, cb.OcclusionFadeStart, cb.OcclusionFadeEnd);
+
+					if (nearestHit == RayHitDistanceOnMiss || tHit < nearestHit) nearestHit = tHit;
+				}
+
+				if (samplesPerPixel > 0) {
+					occlusionSum += occlusion;
+				}
+				else {
+					// Every sample traces the same direction; the sum is kept to round like the shader's.
+					for (UINT n = 0; n < cb.SampleCount; ++n)
+						occlusionSum += occlusion;
+				}
+			}
+			occlusionSum /= static_cast<float>(samplesPerPixel > 0 ? samplesPerPixel : cb.SampleCount);
+
+			frame.AOCoefficients[pixels[i]] = 1 - occlusionSum;
+			frame.RayHitDistances[pixels[i]] = nearestHit != RayHitDistanceOnMiss ? nearestHit : cb.OcclusionRadius;
+		}
+
+		if (bTrace) rayCount += rays.size();
+	});
+
+	if (pStats != nullptr) {
+		pStats->RayCount = rayCount;
+		pStats->Milliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+bool RtaoReference::Compare(const RtaoFrame& reference, const RtaoFrame& gpu, float tolerance, RtaoComparison& outComparison) {
+	const size_t pixelCount = static_cast<size_t>(reference.Width) * reference.Height;
+	if (reference.Width != gpu.Width || reference.Height != gpu.Height) ReturnFalse(L"RTAO frames differ in size");
+	if (reference.AOCoefficients.size() != pixelCount || gpu.AOCoefficients.size() != pixelCount ||
+		reference.RayHitDistances.size() != pixelCount || gpu.RayHitDistances.size() != pixelCount)
+		ReturnFalse(L"RTAO frames have no outputs to compare");
+
+	outComparison = RtaoComparison();
+	outComparison.PixelCount = static_cast<UINT>(pixelCount);
+
+	UINT aoCount = 0;
+	for (size_t i = 0; i < pixelCount; ++i) {
+		const float refAO = reference.AOCoefficients[i];
+		const float gpuAO = gpu.AOCoefficients[i];
+		if ((refAO == InvalidAOCoefficientValue) != (gpuAO == InvalidAOCoefficientValue)) {
+			++outComparison.CoverageMismatchCount;
+			continue;
+		}
+
+		if (refAO != InvalidAOCoefficientValue) {
+			const float aoError = CompareError(refAO, gpuAO);
+			if (aoError > tolerance) ++outComparison.AOMismatchCount;
+			outComparison.AOMaxError = std::max(outComparison.AOMaxError, aoError);
+			outComparison.AOMeanError += aoError;
+			++aoCount;
+		}
+
+		const float hitError = CompareError(reference.RayHitDistances[i], gpu.RayHitDistances[i]);
+		if (hitError > tolerance) ++outComparison.HitDistanceMismatchCount;
+		outComparison.HitDistanceMaxError = std::max(outComparison.HitDistanceMaxError, hitError);
+		outComparison.HitDistanceMeanError += hitError;
+	}
+
+	const UINT comparedCount = outComparison.PixelCount - outComparison.CoverageMismatchCount;
+	if (aoCount > 0) outComparison.AOMeanError /= aoCount;
+	if (comparedCount > 0) outComparison.HitDistanceMeanError /= comparedCount;
+
+	return true;
+}
+
+bool RtaoReference::Write(const std::wstring& inFilename, const RtaoFrame& frame) {
+	const size_t pixelCount = static_cast<size_t>(frame.Width) * frame.Height;
+	if (frame.Normals.size() != pixelCount || frame.Depths.size() != pixelCount) ReturnFalse(L"RTAO frame inputs do not match its size");
+
+	const bool bHasOutputs = frame.AOCoefficients.size() == pixelCount && frame.RayHitDistances.size() == pixelCount;
+
+	FileHeader header = {};
+	header.Magic = FileMagic;
+	header.Version = FileVersion;
+	header.HeaderSize = sizeof(FileHeader);
+	header.ConstantsSize = sizeof(RtaoConstants);
+	header.Width = frame.Width;
+	header.Height = frame.Height;
+	header.HasOutputs = bHasOutputs ? 1 : 0;
+
+	std::ofstream fout(inFilename, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create RTAO frame: " + inFilename);
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	fout.write(reinterpret_cast<const char*>(&frame.Constants), sizeof(RtaoConstants));
+	WriteArray(fout, frame.Normals);
+	WriteArray(fout, frame.Depths);
+	if (bHasOutputs) {
+		WriteArray(fout, frame.AOCoefficients);
+		WriteArray(fout, frame.RayHitDistances);
+	}
+
+	if (!fout.good()) ReturnFalse(L"Failed to write RTAO frame: " + inFilename);
+
+	return true;
+}
+
+bool RtaoReference::Read(const std::wstring& inFilename, RtaoFrame& outFrame) {
+	std::ifstream fin(inFilename, std::ios::binary | std::ios::ate);
+	if (!fin.is_open()) ReturnFalse(L"Failed to open RTAO frame: " + inFilename);
+
+	const UINT64 size = static_cast<UINT64>(fin.tellg());
+	fin.seekg(0);
+
+	FileHeader header = {};
+	fin.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+
+	bool valid = fin.good() && header.Magic == FileMagic && header.Version == FileVersion;
+	valid = valid && header.HeaderSize == sizeof(FileHeader) && header.ConstantsSize == sizeof(RtaoConstants);
+
+	const UINT64 pixelCount = static_cast<UINT64>(header.Width) * header.Height;
+	const UINT64 pixelSize = sizeof(XMFLOAT3) + sizeof(float) + (header.HasOutputs ? 2 * sizeof(float) : 0);
+	valid = valid && size == sizeof(FileHeader) + sizeof(RtaoConstants) + pixelCount * pixelSize;
+	if (!valid) ReturnFalse(L"Invalid RTAO frame: " + inFilename);
+
+	outFrame = RtaoFrame();
+	outFrame.Width = header.Width;
+	outFrame.Height = header.Height;
+	fin.read(reinterpret_cast<char*>(&outFrame.Constants), sizeof(RtaoConstants));
+	ReadArray(fin, static_cast<size_t>(pixelCount), outFrame.Normals);
+	ReadArray(fin, static_cast<size_t>(pixelCount), outFrame.Depths);
+	if (header.HasOutputs) {
+		ReadArray(fin, static_cast<size_t>(pixelCount), outFrame.AOCoefficients);
+		ReadArray(fin, static_cast<size_t>(pixelCount), outFrame.RayHitDistances);
+	}
+
+	if (!fin.good()) ReturnFalse(L"Failed to read RTAO frame: " + inFilename);
+
+	return true;
+}
@@ -0,0 +1,82 @@
+#include "SceneGenerator.h"
+#include "Logger.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+namespace {
+	const size_t InstanceGrainSize = 4096;
+
+	// SplitMix64 (Steele et al. 2014); one generator per instance, seeded from (seed, index).
+	class InstanceRandom {
+	public:
+		InstanceRandom(UINT seed, UINT index) : mState((static_cast<std::uint64_t>(seed) << 32) | index) {
+			Next();
+		}
+
+	public:
+		std::uint64_t Next() {
+			std::uint64_t z = (mState += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		// Uniform in [0, 1) from the top 24 bits, exact in a float.
+		float NextFloat() {
+			return static_cast<float>(Next() >> 40) * (1.0f / 16777216.0f);
+		}
+
+		float NextFloat(float low, float high) {
+			return low + (high - low) * NextFloat();
+		}
+
+		UINT NextUInt(UINT count) {
+			return static_cast<UINT>((Next() >> 32) * count >> 32);
+		}
+
+	private:
+		std::uint64_t mState;
+	};
+}
+
+bool SceneGenerator::Generate(const SceneGeneratorDesc& desc, std::vector<SceneInstance>& outInstances) {
+	if (desc.InstanceCount > MaxInstanceCount) ReturnFalse(L"Scene instance count exceeds SceneGenerator::MaxInstanceCount");
+	if (desc.ShapeCount == 0 || desc.MaterialCount == 0) ReturnFalse(L"Scene needs at least one shape and one material");
+	if (desc.Density <= 0.0f) ReturnFalse(L"Scene density must be positive");
+
+	const float halfExtent = HalfExtent(desc);
+
+	outInstances.resize(desc.InstanceCount);
+	Parallel::ForRange(desc.InstanceCount, InstanceGrainSize, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			InstanceRandom random(desc.Seed, static_cast<UINT>(i));
+
+			const float x = random.NextFloat(-halfExtent, halfExtent);
+			const float y = random.NextFloat(desc.MinHeight, desc.MaxHeight);
+			const float z = random.NextFloat(-halfExtent, halfExtent);
+			const float scale = random.NextFloat(desc.MinScale, desc.MaxScale);
+			const float yaw = random.NextFloat(0.0f, XM_2PI);
+			const float pitch = random.NextFloat(-XM_PIDIV4, XM_PIDIV4);
+
+			const XMMATRIX world =
+				XMMatrixScaling(scale, scale, scale) *
+				XMMatrixRotationRollPitchYaw(pitch, yaw, 0.0f) *
+				XMMatrixTranslation(x, y, z);
+
+			auto& instance = outInstances[i];
+			XMStoreFloat4x4(&instance.World, world);
+			instance.ShapeIndex = random.NextUInt(desc.ShapeCount);
+			instance.MaterialIndex = random.NextUInt(desc.MaterialCount);
+		}
+	});
+
+	return true;
+}
+
+float SceneGenerator::HalfExtent(const SceneGeneratorDesc& desc) {
+	return 0.5f * std::sqrt(static_cast<float>(desc.InstanceCount) / desc.Density);
+}
@@ -0,0 +1,243 @@
+#include "ShadowReference.h"
+#include "Bvh.h"
+#include "BvhTraversal.h"
+#include "Logger.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace {
+	// ShadowRayGen's ray extent.
+	const float RayTMin = 0.001f;
+	const float RayTMax = 1000.0f;
+
+	struct FileHeader {
+		UINT Magic;
+		UINT Version;
+		UINT HeaderSize;
+		UINT ConstantsSize;
+		UINT Width;
+		UINT Height;
+		UINT LightCount;
+		// Whether shadow factors follow the depths.
+		UINT HasOutputs;
+	};
+
+	// Constant buffers hold transposed matrices; this is element [row][col] of the matrix the
+	//  shader sees.
+	__forceinline float ShaderMatrix(const XMFLOAT4X4& m, int row, int col) {
+		return m.m[col][row];
+	}
+
+	// mul(v, m) with v as a row vector.
+	XMFLOAT4 Mul(const XMFLOAT4& v, const XMFLOAT4X4& m) {
+		float r[4];
+		for (int col = 0; col < 4; ++col)
+			r[col] = v.x * ShaderMatrix(m, 0, col) + v.y * ShaderMatrix(m, 1, col) + v.z * ShaderMatrix(m, 2, col) + v.w * ShaderMatrix(m, 3, col);
+		return XMFLOAT4(r[0], r[1], r[2], r[3]);
+	}
+
+	// The world position ShadowRayGen rebuilds from a depth texel.
+	XMFLOAT3 CalcSurfacePosition(const PassConstants& cb, float depth, UINT x, UINT y, UINT width, UINT height) {
+		const float texX = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+		const float texY = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+		const XMFLOAT4 posH(texX * 2 - 1, (1 - texY) * 2 - 1, 0.0f, 1.0f);
+
+		XMFLOAT4 posV = Mul(posH, cb.InvProj);
+		const float w = posV.w;
+		posV = XMFLOAT4(posV.x / w, posV.y / w, posV.z / w, posV.w / w);
+
+		// NdcDepthToViewDepth
+		const float dv = ShaderMatrix(cb.Proj, 3, 2) / (depth - ShaderMatrix(cb.Proj, 2, 2));
+		const float scale = dv / posV.z;
+
+		const XMFLOAT4 posW = Mul(XMFLOAT4(scale * posV.x, scale * posV.y, scale * posV.z, 1.0f), cb.InvView);
+		return XMFLOAT3(posW.x, posW.y, posW.z);
+	}
+
+	template <typename T>
+	void WriteArray(std::ofstream& fout, const std::vector<T>& values) {
+		fout.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+	}
+
+	template <typename T>
+	void ReadArray(std::ifstream& fin, size_t count, std::vector<T>& outValues) {
+		outValues.resize(count);
+		fin.read(reinterpret_cast<char*>(outValues.data()), static_cast<std::streamsize>(count * sizeof(T)));
+	}
+}
+
+bool ShadowReference::Run(const Bvh& bvh, ShadowFrame& frame, const ShadowTraceDesc& desc, ShadowReferenceStats* pStats) {
+	const UINT width = frame.Width;
+	const UINT height = frame.Height;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	if (frame.Depths.size() != pixelCount) ReturnFalse(L"Shadow frame depths do not match its size");
+	if (frame.LightCount > MaxLights) ReturnFalse(L"Shadow frame traces more lights than PassConstants holds");
+
+	const PassConstants& cb = frame.Constants;
+	const UINT lightCount = frame.LightCount;
+
+	// Pixels without geometry are lit.
+	frame.ShadowFactors.assign(pixelCount, 1.0f);
+
+	const UINT tileCountX = (width + TileSize - 1) / TileSize;
+	const UINT tileCountY = (height + TileSize - 1) / TileSize;
+	std::atomic<UINT64> rayCount(0);
+	std::atomic<UINT64> occludedCount(0);
+
+	Stopwatch timer;
+
+	Parallel::ForEach(static_cast<size_t>(tileCountX) * tileCountY, [&](size_t tile) {
+		const UINT beginX = static_cast<UINT>(tile % tileCountX) * TileSize;
+		const UINT beginY = static_cast<UINT>(tile / tileCountX) * TileSize;
+		const UINT endX = std::min(beginX + TileSize, width);
+		const UINT endY = std::min(beginY + TileSize, height);
+
+		BvhRay rays[TileSize * TileSize];
+		BvhHit hits[TileSize * TileSize];
+		size_t pixels[TileSize * TileSize];
+		UINT litCounts[TileSize * TileSize];
+		UINT count = 0;
+
+		for (UINT y = beginY; y < endY; ++y) {
+			for (UINT x = beginX; x < endX; ++x) {
+				const size_t index = static_cast<size_t>(y) * width + x;
+
+				const float depth = frame.Depths[index];
+				if (!(depth < 1)) continue;
+
+				BvhRay& ray = rays[count];
+				ray.Origin = CalcSurfacePosition(cb, depth, x, y, width, height);
+				ray.TMin = RayTMin;
+				ray.TMax = RayTMax;
+
+				pixels[count] = index;
+				litCounts[count] = 0;
+				++count;
+			}
+		}
+
+		if (count == 0) return;
+
+		// Origins stay put from light to light; only the direction changes, so every batch is as
+		//  coherent as the single-light pass.
+		UINT occluded = 0;
+		for (UINT light = 0; light < lightCount; ++light) {
+			const XMFLOAT3& lightDir = cb.Lights[light].Direction;
+			const XMFLOAT3 direction(-lightDir.x, -lightDir.y, -lightDir.z);
+			for (UINT i = 0; i < count; ++i)
+				rays[i].Direction = direction;
+
+			BvhTraversal::TraceStream(bvh, rays, count, BvhTraversal::EAnyHit, desc.Packets, hits, BvhTraversal::ECullBackFacing);
+
+			for (UINT i = 0; i < count; ++i) {
+				if (hits[i].IsHit()) ++occluded;
+				else ++litCounts[i];
+			}
+		}
+
+		if (lightCount > 0) {
+			for (UINT i = 0; i < count; ++i)
+				frame.ShadowFactors[pixels[i]] = static_cast<float>(litCounts[i]) / static_cast<float>(lightCount);
+		}
+
+		rayCount += static_cast<UINT64>(count) * lightCount;
+		occludedCount += occluded;
+	});
+
+	if (pStats != nullptr) {
+		pStats->RayCount = rayCount;
+		pStats->OccludedCount = occludedCount;
+		pStats->Milliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+bool ShadowReference::Compare(const ShadowFrame& reference, const ShadowFrame& gpu, float tolerance, ShadowComparison& outComparison) {
+	const size_t pixelCount = static_cast<size_t>(reference.Width) * reference.Height;
+	if (reference.Width != gpu.Width || reference.Height != gpu.Height) ReturnFalse(L"Shadow frames differ in size");
+	if (reference.ShadowFactors.size() != pixelCount || gpu.ShadowFactors.size() != pixelCount)
+		ReturnFalse(L"Shadow frames have no outputs to compare");
+
+	outComparison = ShadowComparison();
+	outComparison.PixelCount = static_cast<UINT>(pixelCount);
+
+	for (size_t i = 0; i < pixelCount; ++i) {
+		const float error = std::fabs(reference.ShadowFactors[i] - gpu.ShadowFactors[i]);
+		if (error > tolerance) ++outComparison.MismatchCount;
+		outComparison.MaxError = std::max(outComparison.MaxError, error);
+		outComparison.MeanError += error;
+	}
+
+	if (pixelCount > 0) outComparison.MeanError /= static_cast<double>(pixelCount);
+
+	return true;
+}
+
+bool ShadowReference::Write(const std::wstring& inFilename, const ShadowFrame& frame) {
+	const size_t pixelCount = static_cast<size_t>(frame.Width) * frame.Height;
+	if (frame.Depths.size() != pixelCount) ReturnFalse(L"Shadow frame depths do not match its size");
+
+	const bool bHasOutputs = frame.ShadowFactors.size() == pixelCount;
+
+	FileHeader header = {};
+	header.Magic = FileMagic;
+	header.Version = FileVersion;
+	header.HeaderSize = sizeof(FileHeader);
+	header.ConstantsSize = sizeof(PassConstants);
+	header.Width = frame.Width;
+	header.Height = frame.Height;
+	header.LightCount = frame.LightCount;
+	header.HasOutputs = bHasOutputs ? 1 : 0;
+
+	std::ofstream fout(inFilename, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open()) ReturnFalse(L"Failed to create shadow frame: " + inFilename);
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	fout.write(reinterpret_cast<const char*>(&frame.Constants), sizeof(PassConstants));
+	WriteArray(fout, frame.Depths);
+	if (bHasOutputs) WriteArray(fout, frame.ShadowFactors);
+
+	if (!fout.good()) ReturnFalse(L"Failed to write shadow frame: " + inFilename);
+
+	return true;
+}
+
+bool ShadowReference::Read(const std::wstring& inFilename, ShadowFrame& outFrame) {
+	std::ifstream fin(inFilename, std::ios::binary | std::ios::ate);
+	if (!fin.is_open()) ReturnFalse(L"Failed to open shadow frame: " + inFilename);
+
+	const UINT64 size = static_cast<UINT64>(fin.tellg());
+	fin.seekg(0);
+
+	FileHeader header = {};
+	fin.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+
+	bool valid = fin.good() && header.Magic == FileMagic && header.Version == FileVersion;
+	valid = valid && header.HeaderSize == sizeof(FileHeader) && header.ConstantsSize == sizeof(PassConstants);
+	valid = valid && header.LightCount <= MaxLights;
+
+	const UINT64 pixelCount = static_cast<UINT64>(header.Width) * header.Height;
+	const UINT64 pixelSize = sizeof(float) + (header.HasOutputs ? sizeof(float) : 0);
+	valid = valid && size == sizeof(FileHeader) + sizeof(PassConstants) + pixelCount * pixelSize;
+	if (!valid) ReturnFalse(L"Invalid shadow frame: " + inFilename);
+
+	outFrame = ShadowFrame();
+	outFrame.Width = header.Width;
+	outFrame.Height = header.Height;
+	outFrame.LightCount = header.LightCount;
+	fin.read(reinterpret_cast<char*>(&outFrame.Constants), sizeof(PassConstants));
+	ReadArray(fin, static_cast<size_t>(pixelCount), outFrame.Depths);
+	if (header.HasOutputs) ReadArray(fin, static_cast<size_t>(pixelCount), outFrame.ShadowFactors);
+
+	if (!fin.good()) ReturnFalse(L"Failed to read shadow frame: " + inFilename);
+
+	return true;
+}
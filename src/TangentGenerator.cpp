@@ -0,0 +1,276 @@
+#include "TangentGenerator.h"
+#include "Logger.h"
+#include "GeometryGenerator.h"
+#include "Parallel.h"
+#include "Stopwatch.h"
+#include "VectorMeshSink.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace DirectX;
+
+namespace {
+	// Fixed so the work split, and with it the output, does not depend on the thread count.
+	const size_t TriangleChunkSize = 4096;
+	const size_t VertexGrainSize = 4096;
+
+	const std::uint32_t Unassigned = 0xFFFFFFFF;
+
+	enum CornerUsage : std::uint8_t {
+		EUnflipped	= 1 << 0,
+		EFlipped	= 1 << 1
+	};
+
+	// Writes the angle-weighted tangent of each corner and whether the triangle's tangent frame is
+	//  left-handed; returns false for triangles without texture-space area.
+	bool ComputeTriangle(const Vertex* pVertices, const std::uint32_t* pTriangle, XMFLOAT3* pOutTangents, std::uint8_t* pOutFlipped) {
+		const Vertex& v0 = pVertices[pTriangle[0]];
+		const Vertex& v1 = pVertices[pTriangle[1]];
+		const Vertex& v2 = pVertices[pTriangle[2]];
+
+		const XMVECTOR p[3] = { XMLoadFloat3(&v0.Pos), XMLoadFloat3(&v1.Pos), XMLoadFloat3(&v2.Pos) };
+
+		const float du1 = v1.TexC.x - v0.TexC.x;
+		const float dv1 = v1.TexC.y - v0.TexC.y;
+		const float du2 = v2.TexC.x - v0.TexC.x;
+		const float dv2 = v2.TexC.y - v0.TexC.y;
+		const float signedArea = du1 * dv2 - du2 * dv1;
+
+		const XMVECTOR e1 = XMVectorSubtract(p[1], p[0]);
+		const XMVECTOR e2 = XMVectorSubtract(p[2], p[0]);
+
+		// dot(cross(N, dP/du), dP/dv) has the sign of dot(N, cross(e1, e2)) / signedArea, so the
+		//  frame is left-handed when the texture space is mirrored relative to the winding.
+		const XMVECTOR normalSum = XMVectorAdd(XMVectorAdd(
+			XMLoadFloat3(&v0.Normal), XMLoadFloat3(&v1.Normal)), XMLoadFloat3(&v2.Normal));
+		const bool bMirrored = signedArea < 0.0f;
+		const bool bFlipped = bMirrored != (XMVectorGetX(XMVector3Dot(normalSum, XMVector3Cross(e1, e2))) < 0.0f);
+		for (UINT corner = 0; corner < 3; ++corner) {
+			pOutTangents[corner] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			pOutFlipped[corner] = bFlipped ? 1 : 0;
+		}
+
+		if (std::abs(signedArea) <= FLT_MIN) return false;
+
+		// dP/du up to a positive scale; the magnitude is dropped below anyway.
+		XMVECTOR tangent = XMVectorSubtract(XMVectorScale(e1, dv2), XMVectorScale(e2, dv1));
+		if (bMirrored) tangent = XMVectorNegate(tangent);
+
+		for (UINT corner = 0; corner < 3; ++corner) {
+			const XMVECTOR normal = XMLoadFloat3(&pVertices[pTriangle[corner]].Normal);
+			const XMVECTOR projected = XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent)));
+
+			const float length = XMVectorGetX(XMVector3Length(projected));
+			if (length <= FLT_EPSILON) continue;
+
+			const XMVECTOR edge0 = XMVector3Normalize(XMVectorSubtract(p[(corner + 1) % 3], p[corner]));
+			const XMVECTOR edge1 = XMVector3Normalize(XMVectorSubtract(p[(corner + 2) % 3], p[corner]));
+			const float cosine = std::min(std::max(XMVectorGetX(XMVector3Dot(edge0, edge1)), -1.0f), 1.0f);
+
+			XMStoreFloat3(&pOutTangents[corner], XMVectorScale(projected, std::acos(cosine) / length));
+		}
+
+		return true;
+	}
+
+	// Normalizes the summed tangent and appends its handedness; vertices without one get an
+	//  arbitrary tangent orthogonal to their normal so the frame is still well-formed.
+	XMFLOAT4 FinalizeTangent(FXMVECTOR sum, const XMFLOAT3& normal, bool bFlipped) {
+		const float sign = bFlipped ? -1.0f : 1.0f;
+
+		XMFLOAT4 tangent;
+		if (XMVectorGetX(XMVector3LengthSq(sum)) > FLT_EPSILON * FLT_EPSILON) {
+			XMStoreFloat4(&tangent, XMVectorSetW(XMVector3Normalize(sum), sign));
+			return tangent;
+		}
+
+		const XMVECTOR n = XMLoadFloat3(&normal);
+		const XMVECTOR axis = std::abs(normal.x) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		const XMVECTOR orthogonal = XMVectorSubtract(axis, XMVectorMultiply(n, XMVector3Dot(n, axis)));
+		XMStoreFloat4(&tangent, XMVectorSetW(XMVector3Normalize(orthogonal), sign));
+		return tangent;
+	}
+
+	// Writes the final tangents, appending a copy of every vertex used by both handedness and
+	//  pointing the flipped corners at it.
+	size_t SplitAndStore(
+			std::vector<Vertex>& vertices,
+			std::vector<std::uint32_t>& indices,
+			const std::vector<XMFLOAT3>& sums,
+			const std::vector<XMFLOAT3>& flippedSums,
+			const std::vector<std::uint8_t>& usage,
+			const std::vector<std::uint8_t>& cornerFlipped) {
+		const size_t vertexCount = sums.size();
+
+		std::vector<std::uint32_t> splitIndices(vertexCount, Unassigned);
+		for (size_t v = 0; v < vertexCount; ++v) {
+			if (usage[v] == (EUnflipped | EFlipped)) {
+				Vertex split = vertices[v];
+				split.Tangent = FinalizeTangent(XMLoadFloat3(&flippedSums[v]), split.Normal, true);
+
+				splitIndices[v] = static_cast<std::uint32_t>(vertices.size());
+				vertices.push_back(split);
+			}
+
+			const bool bFlipped = usage[v] == EFlipped;
+			const auto& sum = bFlipped ? flippedSums[v] : sums[v];
+			vertices[v].Tangent = FinalizeTangent(XMLoadFloat3(&sum), vertices[v].Normal, bFlipped);
+		}
+
+		const size_t splitCount = vertices.size() - vertexCount;
+		if (splitCount == 0) return 0;
+
+		for (size_t i = 0, end = indices.size(); i < end; ++i) {
+			if (cornerFlipped[i] && splitIndices[indices[i]] != Unassigned)
+				indices[i] = splitIndices[indices[i]];
+		}
+
+		return splitCount;
+	}
+}
+
+void TangentGenerator::Generate(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, TangentGenerationStats* pStats) {
+	const size_t vertexCount = vertices.size();
+	const size_t triangleCount = indices.size() / 3;
+
+	std::vector<XMFLOAT3> cornerTangents(triangleCount * 3);
+	std::vector<std::uint8_t> cornerFlipped(triangleCount * 3);
+
+	const size_t chunkCount = (triangleCount + TriangleChunkSize - 1) / TriangleChunkSize;
+	std::vector<size_t> degenerateCounts(chunkCount, 0);
+
+	Parallel::ForEach(chunkCount, [&](size_t chunk) {
+		const size_t begin = chunk * TriangleChunkSize;
+		const size_t end = std::min(begin + TriangleChunkSize, triangleCount);
+		for (size_t t = begin; t < end; ++t) {
+			if (!ComputeTriangle(vertices.data(), &indices[t * 3], &cornerTangents[t * 3], &cornerFlipped[t * 3]))
+				++degenerateCounts[chunk];
+		}
+	});
+
+	// Corners of every vertex in index order, so each sum adds up in the same order as the
+	//  sequential reference.
+	std::vector<std::uint32_t> cornerOffsets(vertexCount + 1, 0);
+	for (size_t i = 0, end = triangleCount * 3; i < end; ++i)
+		++cornerOffsets[indices[i] + 1];
+	for (size_t v = 0; v < vertexCount; ++v)
+		cornerOffsets[v + 1] += cornerOffsets[v];
+
+	std::vector<std::uint32_t> vertexCorners(triangleCount * 3);
+	{
+		std::vector<std::uint32_t> cursors(cornerOffsets.begin(), cornerOffsets.end() - 1);
+		for (size_t i = 0, end = triangleCount * 3; i < end; ++i)
+			vertexCorners[cursors[indices[i]]++] = static_cast<std::uint32_t>(i);
+	}
+
+	std::vector<XMFLOAT3> sums(vertexCount);
+	std::vector<XMFLOAT3> flippedSums(vertexCount);
+	std::vector<std::uint8_t> usage(vertexCount);
+
+	Parallel::ForRange(vertexCount, VertexGrainSize, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			XMVECTOR sum = XMVectorZero();
+			XMVECTOR flippedSum = XMVectorZero();
+			std::uint8_t flags = 0;
+
+			for (UINT k = cornerOffsets[v]; k < cornerOffsets[v + 1]; ++k) {
+				const UINT corner = vertexCorners[k];
+				const XMVECTOR tangent = XMLoadFloat3(&cornerTangents[corner]);
+				if (cornerFlipped[corner]) {
+					flippedSum = XMVectorAdd(flippedSum, tangent);
+					flags |= EFlipped;
+				}
+				else {
+					sum = XMVectorAdd(sum, tangent);
+					flags |= EUnflipped;
+				}
+			}
+
+			XMStoreFloat3(&sums[v], sum);
+			XMStoreFloat3(&flippedSums[v], flippedSum);
+			usage[v] = flags;
+		}
+	});
+
+	const size_t splitCount = SplitAndStore(vertices, indices, sums, flippedSums, usage, cornerFlipped);
+
+	if (pStats != nullptr) {
+		pStats->SplitVertexCount = splitCount;
+		pStats->DegenerateTriangleCount = 0;
+		for (size_t count : degenerateCounts)
+			pStats->DegenerateTriangleCount += count;
+	}
+}
+
+void TangentGenerator::GenerateReference(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, TangentGenerationStats* pStats) {
+	const size_t vertexCount = vertices.size();
+	const size_t triangleCount = indices.size() / 3;
+
+	std::vector<XMFLOAT3> sums(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<XMFLOAT3> flippedSums(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<std::uint8_t> usage(vertexCount, 0);
+	std::vector<std::uint8_t> cornerFlipped(triangleCount * 3);
+
+	size_t degenerateCount = 0;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		XMFLOAT3 tangents[3];
+		if (!ComputeTriangle(vertices.data(), &indices[t * 3], tangents, &cornerFlipped[t * 3]))
+			++degenerateCount;
+
+		for (UINT corner = 0; corner < 3; ++corner) {
+			const std::uint32_t v = indices[t * 3 + corner];
+			const bool bFlipped = cornerFlipped[t * 3 + corner] != 0;
+
+			auto& sum = bFlipped ? flippedSums[v] : sums[v];
+			XMStoreFloat3(&sum, XMVectorAdd(XMLoadFloat3(&sum), XMLoadFloat3(&tangents[corner])));
+			usage[v] |= bFlipped ? EFlipped : EUnflipped;
+		}
+	}
+
+	const size_t splitCount = SplitAndStore(vertices, indices, sums, flippedSums, usage, cornerFlipped);
+
+	if (pStats != nullptr) {
+		pStats->SplitVertexCount = splitCount;
+		pStats->DegenerateTriangleCount = degenerateCount;
+	}
+}
+
+bool TangentGenerator::RunBenchmark(UINT iterationCount) {
+	GeometryGenerator geoGen;
+	std::vector<Vertex> sourceVertices;
+	std::vector<std::uint32_t> sourceIndices;
+	VectorMeshSink sink(sourceVertices, sourceIndices);
+	CheckIsValid(geoGen.CreateSphere(1.0f, 1024, 1024, sink));
+
+	double referenceMs = 0.0;
+	double parallelMs = 0.0;
+	for (UINT i = 0; i < iterationCount; ++i) {
+		std::vector<Vertex> referenceVertices(sourceVertices);
+		std::vector<std::uint32_t> referenceIndices(sourceIndices);
+		Stopwatch referenceTimer;
+		TangentGenerator::GenerateReference(referenceVertices, referenceIndices);
+		referenceMs += referenceTimer.ElapsedMilliseconds();
+
+		std::vector<Vertex> vertices(sourceVertices);
+		std::vector<std::uint32_t> indices(sourceIndices);
+		Stopwatch parallelTimer;
+		TangentGenerator::Generate(vertices, indices);
+		parallelMs += parallelTimer.ElapsedMilliseconds();
+
+		if (indices != referenceIndices || vertices.size() != referenceVertices.size() ||
+				std::memcmp(vertices.data(), referenceVertices.data(), vertices.size() * sizeof(Vertex)) != 0)
+			ReturnFalse(L"Parallel tangent generation differs from the reference");
+	}
+
+	referenceMs /= iterationCount;
+	parallelMs /= iterationCount;
+	Logln("Tangent generation sphere_1024 (", std::to_string(sourceIndices.size() / 3), " triangles): reference ",
+		std::to_string(referenceMs), " ms, parallel ", std::to_string(parallelMs), " ms (",
+		std::to_string(parallelMs > 0.0 ? referenceMs / parallelMs : 0.0), "x on ", std::to_string(Parallel::WorkerCount()), " threads)");
+
+	return true;
+}
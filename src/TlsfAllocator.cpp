@@ -0,0 +1,311 @@
+#include "TlsfAllocator.h"
+#include "Logger.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <intrin.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	const UINT InvalidNode = 0xFFFFFFFF;
+
+	__forceinline UINT HighestBit(UINT64 value) {
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return static_cast<UINT>(index);
+	}
+
+	__forceinline UINT LowestBit(UINT64 value) {
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<UINT>(index);
+	}
+}
+
+float TlsfStats::Fragmentation() const {
+	const UINT64 freeSize = Capacity - UsedSize;
+	if (freeSize == 0) return 0.0f;
+	return 1.0f - static_cast<float>(static_cast<double>(LargestFreeBlock) / static_cast<double>(freeSize));
+}
+
+void TlsfAllocator::Mapping(UINT64 size, UINT& outFirst, UINT& outSecond) {
+	if (size < SecondLevelCount) {
+		outFirst = 0;
+		outSecond = static_cast<UINT>(size);
+		return;
+	}
+
+	const UINT log = HighestBit(size);
+	outFirst = log - SecondLevelBits + 1;
+	outSecond = static_cast<UINT>(size >> (log - SecondLevelBits)) - SecondLevelCount;
+}
+
+void TlsfAllocator::Initialize(UINT64 capacity) {
+	mNodes.clear();
+	mUnusedNodes.clear();
+
+	mFirstLevelBitmap = 0;
+	std::fill(std::begin(mSecondLevelBitmaps), std::end(mSecondLevelBitmaps), 0);
+	for (auto& heads : mFreeHeads)
+		std::fill(std::begin(heads), std::end(heads), InvalidNode);
+
+	mCapacity = capacity;
+	mUsedSize = 0;
+	mAllocationCount = 0;
+	mFreeBlockCount = 0;
+
+	if (capacity == 0) return;
+
+	const UINT node = NewNode();
+	mNodes[node].Offset = 0;
+	mNodes[node].Size = capacity;
+	InsertFree(node);
+}
+
+TlsfAllocation TlsfAllocator::Allocate(UINT64 size) {
+	TlsfAllocation allocation;
+	size = std::max<UINT64>(size, 1);
+	if (size > mCapacity - mUsedSize) return allocation;
+
+	// Rounding up to the next bin keeps the search O(1); a request too close to the largest bin
+	//  to round falls back to scanning its own bin.
+	UINT node = InvalidNode;
+	if (size >= SecondLevelCount) {
+		const UINT64 roundUp = (1ull << (HighestBit(size) - SecondLevelBits)) - 1;
+		if (size <= ~0ull - roundUp) node = FindFree(size + roundUp);
+	}
+	else {
+		node = FindFree(size);
+	}
+
+	if (node == InvalidNode) {
+		UINT first, second;
+		Mapping(size, first, second);
+		for (UINT candidate = mFreeHeads[first][second]; candidate != InvalidNode; candidate = mNodes[candidate].NextFree) {
+			if (mNodes[candidate].Size >= size) {
+				node = candidate;
+				break;
+			}
+		}
+		if (node == InvalidNode) return allocation;
+	}
+
+	RemoveFree(node);
+
+	// Return the tail to the free lists.
+	const UINT64 remainder = mNodes[node].Size - size;
+	if (remainder > 0) {
+		const UINT rest = NewNode();
+		// NewNode may have grown mNodes; index afresh.
+		mNodes[rest].Offset = mNodes[node].Offset + size;
+		mNodes[rest].Size = remainder;
+		mNodes[rest].PrevPhysical = node;
+		mNodes[rest].NextPhysical = mNodes[node].NextPhysical;
+		if (mNodes[node].NextPhysical != InvalidNode)
+			mNodes[mNodes[node].NextPhysical].PrevPhysical = rest;
+
+		mNodes[node].NextPhysical = rest;
+		mNodes[node].Size = size;
+
+		InsertFree(rest);
+	}
+
+	mUsedSize += size;
+	++mAllocationCount;
+
+	allocation.Offset = mNodes[node].Offset;
+	allocation.Size = size;
+	allocation.Node = node;
+
+	return allocation;
+}
+
+void TlsfAllocator::Free(const TlsfAllocation& allocation) {
+	if (!allocation.IsValid()) return;
+
+	UINT node = allocation.Node;
+
+	mUsedSize -= mNodes[node].Size;
+	--mAllocationCount;
+
+	const UINT prev = mNodes[node].PrevPhysical;
+	if (prev != InvalidNode && mNodes[prev].bFree) {
+		RemoveFree(prev);
+
+		mNodes[prev].Size += mNodes[node].Size;
+		mNodes[prev].NextPhysical = mNodes[node].NextPhysical;
+		if (mNodes[node].NextPhysical != InvalidNode)
+			mNodes[mNodes[node].NextPhysical].PrevPhysical = prev;
+
+		ReleaseNode(node);
+		node = prev;
+	}
+
+	const UINT next = mNodes[node].NextPhysical;
+	if (next != InvalidNode && mNodes[next].bFree) {
+		RemoveFree(next);
+
+		mNodes[node].Size += mNodes[next].Size;
+		mNodes[node].NextPhysical = mNodes[next].NextPhysical;
+		if (mNodes[next].NextPhysical != InvalidNode)
+			mNodes[mNodes[next].NextPhysical].PrevPhysical = node;
+
+		ReleaseNode(next);
+	}
+
+	InsertFree(node);
+}
+
+TlsfStats TlsfAllocator::Stats() const {
+	TlsfStats stats;
+	stats.Capacity = mCapacity;
+	stats.UsedSize = mUsedSize;
+	stats.AllocationCount = mAllocationCount;
+	stats.FreeBlockCount = mFreeBlockCount;
+
+	// The largest block lives in the highest non-empty bin, though not necessarily at its head.
+	if (mFirstLevelBitmap != 0) {
+		const UINT first = HighestBit(mFirstLevelBitmap);
+		const UINT second = HighestBit(mSecondLevelBitmaps[first]);
+		for (UINT node = mFreeHeads[first][second]; node != InvalidNode; node = mNodes[node].NextFree)
+			stats.LargestFreeBlock = std::max(stats.LargestFreeBlock, mNodes[node].Size);
+	}
+
+	return stats;
+}
+
+UINT TlsfAllocator::NewNode() {
+	UINT node;
+	if (!mUnusedNodes.empty()) {
+		node = mUnusedNodes.back();
+		mUnusedNodes.pop_back();
+	}
+	else {
+		node = static_cast<UINT>(mNodes.size());
+		mNodes.emplace_back();
+	}
+
+	auto& entry = mNodes[node];
+	entry.Offset = 0;
+	entry.Size = 0;
+	entry.PrevPhysical = InvalidNode;
+	entry.NextPhysical = InvalidNode;
+	entry.PrevFree = InvalidNode;
+	entry.NextFree = InvalidNode;
+	entry.bFree = false;
+
+	return node;
+}
+
+void TlsfAllocator::ReleaseNode(UINT node) {
+	mUnusedNodes.push_back(node);
+}
+
+void TlsfAllocator::InsertFree(UINT node) {
+	UINT first, second;
+	Mapping(mNodes[node].Size, first, second);
+
+	const UINT head = mFreeHeads[first][second];
+	mNodes[node].bFree = true;
+	mNodes[node].PrevFree = InvalidNode;
+	mNodes[node].NextFree = head;
+	if (head != InvalidNode) mNodes[head].PrevFree = node;
+
+	mFreeHeads[first][second] = node;
+	mSecondLevelBitmaps[first] |= 1u << second;
+	mFirstLevelBitmap |= 1ull << first;
+
+	++mFreeBlockCount;
+}
+
+void TlsfAllocator::RemoveFree(UINT node) {
+	UINT first, second;
+	Mapping(mNodes[node].Size, first, second);
+
+	const UINT prev = mNodes[node].PrevFree;
+	const UINT next = mNodes[node].NextFree;
+	if (prev != InvalidNode) mNodes[prev].NextFree = next;
+	if (next != InvalidNode) mNodes[next].PrevFree = prev;
+
+	if (mFreeHeads[first][second] == node) {
+		mFreeHeads[first][second] = next;
+		if (next == InvalidNode) {
+			mSecondLevelBitmaps[first] &= ~(1u << second);
+			if (mSecondLevelBitmaps[first] == 0) mFirstLevelBitmap &= ~(1ull << first);
+		}
+	}
+
+	mNodes[node].bFree = false;
+	mNodes[node].PrevFree = InvalidNode;
+	mNodes[node].NextFree = InvalidNode;
+
+	--mFreeBlockCount;
+}
+
+UINT TlsfAllocator::FindFree(UINT64 size) const {
+	UINT first, second;
+	Mapping(size, first, second);
+	if (first >= FirstLevelCount) return InvalidNode;
+
+	UINT secondMap = mSecondLevelBitmaps[first] & (~0u << second);
+	if (secondMap == 0) {
+		const UINT64 firstMap = first + 1 < 64 ? mFirstLevelBitmap & (~0ull << (first + 1)) : 0;
+		if (firstMap == 0) return InvalidNode;
+
+		first = LowestBit(firstMap);
+		secondMap = mSecondLevelBitmaps[first];
+	}
+
+	return mFreeHeads[first][LowestBit(secondMap)];
+}
+
+void TlsfAllocator::RunBenchmark(UINT64 capacity, UINT operationCount, float targetOccupancy) {
+	TlsfAllocator allocator;
+	allocator.Initialize(capacity);
+
+	std::mt19937 generator(1234);
+	// Log-uniform between 256 and 64K units, roughly the spread of small props to large meshes.
+	std::uniform_real_distribution<float> sizeExponent(8.0f, 16.0f);
+
+	std::vector<TlsfAllocation> live;
+	UINT failedCount = 0;
+	double fragmentationSum = 0.0;
+	float maxFragmentation = 0.0f;
+	UINT sampleCount = 0;
+
+	Stopwatch timer;
+	for (UINT op = 0; op < operationCount; ++op) {
+		const float occupancy = static_cast<float>(static_cast<double>(allocator.UsedSize()) / static_cast<double>(capacity));
+		const bool bAllocate = live.empty() || (generator() % 100) < (occupancy < targetOccupancy ? 60u : 40u);
+
+		if (bAllocate) {
+			const auto allocation = allocator.Allocate(static_cast<UINT64>(std::exp2(sizeExponent(generator))));
+			if (allocation.IsValid()) live.push_back(allocation);
+			else ++failedCount;
+		}
+		else {
+			const size_t index = generator() % live.size();
+			allocator.Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+		}
+
+		if ((op & 1023) == 0) {
+			const float fragmentation = allocator.Stats().Fragmentation();
+			fragmentationSum += fragmentation;
+			maxFragmentation = std::max(maxFragmentation, fragmentation);
+			++sampleCount;
+		}
+	}
+	const double elapsedMs = timer.ElapsedMilliseconds();
+
+	const auto stats = allocator.Stats();
+	Logln("Geometry pool churn: ", std::to_string(operationCount), " operations in ", std::to_string(elapsedMs), " ms (",
+		std::to_string(1.0e6 * elapsedMs / operationCount), " ns/op), ", std::to_string(failedCount), " failed, occupancy ",
+		std::to_string(static_cast<double>(stats.UsedSize) / static_cast<double>(capacity)), ", fragmentation mean ",
+		std::to_string(sampleCount > 0 ? fragmentationSum / sampleCount : 0.0), " max ", std::to_string(maxFragmentation),
+		", ", std::to_string(stats.FreeBlockCount), " free blocks");
+}
@@ -0,0 +1,273 @@
+#include "TwoLevelBvh.h"
+#include "Logger.h"
+#include "Parallel.h"
+#include "SceneGenerator.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <string>
+
+using namespace DirectX;
+
+namespace {
+	const size_t InstanceGrainSize = 1 << 12;
+
+	const BvhNode& BlasRoot(const TwoLevelBvh& tlas, const BvhInstance& instance) {
+		return instance.Analytic ? tlas.AnalyticBlases[instance.Blas]->Nodes[0] : tlas.Blases[instance.Blas]->Nodes[0];
+	}
+
+	// Object-to-world bounds of the bottom level's root box (Arvo 1990), and the inverse transform.
+	void UpdateInstance(TwoLevelBvh& tlas, UINT index) {
+		const BvhInstance& instance = tlas.Instances[index];
+		const BvhNode& root = BlasRoot(tlas, instance);
+		const XMFLOAT3X4& m = instance.Transform;
+
+		const float center[] = {
+			0.5f * (root.BoundsMin.x + root.BoundsMax.x),
+			0.5f * (root.BoundsMin.y + root.BoundsMax.y),
+			0.5f * (root.BoundsMin.z + root.BoundsMax.z) };
+		const float extent[] = {
+			0.5f * (root.BoundsMax.x - root.BoundsMin.x),
+			0.5f * (root.BoundsMax.y - root.BoundsMin.y),
+			0.5f * (root.BoundsMax.z - root.BoundsMin.z) };
+
+		float boundsMin[3];
+		float boundsMax[3];
+		for (int row = 0; row < 3; ++row) {
+			float c = m.m[row][3];
+			float e = 0.0f;
+			for (int col = 0; col < 3; ++col) {
+				c += m.m[row][col] * center[col];
+				e += std::fabs(m.m[row][col]) * extent[col];
+			}
+			boundsMin[row] = c - e;
+			boundsMax[row] = c + e;
+		}
+
+		BvhBounds& bounds = tlas.InstanceBounds[index];
+		bounds.Min = XMFLOAT3(boundsMin[0], boundsMin[1], boundsMin[2]);
+		bounds.Max = XMFLOAT3(boundsMax[0], boundsMax[1], boundsMax[2]);
+
+		const XMMATRIX objectToWorld = XMMatrixSet(
+			m.m[0][0], m.m[1][0], m.m[2][0], 0.0f,
+			m.m[0][1], m.m[1][1], m.m[2][1], 0.0f,
+			m.m[0][2], m.m[1][2], m.m[2][2], 0.0f,
+			m.m[0][3], m.m[1][3], m.m[2][3], 1.0f);
+		XMFLOAT4X4 worldToObject;
+		XMStoreFloat4x4(&worldToObject, XMMatrixInverse(nullptr, objectToWorld));
+
+		XMFLOAT3X4& inverse = tlas.WorldToObject[index];
+		for (int row = 0; row < 3; ++row) {
+			for (int col = 0; col < 4; ++col)
+				inverse.m[row][col] = worldToObject.m[col][row];
+		}
+	}
+
+	void UpdateInstances(TwoLevelBvh& tlas) {
+		Parallel::ForRange(tlas.Instances.size(), InstanceGrainSize, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				UpdateInstance(tlas, static_cast<UINT>(i));
+		});
+	}
+
+	// Recomputes a node's bounds from its children or instances; returns whether they changed.
+	bool RefitNode(TwoLevelBvh& tlas, UINT index) {
+		BvhNode& node = tlas.Nodes[index];
+
+		XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		auto grow = [&](const XMFLOAT3& childMin, const XMFLOAT3& childMax) {
+			boundsMin = XMFLOAT3(std::min(boundsMin.x, childMin.x), std::min(boundsMin.y, childMin.y), std::min(boundsMin.z, childMin.z));
+			boundsMax = XMFLOAT3(std::max(boundsMax.x, childMax.x), std::max(boundsMax.y, childMax.y), std::max(boundsMax.z, childMax.z));
+		};
+
+		if (node.IsLeaf()) {
+			for (UINT i = 0; i < node.TriangleCount; ++i) {
+				const BvhBounds& bounds = tlas.InstanceBounds[tlas.InstanceIndices[node.LeftFirst + i]];
+				grow(bounds.Min, bounds.Max);
+			}
+		}
+		else {
+			const BvhNode& left = tlas.Nodes[node.LeftFirst];
+			const BvhNode& right = tlas.Nodes[node.LeftFirst + 1];
+			grow(left.BoundsMin, left.BoundsMax);
+			grow(right.BoundsMin, right.BoundsMax);
+		}
+
+		const bool bChanged =
+			boundsMin.x != node.BoundsMin.x || boundsMin.y != node.BoundsMin.y || boundsMin.z != node.BoundsMin.z ||
+			boundsMax.x != node.BoundsMax.x || boundsMax.y != node.BoundsMax.y || boundsMax.z != node.BoundsMax.z;
+		node.BoundsMin = boundsMin;
+		node.BoundsMax = boundsMax;
+
+		return bChanged;
+	}
+}
+
+bool TwoLevelBvhBuilder::Build(TwoLevelBvh& tlas, const BvhBuildDesc& desc, TwoLevelBvhStats* pStats) {
+	if (tlas.Instances.empty()) ReturnFalse(L"Two-level BVH has no instances");
+	for (const auto blas : tlas.Blases) {
+		if (blas == nullptr || blas->Nodes.empty()) ReturnFalse(L"Two-level BVH references an unbuilt bottom level");
+	}
+	for (const auto blas : tlas.AnalyticBlases) {
+		if (blas == nullptr || blas->Nodes.empty()) ReturnFalse(L"Two-level BVH references an unbuilt bottom level");
+	}
+	for (const auto& instance : tlas.Instances) {
+		if (instance.Blas >= (instance.Analytic ? tlas.AnalyticBlases.size() : tlas.Blases.size()))
+			ReturnFalse(L"Two-level BVH instance references a missing bottom level");
+	}
+
+	Stopwatch timer;
+
+	const UINT instanceCount = static_cast<UINT>(tlas.Instances.size());
+
+	tlas.InstanceBounds.resize(instanceCount);
+	tlas.WorldToObject.resize(instanceCount);
+	UpdateInstances(tlas);
+
+	CheckIsValid(BvhBuilder::BuildOverBounds(tlas.InstanceBounds.data(), instanceCount, desc, tlas.Nodes, tlas.InstanceIndices));
+
+	const UINT nodeCount = static_cast<UINT>(tlas.Nodes.size());
+	tlas.Parents.assign(nodeCount, TwoLevelBvh::NoParent);
+	tlas.InstanceLeaves.resize(instanceCount);
+	for (UINT n = 0; n < nodeCount; ++n) {
+		const BvhNode& node = tlas.Nodes[n];
+		if (node.IsLeaf()) {
+			for (UINT i = 0; i < node.TriangleCount; ++i)
+				tlas.InstanceLeaves[tlas.InstanceIndices[node.LeftFirst + i]] = n;
+		}
+		else {
+			tlas.Parents[node.LeftFirst] = n;
+			tlas.Parents[node.LeftFirst + 1] = n;
+		}
+	}
+
+	if (pStats != nullptr) {
+		pStats->InstanceCount = instanceCount;
+		pStats->NodeCount = nodeCount;
+		pStats->UpdatedNodeCount = nodeCount;
+		pStats->Milliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+bool TwoLevelBvhBuilder::Refit(TwoLevelBvh& tlas, const UINT* pInstances, UINT count, TwoLevelBvhStats* pStats) {
+	const size_t instanceCount = tlas.Instances.size();
+	if (tlas.Nodes.empty() || tlas.InstanceBounds.size() != instanceCount || tlas.InstanceLeaves.size() != instanceCount)
+		ReturnFalse(L"Two-level BVH has to be rebuilt after instances are added or removed");
+
+	Stopwatch timer;
+
+	const UINT nodeCount = static_cast<UINT>(tlas.Nodes.size());
+	UINT updatedCount = 0;
+
+	if (pInstances == nullptr) {
+		UpdateInstances(tlas);
+
+		for (UINT n = nodeCount; n-- > 0;)
+			RefitNode(tlas, n);
+		updatedCount = nodeCount;
+	}
+	else {
+		for (UINT i = 0; i < count; ++i) {
+			if (pInstances[i] >= instanceCount) ReturnFalse(L"Two-level BVH refit references a missing instance");
+			UpdateInstance(tlas, pInstances[i]);
+		}
+
+		for (UINT i = 0; i < count; ++i) {
+			for (UINT n = tlas.InstanceLeaves[pInstances[i]]; n != TwoLevelBvh::NoParent; n = tlas.Parents[n]) {
+				++updatedCount;
+				if (!RefitNode(tlas, n)) break;
+			}
+		}
+	}
+
+	if (pStats != nullptr) {
+		pStats->InstanceCount = static_cast<UINT>(instanceCount);
+		pStats->NodeCount = nodeCount;
+		pStats->UpdatedNodeCount = updatedCount;
+		pStats->Milliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+void TwoLevelBvhBuilder::SetTransform(BvhInstance& instance, const XMFLOAT4X4& world) {
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 4; ++col)
+			instance.Transform.m[row][col] = world.m[col][row];
+	}
+}
+
+bool TwoLevelBvhBuilder::RunBenchmark(const std::vector<const Bvh*>& blases, UINT instanceCount, UINT seed, float density,
+		float drift, float movingFraction, const BvhBuildDesc& desc) {
+	SceneGeneratorDesc sceneDesc;
+	sceneDesc.Seed = seed;
+	sceneDesc.InstanceCount = instanceCount;
+	sceneDesc.ShapeCount = static_cast<UINT>(blases.size());
+	sceneDesc.Density = density;
+
+	std::vector<SceneInstance> instances;
+	CheckIsValid(SceneGenerator::Generate(sceneDesc, instances));
+
+	TwoLevelBvh tlas;
+	tlas.Blases = blases;
+	tlas.Instances.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); ++i) {
+		BvhInstance& instance = tlas.Instances[i];
+		SetTransform(instance, instances[i].World);
+		instance.InstanceID = static_cast<UINT>(i);
+		instance.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+		instance.Blas = instances[i].ShapeIndex;
+	}
+
+	TwoLevelBvhStats buildStats;
+	CheckIsValid(Build(tlas, desc, &buildStats));
+	BvhBuildStats built;
+	BvhBuilder::CalcStats(tlas.Nodes, instanceCount, desc, built);
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> offset(-drift, drift);
+	auto move = [&](BvhInstance& instance) {
+		for (int row = 0; row < 3; ++row)
+			instance.Transform.m[row][3] += offset(generator);
+	};
+
+	// A few animated render items.
+	const UINT movingCount = std::max(1u, static_cast<UINT>(static_cast<float>(instanceCount) * movingFraction));
+	std::vector<UINT> moving(movingCount);
+	for (auto& index : moving) {
+		index = static_cast<UINT>(generator() % instanceCount);
+		move(tlas.Instances[index]);
+	}
+
+	TwoLevelBvhStats partialStats;
+	CheckIsValid(Refit(tlas, moving.data(), movingCount, &partialStats));
+
+	// The whole scene moving.
+	for (auto& instance : tlas.Instances)
+		move(instance);
+
+	TwoLevelBvhStats refitStats;
+	CheckIsValid(Refit(tlas, nullptr, 0, &refitStats));
+	BvhBuildStats refitted;
+	BvhBuilder::CalcStats(tlas.Nodes, instanceCount, desc, refitted);
+
+	TwoLevelBvhStats rebuildStats;
+	CheckIsValid(Build(tlas, desc, &rebuildStats));
+	BvhBuildStats rebuilt;
+	BvhBuilder::CalcStats(tlas.Nodes, instanceCount, desc, rebuilt);
+
+	Logln("Two-level BVH benchmark: ", std::to_string(instanceCount), " instances, ", std::to_string(buildStats.NodeCount),
+		" nodes, built in ", std::to_string(buildStats.Milliseconds), " ms (SAH ", std::to_string(built.SahCost), ")");
+	Logln("    refit of ", std::to_string(movingCount), " moved: ", std::to_string(partialStats.Milliseconds), " ms (",
+		std::to_string(partialStats.UpdatedNodeCount), " nodes); all moved: refit ", std::to_string(refitStats.Milliseconds),
+		" ms (SAH ", std::to_string(refitted.SahCost), "), rebuild ", std::to_string(rebuildStats.Milliseconds),
+		" ms (SAH ", std::to_string(rebuilt.SahCost), ")");
+
+	return true;
+}
@@ -0,0 +1,272 @@
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace {
+	const float SnormScale = 32767.0f;
+
+	// Gathers one attribute of up to four vertices into SoA lanes.
+	struct LanesX4 {
+		XMVECTOR X;
+		XMVECTOR Y;
+		XMVECTOR Z;
+	};
+
+	template <typename Float3>
+	__forceinline LanesX4 GatherX4(const Float3* const p[4]) {
+		LanesX4 lanes;
+		lanes.X = XMVectorSet(p[0]->x, p[1]->x, p[2]->x, p[3]->x);
+		lanes.Y = XMVectorSet(p[0]->y, p[1]->y, p[2]->y, p[3]->y);
+		lanes.Z = XMVectorSet(p[0]->z, p[1]->z, p[2]->z, p[3]->z);
+		return lanes;
+	}
+
+	// +1 for x >= 0, -1 otherwise; unlike a plain sign, zero must not collapse the fold.
+	__forceinline XMVECTOR SignNotZero(FXMVECTOR v) {
+		return XMVectorSelect(XMVectorReplicate(-1.0f), XMVectorSplatOne(), XMVectorGreaterOrEqual(v, XMVectorZero()));
+	}
+
+	// Octahedral mapping (Cigolle et al. 2014): project onto the L1 unit sphere and fold the lower
+	//  hemisphere over the diagonals.
+	__forceinline void OctEncodeX4(XMVECTOR x, XMVECTOR y, FXMVECTOR z, XMVECTOR& outU, XMVECTOR& outV) {
+		const XMVECTOR l1 = XMVectorAdd(XMVectorAdd(XMVectorAbs(x), XMVectorAbs(y)), XMVectorAbs(z));
+		const XMVECTOR invL1 = XMVectorReciprocal(XMVectorMax(l1, XMVectorReplicate(FLT_MIN)));
+		x = XMVectorMultiply(x, invL1);
+		y = XMVectorMultiply(y, invL1);
+
+		const XMVECTOR one = XMVectorSplatOne();
+		const XMVECTOR foldedU = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(y)), SignNotZero(x));
+		const XMVECTOR foldedV = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(x)), SignNotZero(y));
+
+		const XMVECTOR lower = XMVectorLess(z, XMVectorZero());
+		outU = XMVectorSelect(x, foldedU, lower);
+		outV = XMVectorSelect(y, foldedV, lower);
+	}
+
+	__forceinline LanesX4 OctDecodeX4(FXMVECTOR u, FXMVECTOR v) {
+		LanesX4 lanes;
+		lanes.Z = XMVectorSubtract(XMVectorSubtract(XMVectorSplatOne(), XMVectorAbs(u)), XMVectorAbs(v));
+
+		// Unfolding the lower hemisphere moves each coordinate toward zero by -z.
+		const XMVECTOR t = XMVectorMax(XMVectorNegate(lanes.Z), XMVectorZero());
+		lanes.X = XMVectorSubtract(u, XMVectorMultiply(t, SignNotZero(u)));
+		lanes.Y = XMVectorSubtract(v, XMVectorMultiply(t, SignNotZero(v)));
+
+		const XMVECTOR lengthSq = XMVectorAdd(XMVectorAdd(
+			XMVectorMultiply(lanes.X, lanes.X), XMVectorMultiply(lanes.Y, lanes.Y)), XMVectorMultiply(lanes.Z, lanes.Z));
+		const XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+		lanes.X = XMVectorMultiply(lanes.X, invLength);
+		lanes.Y = XMVectorMultiply(lanes.Y, invLength);
+		lanes.Z = XMVectorMultiply(lanes.Z, invLength);
+		return lanes;
+	}
+
+	__forceinline __m128i QuantizeSnormX4(FXMVECTOR v) {
+		const XMVECTOR clamped = XMVectorClamp(v, XMVectorReplicate(-1.0f), XMVectorSplatOne());
+		return _mm_cvtps_epi32(XMVectorScale(clamped, SnormScale));
+	}
+
+	// -32768 and -32767 both map to -1, as the SNORM format rules require.
+	__forceinline XMVECTOR DequantizeSnormX4(std::int16_t a, std::int16_t b, std::int16_t c, std::int16_t d) {
+		const XMVECTOR v = XMVectorScale(XMVectorSet(a, b, c, d), 1.0f / SnormScale);
+		return XMVectorMax(v, XMVectorReplicate(-1.0f));
+	}
+
+	struct QuantizedX4 {
+		alignas(16) std::int32_t Lanes[4];
+	};
+
+	__forceinline void Store(__m128i v, QuantizedX4& out) {
+		_mm_store_si128(reinterpret_cast<__m128i*>(out.Lanes), v);
+	}
+
+	__forceinline float AngleDegrees(FXMVECTOR a, FXMVECTOR b) {
+		const float cosine = XMVectorGetX(XMVector3Dot(a, b));
+		return XMConvertToDegrees(std::acos(std::min(std::max(cosine, -1.0f), 1.0f)));
+	}
+}
+
+XMMATRIX VertexQuantization::Dequantization() const {
+	return XMMatrixScaling(Extents.x, Extents.y, Extents.z) * XMMatrixTranslation(Center.x, Center.y, Center.z);
+}
+
+VertexQuantization VertexCompression::CalcQuantization(const Vertex* pVertices, size_t vertexCount) {
+	VertexQuantization quantization;
+	if (vertexCount == 0) return quantization;
+
+	XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const XMVECTOR pos = XMLoadFloat3(&pVertices[i].Pos);
+		minimum = XMVectorMin(minimum, pos);
+		maximum = XMVectorMax(maximum, pos);
+	}
+
+	XMStoreFloat3(&quantization.Center, XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f));
+	XMStoreFloat3(&quantization.Extents, XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f));
+
+	return quantization;
+}
+
+void VertexCompression::Encode(const Vertex* pVertices, size_t vertexCount, const VertexQuantization& quantization, PackedVertex* pOutVertices) {
+	if (vertexCount == 0) return;
+
+	const XMVECTOR center = XMLoadFloat3(&quantization.Center);
+	const XMVECTOR extents = XMLoadFloat3(&quantization.Extents);
+	// A flat axis has zero extent; every position on it encodes to the center.
+	const XMVECTOR invExtents = XMVectorSelect(
+		XMVectorReciprocal(extents), XMVectorZero(), XMVectorLessOrEqual(extents, XMVectorReplicate(FLT_MIN)));
+
+	const XMVECTOR centerX = XMVectorSplatX(center);
+	const XMVECTOR centerY = XMVectorSplatY(center);
+	const XMVECTOR centerZ = XMVectorSplatZ(center);
+	const XMVECTOR invExtentX = XMVectorSplatX(invExtents);
+	const XMVECTOR invExtentY = XMVectorSplatY(invExtents);
+	const XMVECTOR invExtentZ = XMVectorSplatZ(invExtents);
+
+	for (size_t base = 0; base < vertexCount; base += 4) {
+		const size_t count = std::min<size_t>(4, vertexCount - base);
+
+		const XMFLOAT3* positions[4];
+		const XMFLOAT3* normals[4];
+		const XMFLOAT4* tangents[4];
+		for (size_t lane = 0; lane < 4; ++lane) {
+			const Vertex& vertex = pVertices[base + std::min(lane, count - 1)];
+			positions[lane] = &vertex.Pos;
+			normals[lane] = &vertex.Normal;
+			tangents[lane] = &vertex.Tangent;
+		}
+
+		const LanesX4 pos = GatherX4(positions);
+		QuantizedX4 posX, posY, posZ;
+		Store(QuantizeSnormX4(XMVectorMultiply(XMVectorSubtract(pos.X, centerX), invExtentX)), posX);
+		Store(QuantizeSnormX4(XMVectorMultiply(XMVectorSubtract(pos.Y, centerY), invExtentY)), posY);
+		Store(QuantizeSnormX4(XMVectorMultiply(XMVectorSubtract(pos.Z, centerZ), invExtentZ)), posZ);
+
+		const LanesX4 normal = GatherX4(normals);
+		XMVECTOR normalU, normalV;
+		OctEncodeX4(normal.X, normal.Y, normal.Z, normalU, normalV);
+		QuantizedX4 normalQU, normalQV;
+		Store(QuantizeSnormX4(normalU), normalQU);
+		Store(QuantizeSnormX4(normalV), normalQV);
+
+		const LanesX4 tangent = GatherX4(tangents);
+		XMVECTOR tangentU, tangentV;
+		OctEncodeX4(tangent.X, tangent.Y, tangent.Z, tangentU, tangentV);
+		QuantizedX4 tangentQU, tangentQV;
+		Store(QuantizeSnormX4(tangentU), tangentQU);
+		Store(QuantizeSnormX4(tangentV), tangentQV);
+
+		for (size_t lane = 0; lane < count; ++lane) {
+			PackedVertex& out = pOutVertices[base + lane];
+			out.Pos[0] = static_cast<std::int16_t>(posX.Lanes[lane]);
+			out.Pos[1] = static_cast<std::int16_t>(posY.Lanes[lane]);
+			out.Pos[2] = static_cast<std::int16_t>(posZ.Lanes[lane]);
+			out.Pos[3] = static_cast<std::int16_t>(tangents[lane]->w < 0.0f ? -SnormScale : SnormScale);
+			out.Normal[0] = static_cast<std::int16_t>(normalQU.Lanes[lane]);
+			out.Normal[1] = static_cast<std::int16_t>(normalQV.Lanes[lane]);
+			out.Tangent[0] = static_cast<std::int16_t>(tangentQU.Lanes[lane]);
+			out.Tangent[1] = static_cast<std::int16_t>(tangentQV.Lanes[lane]);
+		}
+	}
+
+	XMConvertFloatToHalfStream(&pOutVertices[0].TexC[0], sizeof(PackedVertex), &pVertices[0].TexC.x, sizeof(Vertex), vertexCount);
+	XMConvertFloatToHalfStream(&pOutVertices[0].TexC[1], sizeof(PackedVertex), &pVertices[0].TexC.y, sizeof(Vertex), vertexCount);
+}
+
+void VertexCompression::Decode(const PackedVertex* pVertices, size_t vertexCount, const VertexQuantization& quantization, Vertex* pOutVertices) {
+	if (vertexCount == 0) return;
+
+	const XMVECTOR centerX = XMVectorReplicate(quantization.Center.x);
+	const XMVECTOR centerY = XMVectorReplicate(quantization.Center.y);
+	const XMVECTOR centerZ = XMVectorReplicate(quantization.Center.z);
+	const XMVECTOR extentX = XMVectorReplicate(quantization.Extents.x);
+	const XMVECTOR extentY = XMVectorReplicate(quantization.Extents.y);
+	const XMVECTOR extentZ = XMVectorReplicate(quantization.Extents.z);
+
+	for (size_t base = 0; base < vertexCount; base += 4) {
+		const size_t count = std::min<size_t>(4, vertexCount - base);
+
+		const PackedVertex* v[4];
+		for (size_t lane = 0; lane < 4; ++lane)
+			v[lane] = &pVertices[base + std::min(lane, count - 1)];
+
+		LanesX4 pos;
+		pos.X = XMVectorMultiplyAdd(DequantizeSnormX4(v[0]->Pos[0], v[1]->Pos[0], v[2]->Pos[0], v[3]->Pos[0]), extentX, centerX);
+		pos.Y = XMVectorMultiplyAdd(DequantizeSnormX4(v[0]->Pos[1], v[1]->Pos[1], v[2]->Pos[1], v[3]->Pos[1]), extentY, centerY);
+		pos.Z = XMVectorMultiplyAdd(DequantizeSnormX4(v[0]->Pos[2], v[1]->Pos[2], v[2]->Pos[2], v[3]->Pos[2]), extentZ, centerZ);
+
+		const LanesX4 normal = OctDecodeX4(
+			DequantizeSnormX4(v[0]->Normal[0], v[1]->Normal[0], v[2]->Normal[0], v[3]->Normal[0]),
+			DequantizeSnormX4(v[0]->Normal[1], v[1]->Normal[1], v[2]->Normal[1], v[3]->Normal[1]));
+		const LanesX4 tangent = OctDecodeX4(
+			DequantizeSnormX4(v[0]->Tangent[0], v[1]->Tangent[0], v[2]->Tangent[0], v[3]->Tangent[0]),
+			DequantizeSnormX4(v[0]->Tangent[1], v[1]->Tangent[1], v[2]->Tangent[1], v[3]->Tangent[1]));
+
+		// Transpose back through the stack; the lanes are scattered to an AoS layout anyway.
+		XMFLOAT4A px, py, pz, nx, ny, nz, tx, ty, tz;
+		XMStoreFloat4A(&px, pos.X);     XMStoreFloat4A(&py, pos.Y);     XMStoreFloat4A(&pz, pos.Z);
+		XMStoreFloat4A(&nx, normal.X);  XMStoreFloat4A(&ny, normal.Y);  XMStoreFloat4A(&nz, normal.Z);
+		XMStoreFloat4A(&tx, tangent.X); XMStoreFloat4A(&ty, tangent.Y); XMStoreFloat4A(&tz, tangent.Z);
+
+		const float* lanes[9] = { &px.x, &py.x, &pz.x, &nx.x, &ny.x, &nz.x, &tx.x, &ty.x, &tz.x };
+		for (size_t lane = 0; lane < count; ++lane) {
+			Vertex& out = pOutVertices[base + lane];
+			out.Pos = XMFLOAT3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+			out.Normal = XMFLOAT3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+			out.Tangent = XMFLOAT4(lanes[6][lane], lanes[7][lane], lanes[8][lane], v[lane]->Pos[3] < 0 ? -1.0f : 1.0f);
+		}
+	}
+
+	XMConvertHalfToFloatStream(&pOutVertices[0].TexC.x, sizeof(Vertex), &pVertices[0].TexC[0], sizeof(PackedVertex), vertexCount);
+	XMConvertHalfToFloatStream(&pOutVertices[0].TexC.y, sizeof(Vertex), &pVertices[0].TexC[1], sizeof(PackedVertex), vertexCount);
+}
+
+VertexCompressionReport VertexCompression::Analyze(const Vertex* pVertices, size_t vertexCount) {
+	VertexCompressionReport report;
+	report.VertexCount = vertexCount;
+	report.SourceByteSize = vertexCount * sizeof(Vertex);
+	report.PackedByteSize = vertexCount * sizeof(PackedVertex);
+	if (vertexCount == 0) return report;
+
+	const VertexQuantization quantization = CalcQuantization(pVertices, vertexCount);
+
+	std::vector<PackedVertex> packed(vertexCount);
+	std::vector<Vertex> decoded(vertexCount);
+	Encode(pVertices, vertexCount, quantization, packed.data());
+	Decode(packed.data(), vertexCount, quantization, decoded.data());
+
+	double positionErrorSum = 0.0;
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const Vertex& source = pVertices[i];
+		const Vertex& result = decoded[i];
+
+		const float positionError = XMVectorGetX(XMVector3Length(
+			XMVectorSubtract(XMLoadFloat3(&source.Pos), XMLoadFloat3(&result.Pos))));
+		report.MaxPositionError = std::max(report.MaxPositionError, positionError);
+		positionErrorSum += positionError;
+
+		// Zero-length source directions have nothing to preserve.
+		const XMVECTOR normal = XMLoadFloat3(&source.Normal);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > FLT_EPSILON)
+			report.MaxNormalError = std::max(report.MaxNormalError, AngleDegrees(XMVector3Normalize(normal), XMLoadFloat3(&result.Normal)));
+
+		const XMVECTOR tangent = XMLoadFloat4(&source.Tangent);
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) > FLT_EPSILON)
+			report.MaxTangentError = std::max(report.MaxTangentError, AngleDegrees(XMVector3Normalize(tangent), XMLoadFloat4(&result.Tangent)));
+		if ((source.Tangent.w < 0.0f) != (result.Tangent.w < 0.0f)) ++report.TangentSignMismatchCount;
+
+		report.MaxTexCoordError = std::max(report.MaxTexCoordError, std::max(
+			std::abs(source.TexC.x - result.TexC.x), std::abs(source.TexC.y - result.TexC.y)));
+	}
+	report.MeanPositionError = static_cast<float>(positionErrorSum / vertexCount);
+
+	return report;
+}
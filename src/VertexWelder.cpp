@@ -0,0 +1,195 @@
+#include "VertexWelder.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace {
+	const size_t MinTableCapacity = 64;
+	const std::uint32_t EmptySlot = 0xFFFFFFFF;
+
+	// Keeps the table at most half full so probe sequences stay short.
+	__forceinline size_t CalcTableCapacity(size_t uniqueCount) {
+		size_t capacity = MinTableCapacity;
+		while (capacity < uniqueCount * 2)
+			capacity <<= 1;
+		return capacity;
+	}
+
+	// Bit-exact keys: +0.0f turns -0.0f into +0.0f so signed zeros weld together.
+	__forceinline __m128i ExactBits(__m128 v) {
+		return _mm_castps_si128(_mm_add_ps(v, _mm_setzero_ps()));
+	}
+
+	// Tolerance keys: snaps each component to the nearest multiple of the tolerance.
+	__forceinline __m128i QuantizedBits(__m128 v, __m128 invTolerance) {
+		return _mm_cvtps_epi32(_mm_mul_ps(v, invTolerance));
+	}
+
+	// Mixes the 256-bit key in two 128-bit lanes; 32x32->64 multiplies on even and odd
+	//  lanes, then folds and finalizes with the murmur3 fmix64 avalanche.
+	__forceinline std::uint32_t HashKey(const std::int32_t* bits) {
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + 4));
+
+		const __m128i prime0 = _mm_set1_epi32(static_cast<int>(0x9E3779B1u));
+		const __m128i prime1 = _mm_set1_epi32(static_cast<int>(0x85EBCA77u));
+
+		const __m128i x = _mm_xor_si128(lo, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 1, 0, 3)));
+		const __m128i even = _mm_mul_epu32(x, prime0);
+		const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), prime1);
+		const __m128i folded = _mm_xor_si128(even, odd);
+
+		std::uint64_t h[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(h), folded);
+
+		std::uint64_t k = h[0] ^ (h[1] * 0xC2B2AE3D27D4EB4Full);
+		k ^= k >> 33;
+		k *= 0xFF51AFD7ED558CCDull;
+		k ^= k >> 33;
+		k *= 0xC4CEB9FE1A85EC53ull;
+		k ^= k >> 33;
+
+		return static_cast<std::uint32_t>(k);
+	}
+
+	__forceinline bool KeyEqual(const std::int32_t* a, const std::int32_t* b) {
+		const __m128i eq0 = _mm_cmpeq_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+		const __m128i eq1 = _mm_cmpeq_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 4)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 4)));
+		return _mm_movemask_epi8(_mm_and_si128(eq0, eq1)) == 0xFFFF;
+	}
+}
+
+VertexWelder::VertexWelder() : VertexWelder(WeldTolerance()) {}
+
+VertexWelder::VertexWelder(const WeldTolerance& tolerance, size_t expectedUniqueCount) {
+	mTolerance = tolerance;
+	mInvPosTolerance = tolerance.Position > 0.0f ? 1.0f / tolerance.Position : 0.0f;
+	mInvNormalTolerance = tolerance.Normal > 0.0f ? 1.0f / tolerance.Normal : 0.0f;
+	mInvTexCoordTolerance = tolerance.TexCoord > 0.0f ? 1.0f / tolerance.TexCoord : 0.0f;
+
+	mSlotMask = 0;
+
+	Reserve(expectedUniqueCount);
+}
+
+void VertexWelder::Reserve(size_t expectedUniqueCount) {
+	mKeys.reserve(expectedUniqueCount);
+	mHashes.reserve(expectedUniqueCount);
+	mVertices.reserve(expectedUniqueCount);
+
+	const size_t capacity = CalcTableCapacity(expectedUniqueCount);
+	if (capacity > mSlots.size())
+		Rehash(capacity);
+}
+
+void VertexWelder::Clear() {
+	std::fill(mSlots.begin(), mSlots.end(), EmptySlot);
+	mKeys.clear();
+	mHashes.clear();
+	mVertices.clear();
+	mStats = WeldStats();
+	mStats.TableCapacity = mSlots.size();
+}
+
+std::uint32_t VertexWelder::Insert(const Vertex& vertex) {
+	if (mSlots.empty())
+		Rehash(MinTableCapacity);
+
+	VertexKey key;
+	MakeKey(vertex, key);
+
+	const std::uint32_t hash = HashKey(key.Bits);
+
+	++mStats.InputVertexCount;
+
+	size_t slot = hash & mSlotMask;
+	while (true) {
+		++mStats.ProbeCount;
+
+		const std::uint32_t index = mSlots[slot];
+		if (index == EmptySlot)
+			break;
+		if (mHashes[index] == hash && KeyEqual(mKeys[index].Bits, key.Bits))
+			return index;
+
+		slot = (slot + 1) & mSlotMask;
+	}
+
+	const std::uint32_t index = static_cast<std::uint32_t>(mVertices.size());
+	mSlots[slot] = index;
+	mKeys.push_back(key);
+	mHashes.push_back(hash);
+	mVertices.push_back(vertex);
+
+	++mStats.UniqueVertexCount;
+
+	if (mVertices.size() * 2 > mSlots.size())
+		Rehash(mSlots.size() * 2);
+
+	return index;
+}
+
+void VertexWelder::Insert(const Vertex* pVertices, size_t count, std::vector<std::uint32_t>& outIndices) {
+	outIndices.reserve(outIndices.size() + count);
+	for (size_t i = 0; i < count; ++i)
+		outIndices.push_back(Insert(pVertices[i]));
+}
+
+void VertexWelder::Release(std::vector<Vertex>& outVertices) {
+	outVertices = std::move(mVertices);
+
+	mVertices = std::vector<Vertex>();
+	mKeys = std::vector<VertexKey>();
+	mHashes = std::vector<std::uint32_t>();
+	mSlots = std::vector<std::uint32_t>();
+	mSlotMask = 0;
+}
+
+void VertexWelder::MakeKey(const Vertex& vertex, VertexKey& outKey) const {
+	// Pos.xyz | Normal.x
+	const __m128 v0 = _mm_setr_ps(vertex.Pos.x, vertex.Pos.y, vertex.Pos.z, vertex.Normal.x);
+	// Normal.yz | TexC.xy
+	const __m128 v1 = _mm_setr_ps(vertex.Normal.y, vertex.Normal.z, vertex.TexC.x, vertex.TexC.y);
+
+	__m128i k0;
+	__m128i k1;
+
+	if (mInvPosTolerance == 0.0f && mInvNormalTolerance == 0.0f && mInvTexCoordTolerance == 0.0f) {
+		k0 = ExactBits(v0);
+		k1 = ExactBits(v1);
+	}
+	else {
+		const __m128 inv0 = _mm_setr_ps(mInvPosTolerance, mInvPosTolerance, mInvPosTolerance, mInvNormalTolerance);
+		const __m128 inv1 = _mm_setr_ps(mInvNormalTolerance, mInvNormalTolerance, mInvTexCoordTolerance, mInvTexCoordTolerance);
+
+		// Components with a zero tolerance keep their exact bits.
+		const __m128 exact0 = _mm_cmpeq_ps(inv0, _mm_setzero_ps());
+		const __m128 exact1 = _mm_cmpeq_ps(inv1, _mm_setzero_ps());
+		const __m128i mask0 = _mm_castps_si128(exact0);
+		const __m128i mask1 = _mm_castps_si128(exact1);
+
+		k0 = _mm_or_si128(_mm_and_si128(mask0, ExactBits(v0)), _mm_andnot_si128(mask0, QuantizedBits(v0, inv0)));
+		k1 = _mm_or_si128(_mm_and_si128(mask1, ExactBits(v1)), _mm_andnot_si128(mask1, QuantizedBits(v1, inv1)));
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(outKey.Bits), k0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(outKey.Bits + 4), k1);
+}
+
+void VertexWelder::Rehash(size_t newCapacity) {
+	mSlots.assign(newCapacity, EmptySlot);
+	mSlotMask = newCapacity - 1;
+
+	for (size_t i = 0, end = mHashes.size(); i < end; ++i) {
+		size_t slot = mHashes[i] & mSlotMask;
+		while (mSlots[slot] != EmptySlot)
+			slot = (slot + 1) & mSlotMask;
+		mSlots[slot] = static_cast<std::uint32_t>(i);
+	}
+
+	mStats.TableCapacity = newCapacity;
+}
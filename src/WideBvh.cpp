@@ -0,0 +1,169 @@
+#include "WideBvh.h"
+#include "Logger.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+	const int MinExponent = -126;
+	const int MaxQuantized = 255;
+
+	float HalfArea(const BvhNode& node) {
+		const float dx = node.BoundsMax.x - node.BoundsMin.x;
+		const float dy = node.BoundsMax.y - node.BoundsMin.y;
+		const float dz = node.BoundsMax.z - node.BoundsMin.z;
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	__forceinline float Component(const DirectX::XMFLOAT3& v, UINT axis) {
+		return (&v.x)[axis];
+	}
+
+	// Binary nodes that become the slots of one wide node.
+	UINT GatherChildren(const Bvh& bvh, UINT index, UINT (&outChildren)[WideBvhWidth]) {
+		const BvhNode& node = bvh.Nodes[index];
+		if (node.IsLeaf()) {
+			outChildren[0] = index;
+			return 1;
+		}
+
+		outChildren[0] = node.LeftFirst;
+		outChildren[1] = node.LeftFirst + 1;
+		UINT count = 2;
+
+		while (count < WideBvhWidth) {
+			UINT best = WideBvhWidth;
+			float bestArea = -1.0f;
+			for (UINT i = 0; i < count; ++i) {
+				const BvhNode& child = bvh.Nodes[outChildren[i]];
+				if (child.IsLeaf()) continue;
+
+				const float area = HalfArea(child);
+				if (area > bestArea) {
+					best = i;
+					bestArea = area;
+				}
+			}
+			if (best == WideBvhWidth) break;
+
+			const UINT expanded = bvh.Nodes[outChildren[best]].LeftFirst;
+			outChildren[best] = expanded;
+			outChildren[count++] = expanded + 1;
+		}
+
+		return count;
+	}
+
+	// Picks the smallest cell size along one axis whose grid holds every child within 8 bits.
+	// q * 2^e is exact, so origin + q * 2^e decodes to the same float with or without FMA, and
+	//  the planes are checked against exactly what traversal will compute.
+	void QuantizeAxis(const Bvh& bvh, const UINT* pChildren, UINT count, UINT axis, WideBvhNode& outNode) {
+		const float origin = Component(outNode.Origin, axis);
+
+		float extent = 0.0f;
+		for (UINT i = 0; i < count; ++i)
+			extent = std::max(extent, Component(bvh.Nodes[pChildren[i]].BoundsMax, axis) - origin);
+
+		int exponent = extent > 0.0f ? static_cast<int>(std::ceil(std::log2(extent / MaxQuantized))) : MinExponent;
+		exponent = std::max(exponent, MinExponent);
+
+		for (;; ++exponent) {
+			const float scale = std::ldexp(1.0f, exponent);
+
+			bool bFits = true;
+			for (UINT i = 0; i < count && bFits; ++i) {
+				const BvhNode& child = bvh.Nodes[pChildren[i]];
+				const float childMin = Component(child.BoundsMin, axis);
+				const float childMax = Component(child.BoundsMax, axis);
+
+				int qMin = std::clamp(static_cast<int>(std::floor((childMin - origin) / scale)), 0, MaxQuantized);
+				while (qMin > 0 && origin + qMin * scale > childMin)
+					--qMin;
+				int qMax = std::clamp(static_cast<int>(std::ceil((childMax - origin) / scale)), 0, MaxQuantized);
+				while (qMax < MaxQuantized && origin + qMax * scale < childMax)
+					++qMax;
+
+				bFits = origin + qMin * scale <= childMin && origin + qMax * scale >= childMax;
+
+				outNode.QuantizedMin[axis][i] = static_cast<std::uint8_t>(qMin);
+				outNode.QuantizedMax[axis][i] = static_cast<std::uint8_t>(qMax);
+			}
+
+			if (bFits) {
+				outNode.Exponent[axis] = static_cast<std::int8_t>(exponent);
+				return;
+			}
+		}
+	}
+}
+
+bool WideBvhBuilder::Collapse(const Bvh& bvh, WideBvh& outBvh, WideBvhStats* pStats) {
+	if (bvh.Nodes.empty()) ReturnFalse(L"Wide BVH needs a built binary hierarchy");
+
+	Stopwatch timer;
+
+	outBvh.Mesh = bvh.Mesh;
+	outBvh.Nodes.clear();
+	outBvh.Nodes.reserve(bvh.Nodes.size() / 4 + 1);
+	outBvh.TriangleIndices.clear();
+	outBvh.TriangleIndices.reserve(bvh.TriangleIndices.size());
+
+	// Binary node every wide node is collapsed from; wide nodes are emitted breadth-first, so the
+	//  interior children of a node end up next to each other.
+	std::vector<UINT> sources = { 0 };
+	UINT leafCount = 0;
+	UINT slotCount = 0;
+
+	for (size_t n = 0; n < sources.size(); ++n) {
+		UINT children[WideBvhWidth];
+		const UINT count = GatherChildren(bvh, sources[n], children);
+
+		WideBvhNode node = {};
+		node.ChildBase = static_cast<UINT>(sources.size());
+		node.TriangleBase = static_cast<UINT>(outBvh.TriangleIndices.size());
+
+		DirectX::XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		for (UINT slot = 0; slot < count; ++slot) {
+			const BvhNode& child = bvh.Nodes[children[slot]];
+			boundsMin.x = std::min(boundsMin.x, child.BoundsMin.x);
+			boundsMin.y = std::min(boundsMin.y, child.BoundsMin.y);
+			boundsMin.z = std::min(boundsMin.z, child.BoundsMin.z);
+
+			if (child.IsLeaf()) {
+				if (child.TriangleCount > 0xFF) ReturnFalse(L"Wide BVH leaves hold at most 255 triangles");
+
+				node.TriangleCounts[slot] = static_cast<std::uint8_t>(child.TriangleCount);
+				outBvh.TriangleIndices.insert(outBvh.TriangleIndices.end(),
+					bvh.TriangleIndices.begin() + child.LeftFirst, bvh.TriangleIndices.begin() + child.LeftFirst + child.TriangleCount);
+				++leafCount;
+			}
+			else {
+				node.InteriorMask |= static_cast<std::uint8_t>(1u << slot);
+				sources.push_back(children[slot]);
+			}
+		}
+
+		node.Origin = boundsMin;
+		for (UINT axis = 0; axis < 3; ++axis)
+			QuantizeAxis(bvh, children, count, axis, node);
+
+		outBvh.Nodes.push_back(node);
+		slotCount += count;
+	}
+
+	if (pStats != nullptr) {
+		pStats->NodeCount = static_cast<UINT>(outBvh.Nodes.size());
+		pStats->LeafCount = leafCount;
+		pStats->AverageChildCount = static_cast<float>(slotCount) / static_cast<float>(outBvh.Nodes.size());
+		pStats->MemoryBytes = outBvh.Nodes.size() * sizeof(WideBvhNode) + outBvh.TriangleIndices.size() * sizeof(UINT);
+		pStats->CollapseMilliseconds = timer.ElapsedMilliseconds();
+	}
+
+	return true;
+}
+
+size_t WideBvhBuilder::CalcMemoryBytes(const Bvh& bvh) {
+	return bvh.Nodes.size() * sizeof(BvhNode) + bvh.TriangleIndices.size() * sizeof(UINT);
+}